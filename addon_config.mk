@@ -6,5 +6,12 @@ meta:
 	ADDON_URL = http://github.com/nama-gatsuo/ofxAtem
 
 common:
+	# Off Windows the addon talks to the switcher over its UDP control protocol. The COM
+	# sources and libs/compat compile to nothing there unless the project defines
+	# OFX_ATEM_COM_COMPAT, which builds the COM backend against the shim and the fake switcher.
 
-vs:	
+vs:
+	# the native protocol client and the emulator are POSIX only, Windows builds go through the SDK
+	ADDON_SOURCES_EXCLUDE = src/AtemUdpClient.cpp src/AtemUdpBackend.cpp src/AtemEmulator.cpp src/AtemDeviceManager.cpp src/AtemSessionRecorder.cpp src/AtemBroker.cpp libs/compat/%
+	# the COM shim would shadow the real ATL and COM headers
+	ADDON_INCLUDES_EXCLUDE = libs/compat/%
@@ -0,0 +1,13 @@
+#include "ofMain.h"
+#include "ofAppNoWindow.h"
+#include "ofApp.h"
+
+//========================================================================
+int main( ){
+
+	// headless, results are printed to the console
+	auto window = std::make_shared<ofAppNoWindow>();
+	ofRunApp(window, std::make_shared<ofApp>());
+	return ofRunMainLoop();
+
+}
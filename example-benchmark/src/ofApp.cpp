@@ -0,0 +1,1580 @@
+#include "ofApp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "AtemFourccDispatch.h"
+
+static const uint16_t kEmulatorPort = 9911;
+
+// Heap allocations made by the current thread, counted by the global operator new below
+static thread_local uint64_t threadAllocations = 0;
+
+void* operator new(size_t size) {
+	threadAllocations++;
+	if (void* p = malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+// GCC cannot tell that operator new above is malloc underneath once both are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+static uint64_t nowMicros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void printStats(const std::string& name, std::vector<uint64_t> samples) {
+	if (samples.empty()) {
+		printf(" %-40s no samples\n", name.c_str());
+		return;
+	}
+	std::sort(samples.begin(), samples.end());
+	uint64_t sum = 0;
+	for (auto s : samples) sum += s;
+	printf(" %-40s mean %8.1f us  p50 %6llu us  p99 %6llu us  (n=%d)\n", name.c_str(),
+		(double)sum / samples.size(),
+		(unsigned long long)samples[samples.size() / 2],
+		(unsigned long long)samples[std::min(samples.size() - 1, samples.size() * 99 / 100)],
+		(int)samples.size());
+}
+
+// Program changes reported by one device, for devices other than ofApp::atem
+struct ProgramListener {
+	std::atomic<uint64_t> programEvents{ 0 };
+	void onMixEffectBlockChanged(BMDSwitcherMixEffectBlockEventType& e) {
+		if (e == bmdSwitcherMixEffectBlockEventTypeProgramInputChanged) programEvents++;
+	}
+};
+
+// When a device last reported its link degraded and restored, 0 until it does
+struct LinkWatcher {
+	std::atomic<uint64_t> degradedMicros{ 0 };
+	std::atomic<uint64_t> restoredMicros{ 0 };
+	void onLinkDegraded(ofxAtem::ConnectionHealth&) { degradedMicros = nowMicros(); }
+	void onLinkRestored(ofxAtem::ConnectionHealth&) { restoredMicros = nowMicros(); }
+};
+
+// Polls until done(i) holds for every i < count, false on timeout
+static bool allReached(const std::function<bool(int)>& done, int count, uint64_t timeoutMillis) {
+	uint64_t deadline = nowMicros() + timeoutMillis * 1000;
+	for (;;) {
+		int n = 0;
+		while (n < count && done(n)) n++;
+		if (n == count) return true;
+		if (nowMicros() > deadline) return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+// Threads of this process, 0 where /proc is not available
+static int countThreads() {
+	DIR* dir = opendir("/proc/self/task");
+	if (!dir) return 0;
+	int count = 0;
+	while (dirent* entry = readdir(dir)) {
+		if (entry->d_name[0] != '.') count++;
+	}
+	closedir(dir);
+	return count;
+}
+
+void ofApp::setup() {
+
+	ofxAtem::EmulatorTopology topology;
+	topology.externalInputs = 40;
+	topology.mixEffectBlocks = 2;
+	topology.auxOutputs = 6;
+	topology.mediaPlayers = 2;
+	topology.superSources = 1;
+
+	if (!emulator.start(topology, kEmulatorPort)) {
+		ofExit(1);
+		return;
+	}
+	address = "127.0.0.1:" + ofToString(kEmulatorPort);
+
+	benchConnect();
+	benchWarmStart();
+
+	if (!atem.connect(address)) {
+		ofExit(1);
+		return;
+	}
+	ofAddListener(atem.mixEffectBlockChanged, this, &ofApp::onMixEffectBlockChanged);
+	ofAddListener(atem.disconnected, this, &ofApp::onDisconnected);
+	ofAddListener(atem.reconnected, this, &ofApp::onReconnected);
+
+	benchRoundTrip();
+	benchEventThroughput(0);
+	benchEventThroughput(0.05f);
+	benchMixEffectSnapshot();
+	benchMixEffectBlocks();
+	benchEventQueue();
+	benchCoalescing();
+	benchInputLookup();
+	benchBatching();
+	benchAllocations();
+	benchLossyDelivery(0);
+	benchLossyDelivery(0.05f);
+	benchLossyDelivery(0.2f);
+	benchMediaUpload(1, 0);
+	benchMediaUpload(4, 0);
+	benchMediaUpload(16, 0);
+	benchMediaUpload(24, 0);
+	benchMediaUpload(31, 0);
+	benchMediaUpload(24, 0.01f);
+	benchRleRoundTrip();
+	benchRleCodec();
+	benchTimecodeRoundTrip();
+	benchSwitcherClock(0);
+	benchSwitcherClock(100);
+	benchDeviceManager(32);
+	benchBroker(32);
+	benchLoad(128);
+	benchReplay();
+	benchRecordDispatch();
+	benchLiveness();
+	benchReconnect();
+#ifdef OFX_ATEM_COM_COMPAT
+	benchComBackend();
+#endif
+
+	if (failedChecks) printf(" %d check(s) FAILED\n", failedChecks);
+	ofExit(failedChecks ? 1 : 0);
+}
+
+void ofApp::exit() {
+	ofRemoveListener(atem.mixEffectBlockChanged, this, &ofApp::onMixEffectBlockChanged);
+	ofRemoveListener(atem.disconnected, this, &ofApp::onDisconnected);
+	ofRemoveListener(atem.reconnected, this, &ofApp::onReconnected);
+	atem.disconnect();
+	emulator.stop();
+}
+
+void ofApp::onDisconnected() {
+	disconnectedEvents++;
+}
+
+void ofApp::onReconnected() {
+	reconnectedEvents++;
+}
+
+void ofApp::onMixEffectBlockChanged(BMDSwitcherMixEffectBlockEventType& e) {
+	if (e == bmdSwitcherMixEffectBlockEventTypeProgramInputChanged) {
+		programEvents++;
+	}
+}
+
+// Counts a failed check, passes the result through
+bool ofApp::check(bool passed) {
+	if (!passed) failedChecks++;
+	return passed;
+}
+
+bool ofApp::waitForEvents(uint64_t target, uint64_t timeoutMillis) {
+	uint64_t deadline = nowMicros() + timeoutMillis * 1000;
+	while (programEvents < target) {
+		if (nowMicros() > deadline) return false;
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+void ofApp::benchConnect() {
+	std::vector<uint64_t> samples;
+	for (int i = 0; i < 10; i++) {
+		ofxAtem::Device device;
+		uint64_t start = nowMicros();
+		if (device.connect(address)) {
+			samples.push_back(nowMicros() - start);
+		}
+		device.disconnect();
+	}
+	printStats("connect + state sync", samples);
+
+	// The caller only pays for opening the socket, the dump is parsed on the receive thread
+	std::vector<uint64_t> returnSamples;
+	samples.clear();
+	for (int i = 0; i < 10; i++) {
+		ofxAtem::Device device;
+		uint64_t start = nowMicros();
+		std::future<bool> result = device.connectAsync(address);
+		returnSamples.push_back(nowMicros() - start);
+		if (result.get()) {
+			samples.push_back(nowMicros() - start);
+		}
+		device.disconnect();
+	}
+	printStats("connectAsync returns", returnSamples);
+	printStats("connectAsync -> ready", samples);
+}
+
+void ofApp::benchWarmStart() {
+	std::string cacheDirectory = ofToDataPath("state-cache");
+	ofDirectory::removeDirectory(cacheDirectory, true, false);
+
+	// Paced like a switcher on a real network, otherwise the whole dump arrives at once.
+	// The first connect writes the snapshot, the others start from it
+	std::vector<uint64_t> cold, warm;
+	emulator.setPacketInterval(20);
+	for (int i = 0; i < 10; i++) {
+		ofxAtem::Device device;
+		device.getBackend().setStateCacheDirectory(cacheDirectory);
+		uint64_t start = nowMicros();
+		if (device.connect(address)) {
+			uint64_t elapsed = nowMicros() - start;
+			(device.getBackend().getClient().isWarmStarted() ? warm : cold).push_back(elapsed);
+		}
+		device.disconnect();
+	}
+	printStats("connect, cold", cold);
+	printStats("connect, warm from state cache", warm);
+
+	// Tally moved while nobody was connected: the reconciled dump reports just that
+	struct Counter {
+		std::atomic<int> count{ 0 };
+		void onEvent(BMDSwitcherMixEffectBlockEventType&) { count++; }
+	} counter;
+	ofxAtem::Device device;
+	device.getBackend().setStateCacheDirectory(cacheDirectory);
+	ofAddListener(device.mixEffectBlockChanged, &counter, &Counter::onEvent);
+	emulator.setProgramInput(0, 5);
+	device.connect(address);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	printf(" %-40s %d event(s), program now %s\n", "reconcile after warm start", counter.count.load(),
+		device.getInputMap()[device.getProgramIndex()]->shortName.c_str());
+	ofRemoveListener(device.mixEffectBlockChanged, &counter, &Counter::onEvent);
+	device.disconnect();
+	emulator.setPacketInterval(0);
+
+	// Alternating with a switcher of the same model but fewer inputs, every connect warm starts
+	// from the other's snapshot: ready comes with the stale input map and the receive thread
+	// swaps in the live one while another thread is reading it
+	ofxAtem::EmulatorTopology smaller;
+	smaller.externalInputs = 8;
+	ofxAtem::Emulator other;
+	if (!check(other.start(smaller, kEmulatorPort + 1))) return;
+	other.setPacketInterval(2);
+	std::string otherAddress = "127.0.0.1:" + ofToString(kEmulatorPort + 1);
+
+	struct Rebuilds {
+		std::atomic<bool> seen{ false };
+		void onInputsChanged() { seen = true; }
+	};
+	int rounds = 20, rebuilds = 0;
+	std::atomic<uint64_t> reads{ 0 }, torn{ 0 };
+	for (int i = 0; i < rounds; i++) {
+		ofxAtem::Device swapped;
+		Rebuilds rebuilt;
+		swapped.getBackend().setStateCacheDirectory(cacheDirectory);
+		ofAddListener(swapped.inputsChanged, &rebuilt, &Rebuilds::onInputsChanged);
+		if (!swapped.connect(i % 2 ? address : otherAddress)) continue;
+
+		std::atomic<bool> reading{ true };
+		std::thread reader([&] {
+			while (reading) {
+				const std::vector<ofPtr<ofxAtem::Input>>& inputs = swapped.getInputMap();
+				for (size_t j = 0; j < inputs.size(); j++) {
+					if (inputs[j]->index != (int)j) torn++;
+				}
+				if (swapped.getIndexByName("BLK") != 0 || swapped.getInputById(1) == nullptr) torn++;
+				reads++;
+			}
+		});
+		uint64_t deadline = nowMicros() + 1000000;
+		while (!rebuilt.seen && nowMicros() < deadline) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		reading = false;
+		reader.join();
+		if (rebuilt.seen) rebuilds++;
+		ofRemoveListener(swapped.inputsChanged, &rebuilt, &Rebuilds::onInputsChanged);
+		swapped.disconnect();
+	}
+	other.stop();
+	check(torn == 0);
+	printf(" %-40s %d / %d rebuilt under a reader, %llu reads, %llu torn\n", "input map swap after warm start",
+		rebuilds, rounds, (unsigned long long)reads.load(), (unsigned long long)torn.load());
+}
+
+void ofApp::benchRoundTrip() {
+	std::vector<uint64_t> samples;
+	int inputCount = (int)atem.getInputMap().size();
+	for (int i = 0; i < 500; i++) {
+		uint64_t target = programEvents + 1;
+		uint64_t start = nowMicros();
+		atem.setProgramByIndex((i + 1) % inputCount);
+		if (waitForEvents(target, 1000)) {
+			samples.push_back(nowMicros() - start);
+		}
+	}
+	printStats("setProgram -> program changed", samples);
+}
+
+void ofApp::benchEventThroughput(float lossRate) {
+	const int count = 20000;
+	ofxAtem::UdpClient& client = atem.getBackend().getClient();
+	uint64_t heldBefore = client.getHeldPacketCount();
+
+	// With loss, packets behind a dropped one wait in their receive buffers for the resend
+	emulator.setLossRate(lossRate);
+	uint64_t target = programEvents + count;
+	uint64_t start = nowMicros();
+	emulator.sendProgramBurst(0, count);
+	waitForEvents(target, 10000);
+	uint64_t elapsed = nowMicros() - start;
+	uint64_t received = count - (target - std::min<uint64_t>(target, programEvents));
+	emulator.setLossRate(0);
+
+	std::string name = "program change burst, " + ofToString(lossRate * 100, 0) + "% loss";
+	printf(" %-40s %llu / %d events in %.1f ms, %.0f events/s, %llu packets held\n", name.c_str(),
+		(unsigned long long)received, count, elapsed / 1000.0, received * 1e6 / elapsed,
+		(unsigned long long)(client.getHeldPacketCount() - heldBefore));
+}
+
+void ofApp::benchMixEffectSnapshot() {
+	const int count = 5000;
+	const std::vector<ofPtr<ofxAtem::Input>>& inputs = atem.getInputMap();
+
+	// A render thread reading the snapshot flat out while the receive thread rewrites it
+	std::atomic<bool> running{ true };
+	std::atomic<uint64_t> reads{ 0 }, torn{ 0 }, versions{ 0 };
+	std::thread reader([&] {
+		uint64_t lastVersion = 0;
+		while (running) {
+			ofxAtem::MixEffectState state;
+			uint64_t version = atem.getMixEffectState(0, state);
+			if (state.programIndex < 0 || state.programIndex >= (int)inputs.size() || inputs[state.programIndex]->bmdId != state.program) torn++;
+			if (version != lastVersion) versions++;
+			lastVersion = version;
+			reads++;
+		}
+	});
+	uint64_t target = programEvents + count;
+	uint64_t start = nowMicros();
+	emulator.sendProgramBurst(0, count);
+	waitForEvents(target, 10000);
+	uint64_t elapsed = nowMicros() - start;
+	running = false;
+	reader.join();
+
+	// And uncontended, as ofApp::update() sees it between changes
+	const int loads = 1000000;
+	int sum = 0;
+	uint64_t loadStart = nowMicros();
+	for (int i = 0; i < loads; i++) sum += atem.getProgramIndex();
+	double loadNanos = (nowMicros() - loadStart) * 1000.0 / loads;
+	// Keeps the loads from being optimised away
+	if (sum == 1) printf(" ");
+
+	check(torn == 0);
+	printf(" %-40s %.1f M reads/s during %d cuts, %llu versions seen, %llu torn, %.1f ns uncontended\n", "ME snapshot reads",
+		reads / (double)elapsed, count, (unsigned long long)versions, (unsigned long long)torn, loadNanos);
+}
+
+void ofApp::benchMixEffectBlocks() {
+	const int count = 5000;
+	const std::vector<ofPtr<ofxAtem::Input>>& inputs = atem.getInputMap();
+	int inputCount = (int)inputs.size();
+
+	// Cuts on ME 2, seen in its own snapshot only
+	std::vector<uint64_t> samples;
+	int program0 = atem.getProgramIndex(0);
+	for (int i = 0; i < 200; i++) {
+		int program = (atem.getProgramIndex(1) + 1) % inputCount;
+		uint64_t start = nowMicros();
+		atem.setProgram(1, program);
+		while (atem.getProgramIndex(1) != program && nowMicros() - start < 1000000) std::this_thread::yield();
+		if (atem.getProgramIndex(1) == program) samples.push_back(nowMicros() - start);
+	}
+	printStats("setProgram(ME 2) -> ME 2 snapshot", samples);
+
+	uint64_t start = nowMicros();
+	atem.setKeyerOnAir(1, 0, true);
+	bool onAir = allReached([&](int) { return (atem.getMixEffectState(1).keyersOnAir & 1) != 0; }, 1, 1000);
+	uint64_t keyerMicros = nowMicros() - start;
+	atem.setKeyerOnAir(1, 0, false);
+	bool offAir = allReached([&](int) { return atem.getMixEffectState(1).keyersOnAir == 0; }, 1, 1000);
+	printf(" %-40s %s in %.2f ms, off air %s, ME 1 program %s\n", "ME 2 keyer on air", check(onAir) ? "mirrored" : "MISSING",
+		keyerMicros / 1000.0, check(offAir) ? "mirrored" : "MISSING", check(atem.getProgramIndex(0) == program0) ? "untouched" : "CHANGED");
+
+	// A reader per ME while ME 2 takes a burst of cuts: ME 1 readers never see a new version
+	std::atomic<bool> running{ true };
+	std::atomic<uint64_t> reads[2] = {}, torn[2] = {}, versions[2] = {};
+	std::vector<std::thread> readers;
+	for (int me = 0; me < 2; me++) {
+		readers.emplace_back([&, me] {
+			uint64_t lastVersion = atem.getMixEffectVersion(me);
+			while (running) {
+				ofxAtem::MixEffectState state;
+				uint64_t version = atem.getMixEffectState(me, state);
+				if (state.programIndex < 0 || state.programIndex >= inputCount || inputs[state.programIndex]->bmdId != state.program) torn[me]++;
+				if (version != lastVersion) versions[me]++;
+				lastVersion = version;
+				reads[me]++;
+			}
+		});
+	}
+	uint64_t target = programEvents + count;
+	start = nowMicros();
+	emulator.sendProgramBurst(1, count);
+	waitForEvents(target, 10000);
+	uint64_t elapsed = nowMicros() - start;
+	running = false;
+	for (auto& reader : readers) reader.join();
+
+	for (int me = 0; me < 2; me++) {
+		std::string name = "ME " + ofToString(me + 1) + " reads during ME 2 cuts";
+		check(torn[me] == 0);
+		printf(" %-40s %.1f M reads/s, %llu versions seen, %llu torn\n", name.c_str(), reads[me] / (double)elapsed,
+			(unsigned long long)versions[me], (unsigned long long)torn[me]);
+	}
+}
+
+void ofApp::benchEventQueue() {
+	// An SDK callback thread handing events to the update() thread, as ComBackend does
+	const int count = 2000000;
+	ofxAtem::SpscQueue<ofxAtem::MixEffectEvent, 1024> queue;
+	std::atomic<uint64_t> full{ 0 };
+	uint64_t producerMicros = 0;
+	uint64_t start = nowMicros();
+	std::thread producer([&] {
+		uint64_t producerStart = nowMicros();
+		ofxAtem::MixEffectEvent e;
+		for (int i = 0; i < count; i++) {
+			e.me = i & 3;
+			while (!queue.push(e)) {
+				full++;
+				std::this_thread::yield();
+			}
+		}
+		producerMicros = nowMicros() - producerStart;
+	});
+	uint64_t popped = 0, outOfOrder = 0;
+	ofxAtem::MixEffectEvent e;
+	while (popped < (uint64_t)count) {
+		if (!queue.pop(e)) {
+			std::this_thread::yield();
+			continue;
+		}
+		if (e.me != int(popped & 3)) outOfOrder++;
+		popped++;
+	}
+	uint64_t elapsed = nowMicros() - start;
+	producer.join();
+	check(outOfOrder == 0);
+	printf(" %-40s %.1f M events/s, %.1f ns / push, %llu pushes on a full queue, %llu out of order\n", "spsc event queue, 1024 slots",
+		popped / (double)elapsed, producerMicros * 1000.0 / count, (unsigned long long)full.load(), (unsigned long long)outOfOrder);
+}
+
+void ofApp::benchCoalescing() {
+	// A lever ride on both MEs to a listener taking 5 ms a position, e.g. redrawing: whatever
+	// piles up meanwhile reaches it once per ME instead of queueing behind it
+	struct TransitionCounter {
+		std::atomic<uint64_t> position{ 0 }, lastMicros{ 0 };
+		void onMixEffectBlockChanged(BMDSwitcherMixEffectBlockEventType& e) {
+			if (e != bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged) return;
+			position++;
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			lastMicros = nowMicros();
+		}
+	} counter;
+	ofxAtem::EventCoalescer& coalescer = atem.getEventCoalescer();
+	uint64_t received = coalescer.getReceivedCount();
+	uint64_t merged = coalescer.getMergedCount(bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged);
+	ofAddListener(atem.mixEffectBlockChanged, &counter, &TransitionCounter::onMixEffectBlockChanged);
+	ofxAtem::EmulatorStorm storm;
+	storm.transitionRate = 2000;
+	emulator.setStorm(storm);
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	emulator.setStorm(ofxAtem::EmulatorStorm());
+	uint64_t stormEnd = nowMicros();
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	ofRemoveListener(atem.mixEffectBlockChanged, &counter, &TransitionCounter::onMixEffectBlockChanged);
+	merged = coalescer.getMergedCount(bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged) - merged;
+	printf(" %-40s %llu events in, %llu positions out, %llu merged, listener done %.0f ms after the storm\n", "coalescing, listener at 5 ms / event",
+		(unsigned long long)(coalescer.getReceivedCount() - received), (unsigned long long)counter.position.load(), (unsigned long long)merged,
+		counter.lastMicros > stormEnd ? (counter.lastMicros - stormEnd) / 1000.0 : 0.0);
+
+	// A frame's worth of SDK notifications per drain: position and frames remaining 16 times
+	// over on 4 MEs, and a cut
+	ofxAtem::EventCoalescer frame;
+	const int frames = 20000;
+	uint64_t delivered = 0;
+	uint64_t allocationsBefore = threadAllocations;
+	uint64_t start = nowMicros();
+	for (int f = 0; f < frames; f++) {
+		for (int i = 0; i < 16; i++) {
+			for (int me = 0; me < 4; me++) {
+				frame.add({ me, bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged });
+				frame.add({ me, bmdSwitcherMixEffectBlockEventTypeTransitionFramesRemainingChanged });
+			}
+		}
+		frame.add({ 0, bmdSwitcherMixEffectBlockEventTypeProgramInputChanged });
+		frame.drain([&](ofxAtem::MixEffectEvent&) { delivered++; });
+	}
+	uint64_t elapsed = nowMicros() - start;
+	printf(" %-40s %.1f events out of %d per drain, %.1f ns / event in, %llu allocations\n", "coalescing, 4 MEs x 16 per frame",
+		delivered / (double)frames, 16 * 4 * 2 + 1, elapsed * 1000.0 / frame.getReceivedCount(), (unsigned long long)(threadAllocations - allocationsBefore));
+}
+
+void ofApp::benchInputLookup() {
+	const std::vector<ofPtr<ofxAtem::Input>>& inputs = atem.getInputMap();
+	std::vector<BMDSwitcherInputId> ids;
+	std::vector<std::string> names;
+	for (auto& input : inputs) {
+		ids.push_back(input->bmdId);
+		names.push_back(input->shortName);
+	}
+
+	const int passes = 20000;
+	auto measure = [&](auto& keys, auto&& find) {
+		int sum = 0;
+		uint64_t allocationsBefore = threadAllocations;
+		uint64_t start = nowMicros();
+		for (int pass = 0; pass < passes; pass++) {
+			for (auto& key : keys) sum += find(key);
+		}
+		uint64_t elapsed = nowMicros() - start;
+		// Keeps the lookups from being optimised away
+		if (sum == 1) printf(" ");
+		if (threadAllocations != allocationsBefore) printf(" %-40s %llu allocations\n", "input lookup", (unsigned long long)(threadAllocations - allocationsBefore));
+		return elapsed * 1000.0 / (passes * keys.size());
+	};
+	double scanIdNanos = measure(ids, [&](BMDSwitcherInputId id) {
+		for (auto& input : inputs) if (input->bmdId == id) return input->index;
+		return -1;
+	});
+	double idNanos = measure(ids, [&](BMDSwitcherInputId id) { return atem.getIndexById(id); });
+	double scanNameNanos = measure(names, [&](const std::string& name) {
+		for (auto& input : inputs) if (input->longName == name || input->shortName == name) return input->index;
+		return -1;
+	});
+	double nameNanos = measure(names, [&](const std::string& name) { return atem.getIndexByName(name); });
+
+	std::string name = "input lookup, " + ofToString(inputs.size()) + " inputs";
+	printf(" %-40s by id: scan %.1f ns, table %.1f ns; by name: scan %.1f ns, table %.1f ns\n", name.c_str(),
+		scanIdNanos, idNanos, scanNameNanos, nameNanos);
+}
+
+void ofApp::benchBatching() {
+	const int frames = 200;
+	int inputCount = (int)atem.getInputMap().size();
+
+	// One "frame" sets program, preview, a keyer and an aux output
+	auto frame = [&](int i) {
+		atem.setProgramByIndex((i + 1) % inputCount);
+		atem.setPreviewByIndex((i + 2) % inputCount);
+		atem.setKeyerOnAir(0, i % 2 == 0);
+		atem.setAuxSourceByIndex(0, (i + 3) % inputCount);
+	};
+
+	for (int batched = 0; batched < 2; batched++) {
+		uint64_t packetsBefore = emulator.getReceivedPacketCount();
+		uint64_t target = programEvents + frames;
+		uint64_t start = nowMicros();
+		for (int i = 0; i < frames; i++) {
+			if (batched) atem.beginBatch();
+			frame(i);
+			if (batched) atem.commitBatch();
+			waitForEvents(target - frames + i + 1, 1000);
+		}
+		uint64_t elapsed = nowMicros() - start;
+		uint64_t packets = emulator.getReceivedPacketCount() - packetsBefore;
+
+		printf(" %-40s %.2f datagrams / frame, %.1f us / frame\n", batched ? "4 commands per frame, batched" : "4 commands per frame, unbatched",
+			(double)packets / frames, (double)elapsed / frames);
+	}
+}
+
+void ofApp::benchAllocations() {
+	const int count = 10000;
+	int inputCount = (int)atem.getInputMap().size();
+
+	auto command = [&](int i) {
+		atem.setProgramByIndex((i + 1) % inputCount);
+		atem.setAuxSourceByIndex(i % 6, i % inputCount);
+	};
+
+	// Warm up, then count what the calling thread allocates in steady state
+	for (int i = 0; i < 100; i++) command(i);
+
+	uint64_t allocationsBefore = threadAllocations;
+	uint64_t start = nowMicros();
+	for (int i = 0; i < count; i++) command(i);
+	uint64_t elapsed = nowMicros() - start;
+	uint64_t unbatched = threadAllocations - allocationsBefore;
+
+	allocationsBefore = threadAllocations;
+	for (int i = 0; i < count / 4; i++) {
+		atem.beginBatch();
+		for (int j = 0; j < 4; j++) command(i * 4 + j);
+		atem.commitBatch();
+	}
+	uint64_t batched = threadAllocations - allocationsBefore;
+
+	printf(" %-40s %llu allocations / %d commands unbatched, %llu batched, %.2f us / command\n", "command encoding",
+		(unsigned long long)unbatched, count * 2, (unsigned long long)batched, (double)elapsed / (count * 2));
+}
+
+void ofApp::benchLossyDelivery(float lossRate) {
+	const int count = 5000;
+	int inputCount = (int)atem.getInputMap().size();
+	ofxAtem::UdpClient& client = atem.getBackend().getClient();
+
+	// Let commands of the previous run drain first
+	uint64_t previous;
+	do {
+		previous = emulator.getReceivedCommandCount();
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	} while (emulator.getReceivedCommandCount() != previous);
+
+	emulator.setLossRate(lossRate);
+	uint64_t commandsBefore = emulator.getReceivedCommandCount();
+	uint64_t retransmitsBefore = client.getRetransmitCount() + emulator.getRetransmitCount();
+
+	// Back-to-back like a fader ride, nothing waits for the switcher
+	int sent = 0;
+	uint64_t start = nowMicros();
+	for (int i = 0; i < count; i++) {
+		if (atem.setAuxSourceByIndex(i % 6, i % inputCount)) sent++;
+	}
+	uint64_t deadline = nowMicros() + 10 * 1000 * 1000;
+	while (emulator.getReceivedCommandCount() - commandsBefore < (uint64_t)sent && nowMicros() < deadline) {
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+	uint64_t elapsed = nowMicros() - start;
+	uint64_t delivered = emulator.getReceivedCommandCount() - commandsBefore;
+	uint64_t retransmitted = client.getRetransmitCount() + emulator.getRetransmitCount() - retransmitsBefore;
+
+	emulator.setLossRate(0);
+
+	std::string name = "command burst, " + ofToString(lossRate * 100, 0) + "% loss";
+	printf(" %-40s %llu / %d delivered in %.1f ms, %.0f commands/s, %llu retransmits\n", name.c_str(),
+		(unsigned long long)delivered, count, elapsed / 1000.0, delivered * 1e6 / elapsed, (unsigned long long)retransmitted);
+}
+
+void ofApp::benchMediaUpload(int window, float lossRate) {
+	// A 1080p still before RLE, 4 bytes per pixel
+	std::vector<uint8_t> still(1920 * 1080 * 4);
+	uint32_t seed = 0x2545f491;
+	for (auto& b : still) {
+		seed = seed * 1664525 + 1013904223;
+		b = uint8_t(seed >> 24);
+	}
+	size_t size = still.size();
+
+	ofxAtem::MediaTransfer& transfer = atem.getBackend().getMediaTransfer();
+	ofxAtem::UdpClient& client = atem.getBackend().getClient();
+	std::atomic<int> callbacks{ 0 };
+	transfer.setWindow(window);
+	transfer.setProgressCallback([&](const ofxAtem::TransferProgress&) { callbacks++; });
+
+	emulator.setLossRate(lossRate);
+	uint64_t retransmitsBefore = client.getRetransmitCount();
+	uint64_t storedBefore = emulator.getCompletedTransferCount();
+
+	uint64_t start = nowMicros();
+	bool stored = transfer.uploadStill(0, std::move(still), "bench") && transfer.waitForCompletion(60 * 1000);
+	uint64_t elapsed = nowMicros() - start;
+	ofxAtem::TransferProgress progress = transfer.getProgress();
+
+	emulator.setLossRate(0);
+	transfer.setProgressCallback(nullptr);
+
+	std::string name = "1080p still upload, window " + ofToString(window) + (lossRate > 0 ? ", " + ofToString(lossRate * 100, 0) + "% loss" : "");
+	if (!check(stored && emulator.getCompletedTransferCount() == storedBefore + 1)) {
+		printf(" %-40s failed after %.1f ms\n", name.c_str(), elapsed / 1000.0);
+		return;
+	}
+	printf(" %-40s %.1f MB in %.1f ms, %.1f MB/s (%.1f MB/s of chunks), chunk %d B, %llu retransmits, %d progress calls\n", name.c_str(),
+		size / 1e6, elapsed / 1000.0, size / (double)elapsed, progress.megabytesPerSecond, (int)progress.chunkSize,
+		(unsigned long long)(client.getRetransmitCount() - retransmitsBefore), callbacks.load());
+}
+
+void ofApp::benchRleRoundTrip() {
+	// Short frames from a small set of words, marker included, so runs, pairs, markers and
+	// trailing bytes meet every boundary of the vector loops
+	const uint64_t alphabet[] = { 0, 0x1122334455667788ull, ofxAtem::rle::kRunMarker, 0xfefefefefefefefeull ^ 1 };
+	std::vector<ofxAtem::rle::Isa> isas = { ofxAtem::rle::kScalar };
+	if (ofxAtem::rle::getIsa() >= ofxAtem::rle::kSse2) isas.push_back(ofxAtem::rle::kSse2);
+	if (ofxAtem::rle::getIsa() >= ofxAtem::rle::kAvx2) isas.push_back(ofxAtem::rle::kAvx2);
+
+	uint32_t seed = 12345;
+	auto next = [&seed]() { seed = seed * 1664525 + 1013904223; return seed >> 8; };
+	const int cases = 5000;
+	int failures = 0;
+	for (int c = 0; c < cases; c++) {
+		size_t words = next() % 80;
+		std::vector<uint8_t> frame(words * 8 + next() % 8);
+		for (size_t w = 0; w < words;) {
+			uint64_t value = alphabet[next() % 4];
+			size_t run = 1 + (next() % 3 == 0 ? next() % 12 : 0);
+			for (size_t r = 0; r < run && w < words; r++, w++) memcpy(frame.data() + w * 8, &value, 8);
+		}
+		for (size_t b = words * 8; b < frame.size(); b++) frame[b] = uint8_t(next());
+
+		std::vector<uint8_t> reference;
+		for (auto isa : isas) {
+			std::vector<uint8_t> encoded(ofxAtem::rle::maxEncodedSize(frame.size()));
+			encoded.resize(ofxAtem::rle::encode(frame.data(), frame.size(), encoded.data(), encoded.size(), isa));
+			std::vector<uint8_t> decoded(frame.size());
+			size_t written = 0;
+			bool ok = ofxAtem::rle::decode(encoded.data(), encoded.size(), decoded.data(), decoded.size(), written, isa) && written == frame.size() && decoded == frame;
+			if (isa == ofxAtem::rle::kScalar) reference = encoded;
+
+			// Again with no room to spare, and with one byte too few
+			std::vector<uint8_t> exact(reference.size());
+			ok = ok && ofxAtem::rle::encode(frame.data(), frame.size(), exact.data(), exact.size(), isa) == exact.size() && exact == reference;
+			ok = ok && (reference.empty() || ofxAtem::rle::encode(frame.data(), frame.size(), exact.data(), exact.size() - 1, isa) == 0);
+			if (!ok || encoded != reference) failures++;
+		}
+	}
+
+	std::string flavours;
+	for (auto isa : isas) flavours += std::string(flavours.empty() ? "" : ", ") + ofxAtem::rle::isaToString(isa);
+	printf(" %-40s %d frames, %s: %s\n", "rle round trip", cases, flavours.c_str(),
+		check(failures == 0) ? "identical encodings, all decoded" : (ofToString(failures) + " FAILED").c_str());
+}
+
+void ofApp::benchRleCodec() {
+	// 4K stills, 4 bytes per pixel: colour bars, a lower third over black, and a photo
+	const int width = 3840, height = 2160;
+	auto makeFrame = [&](const std::function<uint32_t(int, int)>& pixel) {
+		std::vector<uint8_t> frame(size_t(width) * height * 4);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				uint32_t p = pixel(x, y);
+				memcpy(frame.data() + (size_t(y) * width + x) * 4, &p, 4);
+			}
+		}
+		return frame;
+	};
+	const uint32_t bars[] = { 0xffb4b4b4, 0xffb4b410, 0xff10b4b4, 0xff10b410, 0xffb410b4, 0xffb41010, 0xff1010b4 };
+	uint32_t seed = 777;
+	struct Graphic {
+		std::string name;
+		std::vector<uint8_t> frame;
+	};
+	std::vector<Graphic> graphics;
+	graphics.push_back({ "colour bars", makeFrame([&](int x, int) { return bars[x * 7 / width]; }) });
+	graphics.push_back({ "lower third", makeFrame([&](int x, int y) -> uint32_t {
+		if (y < height * 70 / 100 || y >= height * 85 / 100 || x < width / 20 || x >= width * 19 / 20) return 0;
+		// Text: 24 px glyph cells, a third of them with strokes
+		int cellX = x / 24, cellY = y / 24;
+		bool glyph = y > height * 74 / 100 && y < height * 81 / 100 && ((cellX * 7 + cellY * 13) % 3 == 0) && ((x + y) % 6 < 3);
+		return glyph ? 0xffffffff : 0xe0203a6a;
+	}) });
+	graphics.push_back({ "photo", makeFrame([&](int x, int y) {
+		seed = seed * 1664525 + 1013904223;
+		return 0xff000000 | (uint32_t(x * 255 / width) << 16) | (uint32_t(y * 255 / height) << 8) | (seed >> 28);
+	}) });
+
+	std::vector<ofxAtem::rle::Isa> isas = { ofxAtem::rle::kScalar };
+	if (ofxAtem::rle::getIsa() >= ofxAtem::rle::kSse2) isas.push_back(ofxAtem::rle::kSse2);
+	if (ofxAtem::rle::getIsa() >= ofxAtem::rle::kAvx2) isas.push_back(ofxAtem::rle::kAvx2);
+
+	for (auto& graphic : graphics) {
+		const std::vector<uint8_t>& frame = graphic.frame;
+		std::vector<uint8_t> encoded(ofxAtem::rle::maxEncodedSize(frame.size()));
+		std::vector<uint8_t> decoded(frame.size());
+		std::string line;
+		size_t encodedSize = 0;
+		for (auto isa : isas) {
+			// Best of 5, the frames are larger than the caches anyway
+			uint64_t encodeMicros = UINT64_MAX, decodeMicros = UINT64_MAX;
+			size_t written = 0;
+			for (int run = 0; run < 5; run++) {
+				uint64_t start = nowMicros();
+				encodedSize = ofxAtem::rle::encode(frame.data(), frame.size(), encoded.data(), encoded.size(), isa);
+				encodeMicros = std::min(encodeMicros, nowMicros() - start);
+				start = nowMicros();
+				ofxAtem::rle::decode(encoded.data(), encodedSize, decoded.data(), decoded.size(), written, isa);
+				decodeMicros = std::min(decodeMicros, nowMicros() - start);
+			}
+			if (!check(written == frame.size() && decoded == frame)) line += std::string(ofxAtem::rle::isaToString(isa)) + " MISMATCH  ";
+			line += std::string(ofxAtem::rle::isaToString(isa)) + " " + ofToString(frame.size() / (double)encodeMicros / 1000.0, 1) + " / " +
+				ofToString(frame.size() / (double)decodeMicros / 1000.0, 1) + " GB/s  ";
+		}
+		std::string name = "rle 4K " + graphic.name + ", " + ofToString(100.0 * encodedSize / frame.size(), 1) + "%";
+		printf(" %-40s encode / decode %s\n", name.c_str(), line.c_str());
+	}
+}
+
+void ofApp::benchTimecodeRoundTrip() {
+	// Every frame of a day, through timecode and back
+	const ofxAtem::FrameRate rates[] = { { 24000, 1001 }, { 25, 1 }, { 30000, 1001 }, { 50, 1 }, { 60000, 1001 } };
+	int64_t frames = 0;
+	int failures = 0;
+	for (auto& rate : rates) {
+		bool dropFrame = rate.denominator == 1001 && rate.timecodeBase() % 30 == 0;
+		int64_t day = ofxAtem::framesPerDay(rate, dropFrame);
+		for (int64_t frame = 0; frame < day; frame++) {
+			ofxAtem::Timecode timecode = ofxAtem::frameToTimecode(frame, rate, dropFrame);
+			bool dropped = dropFrame && timecode.seconds == 0 && timecode.frames < rate.timecodeBase() / 15 && timecode.minutes % 10 != 0;
+			if (dropped || ofxAtem::timecodeToFrame(timecode, rate) != frame) failures++;
+		}
+		frames += day;
+	}
+	printf(" %-40s %lld frames at 23.98, 25, 29.97 DF, 50 and 59.94 DF: %s\n", "timecode round trip", (long long)frames,
+		check(failures == 0) ? "all identical" : (ofToString(failures) + " FAILED").c_str());
+}
+
+void ofApp::benchSwitcherClock(double driftPpm) {
+	ofxAtem::SwitcherClock& clock = atem.getClock();
+	ofxAtem::FrameRate rate = ofxAtem::protocol::frameRateOfVideoMode(emulator.getTopology().videoMode);
+
+	// A fresh timecode stream, frame N of it starting at startMicros + (N - startFrame) periods
+	emulator.setTimecode(false);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	clock.reset();
+	uint64_t startMicros = ofGetElapsedTimeMicros();
+	emulator.setTimecode(true, driftPpm);
+	int64_t startFrame = ofxAtem::timecodeToFrame(ofxAtem::Timecode{ 10, 0, 0, 0, false }, rate);
+	double periodMicros = 1e6 * rate.denominator / rate.numerator / (1 + driftPpm * 1e-6);
+
+	uint64_t deadline = ofGetElapsedTimeMicros() + 2000000;
+	while (!clock.isLocked() && ofGetElapsedTimeMicros() < deadline) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	uint64_t lockMicros = ofGetElapsedTimeMicros() - startMicros;
+	// A full window of timecodes at 50 fps, for the drift estimate
+	std::this_thread::sleep_for(std::chrono::seconds(10));
+
+	// Where the clock puts frames a little ahead, against where the emulator starts them
+	std::vector<double> errors;
+	for (int i = 0; i < 50; i++) {
+		int64_t frame = clock.getCurrentFrame() + 5;
+		double actual = startMicros + (frame - startFrame) * periodMicros;
+		errors.push_back(double(clock.timeOfFrame(frame)) - actual);
+		std::this_thread::sleep_for(std::chrono::milliseconds(7));
+	}
+	std::sort(errors.begin(), errors.end());
+	ofxAtem::ClockEstimate estimate = clock.getEstimate();
+	emulator.setTimecode(false);
+
+	std::string name = "switcher clock, " + ofToString(driftPpm, 0) + " ppm";
+	if (!check(estimate.locked)) {
+		printf(" %-40s NOT locked after %.1f s\n", name.c_str(), lockMicros / 1e6);
+		return;
+	}
+	// The fitted slope over n timecodes a period apart, each off by the jitter, is good to about
+	// jitter * sqrt(12 / n) / span; four times that is the tolerance
+	double spanMicros = estimate.samples * periodMicros;
+	double tolerancePpm = 4e6 * estimate.jitterMicros * std::sqrt(12.0 / estimate.samples) / spanMicros;
+	printf(" %-40s locked in %.0f ms, drift %.1f ppm (%s, +/- %.1f), jitter %.0f us, frame +5 off by %+.0f us (p50) %+.0f us (max) of %.0f us\n", name.c_str(),
+		lockMicros / 1000.0, estimate.driftPpm, check(std::fabs(estimate.driftPpm - driftPpm) <= tolerancePpm) ? "within tolerance" : "OFF",
+		tolerancePpm, estimate.jitterMicros, errors[errors.size() / 2],
+		std::fabs(errors.front()) > std::fabs(errors.back()) ? errors.front() : errors.back(), periodMicros);
+}
+
+void ofApp::benchLiveness() {
+	// Heartbeats on a clean, otherwise idle link
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	ofxAtem::ConnectionHealth health = atem.getConnectionHealth();
+	printf(" %-40s rtt %.2f ms (min %.2f), loss %.1f %%, %llu heartbeats, %llu missed\n", "link health",
+		health.rttMillis, health.minRttMillis, health.lossRate * 100,
+		(unsigned long long)health.heartbeats, (unsigned long long)health.missedHeartbeats);
+
+	// The switcher goes silent, and is back before the client gives up on the link
+	LinkWatcher watcher;
+	ofAddListener(atem.linkDegraded, &watcher, &LinkWatcher::onLinkDegraded);
+	ofAddListener(atem.linkRestored, &watcher, &LinkWatcher::onLinkRestored);
+	uint64_t disconnectedBefore = disconnectedEvents;
+	uint64_t start = nowMicros();
+	emulator.setLossRate(1);
+	bool degraded = allReached([&](int) { return watcher.degradedMicros != 0; }, 1, 5000);
+	uint64_t back = nowMicros();
+	emulator.setLossRate(0);
+	bool restored = allReached([&](int) { return watcher.restoredMicros != 0; }, 1, 5000);
+	ofRemoveListener(atem.linkDegraded, &watcher, &LinkWatcher::onLinkDegraded);
+	ofRemoveListener(atem.linkRestored, &watcher, &LinkWatcher::onLinkRestored);
+
+	if (!check(degraded && restored)) {
+		printf(" %-40s silent link %s\n", "liveness", degraded ? "not restored" : "NOT detected");
+		return;
+	}
+	ofxAtem::LinkMonitor& link = atem.getBackend().getLinkMonitor();
+	printf(" %-40s degraded %.0f ms into the silence (%d x %d ms heartbeats), restored %.1f ms after it, %s\n", "liveness",
+		(watcher.degradedMicros - start) / 1000.0, link.getMissThreshold(), link.getHeartbeatInterval(),
+		(watcher.restoredMicros - back) / 1000.0, check(disconnectedEvents == disconnectedBefore) ? "stayed online" : "DROPPED");
+}
+
+void ofApp::benchReconnect() {
+	int inputCount = (int)atem.getInputMap().size();
+	auto waitFor = [](std::atomic<uint64_t>& counter, uint64_t target, uint64_t timeoutMillis) {
+		uint64_t deadline = nowMicros() + timeoutMillis * 1000;
+		while (counter < target && nowMicros() < deadline) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return counter >= target;
+	};
+
+	// A second device whose disconnected listener connects again straight away, on the
+	// receive thread that notified it
+	struct Retry {
+		ofxAtem::Device device;
+		std::string address;
+		std::future<bool> result;
+		std::atomic<uint64_t> retries{ 0 };
+		void onDisconnected() {
+			if (retries) return;
+			result = device.connectAsync(address);
+			retries++;
+		}
+	} retry;
+	retry.address = address;
+	bool retryConnected = retry.device.connect(address);
+	ofAddListener(retry.device.disconnected, &retry, &Retry::onDisconnected);
+
+	// Cut the link until the client gives up on it
+	uint64_t start = nowMicros();
+	emulator.setLossRate(1);
+	if (!check(waitFor(disconnectedEvents, 1, 10000))) {
+		ofRemoveListener(retry.device.disconnected, &retry, &Retry::onDisconnected);
+		emulator.setLossRate(0);
+		printf(" %-40s link loss not detected\n", "reconnect");
+		return;
+	}
+	uint64_t detected = nowMicros() - start;
+
+	// The second device gives up on the link too, and its listener connects again
+	bool retried = retryConnected && waitFor(retry.retries, 1, 5000);
+
+	// The panel cuts to another camera meanwhile and the app queues a preview change
+	int program = (atem.getProgramIndex() + 1) % inputCount;
+	int preview = (atem.getPreviewIndex() + 3) % inputCount;
+	uint64_t programEventsBefore = programEvents;
+	emulator.setProgramInput(0, (uint16_t)atem.getInputMap()[program]->bmdId);
+	bool queued = atem.setPreviewByIndex(preview);
+
+	start = nowMicros();
+	emulator.setLossRate(0);
+	bool reconnected = waitFor(reconnectedEvents, 1, 10000);
+	uint64_t elapsed = nowMicros() - start;
+
+	// The replayed preview change comes back from the switcher like any other
+	uint64_t deadline = nowMicros() + 1000 * 1000;
+	while (atem.getPreviewIndex() != preview && nowMicros() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	printf(" %-40s loss detected in %.0f ms, back %.1f ms after the link, %s\n", "reconnect",
+		detected / 1000.0, elapsed / 1000.0, check(reconnected && atem.isOnline()) ? "online" : "FAILED");
+	printf(" %-40s program %s (%llu event), queued preview %s\n", "reconnect reconciliation",
+		check(atem.getProgramIndex() == program) ? "reconciled" : "STALE",
+		(unsigned long long)(programEvents - programEventsBefore),
+		check(queued && atem.getPreviewIndex() == preview) ? "replayed" : "LOST");
+
+	bool retryReady = retried && retry.result.wait_for(std::chrono::seconds(10)) == std::future_status::ready && retry.result.get();
+	ofRemoveListener(retry.device.disconnected, &retry, &Retry::onDisconnected);
+	printf(" %-40s %s, %s\n", "reconnect from a disconnected listener", check(retried) ? "connectAsync() called" : "NOT called",
+		check(retryReady && retry.device.isReady()) ? "synced again" : "sync FAILED");
+	retry.device.disconnect();
+}
+
+void ofApp::benchDeviceManager(int count) {
+	int threadsBefore = countThreads();
+	ofxAtem::DeviceManager manager;
+	std::vector<std::unique_ptr<ProgramListener>> listeners;
+
+	uint64_t start = nowMicros();
+	for (int i = 0; i < count; i++) {
+		ofxAtem::NativeDevice& device = manager.add(address);
+		listeners.emplace_back(new ProgramListener());
+		ofAddListener(device.mixEffectBlockChanged, listeners.back().get(), &ProgramListener::onMixEffectBlockChanged);
+	}
+	bool ready = allReached([&](int i) { return manager.getDevice(i).isReady(); }, count, 10000);
+	uint64_t syncElapsed = nowMicros() - start;
+	int threads = countThreads() - threadsBefore;
+
+	// One cut on the panel, every device reports it
+	int inputCount = (int)atem.getInputMap().size();
+	int program = (atem.getProgramIndex() + 1) % inputCount;
+	start = nowMicros();
+	emulator.setProgramInput(0, (uint16_t)atem.getInputMap()[program]->bmdId);
+	bool fannedOut = allReached([&](int i) { return listeners[i]->programEvents > 0; }, count, 5000);
+	uint64_t fanOutElapsed = nowMicros() - start;
+
+	// And every device can still send on its own
+	uint64_t commandsBefore = emulator.getReceivedCommandCount();
+	for (int i = 0; i < count; i++) {
+		manager.getDevice(i).setAuxSourceByIndex(i % 6, i % inputCount);
+	}
+	bool delivered = allReached([&](int) { return emulator.getReceivedCommandCount() - commandsBefore >= (uint64_t)count; }, 1, 5000);
+
+	// Listeners run on the I/O thread without the manager's lock: one that looks at the manager
+	// and removes its own device on the next cut
+	struct Reentrant {
+		ofxAtem::DeviceManager* manager = nullptr;
+		ofxAtem::NativeDevice* device = nullptr;
+		std::atomic<size_t> seen{ 0 };
+		void onMixEffectBlockChanged(BMDSwitcherMixEffectBlockEventType&) {
+			if (seen) return;
+			seen = manager->size();
+			manager->remove(*device);
+		}
+	} reentrant;
+	reentrant.manager = &manager;
+	reentrant.device = &manager.add(address);
+	ofAddListener(reentrant.device->mixEffectBlockChanged, &reentrant, &Reentrant::onMixEffectBlockChanged);
+	bool extraReady = allReached([&](int) { return reentrant.device->isReady(); }, 1, 5000);
+	emulator.setProgramInput(0, (uint16_t)atem.getInputMap()[(program + 1) % inputCount]->bmdId);
+	bool removedOwn = extraReady && allReached([&](int) { return reentrant.seen > 0 && manager.size() == (size_t)count; }, 1, 5000);
+
+	for (int i = 0; i < count; i++) {
+		ofRemoveListener(manager.getDevice(i).mixEffectBlockChanged, listeners[i].get(), &ProgramListener::onMixEffectBlockChanged);
+	}
+	manager.clear();
+
+	std::string name = "device manager, " + ofToString(count) + " switchers";
+	printf(" %-40s %s in %.1f ms on %d thread(s), cut seen by all in %.1f ms, commands %s\n", name.c_str(),
+		check(ready) ? "all synced" : "sync FAILED", syncElapsed / 1000.0, threads,
+		check(fannedOut) ? fanOutElapsed / 1000.0 : -1.0, check(delivered) ? "delivered" : "LOST");
+	printf(" %-40s listener saw %d device(s), %s\n", "device manager, listener re-entry", (int)reentrant.seen.load(),
+		check(removedOwn) ? "removed its own device" : "own device NOT removed");
+}
+
+void ofApp::benchLoad(int count) {
+	struct TransitionListener {
+		std::atomic<uint64_t> transitionEvents{ 0 };
+		void onMixEffectBlockChanged(BMDSwitcherMixEffectBlockEventType& e) {
+			if (e == bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged) transitionEvents++;
+		}
+	};
+	ofxAtem::DeviceManager manager;
+	std::vector<std::unique_ptr<TransitionListener>> listeners;
+	for (int i = 0; i < count; i++) {
+		ofxAtem::NativeDevice& device = manager.add(address);
+		listeners.emplace_back(new TransitionListener());
+		ofAddListener(device.mixEffectBlockChanged, listeners.back().get(), &TransitionListener::onMixEffectBlockChanged);
+	}
+	bool ready = allReached([&](int i) { return manager.getDevice(i).isReady(); }, count, 10000);
+
+	// A lever ride at frame rate on every ME, meters on every input and a couple of cuts a second
+	ofxAtem::EmulatorStorm storm;
+	storm.transitionRate = 60;
+	storm.levelRate = 30;
+	storm.cutRate = 4;
+	const uint64_t durationMillis = 2000;
+	emulator.resetDeliveryLatencies();
+	uint64_t recordsBefore = emulator.getStormRecordCount();
+	emulator.setStorm(storm);
+	std::this_thread::sleep_for(std::chrono::milliseconds(durationMillis));
+	emulator.setStorm(ofxAtem::EmulatorStorm());
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	uint64_t records = emulator.getStormRecordCount() - recordsBefore;
+
+	std::vector<ofxAtem::DeliveryLatency> latencies = emulator.getDeliveryLatencies();
+	// Sessions of devices from earlier runs linger until they time out, and acknowledge nothing
+	std::vector<uint32_t> p50s, p99s;
+	for (auto& latency : latencies) {
+		if (!latency.packets) continue;
+		p50s.push_back(latency.p50);
+		p99s.push_back(latency.p99);
+	}
+	std::sort(p50s.begin(), p50s.end());
+	std::sort(p99s.begin(), p99s.end());
+	uint64_t fewestEvents = UINT64_MAX, mostEvents = 0, merged = 0;
+	for (auto& listener : listeners) {
+		fewestEvents = std::min<uint64_t>(fewestEvents, listener->transitionEvents);
+		mostEvents = std::max<uint64_t>(mostEvents, listener->transitionEvents);
+	}
+	for (int i = 0; i < count; i++) merged += manager.getDevice(i).getEventCoalescer().getMergedCount();
+
+	for (int i = 0; i < count; i++) {
+		ofRemoveListener(manager.getDevice(i).mixEffectBlockChanged, listeners[i].get(), &TransitionListener::onMixEffectBlockChanged);
+	}
+	manager.clear();
+
+	std::string name = "load, " + ofToString(count) + " clients under a storm";
+	if (!check(ready && !p99s.empty())) {
+		printf(" %-40s %s\n", name.c_str(), ready ? "no deliveries" : "sync FAILED");
+		return;
+	}
+	printf(" %-40s %.0f records/s to %d sessions, transition events per client %llu - %llu, %llu merged in all\n", name.c_str(),
+		records * 1000.0 / durationMillis, (int)p99s.size(), (unsigned long long)fewestEvents, (unsigned long long)mostEvents, (unsigned long long)merged);
+	printf(" %-40s p50 %u us (median client), p99 %u us (median client), %u us (worst client)\n", "load, delivery until acknowledged",
+		p50s[p50s.size() / 2], p99s[p99s.size() / 2], p99s.back());
+}
+
+void ofApp::benchBroker(int count) {
+	std::string path = "/tmp/ofxAtem-bench.sock";
+	size_t sessionsBefore = emulator.getSessionCount();
+
+	ofxAtem::Broker broker;
+	if (!check(broker.start(address, path))) {
+		printf(" %-40s could not start\n", "broker");
+		return;
+	}
+	bool upstream = allReached([&](int) { return broker.isUpstreamConnected(); }, 1, 5000);
+
+	ofxAtem::DeviceManager manager;
+	std::vector<std::unique_ptr<ProgramListener>> listeners;
+	uint64_t start = nowMicros();
+	for (int i = 0; i < count; i++) {
+		ofxAtem::NativeDevice& device = manager.add("unix:" + path);
+		listeners.emplace_back(new ProgramListener());
+		ofAddListener(device.mixEffectBlockChanged, listeners.back().get(), &ProgramListener::onMixEffectBlockChanged);
+	}
+	bool ready = upstream && allReached([&](int i) { return manager.getDevice(i).isReady(); }, count, 10000);
+	uint64_t syncElapsed = nowMicros() - start;
+	size_t upstreamSessions = emulator.getSessionCount() - sessionsBefore;
+
+	// A cut on the panel reaches every local client through the one upstream session
+	int inputCount = (int)atem.getInputMap().size();
+	int program = (atem.getProgramIndex() + 1) % inputCount;
+	start = nowMicros();
+	emulator.setProgramInput(0, (uint16_t)atem.getInputMap()[program]->bmdId);
+	bool fannedOut = ready && allReached([&](int i) { return listeners[i]->programEvents > 0; }, count, 5000);
+	uint64_t fanOutElapsed = nowMicros() - start;
+
+	// Commands from every client are merged upstream
+	uint64_t commandsBefore = emulator.getReceivedCommandCount();
+	uint64_t packetsBefore = emulator.getReceivedPacketCount();
+	for (int i = 0; i < count; i++) {
+		manager.getDevice(i).setAuxSourceByIndex(i % 6, i % inputCount);
+	}
+	bool delivered = ready && allReached([&](int) { return emulator.getReceivedCommandCount() - commandsBefore >= (uint64_t)count; }, 1, 5000);
+	uint64_t packets = emulator.getReceivedPacketCount() - packetsBefore;
+
+	for (int i = 0; i < count; i++) {
+		ofRemoveListener(manager.getDevice(i).mixEffectBlockChanged, listeners[i].get(), &ProgramListener::onMixEffectBlockChanged);
+	}
+	manager.clear();
+	broker.stop();
+
+	std::string name = "broker, " + ofToString(count) + " local clients";
+	printf(" %-40s %s in %.1f ms over %d upstream session(s), cut seen by all in %.1f ms, %d commands in %d packet(s) %s\n", name.c_str(),
+		check(ready) ? "all synced" : "sync FAILED", syncElapsed / 1000.0, (int)upstreamSessions,
+		check(fannedOut) ? fanOutElapsed / 1000.0 : -1.0, count, (int)packets, check(delivered) ? "delivered" : "LOST");
+}
+
+void ofApp::benchReplay() {
+	const int count = 5000;
+	std::string path = ofToDataPath("benchmark.atemrec");
+
+	// Record a connect, half a second of keep-alives and timecodes, and a burst of cuts
+	emulator.setTimecode(true);
+	{
+		ofxAtem::NativeDevice device;
+		ProgramListener listener;
+		ofAddListener(device.mixEffectBlockChanged, &listener, &ProgramListener::onMixEffectBlockChanged);
+		device.getBackend().getRecorder().open(path);
+		if (device.connect(address)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+			emulator.sendProgramBurst(0, count);
+			uint64_t deadline = nowMicros() + 5000 * 1000;
+			while (listener.programEvents < (uint64_t)count && nowMicros() < deadline) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+		ofRemoveListener(device.mixEffectBlockChanged, &listener, &ProgramListener::onMixEffectBlockChanged);
+		device.disconnect();
+		device.getBackend().getRecorder().close();
+	}
+	emulator.setTimecode(false);
+
+	// The clock is fitted to the recorded arrival times, at either speed
+	ofxAtem::ClockEstimate clocks[2];
+	for (int realTime = 1; realTime >= 0; realTime--) {
+		ofxAtem::ReplayDevice replay;
+		ProgramListener listener;
+		ofAddListener(replay.mixEffectBlockChanged, &listener, &ProgramListener::onMixEffectBlockChanged);
+		replay.getBackend().setRealTime(realTime);
+
+		uint64_t start = nowMicros();
+		bool ready = replay.connect(path);
+		while (!replay.getBackend().isFinished()) {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		uint64_t elapsed = nowMicros() - start;
+		uint64_t datagrams = replay.getBackend().getReplayedCount();
+		clocks[realTime] = replay.getClock().getEstimate();
+
+		ofRemoveListener(replay.mixEffectBlockChanged, &listener, &ProgramListener::onMixEffectBlockChanged);
+		replay.disconnect();
+
+		std::string name = realTime ? "replay, real time" : "replay, as fast as possible";
+		printf(" %-40s %s, %llu / %d cuts from %llu datagrams in %.1f ms (recorded %.1f ms), %.0f datagrams/s\n", name.c_str(),
+			check(ready) ? "synced" : "sync FAILED", (unsigned long long)listener.programEvents.load(), count, (unsigned long long)datagrams,
+			elapsed / 1000.0, replay.getBackend().getDurationMicros() / 1000.0, datagrams * 1e6 / elapsed);
+	}
+	bool sameClock = clocks[1].locked && clocks[0].locked && clocks[1].samples == clocks[0].samples &&
+		std::fabs(clocks[1].framesPerSecond - clocks[0].framesPerSecond) < 1e-6 && std::fabs(clocks[1].jitterMicros - clocks[0].jitterMicros) < 1e-3;
+	printf(" %-40s %d timecodes, %.4f / %.4f fps, jitter %.0f / %.0f us (real time / as fast as possible), %s\n", "replay, switcher clock",
+		(int)clocks[0].samples, clocks[1].framesPerSecond, clocks[0].framesPerSecond, clocks[1].jitterMicros, clocks[0].jitterMicros,
+		check(sameClock) ? "identical" : "DIFFERENT");
+
+	// Settings made before connect() last across replays, and disconnect() returns without
+	// waiting for the recording to get past the gap before the cuts
+	ofxAtem::ReplayDevice replay;
+	const BMDSwitcherMixEffectBlockEventType position = bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged;
+	replay.getEventCoalescer().setCoalesced(position, false);
+	bool ready = true;
+	uint64_t longestDisconnect = 0;
+	for (int i = 0; i < 2; i++) {
+		ready = replay.connect(path) && ready;
+		uint64_t start = nowMicros();
+		replay.disconnect();
+		longestDisconnect = std::max(longestDisconnect, nowMicros() - start);
+	}
+	printf(" %-40s %s, coalescer settings %s, disconnect in the gap %.2f ms\n", "replay, disconnect mid-recording",
+		check(ready) ? "synced twice" : "sync FAILED", check(!replay.getEventCoalescer().isCoalesced(position)) ? "kept" : "LOST", longestDisconnect / 1000.0);
+
+	// A ready listener that starts the replay over, on the replay thread it was notified on
+	struct Restart {
+		ofxAtem::ReplayDevice* device = nullptr;
+		std::string path;
+		std::future<bool> result;
+		std::atomic<uint64_t> readies{ 0 };
+		void onReady() {
+			if (readies++ == 0) result = device->connectAsync(path);
+		}
+	} restart;
+	restart.device = &replay;
+	restart.path = path;
+	ofAddListener(replay.ready, &restart, &Restart::onReady);
+	bool restarted = replay.connect(path) && allReached([&](int) { return restart.readies >= 2; }, 1, 5000);
+	ofRemoveListener(replay.ready, &restart, &Restart::onReady);
+	replay.disconnect();
+	printf(" %-40s %s\n", "replay, restarted from a ready listener", check(restarted && restart.result.get()) ? "synced again" : "sync FAILED");
+}
+
+// The mirrored state records, looked up the way the client did before the perfect hash
+static int findByCompare(uint32_t name) {
+	using namespace ofxAtem::protocol;
+	if (name == state::kVersion) return 0;
+	else if (name == state::kProductName) return 1;
+	else if (name == state::kTopology) return 2;
+	else if (name == state::kMixEffectConfig) return 3;
+	else if (name == state::kMediaPoolConfig) return 4;
+	else if (name == state::kInputProperties) return 5;
+	else if (name == state::kProgramInput) return 6;
+	else if (name == state::kPreviewInput) return 7;
+	else if (name == state::kTransitionPosition) return 8;
+	else if (name == state::kKeyerOnAir) return 9;
+	else if (name == state::kAuxSource) return 10;
+	return -1;
+}
+
+void ofApp::benchRecordDispatch() {
+	using namespace ofxAtem::protocol;
+	std::string path = ofToDataPath("state-dump.atemrec");
+
+	// A real state dump of the 40 input emulator topology
+	{
+		ofxAtem::NativeDevice device;
+		device.getBackend().getRecorder().open(path);
+		device.connect(address);
+		device.disconnect();
+		device.getBackend().getRecorder().close();
+	}
+	ofxAtem::SessionReader reader;
+	if (!check(reader.open(path))) return;
+
+	std::vector<std::vector<uint8_t>> datagrams;
+	std::vector<uint32_t> names;
+	ofxAtem::SessionReader::Entry entry;
+	while (reader.next(entry)) {
+		if (entry.direction != ofxAtem::kFromSwitcher) continue;
+		datagrams.emplace_back(entry.data, entry.data + entry.size);
+
+		RecordReader records(entry.data + kHeaderSize, entry.size - kHeaderSize);
+		uint32_t name;
+		const uint8_t* payload;
+		size_t payloadSize;
+		while (records.next(name, payload, payloadSize)) names.push_back(name);
+	}
+
+	static constexpr uint32_t kNames[] = {
+		state::kVersion, state::kProductName, state::kTopology, state::kMixEffectConfig, state::kMediaPoolConfig, state::kInputProperties,
+		state::kProgramInput, state::kPreviewInput, state::kTransitionPosition, state::kKeyerOnAir, state::kAuxSource,
+	};
+	static constexpr FourccDispatch<11, 5> dispatch(kNames);
+	std::map<uint32_t, int> map;
+	for (int i = 0; i < 11; i++) map[kNames[i]] = i;
+
+	const int passes = 50000;
+	auto measure = [&](auto&& find) {
+		int sum = 0;
+		uint64_t start = nowMicros();
+		for (int pass = 0; pass < passes; pass++) {
+			for (uint32_t name : names) sum += find(name);
+		}
+		uint64_t elapsed = nowMicros() - start;
+		// Keeps the lookups from being optimised away
+		if (sum == 1) printf(" ");
+		return elapsed * 1000.0 / (passes * names.size());
+	};
+	double compareNanos = measure([](uint32_t name) { return findByCompare(name); });
+	double mapNanos = measure([&](uint32_t name) { auto it = map.find(name); return it == map.end() ? -1 : it->second; });
+	double hashNanos = measure([](uint32_t name) { return dispatch.find(name); });
+
+	printf(" %-40s %d records in %d datagrams\n", "state dump, 40 inputs", (int)names.size(), (int)datagrams.size());
+	printf(" %-40s compare chain %.1f ns, std::map %.1f ns, perfect hash %.1f ns\n", "record dispatch per lookup", compareNanos, mapNanos, hashNanos);
+
+	// The whole parse, through the client as the dump arrives
+	std::unique_ptr<ofxAtem::UdpClient> client;
+	uint64_t elapsed = 0;
+	const int parses = 200;
+	for (int pass = 0; pass < parses; pass++) {
+		client.reset(new ofxAtem::UdpClient());
+		uint64_t start = nowMicros();
+		for (auto& datagram : datagrams) {
+			client->inject(datagram.data(), datagram.size(), ofGetElapsedTimeMicros(), [](ofxAtem::MixEffectEvent&) {});
+		}
+		elapsed += nowMicros() - start;
+	}
+	printf(" %-40s %.1f us per dump, %.0f records/s\n", "state dump parse", (double)elapsed / parses, names.size() * 1e6 * parses / elapsed);
+}
+
+#ifdef OFX_ATEM_COM_COMPAT
+void ofApp::benchComBackend() {
+	ofxAtemCompat::FakeSwitcherTopology topology;
+	topology.externalInputs = 40;
+	topology.mixEffectBlocks = 2;
+	topology.keyersPerMixEffectBlock = 4;
+	topology.auxOutputs = 6;
+	CComPtr<ofxAtemCompat::FakeSwitcher> fake;
+	fake.Attach(new ofxAtemCompat::FakeSwitcher(topology));
+	ofxAtemCompat::installFakeSwitcher(fake);
+
+	// ConnectTo, the object graph walk and readInputs, all synchronous on this thread
+	std::vector<uint64_t> samples;
+	for (int i = 0; i < 10; i++) {
+		ofxAtem::ComDevice device;
+		uint64_t start = nowMicros();
+		if (device.connect("fake")) {
+			samples.push_back(nowMicros() - start);
+		}
+		device.disconnect();
+	}
+	printStats("COM connect + readInputs", samples);
+
+	// A switcher that does not answer: every failed connect leaves COM as it found it
+	{
+		ofxAtem::ComDevice device;
+		int refused = 0;
+		fake->setReachable(false);
+		for (int i = 0; i < 3; i++) {
+			if (!device.connect("fake")) refused++;
+		}
+		fake->setReachable(true);
+		bool connected = device.connect("fake");
+		printf(" %-40s %d / 3 refused, then %s\n", "COM connect, switcher unreachable", refused, check(refused == 3 && connected) ? "connected" : "NOT connected");
+		device.disconnect();
+	}
+	size_t leftCallbacks = fake->getCallbackCount();
+
+	struct Counter {
+		std::atomic<uint64_t> program{ 0 }, position{ 0 }, disconnected{ 0 }, reconnected{ 0 }, elsewhere{ 0 };
+		std::thread::id thread = std::this_thread::get_id();
+		void onMixEffectBlockChanged(BMDSwitcherMixEffectBlockEventType& e) {
+			if (e == bmdSwitcherMixEffectBlockEventTypeProgramInputChanged) program++;
+			if (e == bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged) position++;
+			if (std::this_thread::get_id() != thread) elsewhere++;
+		}
+		void onDisconnected() { disconnected++; }
+		void onReconnected() { reconnected++; }
+	} counter;
+	ofxAtem::ComDevice device;
+	ofAddListener(device.mixEffectBlockChanged, &counter, &Counter::onMixEffectBlockChanged);
+	ofAddListener(device.disconnected, &counter, &Counter::onDisconnected);
+	ofAddListener(device.reconnected, &counter, &Counter::onReconnected);
+	if (!check(device.connect("fake"))) {
+		printf(" %-40s connect FAILED\n", "COM backend");
+		ofxAtemCompat::installFakeSwitcher(nullptr);
+		return;
+	}
+
+	// Callbacks are only queued, the backend delivers them from ofApp::update(), driven by hand here
+	auto update = [] {
+		ofEventArgs args;
+		ofNotifyEvent(ofEvents().update, args);
+	};
+	uint64_t longestUpdate = 0;
+	auto pumpUntil = [&](std::atomic<uint64_t>& counter, uint64_t target, uint64_t timeoutMillis) {
+		uint64_t deadline = nowMicros() + timeoutMillis * 1000;
+		while (counter < target && nowMicros() < deadline) {
+			uint64_t begin = nowMicros();
+			update();
+			longestUpdate = std::max(longestUpdate, nowMicros() - begin);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return counter >= target;
+	};
+
+	// The fake calls back before SetProgramInput returns, so this is the cost of the
+	// backend, the monitor, the queue and the event dispatch alone
+	samples.clear();
+	int inputCount = (int)device.getInputMap().size();
+	for (int i = 0; i < 500; i++) {
+		uint64_t target = counter.program + 1;
+		uint64_t start = nowMicros();
+		device.setProgramByIndex((i + 2) % inputCount);
+		update();
+		if (counter.program >= target) samples.push_back(nowMicros() - start);
+	}
+	printStats("COM setProgram -> update() delivers", samples);
+
+	// Apps written against the monitors' static event still hear the same changes
+	ProgramListener legacy;
+	ofAddListener(MixEffectBlockMonitor::effectBlockChanged, &legacy, &ProgramListener::onMixEffectBlockChanged);
+	uint64_t programBefore = counter.program;
+	for (int i = 0; i < 10; i++) {
+		device.setProgramByIndex((i + 3) % inputCount);
+		update();
+	}
+	ofRemoveListener(MixEffectBlockMonitor::effectBlockChanged, &legacy, &ProgramListener::onMixEffectBlockChanged);
+	uint64_t programChanges = counter.program - programBefore;
+	printf(" %-40s %llu of %llu program change(s) %s\n", "COM deprecated effectBlockChanged", (unsigned long long)legacy.programEvents.load(),
+		(unsigned long long)programChanges, check(programChanges > 0 && legacy.programEvents == programChanges) ? "forwarded" : "LOST");
+
+	// More changes between two updates than the queue holds: the rest is dropped, and the
+	// device reads the switcher again instead
+	uint64_t delivered = device.getBackend().getDeliveredEventCount();
+	int program = device.getProgramIndex();
+	for (int i = 0; i < (int)MonitorQueue::kCapacity + 500; i++) {
+		program = (program + 1) % inputCount;
+		device.setProgramByIndex(program);
+	}
+	update();
+	printf(" %-40s %llu delivered, %llu dropped, program %s, %llu listener call(s) off the update() thread\n", "COM burst past the monitor queue",
+		(unsigned long long)(device.getBackend().getDeliveredEventCount() - delivered), (unsigned long long)device.getBackend().getDroppedEventCount(),
+		check(device.getProgramIndex() == program) ? "resynchronised" : "STALE", (unsigned long long)counter.elsewhere);
+	check(counter.elsewhere == 0);
+
+	// A T-bar pulled through 100 positions on both MEs within one frame: one event per ME
+	uint64_t merged = device.getEventCoalescer().getMergedCount();
+	for (int i = 1; i <= 100; i++) {
+		for (int me = 0; me < 2; me++) fake->getMixEffectBlock(me).SetTransitionPosition(i / 200.0);
+	}
+	update();
+	printf(" %-40s %llu position event(s) delivered for 200 notifications, %llu merged, position %.3f\n", "COM coalescing, one frame",
+		(unsigned long long)counter.position.load(), (unsigned long long)(device.getEventCoalescer().getMergedCount() - merged),
+		device.getMixEffectState(1).transition.position);
+
+	// ME 2 and its keyers, through their own monitors
+	program = (device.getProgramIndex(1) + 1) % inputCount;
+	device.setProgram(1, program);
+	device.setKeyerOnAir(1, 3, true);
+	update();
+	ofxAtem::MixEffectState me2 = device.getMixEffectState(1);
+	printf(" %-40s program %s, keyer 4 %s, %d block(s)\n", "COM ME 2 mirror", check(me2.programIndex == program) ? "mirrored" : "STALE",
+		check(me2.keyersOnAir == (1u << 3)) ? "on air" : "MISSING", device.getMixEffectBlockCount());
+	device.setKeyerOnAir(1, 3, false);
+
+	// Every get_* helper of AtemDeviceInfo, with the report itself discarded
+	fflush(stdout);
+	int savedStdout = dup(1);
+	int devNull = open("/dev/null", O_WRONLY);
+	dup2(devNull, 1);
+	uint64_t start = nowMicros();
+	device.printInfo();
+	fflush(stdout);
+	uint64_t printInfoMicros = nowMicros() - start;
+	dup2(savedStdout, 1);
+	::close(devNull);
+	::close(savedStdout);
+	printf(" %-40s %.1f ms\n", "COM printInfo", printInfoMicros / 1000.0);
+
+	// The timecode asked for on every frame, a second of 60 Hz updates
+	for (int i = 0; i < 60; i++) {
+		update();
+		std::this_thread::sleep_for(std::chrono::microseconds(16667));
+	}
+	ofxAtem::ClockEstimate estimate = device.getClock().getEstimate();
+	printf(" %-40s %s, %d timecodes, %.2f fps (nominal %.2f), jitter %.0f us\n", "COM switcher clock", check(estimate.locked) ? "locked" : "NOT locked",
+		(int)estimate.samples, estimate.framesPerSecond, estimate.frameRate.framesPerSecond(), estimate.jitterMicros);
+
+	// The switcher goes silent without the SDK noticing, the timecode heartbeat does
+	LinkWatcher watcher;
+	ofAddListener(device.linkDegraded, &watcher, &LinkWatcher::onLinkDegraded);
+	ofAddListener(device.linkRestored, &watcher, &LinkWatcher::onLinkRestored);
+	fake->setReachable(false);
+	start = nowMicros();
+	bool degraded = pumpUntil(watcher.degradedMicros, 1, 2000);
+	fake->setReachable(true);
+	uint64_t back = nowMicros();
+	bool restored = pumpUntil(watcher.restoredMicros, 1, 2000);
+	ofRemoveListener(device.linkDegraded, &watcher, &LinkWatcher::onLinkDegraded);
+	ofRemoveListener(device.linkRestored, &watcher, &LinkWatcher::onLinkRestored);
+	if (check(degraded && restored)) {
+		printf(" %-40s degraded %.0f ms into the silence, restored %.1f ms after it, rtt %.2f ms\n", "COM liveness",
+			(watcher.degradedMicros - start) / 1000.0, (watcher.restoredMicros - back) / 1000.0, device.getConnectionHealth().rttMillis);
+	} else {
+		printf(" %-40s silent link %s\n", "COM liveness", degraded ? "not restored" : "NOT detected");
+	}
+
+	// The switcher drops the link and stays away for a while; the backend notices on the next
+	// frame and retries with backoff. Every ConnectTo takes 100 ms and the first ones fail,
+	// on a worker thread, so update() keeps its pace throughout
+	int preview = (device.getPreviewIndex() + 3) % inputCount;
+	fake->setConnectDelay(100);
+	fake->disconnect();
+	bool detected = pumpUntil(counter.disconnected, 1, 1000);
+	bool queued = device.setPreviewByIndex(preview);
+	longestUpdate = 0;
+	pumpUntil(counter.reconnected, 1, 600);
+	fake->setReachable(true);
+	start = nowMicros();
+	bool reconnected = pumpUntil(counter.reconnected, 1, 10000);
+	uint64_t elapsed = nowMicros() - start;
+	fake->setConnectDelay(0);
+	// The replayed preview's callback comes with the next update
+	update();
+	printf(" %-40s %s, back %.1f ms after the switcher, %s, queued preview %s, longest update() %.2f ms\n", "COM reconnect",
+		check(detected) ? "loss detected" : "loss NOT detected", elapsed / 1000.0, check(reconnected && device.isOnline()) ? "online" : "FAILED",
+		check(queued && device.getPreviewIndex() == preview) ? "replayed" : "LOST", longestUpdate / 1000.0);
+
+	ofRemoveListener(device.mixEffectBlockChanged, &counter, &Counter::onMixEffectBlockChanged);
+	ofRemoveListener(device.disconnected, &counter, &Counter::onDisconnected);
+	ofRemoveListener(device.reconnected, &counter, &Counter::onReconnected);
+	device.disconnect();
+	printf(" %-40s %d after 10 connects, %d after this one\n", "COM callbacks left on the switcher",
+		(int)leftCallbacks, (int)fake->getCallbackCount());
+
+	// Back with one ME instead of two: a cut on ME 2 held meanwhile is refused on replay,
+	// and printInfo() has nothing to ask while the switcher is away
+	{
+		ofxAtemCompat::FakeSwitcherTopology oneMe = topology;
+		oneMe.mixEffectBlocks = 1;
+		CComPtr<ofxAtemCompat::FakeSwitcher> smaller;
+		smaller.Attach(new ofxAtemCompat::FakeSwitcher(oneMe));
+		Counter shrink;
+		ofxAtem::ComDevice shrinking;
+		ofAddListener(shrinking.disconnected, &shrink, &Counter::onDisconnected);
+		ofAddListener(shrinking.reconnected, &shrink, &Counter::onReconnected);
+		bool reconnected = false, held = false;
+		if (shrinking.connect("fake")) {
+			fake->disconnect();
+			pumpUntil(shrink.disconnected, 1, 1000);
+			held = shrinking.setProgram(1, 0);
+			shrinking.printInfo();
+			ofxAtemCompat::installFakeSwitcher(smaller);
+			reconnected = pumpUntil(shrink.reconnected, 1, 5000);
+			fake->setReachable(true);
+		}
+		ofRemoveListener(shrinking.disconnected, &shrink, &Counter::onDisconnected);
+		ofRemoveListener(shrinking.reconnected, &shrink, &Counter::onReconnected);
+		printf(" %-40s %s, ME 2 cut %s, %d block(s)\n", "COM reconnect to fewer MEs", check(reconnected) ? "online" : "FAILED",
+			check(held) ? "held and dropped" : "NOT held", shrinking.getMixEffectBlockCount());
+		check(shrinking.getMixEffectBlockCount() == 1);
+		shrinking.disconnect();
+	}
+	ofxAtemCompat::installFakeSwitcher(nullptr);
+}
+#endif
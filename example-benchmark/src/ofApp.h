@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+
+#include "ofMain.h"
+#include "ofxAtem.h"
+#include "AtemBroker.h"
+#include "AtemDeviceManager.h"
+#include "AtemEmulator.h"
+#include "AtemRle.h"
+#include "AtemSpscQueue.h"
+
+#ifdef OFX_ATEM_COM_COMPAT
+#include "AtemFakeSwitcher.h"
+#endif
+
+// Measures Device against the loopback emulator, no switcher needed.
+// Built with OFX_ATEM_COM_COMPAT it also runs the COM backend against the in-memory switcher.
+class ofApp : public ofBaseApp{
+
+public:
+	void setup();
+	void exit();
+
+	void onMixEffectBlockChanged(BMDSwitcherMixEffectBlockEventType& e);
+	void onDisconnected();
+	void onReconnected();
+
+private:
+	void benchConnect();
+	void benchWarmStart();
+	void benchRoundTrip();
+	void benchEventThroughput(float lossRate);
+	void benchMixEffectSnapshot();
+	void benchMixEffectBlocks();
+	void benchEventQueue();
+	void benchCoalescing();
+	void benchInputLookup();
+	void benchBatching();
+	void benchAllocations();
+	void benchLossyDelivery(float lossRate);
+	void benchMediaUpload(int window, float lossRate);
+	void benchRleRoundTrip();
+	void benchRleCodec();
+	void benchTimecodeRoundTrip();
+	void benchSwitcherClock(double driftPpm);
+	void benchDeviceManager(int count);
+	void benchLoad(int count);
+	void benchBroker(int count);
+	void benchReplay();
+	void benchRecordDispatch();
+	void benchLiveness();
+	void benchReconnect();
+#ifdef OFX_ATEM_COM_COMPAT
+	void benchComBackend();
+#endif
+
+	bool waitForEvents(uint64_t target, uint64_t timeoutMillis);
+	bool check(bool passed);
+
+	ofxAtem::Emulator emulator;
+	ofxAtem::Device atem;
+	std::string address;
+
+	std::atomic<uint64_t> programEvents{ 0 };
+	std::atomic<uint64_t> disconnectedEvents{ 0 };
+	std::atomic<uint64_t> reconnectedEvents{ 0 };
+	// Checks that failed, for the exit code
+	int failedChecks = 0;
+};
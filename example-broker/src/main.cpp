@@ -0,0 +1,24 @@
+#include "ofMain.h"
+#include "ofAppNoWindow.h"
+#include "ofApp.h"
+
+//========================================================================
+// Usage: example-broker [--switcher ADDRESS] [--path PATH]
+int main(int argc, char* argv[]) {
+
+	std::string switcherAddress = "192.168.10.240";
+	std::string path = "/tmp/ofxAtem.sock";
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string key = argv[i];
+		std::string value = argv[i + 1];
+		if (key == "--switcher") switcherAddress = value;
+		else if (key == "--path") path = value;
+	}
+
+	// headless, the broker has nothing to draw
+	auto window = std::make_shared<ofAppNoWindow>();
+	ofRunApp(window, std::make_shared<ofApp>(switcherAddress, path));
+	ofRunMainLoop();
+
+}
@@ -0,0 +1,32 @@
+#include "ofApp.h"
+
+
+void ofApp::setup() {
+
+	ofSetFrameRate(30);
+
+	if (!broker.start(switcherAddress, path)) {
+		ofExit(1);
+		return;
+	}
+
+	ofLogNotice() << "Sharing " << switcherAddress << " on unix:" << path;
+}
+
+void ofApp::update() {
+
+	if (broker.isUpstreamConnected() != upstreamConnected) {
+		upstreamConnected = broker.isUpstreamConnected();
+		ofLogNotice() << "switcher " << (upstreamConnected ? "connected" : "disconnected");
+	}
+
+	size_t count = broker.getClientCount();
+	if (count != clientCount) {
+		ofLogNotice() << count << " client(s) connected";
+		clientCount = count;
+	}
+}
+
+void ofApp::exit() {
+	broker.stop();
+}
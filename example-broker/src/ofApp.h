@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxAtem.h"
+#include "AtemBroker.h"
+
+class ofApp : public ofBaseApp{
+
+public:
+	ofApp(const std::string& switcherAddress, const std::string& path) : switcherAddress(switcherAddress), path(path) {}
+
+	void setup();
+	void update();
+	void exit();
+
+private:
+	ofxAtem::Broker broker;
+	std::string switcherAddress;
+	std::string path;
+	size_t clientCount = 0;
+	bool upstreamConnected = false;
+};
@@ -0,0 +1,47 @@
+#include "ofMain.h"
+#include "ofAppNoWindow.h"
+#include "ofApp.h"
+
+//========================================================================
+// Usage: example-emulator [--inputs N] [--mes N] [--keyers N] [--aux N]
+//                         [--stills N] [--clips N] [--port N] [--name NAME]
+//                         [--loss PERCENT]
+//                         [--transition-rate HZ] [--level-rate HZ] [--cut-rate HZ]
+//                         [--video-mode N] [--timecode DRIFT_PPM]
+int main(int argc, char* argv[]) {
+
+	ofxAtem::EmulatorTopology topology;
+	ofxAtem::EmulatorStorm storm;
+	uint16_t port = 9910;
+	float lossRate = 0;
+	bool timecode = false;
+	double timecodeDriftPpm = 0;
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		std::string key = argv[i];
+		std::string value = argv[i + 1];
+		if (key == "--inputs") topology.externalInputs = ofToInt(value);
+		else if (key == "--mes") topology.mixEffectBlocks = ofToInt(value);
+		else if (key == "--keyers") topology.keyersPerMixEffectBlock = ofToInt(value);
+		else if (key == "--aux") topology.auxOutputs = ofToInt(value);
+		else if (key == "--stills") topology.stills = ofToInt(value);
+		else if (key == "--clips") topology.clips = ofToInt(value);
+		else if (key == "--port") port = (uint16_t)ofToInt(value);
+		else if (key == "--name") topology.productName = value;
+		else if (key == "--loss") lossRate = ofToFloat(value) / 100.f;
+		else if (key == "--transition-rate") storm.transitionRate = ofToFloat(value);
+		else if (key == "--level-rate") storm.levelRate = ofToFloat(value);
+		else if (key == "--cut-rate") storm.cutRate = ofToFloat(value);
+		else if (key == "--video-mode") topology.videoMode = (uint8_t)ofToInt(value);
+		else if (key == "--timecode") {
+			timecode = true;
+			timecodeDriftPpm = ofToDouble(value);
+		}
+	}
+
+	// headless, the emulator has nothing to draw
+	auto window = std::make_shared<ofAppNoWindow>();
+	ofRunApp(window, std::make_shared<ofApp>(topology, storm, port, lossRate, timecode, timecodeDriftPpm));
+	ofRunMainLoop();
+
+}
@@ -0,0 +1,59 @@
+#include "ofApp.h"
+
+
+void ofApp::setup() {
+
+	ofSetFrameRate(30);
+
+	if (!emulator.start(topology, port)) {
+		ofExit(1);
+		return;
+	}
+	emulator.setLossRate(lossRate);
+	emulator.setStorm(storm);
+	emulator.setTimecode(timecode, timecodeDriftPpm);
+
+	ofLogNotice() << "Emulating \"" << topology.productName << "\" on 127.0.0.1:" << port
+		<< " with " << emulator.getInputs().size() << " sources and " << topology.mixEffectBlocks << " ME";
+}
+
+void ofApp::update() {
+
+	size_t count = emulator.getSessionCount();
+	if (count != sessionCount) {
+		ofLogNotice() << count << " client(s) connected";
+		sessionCount = count;
+	}
+
+	// Delivery latency of the last interval, summed up over the clients
+	if (ofGetElapsedTimeMillis() >= nextReportMillis) {
+		if (nextReportMillis) reportLatencies();
+		nextReportMillis = ofGetElapsedTimeMillis() + 5000;
+	}
+}
+
+void ofApp::reportLatencies() {
+	std::vector<ofxAtem::DeliveryLatency> latencies = emulator.getDeliveryLatencies();
+	emulator.resetDeliveryLatencies();
+
+	std::vector<uint32_t> p50s, p99s;
+	uint64_t packets = 0;
+	const ofxAtem::DeliveryLatency* worst = nullptr;
+	for (auto& latency : latencies) {
+		if (!latency.packets) continue;
+		p50s.push_back(latency.p50);
+		p99s.push_back(latency.p99);
+		packets += latency.packets;
+		if (!worst || latency.p99 > worst->p99) worst = &latency;
+	}
+	if (!worst) return;
+
+	std::sort(p50s.begin(), p50s.end());
+	std::sort(p99s.begin(), p99s.end());
+	ofLogNotice() << packets << " packets to " << p99s.size() << " client(s), delivery p50 " << p50s[p50s.size() / 2]
+		<< " us, p99 " << p99s[p99s.size() / 2] << " us (median client), worst p99 " << worst->p99 << " us (session " << ofToHex(worst->sessionId) << ")";
+}
+
+void ofApp::exit() {
+	emulator.stop();
+}
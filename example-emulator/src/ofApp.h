@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ofMain.h"
+#include "ofxAtem.h"
+#include "AtemEmulator.h"
+
+class ofApp : public ofBaseApp{
+
+public:
+	ofApp(const ofxAtem::EmulatorTopology& topology, const ofxAtem::EmulatorStorm& storm, uint16_t port, float lossRate, bool timecode, double timecodeDriftPpm)
+		: topology(topology), storm(storm), port(port), lossRate(lossRate), timecode(timecode), timecodeDriftPpm(timecodeDriftPpm) {}
+
+	void setup();
+	void update();
+	void exit();
+
+private:
+	void reportLatencies();
+
+	ofxAtem::Emulator emulator;
+	ofxAtem::EmulatorTopology topology;
+	ofxAtem::EmulatorStorm storm;
+	uint16_t port;
+	float lossRate;
+	bool timecode;
+	double timecodeDriftPpm;
+	size_t sessionCount = 0;
+	uint64_t nextReportMillis = 0;
+};
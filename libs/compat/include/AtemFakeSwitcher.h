@@ -0,0 +1,358 @@
+#pragma once
+
+// In-memory stand-ins for the SDK objects the COM backend talks to: discovery, switcher,
+// inputs (aux outputs included), mix effect blocks, upstream keyers and their iterators.
+// They keep their state in plain members and call the registered callbacks synchronously,
+// on the thread that made the change, so ComBackend, the monitors and the get_* helpers
+// of AtemDeviceInfo run unchanged against them. Built with OFX_ATEM_COM_COMPAT only.
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "ofxAtemComCompat.h"
+#include "atlbase.h"
+#include "BMDSwitcherAPI_h.h"
+
+namespace ofxAtemCompat {
+
+	// Shape of the fake switcher
+	struct FakeSwitcherTopology {
+		std::string productName = "ATEM Fake";
+		int externalInputs = 4;
+		int mixEffectBlocks = 1;
+		int keyersPerMixEffectBlock = 1;
+		int auxOutputs = 1;
+	};
+
+	// Callbacks registered on one object, notified outside the lock so they may call back in
+	template<class Callback>
+	class FakeCallbacks {
+	public:
+		HRESULT add(Callback* callback) {
+			if (!callback) return E_INVALIDARG;
+			std::lock_guard<std::mutex> lock(mutex);
+			callback->AddRef();
+			callbacks.push_back(callback);
+			return S_OK;
+		}
+
+		HRESULT remove(Callback* callback) {
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto it = callbacks.begin(); it != callbacks.end(); ++it) {
+				if (*it == callback) {
+					callbacks.erase(it);
+					callback->Release();
+					return S_OK;
+				}
+			}
+			return E_INVALIDARG;
+		}
+
+		template<typename... Args>
+		void notify(Args... args) {
+			std::vector<CComPtr<Callback>> current;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				current.assign(callbacks.begin(), callbacks.end());
+			}
+			for (auto& callback : current) callback->Notify(args...);
+		}
+
+		size_t size() {
+			std::lock_guard<std::mutex> lock(mutex);
+			return callbacks.size();
+		}
+
+		void clear() {
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto callback : callbacks) callback->Release();
+			callbacks.clear();
+		}
+
+	private:
+		std::mutex mutex;
+		std::vector<Callback*> callbacks;
+	};
+
+	// Walks a snapshot of the items it was created with
+	template<class Iterator, class Item, const IID& iteratorId>
+	class FakeIterator : public Iterator {
+	public:
+		FakeIterator(const std::vector<CComPtr<Item>>& items) : items(items) {}
+		virtual ~FakeIterator() {}
+
+		HRESULT QueryInterface(REFIID iid, void** ppv) override {
+			if (!ppv) return E_POINTER;
+			if (IsEqualGUID(iid, iteratorId) || IsEqualGUID(iid, IID_IUnknown)) {
+				*ppv = static_cast<Iterator*>(this);
+				AddRef();
+				return S_OK;
+			}
+			*ppv = nullptr;
+			return E_NOINTERFACE;
+		}
+		ULONG AddRef() override { return ++refCount; }
+		ULONG Release() override {
+			ULONG count = --refCount;
+			if (count == 0) delete this;
+			return count;
+		}
+
+		HRESULT Next(Item** item) override {
+			if (!item) return E_POINTER;
+			if (next >= items.size()) {
+				*item = nullptr;
+				return S_FALSE;
+			}
+			*item = items[next++];
+			(*item)->AddRef();
+			return S_OK;
+		}
+
+	protected:
+		std::vector<CComPtr<Item>> items;
+		size_t next = 0;
+		std::atomic<ULONG> refCount{ 1 };
+	};
+
+	class FakeInputIterator : public FakeIterator<IBMDSwitcherInputIterator, IBMDSwitcherInput, IID_IBMDSwitcherInputIterator> {
+	public:
+		using FakeIterator::FakeIterator;
+		HRESULT GetById(BMDSwitcherInputId inputId, IBMDSwitcherInput** input) override;
+	};
+	typedef FakeIterator<IBMDSwitcherMixEffectBlockIterator, IBMDSwitcherMixEffectBlock, IID_IBMDSwitcherMixEffectBlockIterator> FakeMixEffectBlockIterator;
+	typedef FakeIterator<IBMDSwitcherKeyIterator, IBMDSwitcherKey, IID_IBMDSwitcherKeyIterator> FakeKeyIterator;
+
+	// Video source, and the source selection of an aux output for aux port types
+	class FakeInput : public IBMDSwitcherInput, public IBMDSwitcherInputAux {
+	public:
+		FakeInput(BMDSwitcherInputId id, const std::string& longName, const std::string& shortName, BMDSwitcherPortType portType,
+			BMDSwitcherExternalPortType externalPortType = bmdSwitcherExternalPortTypeInternal);
+		virtual ~FakeInput() { callbacks.clear(); auxCallbacks.clear(); }
+
+		HRESULT QueryInterface(REFIID iid, void** ppv) override;
+		ULONG AddRef() override { return ++refCount; }
+		ULONG Release() override;
+
+		// IBMDSwitcherInput
+		HRESULT GetPortType(BMDSwitcherPortType* type) override;
+		HRESULT GetInputAvailability(BMDSwitcherInputAvailability* availability) override;
+		HRESULT SetShortName(BSTR name) override;
+		HRESULT GetShortName(BSTR* name) override;
+		HRESULT SetLongName(BSTR name) override;
+		HRESULT GetLongName(BSTR* name) override;
+		HRESULT AreNamesDefault(BOOL* isDefault) override;
+		HRESULT ResetNames() override;
+		HRESULT IsProgramTallied(BOOL* isTallied) override;
+		HRESULT IsPreviewTallied(BOOL* isTallied) override;
+		HRESULT GetAvailableExternalPortTypes(BMDSwitcherExternalPortType* types) override;
+		HRESULT SetCurrentExternalPortType(BMDSwitcherExternalPortType value) override;
+		HRESULT GetCurrentExternalPortType(BMDSwitcherExternalPortType* value) override;
+		HRESULT GetInputId(BMDSwitcherInputId* inputId) override;
+		HRESULT AddCallback(IBMDSwitcherInputCallback* callback) override { return callbacks.add(callback); }
+		HRESULT RemoveCallback(IBMDSwitcherInputCallback* callback) override { return callbacks.remove(callback); }
+
+		// IBMDSwitcherInputAux
+		HRESULT GetInputSource(BMDSwitcherInputId* input) override;
+		HRESULT SetInputSource(BMDSwitcherInputId input) override;
+		HRESULT GetInputAvailabilityMask(BMDSwitcherInputAvailability* availabilityMask) override;
+		HRESULT AddCallback(IBMDSwitcherInputAuxCallback* callback) override { return auxCallbacks.add(callback); }
+		HRESULT RemoveCallback(IBMDSwitcherInputAuxCallback* callback) override { return auxCallbacks.remove(callback); }
+
+		size_t getCallbackCount() { return callbacks.size() + auxCallbacks.size(); }
+		void clearCallbacks() { callbacks.clear(); auxCallbacks.clear(); }
+
+	private:
+		std::mutex mutex;
+		BMDSwitcherInputId id;
+		std::wstring longName, shortName;
+		std::wstring defaultLongName, defaultShortName;
+		BMDSwitcherPortType portType;
+		BMDSwitcherExternalPortType externalPortType;
+		BMDSwitcherInputId auxSource = 0;
+		FakeCallbacks<IBMDSwitcherInputCallback> callbacks;
+		FakeCallbacks<IBMDSwitcherInputAuxCallback> auxCallbacks;
+		std::atomic<ULONG> refCount{ 1 };
+	};
+
+	class FakeKey : public IBMDSwitcherKey {
+	public:
+		virtual ~FakeKey() { callbacks.clear(); }
+
+		HRESULT QueryInterface(REFIID iid, void** ppv) override;
+		ULONG AddRef() override { return ++refCount; }
+		ULONG Release() override;
+
+		HRESULT DoesSupportAdvancedChroma(BOOL* supportsAdvancedChroma) override;
+		HRESULT GetType(BMDSwitcherKeyType* type) override;
+		HRESULT SetType(BMDSwitcherKeyType type) override;
+		HRESULT GetInputCut(BMDSwitcherInputId* input) override;
+		HRESULT SetInputCut(BMDSwitcherInputId input) override;
+		HRESULT GetInputFill(BMDSwitcherInputId* input) override;
+		HRESULT SetInputFill(BMDSwitcherInputId input) override;
+		HRESULT GetCutInputAvailabilityMask(BMDSwitcherInputAvailability*) override { return E_NOTIMPL; }
+		HRESULT GetFillInputAvailabilityMask(BMDSwitcherInputAvailability*) override { return E_NOTIMPL; }
+		HRESULT GetOnAir(BOOL* onAir) override;
+		HRESULT SetOnAir(BOOL onAir) override;
+		HRESULT CanBeDVEKey(BOOL* canDVE) override;
+		HRESULT GetMasked(BOOL*) override { return E_NOTIMPL; }
+		HRESULT SetMasked(BOOL) override { return E_NOTIMPL; }
+		HRESULT GetMaskTop(double*) override { return E_NOTIMPL; }
+		HRESULT SetMaskTop(double) override { return E_NOTIMPL; }
+		HRESULT GetMaskBottom(double*) override { return E_NOTIMPL; }
+		HRESULT SetMaskBottom(double) override { return E_NOTIMPL; }
+		HRESULT GetMaskLeft(double*) override { return E_NOTIMPL; }
+		HRESULT SetMaskLeft(double) override { return E_NOTIMPL; }
+		HRESULT GetMaskRight(double*) override { return E_NOTIMPL; }
+		HRESULT SetMaskRight(double) override { return E_NOTIMPL; }
+		HRESULT ResetMask() override { return E_NOTIMPL; }
+		HRESULT GetTransitionSelectionMask(BMDSwitcherTransitionSelection*) override { return E_NOTIMPL; }
+		HRESULT AddCallback(IBMDSwitcherKeyCallback* callback) override { return callbacks.add(callback); }
+		HRESULT RemoveCallback(IBMDSwitcherKeyCallback* callback) override { return callbacks.remove(callback); }
+
+		size_t getCallbackCount() { return callbacks.size(); }
+		void clearCallbacks() { callbacks.clear(); }
+
+	private:
+		std::mutex mutex;
+		BMDSwitcherKeyType type = bmdSwitcherKeyTypeLuma;
+		BMDSwitcherInputId inputCut = 0;
+		BMDSwitcherInputId inputFill = 0;
+		bool onAir = false;
+		FakeCallbacks<IBMDSwitcherKeyCallback> callbacks;
+		std::atomic<ULONG> refCount{ 1 };
+	};
+
+	// Program / preview bus with instant cuts; an auto transition also completes at once,
+	// reporting the in-transition changes around it like the hardware does
+	class FakeMixEffectBlock : public IBMDSwitcherMixEffectBlock {
+	public:
+		FakeMixEffectBlock(int keyers, BMDSwitcherInputId program, BMDSwitcherInputId preview);
+		virtual ~FakeMixEffectBlock() { callbacks.clear(); }
+
+		HRESULT QueryInterface(REFIID iid, void** ppv) override;
+		ULONG AddRef() override { return ++refCount; }
+		ULONG Release() override;
+
+		HRESULT GetProgramInput(BMDSwitcherInputId* value) override;
+		HRESULT SetProgramInput(BMDSwitcherInputId value) override;
+		HRESULT GetPreviewInput(BMDSwitcherInputId* value) override;
+		HRESULT SetPreviewInput(BMDSwitcherInputId value) override;
+		HRESULT GetPreviewLive(BOOL* value) override;
+		HRESULT GetPreviewTransition(BOOL* value) override;
+		HRESULT SetPreviewTransition(BOOL) override { return E_NOTIMPL; }
+		HRESULT PerformAutoTransition() override;
+		HRESULT PerformCut() override;
+		HRESULT GetInTransition(BOOL* value) override;
+		HRESULT GetTransitionPosition(double* value) override;
+		HRESULT SetTransitionPosition(double value) override;
+		HRESULT GetTransitionFramesRemaining(unsigned int* value) override;
+		HRESULT PerformFadeToBlack() override { return E_NOTIMPL; }
+		HRESULT GetFadeToBlackRate(unsigned int*) override { return E_NOTIMPL; }
+		HRESULT SetFadeToBlackRate(unsigned int) override { return E_NOTIMPL; }
+		HRESULT GetFadeToBlackFramesRemaining(unsigned int*) override { return E_NOTIMPL; }
+		HRESULT GetFadeToBlackFullyBlack(BOOL*) override { return E_NOTIMPL; }
+		HRESULT SetFadeToBlackFullyBlack(BOOL) override { return E_NOTIMPL; }
+		HRESULT GetInFadeToBlack(BOOL*) override { return E_NOTIMPL; }
+		HRESULT GetFadeToBlackInTransition(BOOL*) override { return E_NOTIMPL; }
+		HRESULT GetInputAvailabilityMask(BMDSwitcherInputAvailability* value) override;
+		HRESULT CreateIterator(REFIID iid, LPVOID* ppv) override;
+		HRESULT AddCallback(IBMDSwitcherMixEffectBlockCallback* callback) override { return callbacks.add(callback); }
+		HRESULT RemoveCallback(IBMDSwitcherMixEffectBlockCallback* callback) override { return callbacks.remove(callback); }
+
+		// Its keyers' included
+		size_t getCallbackCount();
+		void clearCallbacks();
+
+	private:
+		std::mutex mutex;
+		BMDSwitcherInputId program;
+		BMDSwitcherInputId preview;
+		double transitionPosition = 0;
+		std::vector<CComPtr<IBMDSwitcherKey>> keyers;
+		FakeCallbacks<IBMDSwitcherMixEffectBlockCallback> callbacks;
+		std::atomic<ULONG> refCount{ 1 };
+	};
+
+	class FakeSwitcher : public IBMDSwitcher {
+	public:
+		FakeSwitcher(const FakeSwitcherTopology& topology = FakeSwitcherTopology());
+		virtual ~FakeSwitcher() { callbacks.clear(); }
+
+		HRESULT QueryInterface(REFIID iid, void** ppv) override;
+		ULONG AddRef() override { return ++refCount; }
+		ULONG Release() override;
+
+		HRESULT GetProductName(BSTR* productName) override;
+		HRESULT GetVideoMode(BMDSwitcherVideoMode* videoMode) override;
+		HRESULT SetVideoMode(BMDSwitcherVideoMode videoMode) override;
+		HRESULT DoesSupportVideoMode(BMDSwitcherVideoMode videoMode, BOOL* supported) override;
+		HRESULT DoesVideoModeChangeRequireReconfiguration(BMDSwitcherVideoMode, BOOL*) override { return E_NOTIMPL; }
+		HRESULT GetMethodForDownConvertedSD(BMDSwitcherDownConversionMethod*) override { return E_NOTIMPL; }
+		HRESULT SetMethodForDownConvertedSD(BMDSwitcherDownConversionMethod) override { return E_NOTIMPL; }
+		HRESULT GetDownConvertedHDVideoMode(BMDSwitcherVideoMode coreVideoMode, BMDSwitcherVideoMode* downConvertedHDVideoMode) override;
+		HRESULT SetDownConvertedHDVideoMode(BMDSwitcherVideoMode, BMDSwitcherVideoMode) override { return E_NOTIMPL; }
+		HRESULT DoesSupportDownConvertedHDVideoMode(BMDSwitcherVideoMode, BMDSwitcherVideoMode, BOOL*) override { return E_NOTIMPL; }
+		HRESULT GetMultiViewVideoMode(BMDSwitcherVideoMode coreVideoMode, BMDSwitcherVideoMode* multiviewVideoMode) override;
+		HRESULT SetMultiViewVideoMode(BMDSwitcherVideoMode, BMDSwitcherVideoMode) override { return E_NOTIMPL; }
+		HRESULT DoesSupportMultiViewVideoMode(BMDSwitcherVideoMode, BMDSwitcherVideoMode, BOOL*) override { return E_NOTIMPL; }
+		HRESULT Get3GSDIOutputLevel(BMDSwitcher3GSDIOutputLevel*) override { return E_NOTIMPL; }
+		HRESULT Set3GSDIOutputLevel(BMDSwitcher3GSDIOutputLevel) override { return E_NOTIMPL; }
+		HRESULT GetPowerStatus(BMDSwitcherPowerStatus* powerStatus) override;
+		HRESULT GetTimeCode(unsigned char* hours, unsigned char* minutes, unsigned char* seconds, unsigned char* frames, BOOL* dropFrame) override;
+		HRESULT SetTimeCode(unsigned char, unsigned char, unsigned char, unsigned char) override { return E_NOTIMPL; }
+		HRESULT RequestTimeCode() override;
+		HRESULT GetTimeCodeLocked(BOOL*) override { return E_NOTIMPL; }
+		HRESULT GetTimeCodeMode(BMDSwitcherTimeCodeMode*) override { return E_NOTIMPL; }
+		HRESULT SetTimeCodeMode(BMDSwitcherTimeCodeMode) override { return E_NOTIMPL; }
+		HRESULT GetAreOutputsConfigurable(BOOL*) override { return E_NOTIMPL; }
+		HRESULT GetSuperSourceCascade(BOOL*) override { return E_NOTIMPL; }
+		HRESULT SetSuperSourceCascade(BOOL) override { return E_NOTIMPL; }
+		HRESULT SuspendStreaming(unsigned int) override { return E_NOTIMPL; }
+		HRESULT AllowStreamingToResume() override { return E_NOTIMPL; }
+		HRESULT DoesSupportAutoVideoMode(BOOL* supported) override;
+		HRESULT GetAutoVideoMode(BOOL*) override { return E_NOTIMPL; }
+		HRESULT GetAutoVideoModeDetected(BOOL*) override { return E_NOTIMPL; }
+		HRESULT SetAutoVideoMode(BOOL) override { return E_NOTIMPL; }
+		HRESULT CreateIterator(REFIID iid, LPVOID* ppv) override;
+		HRESULT AddCallback(IBMDSwitcherCallback* callback) override { return callbacks.add(callback); }
+		HRESULT RemoveCallback(IBMDSwitcherCallback* callback) override { return callbacks.remove(callback); }
+
+		// Panel side
+		FakeMixEffectBlock& getMixEffectBlock(int me) { return *mixEffectBlocks[me]; }
+		FakeInput& getInput(size_t index) { return *inputs[index]; }
+		size_t getInputCount() const { return inputs.size(); }
+
+		// Drops the link: callbacks hear bmdSwitcherEventTypeDisconnected and ConnectTo()
+		// fails until setReachable(true)
+		void disconnect();
+		void setReachable(bool reachable) { this->reachable = reachable; }
+		bool isReachable() const { return reachable; }
+		// ConnectTo() takes this long before answering, like the SDK waiting on a real network
+		void setConnectDelay(int millis) { connectDelayMillis = millis; }
+		int getConnectDelay() const { return connectDelayMillis; }
+
+		// Callbacks still registered on the switcher, its inputs and mix effect blocks
+		size_t getCallbackCount();
+
+	private:
+		std::wstring productName;
+		BMDSwitcherVideoMode videoMode = bmdSwitcherVideoMode1080p50;
+		// Timecode runs from 10:00:00:00 at construction
+		std::chrono::steady_clock::time_point timecodeStart = std::chrono::steady_clock::now();
+		std::vector<CComPtr<FakeInput>> inputs;
+		std::vector<CComPtr<FakeMixEffectBlock>> mixEffectBlocks;
+		std::atomic<bool> reachable{ true };
+		std::atomic<int> connectDelayMillis{ 0 };
+		FakeCallbacks<IBMDSwitcherCallback> callbacks;
+		std::atomic<ULONG> refCount{ 1 };
+	};
+
+	// Makes CoCreateInstance(CLSID_CBMDSwitcherDiscovery) hand out a discovery whose ConnectTo()
+	// returns switcher for any address. nullptr uninstalls it.
+	void installFakeSwitcher(FakeSwitcher* switcher);
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+// ATL smart pointers and CComBSTR, as far as the COM backend uses them
+#include <cassert>
+#include <memory>
+#include <utility>
+
+#include "ofxAtemComCompat.h"
+
+// Without __uuidof on types, the interfaces CComPtr::CoCreateInstance() and CComQIPtr
+// are used with name their IID here
+template<class T> struct ComInterfaceId;
+
+#define OFX_ATEM_COM_INTERFACE(I) \
+	struct I; \
+	EXTERN_C const IID IID_##I; \
+	template<> struct ComInterfaceId<I> { static const IID& get() { return IID_##I; } };
+
+template<> struct ComInterfaceId<IUnknown> { static const IID& get() { return IID_IUnknown; } };
+OFX_ATEM_COM_INTERFACE(IBMDSwitcherDiscovery)
+OFX_ATEM_COM_INTERFACE(IBMDSwitcherInput)
+OFX_ATEM_COM_INTERFACE(IBMDSwitcherInputAux)
+OFX_ATEM_COM_INTERFACE(IBMDSwitcherMediaPool)
+OFX_ATEM_COM_INTERFACE(IBMDSwitcherAudioMixer)
+OFX_ATEM_COM_INTERFACE(IBMDSwitcherFairlightAudioMixer)
+
+template<class T>
+class CComPtr {
+public:
+	CComPtr() : p(nullptr) {}
+	CComPtr(T* lp) : p(lp) { if (p) p->AddRef(); }
+	CComPtr(const CComPtr& other) : CComPtr(other.p) {}
+	CComPtr(CComPtr&& other) : p(other.p) { other.p = nullptr; }
+	~CComPtr() { if (p) p->Release(); }
+
+	CComPtr& operator=(T* lp) {
+		if (lp) lp->AddRef();
+		if (p) p->Release();
+		p = lp;
+		return *this;
+	}
+	CComPtr& operator=(const CComPtr& other) { return *this = other.p; }
+	CComPtr& operator=(CComPtr&& other) {
+		if (this != std::addressof(other)) {
+			if (p) p->Release();
+			p = other.p;
+			other.p = nullptr;
+		}
+		return *this;
+	}
+
+	operator T*() const { return p; }
+	T* operator->() const { assert(p); return p; }
+	T& operator*() const { return *p; }
+	// Only for out parameters, like ATL it must be empty
+	T** operator&() { assert(!p); return &p; }
+	bool operator!() const { return !p; }
+
+	void Release() {
+		T* old = p;
+		p = nullptr;
+		if (old) old->Release();
+	}
+	void Attach(T* lp) {
+		if (p) p->Release();
+		p = lp;
+	}
+	T* Detach() {
+		T* old = p;
+		p = nullptr;
+		return old;
+	}
+
+	HRESULT CoCreateInstance(REFCLSID clsid, IUnknown* outer = nullptr, DWORD context = CLSCTX_ALL) {
+		assert(!p);
+		return ::CoCreateInstance(clsid, outer, context, ComInterfaceId<T>::get(), (void**)&p);
+	}
+
+	T* p;
+};
+
+// CComPtr filled through QueryInterface, empty if the object does not implement T
+template<class T>
+class CComQIPtr : public CComPtr<T> {
+public:
+	CComQIPtr() {}
+	CComQIPtr(IUnknown* lp) { query(lp); }
+	CComQIPtr(const CComQIPtr& other) : CComPtr<T>(other.p) {}
+	template<class U>
+	CComQIPtr(const CComPtr<U>& other) { query(other.p); }
+
+	CComQIPtr& operator=(IUnknown* lp) {
+		CComPtr<T>::Release();
+		query(lp);
+		return *this;
+	}
+	CComQIPtr& operator=(const CComQIPtr& other) {
+		CComPtr<T>::operator=(other.p);
+		return *this;
+	}
+	template<class U>
+	CComQIPtr& operator=(const CComPtr<U>& other) { return *this = static_cast<IUnknown*>(other.p); }
+
+private:
+	void query(IUnknown* lp) {
+		if (lp) lp->QueryInterface(ComInterfaceId<T>::get(), (void**)&this->p);
+	}
+};
+
+class CComBSTR {
+public:
+	CComBSTR() : m_str(nullptr) {}
+	CComBSTR(LPCOLESTR str) : m_str(SysAllocString(str)) {}
+	CComBSTR(LPCSTR str) : m_str(nullptr) {
+		if (!str) return;
+		int length = MultiByteToWideChar(CP_UTF8, 0, str, -1, nullptr, 0);
+		m_str = SysAllocStringLen(nullptr, UINT(length - 1));
+		std::wstring wide(length, 0);
+		MultiByteToWideChar(CP_UTF8, 0, str, -1, &wide[0], length);
+		memcpy(m_str, wide.data(), (length - 1) * sizeof(OLECHAR));
+	}
+	CComBSTR(const CComBSTR& other) : m_str(other.m_str ? SysAllocStringLen(other.m_str, SysStringLen(other.m_str)) : nullptr) {}
+	CComBSTR(CComBSTR&& other) : m_str(other.m_str) { other.m_str = nullptr; }
+	~CComBSTR() { SysFreeString(m_str); }
+
+	CComBSTR& operator=(const CComBSTR& other) {
+		if (this != &other) {
+			SysFreeString(m_str);
+			m_str = other.m_str ? SysAllocStringLen(other.m_str, SysStringLen(other.m_str)) : nullptr;
+		}
+		return *this;
+	}
+
+	operator BSTR() const { return m_str; }
+	// Only for out parameters, like ATL it must be empty
+	BSTR* operator&() { assert(!m_str); return &m_str; }
+
+	unsigned int Length() const { return SysStringLen(m_str); }
+	void Empty() {
+		SysFreeString(m_str);
+		m_str = nullptr;
+	}
+
+	BSTR m_str;
+};
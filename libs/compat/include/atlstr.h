@@ -0,0 +1,35 @@
+#pragma once
+
+// CString and the CT2CA conversion, as far as the COM backend uses them
+#include <string>
+
+#include "ofxAtemComCompat.h"
+
+class CString {
+public:
+	CString() {}
+	CString(const wchar_t* str) : str(str ? str : L"") {}
+
+	operator const wchar_t*() const { return str.c_str(); }
+	int GetLength() const { return (int)str.size(); }
+
+private:
+	std::wstring str;
+};
+
+// Wide to narrow (UTF-8), valid while the object lives
+class CT2CA {
+public:
+	CT2CA(const wchar_t* wide) {
+		if (!wide) return;
+		int length = WideCharToMultiByte(CP_UTF8, 0, wide, -1, nullptr, 0, nullptr, nullptr);
+		narrow.resize(length);
+		WideCharToMultiByte(CP_UTF8, 0, wide, -1, &narrow[0], length, nullptr, nullptr);
+		if (!narrow.empty()) narrow.pop_back();
+	}
+
+	operator LPSTR() { return &narrow[0]; }
+
+private:
+	std::string narrow;
+};
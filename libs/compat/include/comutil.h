@@ -0,0 +1,37 @@
+#pragma once
+
+// _bstr_t and _com_util from the compiler COM support, narrow strings are UTF-8
+#include <string>
+
+#include "ofxAtemComCompat.h"
+
+namespace _com_util {
+
+	inline BSTR ConvertStringToBSTR(const char* str) {
+		if (!str) return nullptr;
+		int length = MultiByteToWideChar(CP_UTF8, 0, str, -1, nullptr, 0);
+		std::wstring wide(length, 0);
+		MultiByteToWideChar(CP_UTF8, 0, str, -1, &wide[0], length);
+		return SysAllocStringLen(wide.data(), UINT(length - 1));
+	}
+
+}
+
+class _bstr_t {
+public:
+	_bstr_t() {}
+	_bstr_t(const wchar_t* str) : wide(str ? str : L"") {
+		int length = WideCharToMultiByte(CP_UTF8, 0, wide.data(), (int)wide.size(), nullptr, 0, nullptr, nullptr);
+		narrow.resize(length);
+		WideCharToMultiByte(CP_UTF8, 0, wide.data(), (int)wide.size(), &narrow[0], length, nullptr, nullptr);
+	}
+
+	unsigned int length() const { return (unsigned int)wide.size(); }
+	operator const wchar_t*() const { return wide.c_str(); }
+	operator const char*() const { return narrow.c_str(); }
+	operator char*() { return &narrow[0]; }
+
+private:
+	std::wstring wide;
+	std::string narrow;
+};
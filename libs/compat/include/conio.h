@@ -0,0 +1,3 @@
+#pragma once
+
+// Console I/O is not used, the SDK samples only include it
@@ -0,0 +1,195 @@
+#pragma once
+
+// Just enough of COM, OLE Automation and the Win32 string APIs for the ATEM SDK header and
+// the COM backend to build off Windows. Objects live in-process and calls are plain virtual
+// calls: there is no apartment, marshalling or registry, and CoCreateInstance() hands out
+// whatever was registered with ofxAtemCompat::registerClass(), e.g. the fake switcher of
+// AtemFakeSwitcher.h. Not used on Windows, where the real headers are found first.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <map>
+#include <string>
+
+typedef int32_t HRESULT;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef uint32_t DWORD;
+typedef unsigned int UINT;
+typedef int BOOL;
+typedef uint8_t BYTE;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef void* LPVOID;
+typedef wchar_t OLECHAR;
+typedef OLECHAR* BSTR;
+typedef const OLECHAR* LPCOLESTR;
+typedef char* LPSTR;
+typedef const char* LPCSTR;
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_NOTIMPL ((HRESULT)0x80004001)
+#define E_NOINTERFACE ((HRESULT)0x80004002)
+#define E_POINTER ((HRESULT)0x80004003)
+#define E_FAIL ((HRESULT)0x80004005)
+#define E_INVALIDARG ((HRESULT)0x80070057)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000E)
+#define CLASS_E_NOAGGREGATION ((HRESULT)0x80040110)
+#define REGDB_E_CLASSNOTREG ((HRESULT)0x80040154)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+// MIDL output
+#define interface struct
+#define MIDL_INTERFACE(x) struct
+#define DECLSPEC_UUID(x)
+#define __declspec(x)
+#define STDMETHODCALLTYPE
+#define BEGIN_INTERFACE
+#define END_INTERFACE
+#define EXTERN_C extern "C"
+#define __RPCNDR_H_VERSION__ 500
+// Only for interface names, e.g. __uuidof(IBMDSwitcherInputAux)
+#define __uuidof(I) IID_##I
+
+struct GUID {
+	uint32_t Data1;
+	uint16_t Data2;
+	uint16_t Data3;
+	uint8_t Data4[8];
+};
+#define __IID_DEFINED__
+#define CLSID_DEFINED
+typedef GUID IID;
+typedef GUID CLSID;
+typedef const IID& REFIID;
+typedef const CLSID& REFCLSID;
+
+inline bool IsEqualGUID(const GUID& a, const GUID& b) { return memcmp(&a, &b, sizeof(GUID)) == 0; }
+inline bool operator==(const GUID& a, const GUID& b) { return IsEqualGUID(a, b); }
+inline bool operator!=(const GUID& a, const GUID& b) { return !IsEqualGUID(a, b); }
+
+struct IUnknown {
+	virtual HRESULT QueryInterface(REFIID iid, void** ppv) = 0;
+	virtual ULONG AddRef() = 0;
+	virtual ULONG Release() = 0;
+};
+EXTERN_C const IID IID_IUnknown;
+
+// Interlocked operations, sequentially consistent like on Windows
+inline LONG InterlockedIncrement(volatile LONG* value) { return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedDecrement(volatile LONG* value) { return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedExchange(volatile LONG* target, LONG value) { return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedExchangeAdd(volatile LONG* target, LONG value) { return __atomic_fetch_add(target, value, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedCompareExchange(volatile LONG* target, LONG exchange, LONG comparand) {
+	__atomic_compare_exchange_n(target, &comparand, exchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return comparand;
+}
+
+// BSTR: length prefixed, null terminated, the pointer is to the first character
+inline BSTR SysAllocStringLen(const OLECHAR* chars, UINT length) {
+	uint32_t* block = (uint32_t*)malloc(sizeof(uint32_t) + (length + 1) * sizeof(OLECHAR));
+	if (!block) return nullptr;
+	block[0] = uint32_t(length * sizeof(OLECHAR));
+	BSTR str = (BSTR)(block + 1);
+	if (chars) memcpy(str, chars, length * sizeof(OLECHAR));
+	else memset(str, 0, length * sizeof(OLECHAR));
+	str[length] = 0;
+	return str;
+}
+inline BSTR SysAllocString(const OLECHAR* chars) { return chars ? SysAllocStringLen(chars, (UINT)wcslen(chars)) : nullptr; }
+inline void SysFreeString(BSTR str) { if (str) free((uint32_t*)str - 1); }
+inline UINT SysStringLen(BSTR str) { return str ? ((uint32_t*)str)[-1] / sizeof(OLECHAR) : 0; }
+
+// Code pages are ignored, narrow strings are UTF-8
+#define CP_ACP 0
+#define CP_UTF8 65001
+
+inline int WideCharToMultiByte(UINT, DWORD, const OLECHAR* wide, int wideLength, LPSTR out, int outSize, LPCSTR, BOOL*) {
+	if (wideLength < 0) wideLength = (int)wcslen(wide) + 1;
+	std::string utf8;
+	for (int i = 0; i < wideLength; i++) {
+		uint32_t c = (uint32_t)wide[i];
+		if (c < 0x80) utf8 += char(c);
+		else if (c < 0x800) { utf8 += char(0xc0 | (c >> 6)); utf8 += char(0x80 | (c & 0x3f)); }
+		else if (c < 0x10000) { utf8 += char(0xe0 | (c >> 12)); utf8 += char(0x80 | ((c >> 6) & 0x3f)); utf8 += char(0x80 | (c & 0x3f)); }
+		else { utf8 += char(0xf0 | (c >> 18)); utf8 += char(0x80 | ((c >> 12) & 0x3f)); utf8 += char(0x80 | ((c >> 6) & 0x3f)); utf8 += char(0x80 | (c & 0x3f)); }
+	}
+	if (outSize == 0) return (int)utf8.size();
+	if ((int)utf8.size() > outSize) return 0;
+	memcpy(out, utf8.data(), utf8.size());
+	return (int)utf8.size();
+}
+
+inline int MultiByteToWideChar(UINT, DWORD, LPCSTR utf8, int length, OLECHAR* out, int outSize) {
+	if (length < 0) length = (int)strlen(utf8) + 1;
+	std::wstring wide;
+	for (int i = 0; i < length;) {
+		uint8_t b = (uint8_t)utf8[i];
+		int extra = b < 0x80 ? 0 : b < 0xe0 ? 1 : b < 0xf0 ? 2 : 3;
+		uint32_t c = extra == 0 ? b : extra == 1 ? (b & 0x1f) : extra == 2 ? (b & 0x0f) : (b & 0x07);
+		for (int k = 1; k <= extra && i + k < length; k++) c = (c << 6) | ((uint8_t)utf8[i + k] & 0x3f);
+		wide += OLECHAR(c);
+		i += extra + 1;
+	}
+	if (outSize == 0) return (int)wide.size();
+	if ((int)wide.size() > outSize) return 0;
+	memcpy(out, wide.data(), wide.size() * sizeof(OLECHAR));
+	return (int)wide.size();
+}
+
+inline int strcpy_s(char* dest, size_t destSize, const char* src) {
+	if (!dest || !src || strlen(src) >= destSize) return 22;
+	strcpy(dest, src);
+	return 0;
+}
+
+// Class objects instead of the registry
+#define CLSCTX_INPROC_SERVER 0x1
+#define CLSCTX_ALL 0x17
+#define COINIT_MULTITHREADED 0x0
+#define COINIT_APARTMENTTHREADED 0x2
+
+namespace ofxAtemCompat {
+
+	// Creates an object and returns its iid interface, AddRef'ed
+	typedef HRESULT (*ClassFactory)(REFIID iid, void** ppv);
+
+	struct GuidLess {
+		bool operator()(const GUID& a, const GUID& b) const { return memcmp(&a, &b, sizeof(GUID)) < 0; }
+	};
+
+	inline std::map<CLSID, ClassFactory, GuidLess>& classes() {
+		static std::map<CLSID, ClassFactory, GuidLess> registered;
+		return registered;
+	}
+
+	// nullptr unregisters
+	inline void registerClass(REFCLSID clsid, ClassFactory factory) {
+		if (factory) classes()[clsid] = factory;
+		else classes().erase(clsid);
+	}
+
+}
+
+inline HRESULT CoInitializeEx(void*, DWORD) { return S_OK; }
+inline HRESULT CoInitialize(void*) { return S_OK; }
+inline void CoUninitialize() {}
+
+inline HRESULT CoCreateInstance(REFCLSID clsid, IUnknown* outer, DWORD, REFIID iid, void** ppv) {
+	if (!ppv) return E_POINTER;
+	*ppv = nullptr;
+	if (outer) return CLASS_E_NOAGGREGATION;
+	auto it = ofxAtemCompat::classes().find(clsid);
+	if (it == ofxAtemCompat::classes().end()) return REGDB_E_CLASSNOTREG;
+	return it->second(iid, ppv);
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// COM declarations the MIDL generated SDK header expects
+#include "ofxAtemComCompat.h"
@@ -0,0 +1,4 @@
+#pragma once
+
+// IUnknown
+#include "ofxAtemComCompat.h"
@@ -0,0 +1,614 @@
+#ifdef OFX_ATEM_COM_COMPAT
+
+#include "AtemFakeSwitcher.h"
+
+#include <thread>
+
+namespace ofxAtemCompat {
+
+	template<class Interface>
+	static HRESULT answer(Interface* object, void** ppv) {
+		*ppv = object;
+		object->AddRef();
+		return S_OK;
+	}
+
+	static HRESULT copyString(const std::wstring& value, BSTR* name) {
+		if (!name) return E_POINTER;
+		*name = SysAllocStringLen(value.data(), (UINT)value.size());
+		return S_OK;
+	}
+
+	static std::wstring widen(const std::string& value) {
+		return std::wstring(value.begin(), value.end());
+	}
+
+	static CComPtr<FakeInput> makeInput(BMDSwitcherInputId id, const std::string& longName, const std::string& shortName, BMDSwitcherPortType portType,
+		BMDSwitcherExternalPortType externalPortType = bmdSwitcherExternalPortTypeInternal) {
+		CComPtr<FakeInput> input;
+		input.Attach(new FakeInput(id, longName, shortName, portType, externalPortType));
+		return input;
+	}
+
+	HRESULT FakeInputIterator::GetById(BMDSwitcherInputId inputId, IBMDSwitcherInput** input) {
+		if (!input) return E_POINTER;
+		for (auto& item : items) {
+			BMDSwitcherInputId id;
+			if (item->GetInputId(&id) == S_OK && id == inputId) return answer(item.p, (void**)input);
+		}
+		*input = nullptr;
+		return E_INVALIDARG;
+	}
+
+	// FakeInput
+
+	FakeInput::FakeInput(BMDSwitcherInputId id, const std::string& longName, const std::string& shortName, BMDSwitcherPortType portType,
+		BMDSwitcherExternalPortType externalPortType)
+		: id(id), longName(widen(longName)), shortName(widen(shortName)), defaultLongName(this->longName), defaultShortName(this->shortName),
+		portType(portType), externalPortType(externalPortType) {
+	}
+
+	HRESULT FakeInput::QueryInterface(REFIID iid, void** ppv) {
+		if (!ppv) return E_POINTER;
+		if (IsEqualGUID(iid, IID_IBMDSwitcherInput) || IsEqualGUID(iid, IID_IUnknown)) return answer(static_cast<IBMDSwitcherInput*>(this), ppv);
+		// Only aux outputs have a source to select
+		if (IsEqualGUID(iid, IID_IBMDSwitcherInputAux) && portType == bmdSwitcherPortTypeAuxOutput) return answer(static_cast<IBMDSwitcherInputAux*>(this), ppv);
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	ULONG FakeInput::Release() {
+		ULONG count = --refCount;
+		if (count == 0) delete this;
+		return count;
+	}
+
+	HRESULT FakeInput::GetPortType(BMDSwitcherPortType* type) {
+		if (!type) return E_POINTER;
+		*type = portType;
+		return S_OK;
+	}
+
+	HRESULT FakeInput::GetInputAvailability(BMDSwitcherInputAvailability* availability) {
+		if (!availability) return E_POINTER;
+		switch (portType) {
+		case bmdSwitcherPortTypeAuxOutput:
+		case bmdSwitcherPortTypeMixEffectBlockOutput:
+			*availability = (BMDSwitcherInputAvailability)(bmdSwitcherInputAvailabilityAuxOutputs | bmdSwitcherInputAvailabilityMultiView);
+			break;
+		default:
+			*availability = (BMDSwitcherInputAvailability)(bmdSwitcherInputAvailabilityMixEffectBlock0 | bmdSwitcherInputAvailabilityMixEffectBlock1 |
+				bmdSwitcherInputAvailabilityMixEffectBlock2 | bmdSwitcherInputAvailabilityMixEffectBlock3 |
+				bmdSwitcherInputAvailabilityAuxOutputs | bmdSwitcherInputAvailabilityMultiView);
+			break;
+		}
+		return S_OK;
+	}
+
+	HRESULT FakeInput::SetShortName(BSTR name) {
+		if (!name) return E_POINTER;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			shortName.assign(name, SysStringLen(name));
+		}
+		callbacks.notify(bmdSwitcherInputEventTypeShortNameChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeInput::GetShortName(BSTR* name) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return copyString(shortName, name);
+	}
+
+	HRESULT FakeInput::SetLongName(BSTR name) {
+		if (!name) return E_POINTER;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			longName.assign(name, SysStringLen(name));
+		}
+		callbacks.notify(bmdSwitcherInputEventTypeLongNameChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeInput::GetLongName(BSTR* name) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return copyString(longName, name);
+	}
+
+	HRESULT FakeInput::AreNamesDefault(BOOL* isDefault) {
+		if (!isDefault) return E_POINTER;
+		std::lock_guard<std::mutex> lock(mutex);
+		*isDefault = longName == defaultLongName && shortName == defaultShortName;
+		return S_OK;
+	}
+
+	HRESULT FakeInput::ResetNames() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			longName = defaultLongName;
+			shortName = defaultShortName;
+		}
+		callbacks.notify(bmdSwitcherInputEventTypeLongNameChanged);
+		callbacks.notify(bmdSwitcherInputEventTypeShortNameChanged);
+		return S_OK;
+	}
+
+	// Tally follows the buses, which inputs do not see
+	HRESULT FakeInput::IsProgramTallied(BOOL*) { return E_NOTIMPL; }
+	HRESULT FakeInput::IsPreviewTallied(BOOL*) { return E_NOTIMPL; }
+
+	HRESULT FakeInput::GetAvailableExternalPortTypes(BMDSwitcherExternalPortType* types) {
+		if (!types) return E_POINTER;
+		*types = externalPortType;
+		return S_OK;
+	}
+
+	HRESULT FakeInput::SetCurrentExternalPortType(BMDSwitcherExternalPortType value) {
+		if (value != externalPortType) return E_INVALIDARG;
+		return S_OK;
+	}
+
+	HRESULT FakeInput::GetCurrentExternalPortType(BMDSwitcherExternalPortType* value) {
+		if (!value) return E_POINTER;
+		*value = externalPortType;
+		return S_OK;
+	}
+
+	HRESULT FakeInput::GetInputId(BMDSwitcherInputId* inputId) {
+		if (!inputId) return E_POINTER;
+		*inputId = id;
+		return S_OK;
+	}
+
+	HRESULT FakeInput::GetInputSource(BMDSwitcherInputId* input) {
+		if (!input) return E_POINTER;
+		std::lock_guard<std::mutex> lock(mutex);
+		*input = auxSource;
+		return S_OK;
+	}
+
+	HRESULT FakeInput::SetInputSource(BMDSwitcherInputId input) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (auxSource == input) return S_OK;
+			auxSource = input;
+		}
+		auxCallbacks.notify(bmdSwitcherInputAuxEventTypeInputSourceChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeInput::GetInputAvailabilityMask(BMDSwitcherInputAvailability* availabilityMask) {
+		if (!availabilityMask) return E_POINTER;
+		*availabilityMask = bmdSwitcherInputAvailabilityAuxOutputs;
+		return S_OK;
+	}
+
+	// FakeKey
+
+	HRESULT FakeKey::QueryInterface(REFIID iid, void** ppv) {
+		if (!ppv) return E_POINTER;
+		if (IsEqualGUID(iid, IID_IBMDSwitcherKey) || IsEqualGUID(iid, IID_IUnknown)) return answer(static_cast<IBMDSwitcherKey*>(this), ppv);
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	ULONG FakeKey::Release() {
+		ULONG count = --refCount;
+		if (count == 0) delete this;
+		return count;
+	}
+
+	HRESULT FakeKey::DoesSupportAdvancedChroma(BOOL* supportsAdvancedChroma) {
+		if (!supportsAdvancedChroma) return E_POINTER;
+		*supportsAdvancedChroma = FALSE;
+		return S_OK;
+	}
+
+	HRESULT FakeKey::GetType(BMDSwitcherKeyType* value) {
+		if (!value) return E_POINTER;
+		std::lock_guard<std::mutex> lock(mutex);
+		*value = type;
+		return S_OK;
+	}
+
+	HRESULT FakeKey::SetType(BMDSwitcherKeyType value) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (type == value) return S_OK;
+			type = value;
+		}
+		callbacks.notify(bmdSwitcherKeyEventTypeTypeChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeKey::GetInputCut(BMDSwitcherInputId* input) {
+		if (!input) return E_POINTER;
+		std::lock_guard<std::mutex> lock(mutex);
+		*input = inputCut;
+		return S_OK;
+	}
+
+	HRESULT FakeKey::SetInputCut(BMDSwitcherInputId input) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (inputCut == input) return S_OK;
+			inputCut = input;
+		}
+		callbacks.notify(bmdSwitcherKeyEventTypeInputCutChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeKey::GetInputFill(BMDSwitcherInputId* input) {
+		if (!input) return E_POINTER;
+		std::lock_guard<std::mutex> lock(mutex);
+		*input = inputFill;
+		return S_OK;
+	}
+
+	HRESULT FakeKey::SetInputFill(BMDSwitcherInputId input) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (inputFill == input) return S_OK;
+			inputFill = input;
+		}
+		callbacks.notify(bmdSwitcherKeyEventTypeInputFillChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeKey::GetOnAir(BOOL* value) {
+		if (!value) return E_POINTER;
+		std::lock_guard<std::mutex> lock(mutex);
+		*value = onAir;
+		return S_OK;
+	}
+
+	HRESULT FakeKey::SetOnAir(BOOL value) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (onAir == !!value) return S_OK;
+			onAir = !!value;
+		}
+		callbacks.notify(bmdSwitcherKeyEventTypeOnAirChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeKey::CanBeDVEKey(BOOL* canDVE) {
+		if (!canDVE) return E_POINTER;
+		*canDVE = FALSE;
+		return S_OK;
+	}
+
+	// FakeMixEffectBlock
+
+	FakeMixEffectBlock::FakeMixEffectBlock(int keyerCount, BMDSwitcherInputId program, BMDSwitcherInputId preview) : program(program), preview(preview) {
+		for (int i = 0; i < keyerCount; i++) {
+			keyers.emplace_back();
+			keyers.back().Attach(new FakeKey());
+		}
+	}
+
+	HRESULT FakeMixEffectBlock::QueryInterface(REFIID iid, void** ppv) {
+		if (!ppv) return E_POINTER;
+		if (IsEqualGUID(iid, IID_IBMDSwitcherMixEffectBlock) || IsEqualGUID(iid, IID_IUnknown)) return answer(static_cast<IBMDSwitcherMixEffectBlock*>(this), ppv);
+		// No transition styles
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	ULONG FakeMixEffectBlock::Release() {
+		ULONG count = --refCount;
+		if (count == 0) delete this;
+		return count;
+	}
+
+	HRESULT FakeMixEffectBlock::GetProgramInput(BMDSwitcherInputId* value) {
+		if (!value) return E_POINTER;
+		std::lock_guard<std::mutex> lock(mutex);
+		*value = program;
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::SetProgramInput(BMDSwitcherInputId value) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (program == value) return S_OK;
+			program = value;
+		}
+		callbacks.notify(bmdSwitcherMixEffectBlockEventTypeProgramInputChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::GetPreviewInput(BMDSwitcherInputId* value) {
+		if (!value) return E_POINTER;
+		std::lock_guard<std::mutex> lock(mutex);
+		*value = preview;
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::SetPreviewInput(BMDSwitcherInputId value) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (preview == value) return S_OK;
+			preview = value;
+		}
+		callbacks.notify(bmdSwitcherMixEffectBlockEventTypePreviewInputChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::GetPreviewLive(BOOL* value) {
+		if (!value) return E_POINTER;
+		*value = FALSE;
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::GetPreviewTransition(BOOL* value) {
+		if (!value) return E_POINTER;
+		*value = FALSE;
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::PerformAutoTransition() {
+		callbacks.notify(bmdSwitcherMixEffectBlockEventTypeInTransitionChanged);
+		callbacks.notify(bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged);
+		PerformCut();
+		callbacks.notify(bmdSwitcherMixEffectBlockEventTypeInTransitionChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::PerformCut() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::swap(program, preview);
+			transitionPosition = 0;
+		}
+		callbacks.notify(bmdSwitcherMixEffectBlockEventTypeProgramInputChanged);
+		callbacks.notify(bmdSwitcherMixEffectBlockEventTypePreviewInputChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::GetInTransition(BOOL* value) {
+		if (!value) return E_POINTER;
+		std::lock_guard<std::mutex> lock(mutex);
+		*value = transitionPosition > 0;
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::GetTransitionPosition(double* value) {
+		if (!value) return E_POINTER;
+		std::lock_guard<std::mutex> lock(mutex);
+		*value = transitionPosition;
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::SetTransitionPosition(double value) {
+		if (value < 0 || value > 1) return E_INVALIDARG;
+		// Taking the lever to the end completes the transition like a cut
+		if (value == 1) return PerformCut();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			transitionPosition = value;
+		}
+		callbacks.notify(bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged);
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::GetTransitionFramesRemaining(unsigned int* value) {
+		if (!value) return E_POINTER;
+		*value = 0;
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::GetInputAvailabilityMask(BMDSwitcherInputAvailability* value) {
+		if (!value) return E_POINTER;
+		*value = bmdSwitcherInputAvailabilityMixEffectBlock0;
+		return S_OK;
+	}
+
+	HRESULT FakeMixEffectBlock::CreateIterator(REFIID iid, LPVOID* ppv) {
+		if (!ppv) return E_POINTER;
+		*ppv = nullptr;
+		if (!IsEqualGUID(iid, IID_IBMDSwitcherKeyIterator)) return E_NOINTERFACE;
+		*ppv = static_cast<IBMDSwitcherKeyIterator*>(new FakeKeyIterator(keyers));
+		return S_OK;
+	}
+
+	size_t FakeMixEffectBlock::getCallbackCount() {
+		size_t count = callbacks.size();
+		for (auto& keyer : keyers) count += static_cast<FakeKey*>(keyer.p)->getCallbackCount();
+		return count;
+	}
+
+	void FakeMixEffectBlock::clearCallbacks() {
+		callbacks.clear();
+		for (auto& keyer : keyers) static_cast<FakeKey*>(keyer.p)->clearCallbacks();
+	}
+
+	// FakeSwitcher
+
+	FakeSwitcher::FakeSwitcher(const FakeSwitcherTopology& topology) : productName(widen(topology.productName)) {
+		inputs.push_back(makeInput(0, "Black", "BLK", bmdSwitcherPortTypeBlack));
+		for (int i = 1; i <= topology.externalInputs; i++) {
+			inputs.push_back(makeInput(i, "Camera " + std::to_string(i), "CAM" + std::to_string(i), bmdSwitcherPortTypeExternal, bmdSwitcherExternalPortTypeSDI));
+		}
+		inputs.push_back(makeInput(1000, "Color Bars", "BARS", bmdSwitcherPortTypeColorBars));
+		for (int i = 1; i <= topology.auxOutputs; i++) {
+			inputs.push_back(makeInput(8000 + i, "Auxiliary " + std::to_string(i), "AUX" + std::to_string(i), bmdSwitcherPortTypeAuxOutput));
+		}
+		for (int me = 0; me < topology.mixEffectBlocks; me++) {
+			std::string suffix = topology.mixEffectBlocks > 1 ? " " + std::to_string(me + 1) : "";
+			inputs.push_back(makeInput(10010 + me * 10, "Program" + suffix, "PGM" + suffix, bmdSwitcherPortTypeMixEffectBlockOutput));
+			inputs.push_back(makeInput(10011 + me * 10, "Preview" + suffix, "PVW" + suffix, bmdSwitcherPortTypeMixEffectBlockOutput));
+
+			mixEffectBlocks.emplace_back();
+			mixEffectBlocks.back().Attach(new FakeMixEffectBlock(topology.keyersPerMixEffectBlock, topology.externalInputs >= 1 ? 1 : 0, topology.externalInputs >= 2 ? 2 : 0));
+		}
+	}
+
+	HRESULT FakeSwitcher::QueryInterface(REFIID iid, void** ppv) {
+		if (!ppv) return E_POINTER;
+		if (IsEqualGUID(iid, IID_IBMDSwitcher) || IsEqualGUID(iid, IID_IUnknown)) return answer(static_cast<IBMDSwitcher*>(this), ppv);
+		// No media pool and no audio mixer
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	ULONG FakeSwitcher::Release() {
+		ULONG count = --refCount;
+		if (count == 0) delete this;
+		return count;
+	}
+
+	HRESULT FakeSwitcher::GetProductName(BSTR* name) {
+		return copyString(productName, name);
+	}
+
+	HRESULT FakeSwitcher::GetVideoMode(BMDSwitcherVideoMode* value) {
+		if (!value) return E_POINTER;
+		*value = videoMode;
+		return S_OK;
+	}
+
+	HRESULT FakeSwitcher::SetVideoMode(BMDSwitcherVideoMode value) {
+		if (videoMode == value) return S_OK;
+		videoMode = value;
+		callbacks.notify(bmdSwitcherEventTypeVideoModeChanged, value);
+		return S_OK;
+	}
+
+	HRESULT FakeSwitcher::GetTimeCode(unsigned char* hours, unsigned char* minutes, unsigned char* seconds, unsigned char* frames, BOOL* dropFrame) {
+		if (!hours || !minutes || !seconds || !frames || !dropFrame) return E_POINTER;
+
+		// The supported modes run at 50 Hz, interlaced ones count 25 frames a second
+		long long rate = videoMode == bmdSwitcherVideoMode1080i50 ? 25 : 50;
+		long long elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - timecodeStart).count();
+		long long frame = 10 * 3600 * rate + elapsed * rate / 1000000;
+		*hours = (unsigned char)(frame / (rate * 3600) % 24);
+		*minutes = (unsigned char)(frame / (rate * 60) % 60);
+		*seconds = (unsigned char)(frame / rate % 60);
+		*frames = (unsigned char)(frame % rate);
+		*dropFrame = FALSE;
+		return S_OK;
+	}
+
+	HRESULT FakeSwitcher::RequestTimeCode() {
+		if (!reachable) return E_FAIL;
+		callbacks.notify(bmdSwitcherEventTypeTimeCodeChanged, videoMode);
+		return S_OK;
+	}
+
+	HRESULT FakeSwitcher::DoesSupportVideoMode(BMDSwitcherVideoMode value, BOOL* supported) {
+		if (!supported) return E_POINTER;
+		*supported = value == bmdSwitcherVideoMode1080p50 || value == bmdSwitcherVideoMode1080i50 || value == bmdSwitcherVideoMode720p50;
+		return S_OK;
+	}
+
+	HRESULT FakeSwitcher::GetDownConvertedHDVideoMode(BMDSwitcherVideoMode coreVideoMode, BMDSwitcherVideoMode* downConvertedHDVideoMode) {
+		if (!downConvertedHDVideoMode) return E_POINTER;
+		*downConvertedHDVideoMode = coreVideoMode;
+		return S_OK;
+	}
+
+	HRESULT FakeSwitcher::GetMultiViewVideoMode(BMDSwitcherVideoMode coreVideoMode, BMDSwitcherVideoMode* multiviewVideoMode) {
+		if (!multiviewVideoMode) return E_POINTER;
+		*multiviewVideoMode = coreVideoMode;
+		return S_OK;
+	}
+
+	HRESULT FakeSwitcher::GetPowerStatus(BMDSwitcherPowerStatus* powerStatus) {
+		if (!powerStatus) return E_POINTER;
+		*powerStatus = bmdSwitcherPowerStatusSupply1;
+		return S_OK;
+	}
+
+	HRESULT FakeSwitcher::DoesSupportAutoVideoMode(BOOL* supported) {
+		if (!supported) return E_POINTER;
+		*supported = FALSE;
+		return S_OK;
+	}
+
+	HRESULT FakeSwitcher::CreateIterator(REFIID iid, LPVOID* ppv) {
+		if (!ppv) return E_POINTER;
+		*ppv = nullptr;
+		if (IsEqualGUID(iid, IID_IBMDSwitcherInputIterator)) {
+			std::vector<CComPtr<IBMDSwitcherInput>> items(inputs.begin(), inputs.end());
+			*ppv = static_cast<IBMDSwitcherInputIterator*>(new FakeInputIterator(items));
+			return S_OK;
+		}
+		if (IsEqualGUID(iid, IID_IBMDSwitcherMixEffectBlockIterator)) {
+			std::vector<CComPtr<IBMDSwitcherMixEffectBlock>> items(mixEffectBlocks.begin(), mixEffectBlocks.end());
+			*ppv = static_cast<IBMDSwitcherMixEffectBlockIterator*>(new FakeMixEffectBlockIterator(items));
+			return S_OK;
+		}
+		return E_NOINTERFACE;
+	}
+
+	void FakeSwitcher::disconnect() {
+		reachable = false;
+		callbacks.notify(bmdSwitcherEventTypeDisconnected, videoMode);
+
+		// The session is gone, and the callbacks registered on it with it
+		callbacks.clear();
+		for (auto& input : inputs) input->clearCallbacks();
+		for (auto& meb : mixEffectBlocks) meb->clearCallbacks();
+	}
+
+	size_t FakeSwitcher::getCallbackCount() {
+		size_t count = callbacks.size();
+		for (auto& input : inputs) count += input->getCallbackCount();
+		for (auto& meb : mixEffectBlocks) count += meb->getCallbackCount();
+		return count;
+	}
+
+	// Discovery
+
+	static CComPtr<FakeSwitcher> installedSwitcher;
+
+	class FakeSwitcherDiscovery : public IBMDSwitcherDiscovery {
+	public:
+		virtual ~FakeSwitcherDiscovery() {}
+
+		HRESULT QueryInterface(REFIID iid, void** ppv) override {
+			if (!ppv) return E_POINTER;
+			if (IsEqualGUID(iid, IID_IBMDSwitcherDiscovery) || IsEqualGUID(iid, IID_IUnknown)) return answer(static_cast<IBMDSwitcherDiscovery*>(this), ppv);
+			*ppv = nullptr;
+			return E_NOINTERFACE;
+		}
+		ULONG AddRef() override { return ++refCount; }
+		ULONG Release() override {
+			ULONG count = --refCount;
+			if (count == 0) delete this;
+			return count;
+		}
+
+		HRESULT ConnectTo(BSTR, IBMDSwitcher** switcherDevice, BMDSwitcherConnectToFailure* failReason) override {
+			if (!switcherDevice) return E_POINTER;
+			*switcherDevice = nullptr;
+			if (installedSwitcher && installedSwitcher->getConnectDelay() > 0) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(installedSwitcher->getConnectDelay()));
+			}
+			if (!installedSwitcher || !installedSwitcher->isReachable()) {
+				if (failReason) *failReason = bmdSwitcherConnectToFailureNoResponse;
+				return E_FAIL;
+			}
+			return answer(static_cast<IBMDSwitcher*>(installedSwitcher.p), (void**)switcherDevice);
+		}
+
+		static HRESULT create(REFIID iid, void** ppv) {
+			FakeSwitcherDiscovery* discovery = new FakeSwitcherDiscovery();
+			HRESULT result = discovery->QueryInterface(iid, ppv);
+			discovery->Release();
+			return result;
+		}
+
+	private:
+		std::atomic<ULONG> refCount{ 1 };
+	};
+
+	void installFakeSwitcher(FakeSwitcher* switcher) {
+		installedSwitcher = switcher;
+		registerClass(CLSID_CBMDSwitcherDiscovery, switcher ? &FakeSwitcherDiscovery::create : nullptr);
+	}
+
+}
+
+#endif
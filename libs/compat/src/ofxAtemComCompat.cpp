@@ -0,0 +1,10 @@
+#ifdef OFX_ATEM_COM_COMPAT
+
+#include "ofxAtemComCompat.h"
+
+// On Windows these come with the platform and BMDSwitcherAPI_i.c is added to the project
+EXTERN_C const IID IID_IUnknown = { 0x00000000, 0x0000, 0x0000, { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46 } };
+
+#include "BMDSwitcherAPI_i.c"
+
+#endif
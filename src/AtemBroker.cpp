@@ -0,0 +1,353 @@
+#include "AtemBroker.h"
+
+#include <cerrno>
+#include <mutex>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ofLog.h"
+#include "ofUtils.h"
+
+namespace ofxAtem {
+
+	using namespace protocol;
+
+	static const int kTickMillis = 10;
+	static const uint64_t kKeepAliveIntervalMillis = 1000;
+	static const uint64_t kClientTimeoutMillis = 5000;
+	// Pause before starting over with a switcher that could not be reached or synced
+	static const uint64_t kUpstreamRetryMillis = 1000;
+	// Datagrams drained from the local socket per round
+	static const int kMaxDatagramsPerRound = 64;
+	// Packets waiting for a client whose socket is full, before the client is dropped
+	static const size_t kMaxBacklog = 256;
+
+	Broker::~Broker() {
+		stop();
+	}
+
+	bool Broker::start(const std::string& switcherAddress, const std::string& path) {
+		stop();
+
+		sockaddr_un local = {};
+		if (path.empty() || path.size() >= sizeof(local.sun_path)) {
+			ofLogError(__FUNCTION__) << "Invalid broker path " << path;
+			return false;
+		}
+		local.sun_family = AF_UNIX;
+		strncpy(local.sun_path, path.c_str(), sizeof(local.sun_path) - 1);
+
+		// A previous broker that did not shut down cleanly leaves its socket behind
+		unlink(path.c_str());
+		sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+		if (sock < 0 || bind(sock, (sockaddr*)&local, sizeof(local)) != 0) {
+			ofLogError(__FUNCTION__) << "Could not bind broker to " << path;
+			if (sock >= 0) ::close(sock);
+			sock = -1;
+			return false;
+		}
+
+		this->switcherAddress = switcherAddress;
+		this->path = path;
+		upstream.setThreaded(false);
+		upstream.getClient().setRecordListener([this](uint32_t name, const uint8_t* payload, size_t size) { handleUpstreamRecord(name, payload, size); });
+		if (!upstream.connect(switcherAddress, *this)) {
+			stop();
+			return false;
+		}
+
+		startThread();
+		return true;
+	}
+
+	void Broker::stop() {
+		if (isThreadRunning()) {
+			waitForThread(true);
+		}
+		upstream.disconnect(*this);
+		upstreamConnected = false;
+		if (sock >= 0) {
+			::close(sock);
+			sock = -1;
+			unlink(path.c_str());
+		}
+		clients.clear();
+		pending.reset();
+	}
+
+	size_t Broker::getClientCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return clients.size();
+	}
+
+	void Broker::onBackendConnected(bool success) {
+		if (!success) {
+			ofLogError(__FUNCTION__) << "Could not sync with " << switcherAddress << ", retrying";
+			return;
+		}
+		ofLogNotice(__FUNCTION__) << "Sharing " << upstream.getProductName() << " on " << path;
+		upstreamConnected = true;
+
+		// Clients that joined early waited for the mirror
+		for (auto& it : clients) {
+			if (it.second.helloAcked && !it.second.synced) sendStateDump(it.second);
+		}
+	}
+
+	void Broker::onBackendDisconnected() {
+		upstreamConnected = false;
+	}
+
+	void Broker::onBackendReconnected() {
+		upstreamConnected = true;
+		broadcastState();
+		for (auto& it : clients) {
+			if (it.second.helloAcked && !it.second.synced) sendStateDump(it.second);
+		}
+	}
+
+	void Broker::onLinkDegraded(ConnectionHealth& health) {
+		ofLogWarning(__FUNCTION__) << "No answer from " << switcherAddress << " for " << health.silentMicros / 1000 << " ms";
+	}
+
+	void Broker::onLinkRestored(ConnectionHealth& health) {
+		ofLogNotice(__FUNCTION__) << switcherAddress << " answering again, round trip " << health.rttMillis << " ms";
+	}
+
+	void Broker::threadedFunction() {
+		uint64_t retryMillis = 0;
+
+		while (isThreadRunning()) {
+			pollfd fds[2] = { { upstream.getSocket(), POLLIN, 0 }, { sock, POLLIN, 0 } };
+			::poll(fds, 2, kTickMillis);
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			// Commands of every client that spoke this round share one upstream datagram
+			upstream.beginBatch();
+			receiveLocal();
+			upstream.commitBatch();
+
+			uint64_t now = ofGetElapsedTimeMillis();
+			if (!upstream.poll(*this, 0) && now >= retryMillis) {
+				upstream.connect(switcherAddress, *this);
+				retryMillis = now + kUpstreamRetryMillis;
+			}
+
+			// Upstream records of this round go out as one packet per client
+			if (!pending.empty()) {
+				broadcast(pending);
+				pending.reset();
+			}
+
+			// Keep-alives, backlogs and expiry of silent or stuck clients
+			now = ofGetElapsedTimeMillis();
+			for (auto it = clients.begin(); it != clients.end();) {
+				Client& client = it->second;
+				while (!client.backlog.empty() && !client.dropped) {
+					ssize_t sent = sendto(sock, client.backlog.front().data(), client.backlog.front().size(), MSG_DONTWAIT, (const sockaddr*)&client.address, client.addressSize);
+					if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+					client.dropped = sent < 0;
+					client.backlog.pop_front();
+				}
+				if (client.synced && now - client.lastSentMillis > kKeepAliveIntervalMillis) {
+					PacketWriter keepAlive;
+					sendRecords(client, keepAlive);
+				}
+				if (client.dropped || now - client.lastReceivedMillis > kClientTimeoutMillis) {
+					it = clients.erase(it);
+					continue;
+				}
+				++it;
+			}
+		}
+	}
+
+	void Broker::receiveLocal() {
+		uint8_t buffer[kMaxPacketSize];
+		for (int n = 0; n < kMaxDatagramsPerRound; n++) {
+			sockaddr_un from = {};
+			socklen_t fromSize = sizeof(from);
+			ssize_t size = recvfrom(sock, buffer, sizeof(buffer), MSG_DONTWAIT, (sockaddr*)&from, &fromSize);
+			if (size <= 0) break;
+			handleDatagram(from, fromSize, buffer, (size_t)size);
+		}
+	}
+
+	void Broker::handleDatagram(const sockaddr_un& from, socklen_t fromSize, const uint8_t* data, size_t size) {
+		PacketHeader header;
+		if (!readHeader(data, size, header)) return;
+
+		// Unnamed sockets cannot be answered
+		std::string key(from.sun_path, strnlen(from.sun_path, sizeof(from.sun_path)));
+		if (key.empty()) return;
+
+		if (header.flags & kFlagHello) {
+			Client client;
+			client.address = from;
+			client.addressSize = fromSize;
+			client.sessionId = nextSessionId;
+			client.lastReceivedMillis = ofGetElapsedTimeMillis();
+			nextSessionId = nextSessionId == 0xffff ? 0x8001 : nextSessionId + 1;
+			Client& added = clients[key] = client;
+
+			PacketHeader reply;
+			reply.flags = kFlagHello;
+			reply.sessionId = header.sessionId;
+			uint8_t payload[kHelloPayloadSize] = { kHelloAccepted, 0, 0, 0, 0, 0, 0, 0 };
+			sendPacket(added, reply, payload, sizeof(payload));
+			return;
+		}
+
+		auto it = clients.find(key);
+		if (it == clients.end()) return;
+
+		Client& client = it->second;
+		client.lastReceivedMillis = ofGetElapsedTimeMillis();
+
+		// The ack of the hello reply asks for the dump, which waits for the upstream sync
+		if (!client.helloAcked) {
+			if (!(header.flags & kFlagAck)) return;
+			client.helloAcked = true;
+			if (upstreamConnected) sendStateDump(client);
+			return;
+		}
+
+		// Local datagrams arrive in order, anything else is a resend
+		if (header.flags & kFlagAckRequest) {
+			if (header.packetId == nextPacketId(client.remotePacketId)) {
+				forwardCommands(data, header.length);
+				client.remotePacketId = header.packetId;
+			}
+
+			PacketHeader ack;
+			ack.flags = kFlagAck;
+			ack.sessionId = client.sessionId;
+			ack.ackId = client.remotePacketId;
+			sendPacket(client, ack, nullptr, 0);
+		}
+	}
+
+	void Broker::forwardCommands(const uint8_t* data, size_t size) {
+		RecordReader reader(data + kHeaderSize, size - kHeaderSize);
+		uint32_t name;
+		const uint8_t* payload;
+		size_t payloadSize;
+		while (reader.next(name, payload, payloadSize)) {
+			if (upstream.getClient().sendRecord(name, payload, payloadSize)) forwardedCommands++;
+		}
+	}
+
+	void Broker::handleUpstreamRecord(uint32_t name, const uint8_t* payload, size_t size) {
+		if (name == state::kInitComplete) return;
+		if (!pending.fits(size)) {
+			broadcast(pending);
+			pending.reset();
+		}
+		pending.appendRecord(name, payload, size);
+		forwardedRecords++;
+	}
+
+	void Broker::sendStateDump(Client& client) {
+		std::vector<uint8_t> records;
+		encodeState(upstream.getClient().getState(), records);
+		uint8_t initComplete[kInitCompleteSize] = {};
+
+		PacketWriter packet;
+		RecordReader reader(records.data(), records.size());
+		uint32_t name;
+		const uint8_t* payload;
+		size_t payloadSize;
+		while (reader.next(name, payload, payloadSize)) {
+			if (!packet.fits(payloadSize)) {
+				sendRecords(client, packet);
+				packet.reset();
+			}
+			packet.appendRecord(name, payload, payloadSize);
+		}
+		if (!packet.fits(kInitCompleteSize)) {
+			sendRecords(client, packet);
+			packet.reset();
+		}
+		packet.appendRecord(state::kInitComplete, initComplete, kInitCompleteSize);
+		sendRecords(client, packet);
+		client.synced = true;
+	}
+
+	void Broker::broadcastState() {
+		// Pending records are older than the reconciled mirror
+		pending.reset();
+
+		std::vector<uint8_t> records;
+		encodeState(upstream.getClient().getState(), records);
+
+		// Topology and configuration are the same after a reconnect; selections, names and
+		// transitions may have changed while the link was down
+		PacketWriter packet;
+		RecordReader reader(records.data(), records.size());
+		uint32_t name;
+		const uint8_t* payload;
+		size_t payloadSize;
+		while (reader.next(name, payload, payloadSize)) {
+			if (name == state::kVersion || name == state::kProductName || name == state::kTopology ||
+				name == state::kMixEffectConfig || name == state::kMediaPoolConfig) {
+				continue;
+			}
+			if (!packet.fits(payloadSize)) {
+				broadcast(packet);
+				packet.reset();
+			}
+			packet.appendRecord(name, payload, payloadSize);
+		}
+		if (!packet.empty()) broadcast(packet);
+	}
+
+	void Broker::broadcast(const PacketWriter& records) {
+		for (auto& it : clients) {
+			if (it.second.synced) sendRecords(it.second, records);
+		}
+	}
+
+	bool Broker::sendRecords(Client& client, const PacketWriter& records) {
+		PacketHeader header;
+		header.flags = kFlagAckRequest;
+		header.sessionId = client.sessionId;
+		header.packetId = client.localPacketId = nextPacketId(client.localPacketId);
+		return sendPacket(client, header, records.data() + kHeaderSize, records.size() - kHeaderSize);
+	}
+
+	bool Broker::sendPacket(Client& client, const PacketHeader& header, const uint8_t* payload, size_t size) {
+		uint8_t packet[kMaxPacketSize];
+		PacketHeader h = header;
+		h.length = uint16_t(kHeaderSize + size);
+		writeHeader(packet, h);
+		if (size) memcpy(packet + kHeaderSize, payload, size);
+		return sendDatagram(client, packet, kHeaderSize + size);
+	}
+
+	bool Broker::sendDatagram(Client& client, const uint8_t* data, size_t size) {
+		if (client.dropped) return false;
+		client.lastSentMillis = ofGetElapsedTimeMillis();
+
+		// Behind a backlog, or with the client's socket full, the packet waits its turn
+		if (client.backlog.empty()) {
+			ssize_t sent = sendto(sock, data, size, MSG_DONTWAIT, (const sockaddr*)&client.address, client.addressSize);
+			if (sent == (ssize_t)size) return true;
+			if (sent >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+				// The client closed its socket
+				client.dropped = true;
+				return false;
+			}
+		}
+		if (client.backlog.size() >= kMaxBacklog) {
+			ofLogWarning(__FUNCTION__) << "Dropping a broker client that stopped reading";
+			client.dropped = true;
+			return false;
+		}
+		client.backlog.emplace_back(data, data + size);
+		return true;
+	}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "ofThread.h"
+
+#include "AtemProtocol.h"
+#include "AtemTypes.h"
+#include "AtemUdpBackend.h"
+
+namespace ofxAtem {
+
+	// Shares one switcher session between the apps on a machine.
+	// The broker holds the only upstream connection and speaks the same control protocol to
+	// local clients on a Unix datagram socket, so any Device can connect("unix:<path>") instead
+	// of to the switcher. A joining client gets its state dump from the broker's mirror without
+	// a new upstream sync, every state record from the switcher is forwarded to all clients,
+	// and their commands are merged into the upstream command stream, one datagram per round.
+	//
+	// Unix datagrams are neither lost nor reordered, so local delivery needs no retransmission;
+	// a client that stops draining its socket is dropped instead of stalling the others.
+	class Broker : public ofThread {
+	public:
+		Broker() {}
+		~Broker();
+
+		// switcherAddress as for Device::connect(), path is where local clients connect
+		bool start(const std::string& switcherAddress, const std::string& path);
+		void stop();
+
+		bool isUpstreamConnected() const { return upstreamConnected; }
+		size_t getClientCount();
+		uint64_t getForwardedRecordCount() const { return forwardedRecords; }
+		uint64_t getForwardedCommandCount() const { return forwardedCommands; }
+
+		// UdpBackend callbacks, on the broker thread
+		void onMixEffectBlockUpdated(MixEffectEvent&) {}
+		void onBackendConnected(bool success);
+		void onBackendDisconnected();
+		void onBackendReconnected();
+		void onLinkDegraded(ConnectionHealth& health);
+		void onLinkRestored(ConnectionHealth& health);
+		void onInputsChanged() {}
+
+	private:
+		struct Client {
+			sockaddr_un address;
+			socklen_t addressSize = 0;
+			uint16_t sessionId = 0;
+			uint16_t localPacketId = 0;
+			uint16_t remotePacketId = 0;	// last client packet forwarded
+			bool helloAcked = false;
+			bool synced = false;	// dump sent, receives the upstream records
+			uint64_t lastReceivedMillis = 0;
+			uint64_t lastSentMillis = 0;
+			std::deque<std::vector<uint8_t>> backlog;	// packets its full socket did not take yet
+			bool dropped = false;
+		};
+
+		void threadedFunction() override;
+
+		void receiveLocal();
+		void handleDatagram(const sockaddr_un& from, socklen_t fromSize, const uint8_t* data, size_t size);
+		void forwardCommands(const uint8_t* data, size_t size);
+		void handleUpstreamRecord(uint32_t name, const uint8_t* payload, size_t size);
+
+		void sendStateDump(Client& client);
+		// Records of the mirror that can change during a session, after the upstream link recovered
+		void broadcastState();
+		void broadcast(const protocol::PacketWriter& records);
+		bool sendRecords(Client& client, const protocol::PacketWriter& records);
+		bool sendPacket(Client& client, const protocol::PacketHeader& header, const uint8_t* payload, size_t size);
+		bool sendDatagram(Client& client, const uint8_t* data, size_t size);
+
+		UdpBackend upstream;	// not threaded, polled by the broker thread
+		std::string switcherAddress;
+		std::string path;
+		int sock = -1;
+		std::atomic<bool> upstreamConnected{ false };
+
+		std::map<std::string, Client> clients;	// by socket path
+		uint16_t nextSessionId = 0x8001;
+		protocol::PacketWriter pending;	// upstream records not yet forwarded
+
+		std::atomic<uint64_t> forwardedRecords{ 0 };
+		std::atomic<uint64_t> forwardedCommands{ 0 };
+	};
+
+}
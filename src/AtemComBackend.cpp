@@ -0,0 +1,394 @@
+#include "AtemTypes.h"
+
+#ifdef OFX_ATEM_HAS_COM
+
+#include "AtemComBackend.h"
+
+std::string convertToString(const BSTR& bstr) {
+	CString cstr(bstr);
+	CT2CA pszConvertedAnsiString(cstr);
+
+	return std::string(pszConvertedAnsiString);
+}
+
+namespace ofxAtem {
+
+	bool ComBackend::open(const std::string& ipAddress) {
+
+		// Initialise COM on this thread
+		HRESULT result = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+		if (FAILED(result)) {
+			ofLogError(__FUNCTION__) << "Initialization of COM failed.";
+			return false;
+		}
+
+		CComPtr<IBMDSwitcher> connected = connectTo(ipAddress);
+		if (!connected) {
+			CoUninitialize();
+			return false;
+		}
+		comInitialized = true;
+		attach(connected);
+		return true;
+
+	}
+
+	CComPtr<IBMDSwitcher> ComBackend::connectTo(const std::string& ipAddress) {
+		CComPtr<IBMDSwitcher> connected;
+
+		// Create an IBMDSwitcherDiscovery object to access switcher device
+		CComPtr<IBMDSwitcherDiscovery> switcherDiscovery;
+		HRESULT result = switcherDiscovery.CoCreateInstance(CLSID_CBMDSwitcherDiscovery, NULL, CLSCTX_ALL);
+		if (FAILED(result)) {
+			ofLogError(__FUNCTION__) << "A Switcher Discovery instance could not be created.  The Switcher drivers may not be installed.";
+			return connected;
+		}
+
+		// Connect to switcher with address provided by arguments
+		CComBSTR addressString = _com_util::ConvertStringToBSTR(ipAddress.data());
+		BMDSwitcherConnectToFailure	connectToFailReason;
+		result = switcherDiscovery->ConnectTo(addressString, &connected, &connectToFailReason);
+		if (FAILED(result)) {
+			ofLogError(__FUNCTION__) << "Failed to connect to switcher at address " << ipAddress;
+			connected.Release();
+		}
+		return connected;
+	}
+
+	void ComBackend::attach(IBMDSwitcher* connected) {
+		switcher = connected;
+
+		productName = get_product_name(switcher);
+
+		// Get the mix effect block iterator
+		get_switcher_mix_effect_blocks(switcher, switcherMixEffectBlocks);
+
+		// Create an InputMonitor for each input so we can catch any changes to input names
+		get_switcher_inputs(switcher, switcherInputs);
+
+		for (auto& meb : switcherMixEffectBlocks) {
+			switcherKeyers.emplace_back();
+			get_keyers_for_meb(meb, switcherKeyers.back());
+		}
+		get_aux_outputs(switcherInputs, switcherAuxOutputs);
+
+		switcherMediaPool = switcher;
+
+		// Whatever the last session left queued is stale now
+		monitorQueue.clear();
+		link.reset(ofGetElapsedTimeMicros());
+		switcherMonitor = new SwitcherMonitor(switcher, clock, link, monitorQueue);
+		switcher->AddCallback(switcherMonitor);
+
+		BMDSwitcherVideoMode videoMode;
+		if (SUCCEEDED(switcher->GetVideoMode(&videoMode)))
+			clock.setFrameRate(get_video_mode_frame_rate(videoMode));
+
+		// For every input, install a callback to monitor property changes on the input
+		for (auto input : switcherInputs) {
+			InputMonitor* inputMonitor = new InputMonitor(input);
+			//input->AddCallback(inputMonitor);
+			inputMonitors.push_back(inputMonitor);
+		}
+
+		for (int me = 0; me < (int)switcherMixEffectBlocks.size(); me++) {
+			MixEffectBlockMonitor* mixEffectBlockMonitor = new MixEffectBlockMonitor(me, monitorQueue);
+			switcherMixEffectBlocks[me]->AddCallback(mixEffectBlockMonitor);
+			mixEffectBlockMonitors.push_back(mixEffectBlockMonitor);
+
+			// Keyers report going on air through their own callback
+			keyerMonitors.emplace_back();
+			for (auto& keyer : switcherKeyers[me]) {
+				KeyerMonitor* keyerMonitor = new KeyerMonitor(me, monitorQueue);
+				keyer->AddCallback(keyerMonitor);
+				keyerMonitors.back().push_back(keyerMonitor);
+			}
+		}
+
+	}
+
+	void ComBackend::printInfo() {
+		// Nothing to ask while the switcher is away
+		if (offline || !switcher) return;
+
+		// Print current and MultiView video modes
+		BMDSwitcherVideoMode currentVideoMode;
+		if (SUCCEEDED(switcher->GetVideoMode(&currentVideoMode))) {
+			std::string currentVideoModeStr = LookupString<BMDSwitcherVideoMode>(kSwitcherVideoModes, currentVideoMode);
+			printf(" %-40s %s\n", "Current Video Mode:", currentVideoModeStr.c_str());
+
+			BMDSwitcherVideoMode multiViewVideoMode;
+			if (SUCCEEDED(switcher->GetMultiViewVideoMode(currentVideoMode, &multiViewVideoMode))) {
+				std::string multiViewVideoModeStr = LookupString<BMDSwitcherVideoMode>(kSwitcherVideoModes, multiViewVideoMode);
+				printf(" %-40s %s\n", "MultiView Video Mode:", multiViewVideoModeStr.c_str());
+			}
+		}
+
+		// Print the power status of switcher
+		BMDSwitcherPowerStatus powerStatus;
+		if (SUCCEEDED(switcher->GetPowerStatus(&powerStatus))) {
+			printf(" %-40s %s\n", "Power Supply 1:", powerStatus & bmdSwitcherPowerStatusSupply1 ? "Powered" : "Not powered");
+			printf(" %-40s %s\n", "Power Supply 2:", powerStatus & bmdSwitcherPowerStatusSupply2 ? "Powered" : "Not powered");
+		}
+
+		// Print whether Fairlight or original audio mixer
+		fairlightAudioMixer = switcher;
+		printf(" %-40s %s\n", "Audio Mixer:", fairlightAudioMixer ? "Fairlight" : "Original");
+
+		// Print Mix Effect block count
+		printf(" %-40s %d\n", "Number of Mix Effect Blocks:", (int)switcherMixEffectBlocks.size());
+
+		for (unsigned int i = 0; i < switcherMixEffectBlocks.size(); i++) {
+			printf(" - Number of Upstream Keyers for ME%d:     %d\n", i, get_usk_count_for_meb(switcherMixEffectBlocks[i]));
+			printf(" - Transition Styles supported by ME%d:    ", i);
+			for (auto& transitionStyleStr : get_transition_styles_for_meb(switcherMixEffectBlocks[i]))
+				printf("%s ", transitionStyleStr.c_str());
+			printf("\n");
+		}
+
+		printf(" %-40s %s\n", "Supports Advanced Chroma Keyers:", does_support_advanced_chroma_keyers(switcherMixEffectBlocks) ? "Yes" : "No");
+		printf(" %-40s %d\n", "Number of Downstream Keyers", get_downstream_keyer_count(switcher));
+
+		// Print swicther input type counts
+		printf(" %-40s %d\n", "Number of External Inputs:", get_input_type_count(switcherInputs, bmdSwitcherPortTypeExternal));
+		printf(" %-40s %d\n", "Number of SuperSources:", get_input_type_count(switcherInputs, bmdSwitcherPortTypeSuperSource));
+		printf(" %-40s %d\n", "Number of Media Players:", get_input_type_count(switcherInputs, bmdSwitcherPortTypeMediaPlayerFill));
+		printf(" %-40s %d\n", "Number of AUX Outputs:", get_input_type_count(switcherInputs, bmdSwitcherPortTypeAuxOutput));
+
+		// Get Switcher Media pool.
+
+		if (switcherMediaPool) {
+			// Get Switcher stills interfaceobject
+			if (switcherMediaPool->GetStills(&switcherStills) == S_OK) {
+				printf(" %-40s %u\n", "Number of Stills in Media Pool:", get_media_pool_stills_count(switcherStills));
+			}
+
+			printf(" %-40s %u\n", "Number of Clips in Media Pool:", get_media_pool_clip_count(switcherMediaPool));
+		}
+
+		print_supported_video_modes(switcher);
+		print_switcher_inputs(switcherInputs);
+		print_input_availability_matrix(switcherInputs, (int)switcherMixEffectBlocks.size());
+		if (fairlightAudioMixer) {
+			// Print Fairlight audiomixer inputs
+			print_fairlight_audio_inputs(fairlightAudioMixer, switcherInputs);
+		} else {
+			// Print original audio mixer inputs
+			CComQIPtr<IBMDSwitcherAudioMixer> audioMixer = switcher;
+			if (audioMixer)
+				print_audio_inputs(audioMixer, switcherInputs);
+		}
+
+		if (switcherStills) {
+			print_media_pool_stills(switcherStills);
+		}
+
+		if (switcherMediaPool) {
+			print_media_pool_clips(switcherMediaPool);
+		}
+
+	}
+
+	void ComBackend::close() {
+		detach();
+
+		// Uninitalize COM on this thread
+		if (comInitialized) CoUninitialize();
+		comInitialized = false;
+	}
+
+	void ComBackend::detach() {
+		if (!switcher) return;
+		switcher->RemoveCallback(switcherMonitor);
+		switcher.Release();
+		switcherMonitor->Release();
+
+		for (size_t i = 0; i < switcherInputs.size(); i++) {
+			switcherInputs[i]->RemoveCallback(inputMonitors[i]);
+			switcherInputs[i].Release();
+			inputMonitors[i]->Release();
+		}
+		for (size_t i = 0; i < switcherMixEffectBlocks.size(); i++) {
+			for (size_t keyer = 0; keyer < switcherKeyers[i].size(); keyer++) {
+				switcherKeyers[i][keyer]->RemoveCallback(keyerMonitors[i][keyer]);
+				keyerMonitors[i][keyer]->Release();
+			}
+			switcherMixEffectBlocks[i]->RemoveCallback(mixEffectBlockMonitors[i]);
+			switcherMixEffectBlocks[i].Release();
+			mixEffectBlockMonitors[i]->Release();
+		}
+		// attach() fills these again on reconnect
+		switcherInputs.clear();
+		inputMonitors.clear();
+		switcherMixEffectBlocks.clear();
+		mixEffectBlockMonitors.clear();
+		switcherKeyers.clear();
+		keyerMonitors.clear();
+		switcherAuxOutputs.clear();
+		switcherMediaPool.Release();
+		switcherStills.Release();
+		fairlightAudioMixer.Release();
+
+	}
+
+	bool ComBackend::collectMonitors() {
+		MonitorEvent e;
+		while (monitorQueue.pop(e)) {
+			// Anything after the loss belongs to the dead session
+			if (e.type == MonitorEvent::kDisconnected) return true;
+			events.add(e.mixEffect);
+		}
+		return false;
+	}
+
+	bool ComBackend::consumeDropped() {
+		uint64_t dropped = monitorQueue.consumeDropped();
+		if (!dropped) return false;
+		droppedEvents += dropped;
+		ofLogWarning(__FUNCTION__) << dropped << " switcher events dropped while update() did not run, resynchronising";
+		return true;
+	}
+
+	void ComBackend::goOffline() {
+		detach();
+		offline = true;
+		backoffMs = kReconnectMinBackoffMs;
+		nextReconnectMillis = ofGetElapsedTimeMillis() + backoffMs;
+	}
+
+	void ComBackend::requestTimecode() {
+		// The SDK reports the timecode when asked, its TimeCodeChanged feeds the clock and, for
+		// the request that went out as the heartbeat, answers it
+		switcherMonitor->timecodeRequested(link.heartbeatDue(ofGetElapsedTimeMicros()));
+		switcher->RequestTimeCode();
+	}
+
+	bool ComBackend::reconnect() {
+		if (reconnecting.valid()) {
+			if (reconnecting.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+			CComPtr<IBMDSwitcher> connected = reconnecting.get();
+			if (connected) {
+				attach(connected);
+				offline = false;
+				return true;
+			}
+			backoffMs = std::min(backoffMs * 2, kReconnectMaxBackoffMs);
+			nextReconnectMillis = ofGetElapsedTimeMillis() + backoffMs;
+			return false;
+		}
+		if (!autoReconnect || ofGetElapsedTimeMillis() < nextReconnectMillis) return false;
+
+		// ConnectTo blocks until it succeeds or gives up, which would stall the frame. This
+		// thread keeps the MTA alive meanwhile, so the worker's switcher is usable here.
+		std::string address = this->address;
+		reconnecting = std::async(std::launch::async, [address] {
+			CComPtr<IBMDSwitcher> connected;
+			if (FAILED(CoInitializeEx(NULL, COINIT_MULTITHREADED))) return connected;
+			connected = connectTo(address);
+			CoUninitialize();
+			return connected;
+		});
+		return false;
+	}
+
+	void ComBackend::replayCommands() {
+		std::vector<std::function<bool()>> commands;
+		commands.swap(pendingCommands);
+		for (auto& command : commands) command();
+	}
+
+	bool ComBackend::hold(std::function<bool()> command) {
+		pendingCommands.push_back(std::move(command));
+		return true;
+	}
+
+	bool ComBackend::setKeyerOnAir(int me, int keyer, bool onAir) {
+		if (offline) return hold([=] { return setKeyerOnAir(me, keyer, onAir); });
+		if (me < 0 || me >= (int)switcherKeyers.size() || keyer < 0 || keyer >= (int)switcherKeyers[me].size()) return false;
+		return SUCCEEDED(switcherKeyers[me][keyer]->SetOnAir(onAir ? TRUE : FALSE));
+	}
+
+	bool ComBackend::setAuxSource(int aux, BMDSwitcherInputId id) {
+		if (offline) return hold([=] { return setAuxSource(aux, id); });
+		if (aux < 0 || aux >= (int)switcherAuxOutputs.size()) return false;
+		return SUCCEEDED(switcherAuxOutputs[aux]->SetInputSource(id));
+	}
+
+	bool ComBackend::getTransition(int me, TransitionState& transition) {
+		if (offline || me < 0 || me >= (int)switcherMixEffectBlocks.size()) return false;
+		BOOL inTransition;
+		double position;
+		unsigned int framesRemaining;
+		IBMDSwitcherMixEffectBlock* meb = switcherMixEffectBlocks[me];
+		if (FAILED(meb->GetInTransition(&inTransition)) || FAILED(meb->GetTransitionPosition(&position)) ||
+			FAILED(meb->GetTransitionFramesRemaining(&framesRemaining))) return false;
+		transition.inTransition = inTransition != FALSE;
+		transition.position = position;
+		transition.framesRemaining = (int)framesRemaining;
+		return true;
+	}
+
+	bool ComBackend::getKeyersOnAir(int me, uint32_t& onAir) {
+		if (offline || me < 0 || me >= (int)switcherKeyers.size()) return false;
+		onAir = 0;
+		for (int keyer = 0; keyer < (int)switcherKeyers[me].size(); keyer++) {
+			BOOL keyerOnAir;
+			if (FAILED(switcherKeyers[me][keyer]->GetOnAir(&keyerOnAir))) return false;
+			if (keyerOnAir) onAir |= 1u << keyer;
+		}
+		return true;
+	}
+
+	bool ComBackend::readInputs(std::vector<ofPtr<Input>>& inputs) {
+
+		HRESULT result;
+		IBMDSwitcherInputIterator* inputIterator = NULL;
+		IBMDSwitcherInput* input = NULL;
+
+		result = switcher->CreateIterator(IID_IBMDSwitcherInputIterator, (void**)&inputIterator);
+		if (FAILED(result)) {
+			ofLogError() << "Could not create IBMDSwitcherInputIterator iterator";
+			return false;
+		}
+
+		BSTR longName, shortName;
+		int index = 0;
+		while (S_OK == inputIterator->Next(&input)) {
+			BMDSwitcherInputId id;
+			BMDSwitcherPortType portType;
+
+			input->GetInputId(&id);
+			input->GetLongName(&longName);
+			input->GetShortName(&shortName);
+			input->GetPortType(&portType);
+
+			std::string portTypeStr = LookupString<BMDSwitcherPortType>(kSwitcherPortTypes, portType);
+			if (portType == bmdSwitcherPortTypeExternal) {
+				BMDSwitcherExternalPortType externalPortType;
+				input->GetCurrentExternalPortType(&externalPortType);
+				portTypeStr += " (" + LookupString<BMDSwitcherExternalPortType>(kSwitcherExternalPortTypes, externalPortType) + ")";
+			}
+
+
+			ofPtr<Input> inputPtr = std::make_shared<Input>();
+			inputPtr->bmdId = id;
+			inputPtr->index = index;
+			inputPtr->longName = convertToString(longName);
+			inputPtr->shortName = convertToString(shortName);
+			inputPtr->portType = portTypeStr;
+
+			inputs.push_back(std::move(inputPtr));
+
+			input->Release();
+
+			index++;
+		}
+
+		inputIterator->Release();
+
+		return true;
+	}
+
+}
+
+#endif
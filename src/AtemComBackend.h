@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "ofEvents.h"
+#include "ofEventUtils.h"
+#include "ofLog.h"
+#include "ofTypes.h"
+#include "ofUtils.h"
+
+#include "AtemTypes.h"
+#include "AtemDeviceInfo.h"
+#include "AtemEventCoalescer.h"
+#include "AtemLinkMonitor.h"
+#include "AtemMonitors.h"
+#include "AtemSwitcherClock.h"
+
+namespace ofxAtem {
+
+	// Device backend over the Windows ATEM Switchers SDK.
+	// The SDK's COM callbacks only queue their notifications (see MonitorQueue), which
+	// ofApp::update() delivers to the device on the main thread; the SDK's thread never runs
+	// listeners or waits for them. The SDK getters are blocking calls bound to the caller's
+	// apartment, so connect() completes the sync before returning.
+	// A lost link is re-opened by a worker thread, as ConnectTo blocks for seconds while the
+	// switcher is away; ofApp::update() picks the new connection up. Set calls made while offline
+	// are queued and replayed in order. The SDK only reports a dead link
+	// after seconds; the timecode is requested on every update and one request per heartbeat
+	// interval doubles as the heartbeat, so a switcher
+	// that stops answering is reported by onLinkDegraded() a few hundred milliseconds in.
+	class ComBackend {
+	public:
+		ComBackend() {}
+		~ComBackend() {}
+
+		template<typename Sink>
+		bool connect(const std::string& address, Sink& sink) {
+			if (!open(address)) return false;
+			this->address = address;
+			this->sink = &sink;
+			ofAddListener(ofEvents().update, this, &ComBackend::onUpdate<Sink>);
+			sink.onBackendConnected(true);
+			return true;
+		}
+
+		template<typename Sink>
+		void disconnect(Sink&) {
+			ofRemoveListener(ofEvents().update, this, &ComBackend::onUpdate<Sink>);
+			// A reconnect in flight has to give up first, its connection is dropped
+			if (reconnecting.valid()) reconnecting.get();
+			close();
+			monitorQueue.clear();
+			offline = false;
+			pendingCommands.clear();
+			this->sink = nullptr;
+		}
+		// Events come from update()
+		template<typename Sink>
+		void deliver(Sink&) {}
+
+		void printInfo();
+		std::string getProductName() { return productName; }
+		bool readInputs(std::vector<ofPtr<Input>>& inputs);
+
+		bool setProgramInput(int me, BMDSwitcherInputId id) {
+			if (offline) return hold([=] { return setProgramInput(me, id); });
+			if (me < 0 || me >= (int)switcherMixEffectBlocks.size()) return false;
+			return SUCCEEDED(switcherMixEffectBlocks[me]->SetProgramInput(id));
+		}
+		bool setPreviewInput(int me, BMDSwitcherInputId id) {
+			if (offline) return hold([=] { return setPreviewInput(me, id); });
+			if (me < 0 || me >= (int)switcherMixEffectBlocks.size()) return false;
+			return SUCCEEDED(switcherMixEffectBlocks[me]->SetPreviewInput(id));
+		}
+		bool setKeyerOnAir(int me, int keyer, bool onAir);
+		bool setAuxSource(int aux, BMDSwitcherInputId id);
+
+		// The SDK sends every call on its own, there is no way to group them into one datagram
+		void beginBatch() {}
+		bool commitBatch() { return true; }
+
+		bool getProgramInput(int me, BMDSwitcherInputId& id) {
+			if (offline || me < 0 || me >= (int)switcherMixEffectBlocks.size()) return false;
+			return SUCCEEDED(switcherMixEffectBlocks[me]->GetProgramInput(&id));
+		}
+		bool getPreviewInput(int me, BMDSwitcherInputId& id) {
+			if (offline || me < 0 || me >= (int)switcherMixEffectBlocks.size()) return false;
+			return SUCCEEDED(switcherMixEffectBlocks[me]->GetPreviewInput(&id));
+		}
+		bool getTransition(int me, TransitionState& transition);
+		bool getKeyersOnAir(int me, uint32_t& onAir);
+		int getMixEffectBlockCount() { return (int)switcherMixEffectBlocks.size(); }
+
+		// Fed with the timecode requested from the switcher on every ofApp::update()
+		SwitcherClock& getClock() { return clock; }
+		// Heartbeats are timecode requests, the first TimeCodeChanged after one answers it.
+		// Round trips are only as fine as the update rate, commands are not tracked.
+		LinkMonitor& getLinkMonitor() { return link; }
+		// Merges what the SDK notified between two updates
+		EventCoalescer& getEventCoalescer() { return events; }
+
+		// Re-open the link after the switcher disconnected (on by default)
+		void setAutoReconnect(bool enable) { autoReconnect = enable; }
+
+		// Callback notifications delivered so far, after coalescing, and dropped because update()
+		// did not come round before MonitorQueue::kCapacity of them piled up
+		uint64_t getDeliveredEventCount() const { return deliveredEvents; }
+		uint64_t getDroppedEventCount() const { return droppedEvents; }
+
+	private:
+		static constexpr int kReconnectMinBackoffMs = 250;
+		static constexpr int kReconnectMaxBackoffMs = 5000;
+
+		// On the calling thread, which keeps COM initialised until close()
+		bool open(const std::string& address);
+		void close();
+		// Blocks until the switcher answers or ConnectTo gives up, on any thread in the MTA.
+		// Empty if it could not be reached.
+		static CComPtr<IBMDSwitcher> connectTo(const std::string& address);
+		// Walks the object graph of a connected switcher and installs the monitors
+		void attach(IBMDSwitcher* connected);
+		// Releases what attach() set up, COM stays initialised
+		void detach();
+
+		// Instantiated for the sink connect() was given, so events reach it as direct calls
+		template<typename Sink>
+		void onUpdate(ofEventArgs&) {
+			Sink& sink = *static_cast<Sink*>(this->sink);
+
+			// The device reads the SDK objects on this thread, so they are released here rather
+			// than from the SDK callback that reported the loss
+			if (!offline && drainMonitors(sink)) {
+				goOffline();
+				sink.onBackendDisconnected();
+			}
+			if (!offline) {
+				requestTimecode();
+				link.update(ofGetElapsedTimeMicros(), sink);
+			}
+			if (offline && reconnect()) {
+				sink.onInputsChanged();
+				sink.onBackendReconnected();
+				replayCommands();
+			}
+		}
+
+		// Delivers what the monitors queued, true if the switcher disconnected
+		template<typename Sink>
+		bool drainMonitors(Sink& sink) {
+			bool disconnected = collectMonitors();
+			events.drain([this, &sink](MixEffectEvent& e) {
+				deliveredEvents++;
+				notify(sink, e);
+			});
+			if (disconnected) return true;
+
+			// Some changes never made it, have the device read every block again
+			if (!consumeDropped()) return false;
+			for (int me = 0; me < (int)switcherMixEffectBlocks.size(); me++) {
+				for (auto type : { bmdSwitcherMixEffectBlockEventTypeProgramInputChanged, bmdSwitcherMixEffectBlockEventTypePreviewInputChanged, kKeyerOnAirChanged }) {
+					MixEffectEvent resync{ me, type };
+					notify(sink, resync);
+				}
+			}
+			return false;
+		}
+		// To the device, and to the deprecated MixEffectBlockMonitor::effectBlockChanged
+		template<typename Sink>
+		void notify(Sink& sink, MixEffectEvent& e) {
+			sink.onMixEffectBlockUpdated(e);
+			ofNotifyEvent(MixEffectBlockMonitor::effectBlockChanged, e.type);
+		}
+		// Moves what the monitors queued into events, true if the switcher disconnected
+		bool collectMonitors();
+		// True if the queue overflowed since the last call
+		bool consumeDropped();
+		void goOffline();
+		// Asks the switcher for its timecode for the clock, as the heartbeat when one is due
+		void requestTimecode();
+		// Once the backoff is over, starts a reconnect on a worker; true once one got the link back
+		bool reconnect();
+		void replayCommands();
+		bool hold(std::function<bool()> command);
+
+		CComPtr<IBMDSwitcher> switcher;
+		std::vector<CComPtr<IBMDSwitcherInput>>	switcherInputs;
+		std::vector<CComPtr<IBMDSwitcherMixEffectBlock>> switcherMixEffectBlocks;
+		std::vector<std::vector<CComPtr<IBMDSwitcherKey>>> switcherKeyers;	// per ME
+		std::vector<CComQIPtr<IBMDSwitcherInputAux>> switcherAuxOutputs;
+		CComQIPtr<IBMDSwitcherMediaPool> switcherMediaPool;
+		CComPtr<IBMDSwitcherStills>	switcherStills;
+		CComQIPtr<IBMDSwitcherFairlightAudioMixer> fairlightAudioMixer;
+		std::string	productName;
+		SwitcherClock clock;
+		LinkMonitor link;
+
+		MonitorQueue monitorQueue;
+		EventCoalescer events;
+		uint64_t deliveredEvents = 0;
+		uint64_t droppedEvents = 0;
+		SwitcherMonitor* switcherMonitor;
+		std::vector<InputMonitor*> inputMonitors;
+		std::vector<MixEffectBlockMonitor*> mixEffectBlockMonitors;
+		std::vector<std::vector<KeyerMonitor*>> keyerMonitors;	// per ME, like switcherKeyers
+
+		std::string address;
+		bool comInitialized = false;
+		bool offline = false;
+		bool autoReconnect = true;
+		int backoffMs = kReconnectMinBackoffMs;
+		uint64_t nextReconnectMillis = 0;
+		std::future<CComPtr<IBMDSwitcher>> reconnecting;	// ConnectTo on a worker thread
+		std::vector<std::function<bool()>> pendingCommands;
+
+		void* sink = nullptr;	// the Sink of onUpdate<Sink>()
+	};
+
+}
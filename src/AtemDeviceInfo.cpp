@@ -1,5 +1,13 @@
+#include "AtemTypes.h"
+
+#ifdef OFX_ATEM_HAS_COM
+
 #include "AtemDeviceInfo.h"
 
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
 
 void get_switcher_inputs(const CComPtr<IBMDSwitcher>& switcher, std::vector<CComPtr<IBMDSwitcherInput>>& switcherInputs) {
 	CComPtr<IBMDSwitcherInputIterator> inputIterator;
@@ -19,6 +27,23 @@ void get_switcher_mix_effect_blocks(const CComPtr<IBMDSwitcher>& switcher, std::
 	}
 }
 
+void get_keyers_for_meb(const CComPtr<IBMDSwitcherMixEffectBlock>& mixEffectBlock, std::vector<CComPtr<IBMDSwitcherKey>>& keyers) {
+	CComPtr<IBMDSwitcherKeyIterator> keyIterator;
+	if (mixEffectBlock->CreateIterator(IID_IBMDSwitcherKeyIterator, (void**)&keyIterator) == S_OK) {
+		CComPtr<IBMDSwitcherKey> keyer;
+		while (keyIterator->Next(&keyer) == S_OK)
+			keyers.push_back(std::move(keyer));
+	}
+}
+
+void get_aux_outputs(const std::vector<CComPtr<IBMDSwitcherInput>>& switcherInputs, std::vector<CComQIPtr<IBMDSwitcherInputAux>>& auxOutputs) {
+	for (auto& input : switcherInputs) {
+		BMDSwitcherPortType type;
+		if ((input->GetPortType(&type) == S_OK) && (type == bmdSwitcherPortTypeAuxOutput))
+			auxOutputs.push_back(CComQIPtr<IBMDSwitcherInputAux>(input));
+	}
+}
+
 int get_downstream_keyer_count(const CComPtr<IBMDSwitcher>& switcher) {
 	int											downstreamKeyerCount = 0;
 	CComPtr<IBMDSwitcherDownstreamKeyIterator>	dskIterator;
@@ -151,6 +176,28 @@ int get_media_pool_stills_count(const CComPtr<IBMDSwitcherStills>& stills) {
 	return validStillsCount;
 }
 
+ofxAtem::FrameRate get_video_mode_frame_rate(BMDSwitcherVideoMode videoMode) {
+	auto iter = kSwitcherVideoModes.find(videoMode);
+	if (iter == kSwitcherVideoModes.end())
+		return ofxAtem::FrameRate{ 0, 1 };
+
+	// "HD 1080i59.94": the rate follows the scan letter, fields per second for interlaced modes
+	const std::string& name = iter->second;
+	for (size_t i = 1; i + 1 < name.size(); i++) {
+		if ((name[i] != 'p' && name[i] != 'i') || !isdigit((unsigned char)name[i - 1]) || !isdigit((unsigned char)name[i + 1]))
+			continue;
+
+		double rate = atof(name.c_str() + i + 1);
+		if (name[i] == 'i')
+			rate /= 2;
+		double whole = floor(rate + 0.5);
+		if (fabs(rate - whole) > 0.01)
+			return ofxAtem::FrameRate{ uint32_t(whole * 1000 + 0.5), 1001 };
+		return ofxAtem::FrameRate{ uint32_t(whole), 1 };
+	}
+	return ofxAtem::FrameRate{ 0, 1 };
+}
+
 void print_supported_video_modes(const CComPtr<IBMDSwitcher>& switcher) {
 	printf("\nSwitcher Video Mode Support:\n");
 	printf(" %-25s%-35s%s\n", "Video Mode", "HD Down Converted Video Mode", "MultiView Video Mode");
@@ -433,3 +480,5 @@ const char* BSTRToCString(const CComBSTR& str) {
 
 	return retString;
 }
+
+#endif
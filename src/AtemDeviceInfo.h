@@ -41,9 +41,12 @@
 
 //#include <combaseapi.h>
 
+#ifdef _MSC_VER
 #pragma comment(lib, "comsuppw.lib")
+#endif
 
 #include "BMDSwitcherAPI_h.h"
+#include "AtemTypes.h"
 
 static const std::map<BMDSwitcherConnectToFailure, std::string> kConnectFailReasonCodes =
 {
@@ -153,6 +156,8 @@ static const std::vector<BMDSwitcherInputAvailability> kSwitcherInputAvailabilty
 
 void get_switcher_inputs(const CComPtr<IBMDSwitcher>& switcher, std::vector<CComPtr<IBMDSwitcherInput>>& switcherInputs);
 void get_switcher_mix_effect_blocks(const CComPtr<IBMDSwitcher>& switcher, std::vector<CComPtr<IBMDSwitcherMixEffectBlock>>& mixEffectBlocks);
+void get_keyers_for_meb(const CComPtr<IBMDSwitcherMixEffectBlock>& mixEffectBlock, std::vector<CComPtr<IBMDSwitcherKey>>& keyers);
+void get_aux_outputs(const std::vector<CComPtr<IBMDSwitcherInput>>& switcherInputs, std::vector<CComQIPtr<IBMDSwitcherInputAux>>& auxOutputs);
 
 std::string	get_product_name(const CComPtr<IBMDSwitcher>& switcher);
 int	get_usk_count_for_meb(const CComPtr<IBMDSwitcherMixEffectBlock>& mixEffectBlock);
@@ -161,6 +166,8 @@ int	get_downstream_keyer_count(const CComPtr<IBMDSwitcher>& switcher);
 int	get_input_type_count(const std::vector<CComPtr<IBMDSwitcherInput>>& switcherInputs, BMDSwitcherPortType portType);
 int	get_media_pool_clip_count(const CComPtr<IBMDSwitcherMediaPool>& mediaPool);
 int	get_media_pool_stills_count(const CComPtr<IBMDSwitcherStills>& stills);
+// Read off the mode's name in kSwitcherVideoModes, invalid for a mode missing there
+ofxAtem::FrameRate get_video_mode_frame_rate(BMDSwitcherVideoMode videoMode);
 
 bool does_support_advanced_chroma_keyers(const std::vector<CComPtr<IBMDSwitcherMixEffectBlock>>& mixEffectBlocks);
 
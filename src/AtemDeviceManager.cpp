@@ -0,0 +1,198 @@
+#include "AtemDeviceManager.h"
+
+#include <algorithm>
+
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+namespace ofxAtem {
+
+	DeviceManager::~DeviceManager() {
+		clear();
+		if (isThreadRunning()) {
+			waitForThread(true);
+		}
+#ifdef __linux__
+		if (epollFd >= 0) {
+			::close(epollFd);
+			epollFd = -1;
+		}
+#endif
+	}
+
+	NativeDevice& DeviceManager::add(const std::string& address) {
+		std::shared_ptr<Entry> entry(new Entry());
+		entry->device.reset(new NativeDevice());
+		entry->device->getBackend().setThreaded(false);
+		NativeDevice& device = *entry->device;
+
+		// Not polled before it is in entries, nothing else can touch it yet
+		entry->device->connectAsync(address);
+		entry->active = entry->device->getBackend().getSocket() >= 0;
+		{
+			std::lock_guard<std::mutex> lock(devicesMutex);
+#ifdef __linux__
+			if (epollFd < 0) epollFd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+			watch(entry);
+			entries.push_back(entry);
+		}
+
+		if (!isThreadRunning()) startThread();
+		return device;
+	}
+
+	void DeviceManager::remove(NativeDevice& device) {
+		std::shared_ptr<Entry> entry;
+		{
+			std::lock_guard<std::mutex> lock(devicesMutex);
+			auto it = std::find_if(entries.begin(), entries.end(), [&](const std::shared_ptr<Entry>& e) { return e->device.get() == &device; });
+			if (it == entries.end()) return;
+
+			entry = *it;
+			unwatch(*entry);
+			entries.erase(it);
+		}
+		retire(entry);
+	}
+
+	void DeviceManager::clear() {
+		std::vector<std::shared_ptr<Entry>> removed;
+		{
+			std::lock_guard<std::mutex> lock(devicesMutex);
+			for (auto& entry : entries) unwatch(*entry);
+			removed.swap(entries);
+		}
+		for (auto& entry : removed) retire(entry);
+	}
+
+	size_t DeviceManager::size() {
+		std::lock_guard<std::mutex> lock(devicesMutex);
+		return entries.size();
+	}
+
+	NativeDevice& DeviceManager::getDevice(size_t index) {
+		std::lock_guard<std::mutex> lock(devicesMutex);
+		return *entries[index]->device;
+	}
+
+	void DeviceManager::threadedFunction() {
+		std::vector<int> ready;
+		std::vector<std::shared_ptr<Entry>> due;
+		uint64_t nextTickMillis = 0;
+		ioThread = std::this_thread::get_id();
+
+		while (isThreadRunning()) {
+			waitForSockets(ready);
+
+			// Listeners run while the devices are polled, outside the lock so they can call back
+			// into the manager. The entries are held meanwhile, even if one of them is removed.
+			{
+				std::lock_guard<std::mutex> lock(devicesMutex);
+				for (int sock : ready) {
+					auto it = bySocket.find(sock);
+					if (it != bySocket.end()) due.push_back(it->second);
+				}
+
+				// Links without traffic still need their timers run
+				uint64_t now = ofGetElapsedTimeMillis();
+				if (now >= nextTickMillis) {
+					due.insert(due.end(), entries.begin(), entries.end());
+					nextTickMillis = now + kTickMillis;
+				}
+			}
+
+			for (auto& entry : due) {
+				std::lock_guard<std::mutex> lock(entry->mutex);
+				if (entry->removed) continue;
+				polling = entry.get();
+				poll(*entry);
+				polling = nullptr;
+				// One of its own listeners removed it
+				if (entry->removed) entry->device->disconnect();
+			}
+			due.clear();
+		}
+	}
+
+	void DeviceManager::waitForSockets(std::vector<int>& ready) {
+		ready.clear();
+#ifdef __linux__
+		epoll_event events[64];
+		int n = epoll_wait(epollFd, events, 64, kTickMillis);
+		for (int i = 0; i < n; i++) {
+			ready.push_back(events[i].data.fd);
+		}
+#else
+		std::vector<pollfd> fds;
+		{
+			std::lock_guard<std::mutex> lock(devicesMutex);
+			for (auto& it : bySocket) fds.push_back({ it.first, POLLIN, 0 });
+		}
+		if (::poll(fds.data(), fds.size(), kTickMillis) <= 0) return;
+		for (auto& pfd : fds) {
+			if (pfd.revents & POLLIN) ready.push_back(pfd.fd);
+		}
+#endif
+	}
+
+	void DeviceManager::poll(Entry& entry) {
+		if (!entry.active) return;
+
+		NativeDevice& device = *entry.device;
+		entry.active = device.getBackend().poll(device, 0);
+
+		// reconnect() opens the new socket before closing the old one, so a new session always
+		// shows up as a different descriptor
+		std::lock_guard<std::mutex> lock(devicesMutex);
+		if (!entry.active || device.getBackend().getSocket() != entry.sock) {
+			unwatch(entry);
+			// Unless it was removed meanwhile
+			if (entry.active) {
+				auto it = std::find_if(entries.begin(), entries.end(), [&](const std::shared_ptr<Entry>& e) { return e.get() == &entry; });
+				if (it != entries.end()) watch(*it);
+			}
+		}
+	}
+
+	void DeviceManager::retire(const std::shared_ptr<Entry>& entry) {
+		// Its poll is further up this stack, the I/O thread disconnects it once that returns
+		if (std::this_thread::get_id() == ioThread && polling == entry.get()) {
+			entry->removed = true;
+			return;
+		}
+		std::lock_guard<std::mutex> lock(entry->mutex);
+		entry->removed = true;
+		entry->device->disconnect();
+	}
+
+	void DeviceManager::watch(const std::shared_ptr<Entry>& entry) {
+		entry->sock = entry->device->getBackend().getSocket();
+		if (entry->sock < 0) return;
+
+		bySocket[entry->sock] = entry;
+#ifdef __linux__
+		epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.fd = entry->sock;
+		if (epoll_ctl(epollFd, EPOLL_CTL_ADD, entry->sock, &event) != 0) {
+			ofLogError(__FUNCTION__) << "Could not watch the socket of a switcher connection";
+		}
+#endif
+	}
+
+	void DeviceManager::unwatch(Entry& entry) {
+		if (entry.sock < 0) return;
+
+		bySocket.erase(entry.sock);
+#ifdef __linux__
+		// Already gone from the set if the client closed the socket
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, entry.sock, nullptr);
+#endif
+		entry.sock = -1;
+	}
+
+}
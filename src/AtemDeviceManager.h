@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ofThread.h"
+
+#include "ofxAtem.h"
+
+namespace ofxAtem {
+
+	// Owns any number of native switcher connections and drives all of them from one I/O thread,
+	// which waits on their sockets with epoll (poll() where epoll is not available).
+	// Every device keeps its own state mirror and events, exactly as if it was connected on its
+	// own; its listeners are called on the I/O thread, like on the receive thread of a lone Device.
+	// The manager's lock is not held while they run, so they may call any of its methods,
+	// remove() of their own device included: that one is disconnected once its listeners returned.
+	class DeviceManager : public ofThread {
+	public:
+		DeviceManager() {}
+		~DeviceManager();
+
+		// Starts connecting in the background like Device::connectAsync(), the device's ready
+		// event and isReady() tell when its state is in. The device stays owned by the manager:
+		// remove() it rather than calling connect() or disconnect() on it.
+		NativeDevice& add(const std::string& address);
+		void remove(NativeDevice& device);
+		void clear();
+
+		size_t size();
+		NativeDevice& getDevice(size_t index);
+
+	private:
+		struct Entry {
+			std::unique_ptr<NativeDevice> device;
+			std::mutex mutex;	// held while the device is polled or disconnected
+			int sock = -1;	// as registered for waiting
+			bool active = false;	// false once the backend gave up on the link
+			bool removed = false;
+		};
+
+		void threadedFunction() override;
+
+		// Fills ready with the sockets that have datagrams waiting, or returns after kTickMillis
+		void waitForSockets(std::vector<int>& ready);
+		// Expects the entry's mutex to be held, and devicesMutex not
+		void poll(Entry& entry);
+		// Disconnects an entry already taken out of entries, after its poll if one is running
+		void retire(const std::shared_ptr<Entry>& entry);
+		// The following expect devicesMutex to be held
+		void watch(const std::shared_ptr<Entry>& entry);
+		void unwatch(Entry& entry);
+
+		static const int kTickMillis = 20;	// hellos, retransmits and timeouts of idle links
+
+		std::mutex devicesMutex;
+		std::vector<std::shared_ptr<Entry>> entries;
+		std::unordered_map<int, std::shared_ptr<Entry>> bySocket;
+		int epollFd = -1;
+
+		// Only touched on the I/O thread
+		std::thread::id ioThread;
+		Entry* polling = nullptr;
+	};
+
+}
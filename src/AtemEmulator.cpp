@@ -0,0 +1,756 @@
+#include "AtemEmulator.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ofLog.h"
+#include "ofUtils.h"
+
+#include "AtemSwitcherClock.h"
+
+namespace ofxAtem {
+
+	using namespace protocol;
+
+	static const uint64_t kKeepAliveIntervalMillis = 500;
+	static const uint64_t kSessionTimeoutMillis = 5000;
+	static const uint64_t kRetransmitMillis = 100;
+	// Packets in flight per session; further records are coalesced into queued packets
+	static const size_t kSendWindowSize = 32;
+	// Datagrams drained from the socket per round, before the timers are looked at
+	static const int kMaxDatagramsPerRound = 64;
+	// Socket buffers, room for the acks of a few hundred clients arriving at once
+	static const int kSocketBufferSize = 4 << 20;
+	// Delivery latency samples kept per session
+	static const size_t kMaxLatencySamples = 4096;
+	// Length of one generated transition
+	static const uint64_t kStormTransitionMicros = 1000000;
+	// Upload chunks granted per FTCD, topped up once half of them arrived
+	static const uint16_t kTransferChunkCredit = 64;
+	// Largest upload accepted, an uncompressed 4K still with room to spare
+	static const uint32_t kMaxUploadSize = 64 << 20;
+
+	static InputProperties makeInput(uint16_t id, const std::string& longName, const std::string& shortName, uint8_t portType, uint16_t externalPortType = 0) {
+		InputProperties input;
+		input.id = id;
+		snprintf(input.longName, sizeof(input.longName), "%s", longName.c_str());
+		snprintf(input.shortName, sizeof(input.shortName), "%s", shortName.c_str());
+		input.internalPortType = portType;
+		input.externalPortType = externalPortType;
+		input.availableExternalPortTypes = externalPortType;
+		input.sourceAvailability = 0xff;
+		input.meAvailability = 0xff;
+		return input;
+	}
+
+	Emulator::~Emulator() {
+		stop();
+	}
+
+	bool Emulator::start(const EmulatorTopology& t, uint16_t port, const std::string& address) {
+		stop();
+
+		topology = t;
+		buildInputs();
+
+		sock = socket(AF_INET, SOCK_DGRAM, 0);
+		if (sock < 0) {
+			ofLogError(__FUNCTION__) << "Could not open emulator socket";
+			return false;
+		}
+
+		int reuse = 1;
+		setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		int bufferSize = kSocketBufferSize;
+		setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+		setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+		sockaddr_in bindAddress = {};
+		bindAddress.sin_family = AF_INET;
+		bindAddress.sin_port = htons(port);
+		inet_pton(AF_INET, address.c_str(), &bindAddress.sin_addr);
+		if (bind(sock, (sockaddr*)&bindAddress, sizeof(bindAddress)) != 0) {
+			ofLogError(__FUNCTION__) << "Could not bind emulator to " << address << ":" << port;
+			close(sock);
+			sock = -1;
+			return false;
+		}
+
+		startThread();
+		return true;
+	}
+
+	void Emulator::stop() {
+		if (isThreadRunning()) {
+			waitForThread(true);
+		}
+		if (sock >= 0) {
+			close(sock);
+			sock = -1;
+		}
+		sessions.clear();
+		storeLocks.clear();
+		uploads.clear();
+	}
+
+	size_t Emulator::getSessionCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return sessions.size();
+	}
+
+	void Emulator::buildInputs() {
+		inputs.clear();
+
+		inputs.push_back(makeInput(0, "Black", "BLK", kPortBlack));
+		for (int i = 1; i <= topology.externalInputs; i++) {
+			inputs.push_back(makeInput(uint16_t(i), "Camera " + ofToString(i), "CAM" + ofToString(i), kPortExternal, kExternalHDMI));
+		}
+		inputs.push_back(makeInput(1000, "Color Bars", "BARS", kPortColorBars));
+		inputs.push_back(makeInput(2001, "Color 1", "COL1", kPortColorGenerator));
+		inputs.push_back(makeInput(2002, "Color 2", "COL2", kPortColorGenerator));
+		for (int i = 0; i < topology.mediaPlayers; i++) {
+			inputs.push_back(makeInput(uint16_t(3010 + i * 10), "Media Player " + ofToString(i + 1), "MP" + ofToString(i + 1), kPortMediaPlayerFill));
+			inputs.push_back(makeInput(uint16_t(3011 + i * 10), "Media Player " + ofToString(i + 1) + " Key", "MP" + ofToString(i + 1) + "K", kPortMediaPlayerCut));
+		}
+		for (int i = 0; i < topology.superSources; i++) {
+			inputs.push_back(makeInput(uint16_t(6000 + i), "Super Source " + ofToString(i + 1), "SS" + ofToString(i + 1), kPortSuperSource));
+		}
+		for (int i = 0; i < topology.auxOutputs; i++) {
+			inputs.push_back(makeInput(uint16_t(8001 + i), "Aux " + ofToString(i + 1), "AUX" + ofToString(i + 1), kPortAuxOutput));
+		}
+		for (int i = 0; i < topology.mixEffectBlocks; i++) {
+			inputs.push_back(makeInput(uint16_t(10010 + i * 10), "ME " + ofToString(i + 1) + " Program", "M" + ofToString(i + 1) + "PG", kPortMixEffectBlockOutput));
+			inputs.push_back(makeInput(uint16_t(10011 + i * 10), "ME " + ofToString(i + 1) + " Preview", "M" + ofToString(i + 1) + "PV", kPortMixEffectBlockOutput));
+		}
+
+		uint16_t firstCamera = topology.externalInputs > 0 ? 1 : 0;
+		uint16_t secondCamera = topology.externalInputs > 1 ? 2 : firstCamera;
+		programInputs.assign(topology.mixEffectBlocks, firstCamera);
+		previewInputs.assign(topology.mixEffectBlocks, secondCamera);
+		keyersOnAir.assign(topology.mixEffectBlocks, std::vector<bool>(topology.keyersPerMixEffectBlock, false));
+		auxSources.assign(topology.auxOutputs, 0);
+	}
+
+	void Emulator::setProgramInput(int me, uint16_t source) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (me < 0 || me >= (int)programInputs.size()) return;
+
+		programInputs[me] = source;
+		uint8_t payload[kInputSelectionSize];
+		encode(InputSelection{ uint8_t(me), source }, payload);
+		broadcast(state::kProgramInput, payload, sizeof(payload));
+	}
+
+	void Emulator::setPreviewInput(int me, uint16_t source) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (me < 0 || me >= (int)previewInputs.size()) return;
+
+		previewInputs[me] = source;
+		uint8_t payload[kInputSelectionSize];
+		encode(InputSelection{ uint8_t(me), source }, payload);
+		broadcast(state::kPreviewInput, payload, sizeof(payload));
+	}
+
+	void Emulator::sendProgramBurst(int me, int count) {
+		for (int i = 0; i < count; i++) {
+			setProgramInput(me, inputs[i % inputs.size()].id);
+		}
+	}
+
+	void Emulator::setLossRate(float rate) {
+		std::lock_guard<std::mutex> lock(mutex);
+		lossRate = rate;
+	}
+
+	void Emulator::setPacketInterval(int millis) {
+		std::lock_guard<std::mutex> lock(mutex);
+		packetIntervalMillis = (uint64_t)std::max(millis, 0);
+	}
+
+	void Emulator::setStorm(const EmulatorStorm& s) {
+		std::lock_guard<std::mutex> lock(mutex);
+		storm = s;
+		nextTransitionMicros = nextLevelMicros = nextCutMicros = 0;
+		transitionStep = 0;
+	}
+
+	void Emulator::setTimecode(bool enable, double driftPpm) {
+		std::lock_guard<std::mutex> lock(mutex);
+		timecodeEnabled = enable;
+		timecodeDriftPpm = driftPpm;
+		timecodeStartMicros = ofGetElapsedTimeMicros();
+		lastTimecodeFrame = -1;
+	}
+
+	std::vector<DeliveryLatency> Emulator::getDeliveryLatencies() {
+		std::vector<DeliveryLatency> report;
+		std::vector<uint32_t> sorted;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& it : sessions) {
+			const Session& session = it.second;
+			DeliveryLatency latency;
+			latency.sessionId = session.sessionId;
+			latency.packets = session.acknowledged;
+			if (!session.latencies.empty()) {
+				sorted = session.latencies;
+				std::sort(sorted.begin(), sorted.end());
+				latency.p50 = sorted[sorted.size() / 2];
+				latency.p90 = sorted[sorted.size() * 90 / 100];
+				latency.p99 = sorted[sorted.size() * 99 / 100];
+				latency.max = sorted.back();
+			}
+			report.push_back(latency);
+		}
+		std::sort(report.begin(), report.end(), [](const DeliveryLatency& a, const DeliveryLatency& b) { return a.sessionId < b.sessionId; });
+		return report;
+	}
+
+	void Emulator::resetDeliveryLatencies() {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto& it : sessions) {
+			it.second.latencies.clear();
+			it.second.acknowledged = 0;
+		}
+	}
+
+	void Emulator::threadedFunction() {
+		uint8_t buffer[kMaxPacketSize];
+		uint64_t lastHousekeepingMillis = 0;
+		bool fineTimers = false;	// paced dump or storm running, both want millisecond ticks
+
+		while (isThreadRunning()) {
+			pollfd pfd = { sock, POLLIN, 0 };
+			poll(&pfd, 1, fineTimers ? 1 : 10);
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			// With many clients the acks of one broadcast arrive together
+			for (int n = 0; n < kMaxDatagramsPerRound; n++) {
+				sockaddr_in from;
+				socklen_t fromSize = sizeof(from);
+				ssize_t size = recvfrom(sock, buffer, sizeof(buffer), MSG_DONTWAIT, (sockaddr*)&from, &fromSize);
+				if (size <= 0) break;
+				handleDatagram(from, buffer, (size_t)size);
+			}
+
+			runStorm(ofGetElapsedTimeMicros());
+			runTimecode(ofGetElapsedTimeMicros());
+
+			// The timers have millisecond resolution, no need to walk every session more often
+			uint64_t now = ofGetElapsedTimeMillis();
+			if (now != lastHousekeepingMillis) {
+				housekeeping(now);
+				lastHousekeepingMillis = now;
+			}
+			fineTimers = packetIntervalMillis || timecodeEnabled || storm.transitionRate > 0 || storm.levelRate > 0 || storm.cutRate > 0;
+		}
+	}
+
+	void Emulator::housekeeping(uint64_t now) {
+		// Retransmits, keep-alives and expiry of silent clients
+		for (auto it = sessions.begin(); it != sessions.end();) {
+			Session& session = it->second;
+			if (now - session.lastReceivedMillis > kSessionTimeoutMillis) {
+				releaseSession(session);
+				it = sessions.erase(it);
+				continue;
+			}
+			for (size_t i = 0; i < session.inFlight; i++) {
+				if (now - session.outgoing[i].sentMillis >= kRetransmitMillis) retransmit(session, session.outgoing[i], now);
+			}
+			if (packetIntervalMillis) sendQueued(session);
+			if (session.synced && session.outgoing.empty() && now - session.lastSentMillis > kKeepAliveIntervalMillis) {
+				PacketWriter keepAlive;
+				sendRecords(session, keepAlive);
+			}
+			++it;
+		}
+	}
+
+	void Emulator::runStorm(uint64_t nowMicros) {
+		// Due when the deadline passed; a late round is not made up for
+		auto due = [nowMicros](uint64_t& next, float rate) {
+			if (rate <= 0 || nowMicros < next) return false;
+			uint64_t interval = uint64_t(1e6f / rate);
+			next = next && next + interval > nowMicros ? next + interval : nowMicros + interval;
+			return true;
+		};
+		uint8_t payload[kSourceLevelsSize];
+
+		// All MEs move in one packet, like a lever ride on the hardware
+		if (due(nextTransitionMicros, storm.transitionRate)) {
+			uint32_t steps = std::max(2u, uint32_t(storm.transitionRate * kStormTransitionMicros / 1e6f));
+			uint32_t step = transitionStep++ % steps;
+			PacketWriter records;
+			for (int me = 0; me < topology.mixEffectBlocks && records.fits(kTransitionPositionSize); me++) {
+				TransitionPosition pos;
+				pos.me = uint8_t(me);
+				pos.inTransition = step != 0;
+				pos.position = uint16_t(step * 10000 / steps);
+				pos.framesRemaining = uint8_t((steps - step) * 30 / steps);
+				encode(pos, payload);
+				records.appendRecord(state::kTransitionPosition, payload, kTransitionPositionSize);
+				stormRecords++;
+			}
+			broadcast(records);
+		}
+
+		if (due(nextLevelMicros, storm.levelRate)) {
+			levelStep++;
+			PacketWriter records;
+			for (size_t i = 0; i < inputs.size(); i++) {
+				if (inputs[i].internalPortType != kPortExternal) continue;
+				if (!records.fits(kSourceLevelsSize)) {
+					broadcast(records);
+					records.reset();
+				}
+				SourceLevels levels;
+				levels.source = inputs[i].id;
+				levels.leftLevel = int16_t(-2000 - int((levelStep * 37 + i * 101) % 4000));
+				levels.rightLevel = int16_t(-2000 - int((levelStep * 53 + i * 101) % 4000));
+				levels.leftPeak = int16_t(std::max(levels.leftLevel, levels.rightLevel) + 300);
+				levels.rightPeak = levels.leftPeak;
+				encode(levels, payload);
+				records.appendRecord(state::kSourceLevels, payload, kSourceLevelsSize);
+				stormRecords++;
+			}
+			if (!records.empty()) broadcast(records);
+		}
+
+		if (due(nextCutMicros, storm.cutRate) && !programInputs.empty()) {
+			std::swap(programInputs[0], previewInputs[0]);
+			PacketWriter records;
+			encode(InputSelection{ 0, programInputs[0] }, payload);
+			records.appendRecord(state::kProgramInput, payload, kInputSelectionSize);
+			encode(InputSelection{ 0, previewInputs[0] }, payload);
+			records.appendRecord(state::kPreviewInput, payload, kInputSelectionSize);
+			stormRecords += 2;
+			broadcast(records);
+		}
+	}
+
+	void Emulator::runTimecode(uint64_t nowMicros) {
+		FrameRate rate = frameRateOfVideoMode(topology.videoMode);
+		if (!timecodeEnabled || !rate.isValid()) return;
+
+		// 29.97 and 59.94 count in drop-frame timecode, like the hardware
+		bool dropFrame = rate.denominator == 1001 && rate.timecodeBase() % 30 == 0;
+		double elapsed = double(nowMicros - timecodeStartMicros) * (1 + timecodeDriftPpm * 1e-6);
+		int64_t frame = timecodeToFrame(Timecode{ 10, 0, 0, 0, dropFrame }, rate) + int64_t(elapsed * rate.numerator / (rate.denominator * 1e6));
+		if (frame == lastTimecodeFrame) return;
+		lastTimecodeFrame = frame;
+
+		uint8_t payload[kTimecodeSize];
+		encode(frameToTimecode(frame, rate, dropFrame), payload);
+		broadcast(state::kTimecode, payload, kTimecodeSize);
+		timecodes++;
+	}
+
+	void Emulator::handleDatagram(const sockaddr_in& from, const uint8_t* data, size_t size) {
+		PacketHeader header;
+		if (!readHeader(data, size, header)) return;
+
+		uint64_t key = sessionKey(from);
+
+		if (header.flags & kFlagHello) {
+			Session session;
+			session.address = from;
+			session.sessionId = nextSessionId;
+			session.lastReceivedMillis = ofGetElapsedTimeMillis();
+			nextSessionId = nextSessionId == 0xffff ? 0x8001 : nextSessionId + 1;
+			sessions[key] = session;
+
+			PacketHeader reply;
+			reply.flags = kFlagHello;
+			reply.length = uint16_t(kHeaderSize + kHelloPayloadSize);
+			reply.sessionId = header.sessionId;
+			uint8_t payload[kHelloPayloadSize] = { kHelloAccepted, 0, 0, 0, 0, 0, 0, 0 };
+			sendPacket(from, reply, payload, sizeof(payload));
+			return;
+		}
+
+		auto it = sessions.find(key);
+		if (it == sessions.end()) return;
+
+		Session& session = it->second;
+		session.lastReceivedMillis = ofGetElapsedTimeMillis();
+
+		// The ack of the hello reply starts the state dump
+		if (!session.synced && (header.flags & kFlagAck)) {
+			sendStateDump(session);
+			session.synced = true;
+			return;
+		}
+
+		// Incoming loss starts after the handshake, the client does not retry its final ack
+		if (dropPacket()) return;
+
+		if (header.flags & kFlagAck) handleAck(session, header.ackId);
+
+		if (header.flags & kFlagRequestResend) {
+			for (size_t i = 0; i < session.inFlight; i++) {
+				if (session.outgoing[i].header.packetId == header.resendId) retransmit(session, session.outgoing[i], ofGetElapsedTimeMillis());
+			}
+		}
+
+		if (header.flags & kFlagAckRequest) {
+			if (header.packetId == nextPacketId(session.remotePacketId)) {
+				handleCommands(session, data, header.length);
+				session.remotePacketId = header.packetId;
+
+				for (auto early = session.earlyPackets.find(nextPacketId(session.remotePacketId)); early != session.earlyPackets.end();
+					early = session.earlyPackets.find(nextPacketId(session.remotePacketId))) {
+					handleCommands(session, early->second.data(), early->second.size());
+					session.remotePacketId = early->first;
+					session.earlyPackets.erase(early);
+				}
+			} else if (isNewer(header.packetId, session.remotePacketId)) {
+				session.earlyPackets[header.packetId].assign(data, data + header.length);
+
+				PacketHeader request;
+				request.flags = kFlagRequestResend;
+				request.length = uint16_t(kHeaderSize);
+				request.sessionId = session.sessionId;
+				request.resendId = nextPacketId(session.remotePacketId);
+				sendPacket(from, request, nullptr, 0);
+			}
+
+			// Cumulative, like the hardware
+			PacketHeader ack;
+			ack.flags = kFlagAck;
+			ack.length = uint16_t(kHeaderSize);
+			ack.sessionId = session.sessionId;
+			ack.ackId = session.remotePacketId;
+			sendPacket(from, ack, nullptr, 0);
+		}
+	}
+
+	void Emulator::handleCommands(Session& session, const uint8_t* data, size_t size) {
+		// Client heartbeats are empty, only command packets count
+		if (size <= kHeaderSize) return;
+		receivedPackets++;
+
+		RecordReader reader(data + kHeaderSize, size - kHeaderSize);
+		uint32_t name;
+		const uint8_t* payload;
+		size_t payloadSize;
+		while (reader.next(name, payload, payloadSize)) {
+			handleCommand(session, name, payload, payloadSize);
+		}
+	}
+
+	void Emulator::handleAck(Session& session, uint16_t ackId) {
+		uint64_t now = ofGetElapsedTimeMicros();
+		while (session.inFlight > 0 && !isNewer(session.outgoing.front().header.packetId, ackId)) {
+			uint32_t latency = uint32_t(std::min<uint64_t>(now - session.outgoing.front().queuedMicros, UINT32_MAX));
+			if (session.latencies.size() < kMaxLatencySamples) {
+				session.latencies.push_back(latency);
+			} else {
+				session.latencies[session.acknowledged % kMaxLatencySamples] = latency;
+			}
+			session.acknowledged++;
+			session.outgoing.pop_front();
+			session.inFlight--;
+		}
+		sendQueued(session);
+	}
+
+	void Emulator::retransmit(Session& session, OutgoingPacket& sent, uint64_t now) {
+		sent.header.flags |= kFlagResend;
+		sent.packet.finish(sent.header);
+		sent.sentMillis = now;
+		retransmits++;
+		sendDatagram(session.address, sent.packet.data(), sent.packet.size());
+	}
+
+	void Emulator::handleCommand(Session& session, uint32_t name, const uint8_t* payload, size_t size) {
+		receivedCommands++;
+
+		InputSelection sel;
+		uint8_t out[kInputSelectionSize];
+
+		if (name == command::kProgramInput && decode(payload, size, sel) && sel.me < programInputs.size()) {
+			programInputs[sel.me] = sel.source;
+			encode(sel, out);
+			broadcast(state::kProgramInput, out, sizeof(out));
+		} else if (name == command::kPreviewInput && decode(payload, size, sel) && sel.me < previewInputs.size()) {
+			previewInputs[sel.me] = sel.source;
+			encode(sel, out);
+			broadcast(state::kPreviewInput, out, sizeof(out));
+		} else if ((name == command::kCut || name == command::kAuto) && size >= 1 && payload[0] < programInputs.size()) {
+			uint8_t me = payload[0];
+			std::swap(programInputs[me], previewInputs[me]);
+			encode(InputSelection{ me, programInputs[me] }, out);
+			broadcast(state::kProgramInput, out, sizeof(out));
+			encode(InputSelection{ me, previewInputs[me] }, out);
+			broadcast(state::kPreviewInput, out, sizeof(out));
+		} else if (name == command::kKeyerOnAir) {
+			KeyerOnAir key;
+			if (!decode(payload, size, key) || key.me >= keyersOnAir.size() || key.keyer >= keyersOnAir[key.me].size()) return;
+			keyersOnAir[key.me][key.keyer] = key.onAir;
+			uint8_t keyOut[kKeyerOnAirSize];
+			encode(key, keyOut);
+			broadcast(state::kKeyerOnAir, keyOut, sizeof(keyOut));
+		} else if (name == command::kAuxSource) {
+			AuxSource aux;
+			if (!decodeCommand(payload, size, aux) || aux.aux >= auxSources.size()) return;
+			auxSources[aux.aux] = aux.source;
+			uint8_t auxOut[kAuxSourceSize];
+			encode(aux, auxOut);
+			broadcast(state::kAuxSource, auxOut, sizeof(auxOut));
+		} else {
+			handleTransferCommand(session, name, payload, size);
+		}
+	}
+
+	void Emulator::handleTransferCommand(Session& session, uint32_t name, const uint8_t* payload, size_t size) {
+		uint32_t sessionBits = uint32_t(session.sessionId) << 16;
+
+		if (name == command::kTransferData) {
+			TransferData chunk;
+			if (!decode(payload, size, chunk)) return;
+			auto it = uploads.find(sessionBits | chunk.transferId);
+			if (it == uploads.end()) return;
+			Upload& upload = it->second;
+			upload.data.insert(upload.data.end(), chunk.data, chunk.data + std::min<size_t>(chunk.size, upload.size - upload.data.size()));
+
+			// More credit before the client runs out
+			if (++upload.chunksSinceCredit >= kTransferChunkCredit / 2) {
+				upload.chunksSinceCredit = 0;
+				uint8_t out[kTransferCreditSize];
+				encode(TransferCredit{ chunk.transferId, uint16_t(kMaxTransferChunkSize), kTransferChunkCredit }, out);
+				sendRecord(session, state::kTransferCredit, out, sizeof(out));
+			}
+		} else if (name == command::kStoreLock) {
+			StoreLock lock;
+			if (!decode(payload, size, lock)) return;
+			auto holder = storeLocks.find(lock.storeId);
+			uint8_t out[kStoreLockSize];
+			if (lock.locked) {
+				if (holder != storeLocks.end() && holder->second != session.sessionId) return;
+				storeLocks[lock.storeId] = session.sessionId;
+				encode(lock, out);
+				sendRecord(session, state::kLockObtained, out, sizeof(out));
+			} else {
+				if (holder == storeLocks.end() || holder->second != session.sessionId) return;
+				storeLocks.erase(holder);
+				// Unfinished uploads into the store are abandoned with it
+				for (auto it = uploads.begin(); it != uploads.end();) {
+					if ((it->first & 0xffff0000) == sessionBits && it->second.storeId == lock.storeId) it = uploads.erase(it);
+					else ++it;
+				}
+				encode(lock, out);
+			}
+			broadcast(state::kLockState, out, sizeof(out));
+		} else if (name == command::kTransferRequest) {
+			TransferRequest request;
+			if (!decode(payload, size, request)) return;
+			auto holder = storeLocks.find(request.storeId);
+			if (holder == storeLocks.end() || holder->second != session.sessionId) {
+				sendTransferStatus(session, request.transferId, kTransferErrorNotLocked);
+				return;
+			}
+			bool stills = request.storeId == kStillsStoreId;
+			if (request.mode != kTransferModeWrite || request.size == 0 || request.size > kMaxUploadSize ||
+				(stills && request.slot >= topology.stills) || (!stills && request.storeId > topology.clips)) {
+				sendTransferStatus(session, request.transferId, kTransferErrorNotFound);
+				return;
+			}
+
+			Upload& upload = uploads[sessionBits | request.transferId] = Upload();
+			upload.storeId = request.storeId;
+			upload.slot = request.slot;
+			upload.size = request.size;
+			upload.data.reserve(request.size);
+			uint8_t out[kTransferCreditSize];
+			encode(TransferCredit{ request.transferId, uint16_t(kMaxTransferChunkSize), kTransferChunkCredit }, out);
+			sendRecord(session, state::kTransferCredit, out, sizeof(out));
+		} else if (name == command::kTransferDescription) {
+			TransferDescription description;
+			if (!decode(payload, size, description)) return;
+			auto it = uploads.find(sessionBits | description.transferId);
+			if (it == uploads.end()) return;
+
+			uint8_t digest[16];
+			md5(it->second.data.data(), it->second.data.size(), digest);
+			bool intact = it->second.data.size() == it->second.size && memcmp(digest, description.md5, sizeof(digest)) == 0;
+			if (intact) {
+				completedTransfers++;
+				uploadedBytes += it->second.size;
+			}
+			sendTransferStatus(session, description.transferId, intact ? kTransferErrorNone : kTransferErrorCorrupt);
+			uploads.erase(it);
+		}
+	}
+
+	void Emulator::sendTransferStatus(Session& session, uint16_t transferId, uint8_t error) {
+		if (error != kTransferErrorNone) failedTransfers++;
+		uint8_t out[kTransferStatusSize];
+		encode(TransferStatus{ transferId, error }, out);
+		sendRecord(session, error == kTransferErrorNone ? state::kTransferComplete : state::kTransferError, out, sizeof(out));
+	}
+
+	void Emulator::releaseSession(Session& session) {
+		uint32_t sessionBits = uint32_t(session.sessionId) << 16;
+		for (auto it = uploads.begin(); it != uploads.end();) {
+			if ((it->first & 0xffff0000) == sessionBits) it = uploads.erase(it);
+			else ++it;
+		}
+		for (auto it = storeLocks.begin(); it != storeLocks.end();) {
+			if (it->second != session.sessionId) {
+				++it;
+				continue;
+			}
+			uint8_t out[kStoreLockSize];
+			encode(StoreLock{ it->first, false }, out);
+			it = storeLocks.erase(it);
+			broadcast(state::kLockState, out, sizeof(out));
+		}
+	}
+
+	void Emulator::sendStateDump(Session& session) {
+		PacketWriter records;
+		uint8_t payload[kProductNameSize];
+
+		auto flushIfFull = [&](size_t next) {
+			if (!records.fits(next)) {
+				sendRecords(session, records);
+				records.reset();
+			}
+		};
+
+		encode(Version{ 2, 30 }, payload);
+		records.appendRecord(state::kVersion, payload, kVersionSize);
+		encode(topology.productName, payload);
+		records.appendRecord(state::kProductName, payload, kProductNameSize);
+
+		Topology top;
+		top.mixEffectBlocks = uint8_t(topology.mixEffectBlocks);
+		top.sources = uint8_t(inputs.size());
+		top.downstreamKeyers = uint8_t(topology.downstreamKeyers);
+		top.auxOutputs = uint8_t(topology.auxOutputs);
+		top.mediaPlayers = uint8_t(topology.mediaPlayers);
+		top.superSources = uint8_t(topology.superSources);
+		encode(top, payload);
+		records.appendRecord(state::kTopology, payload, kTopologySize);
+
+		for (int i = 0; i < topology.mixEffectBlocks; i++) {
+			encode(MixEffectConfig{ uint8_t(i), uint8_t(topology.keyersPerMixEffectBlock) }, payload);
+			records.appendRecord(state::kMixEffectConfig, payload, kMixEffectConfigSize);
+		}
+		encode(MediaPoolConfig{ uint8_t(topology.stills), uint8_t(topology.clips) }, payload);
+		records.appendRecord(state::kMediaPoolConfig, payload, kMediaPoolConfigSize);
+		encode(VideoMode{ topology.videoMode }, payload);
+		records.appendRecord(state::kVideoMode, payload, kVideoModeSize);
+
+		for (auto& input : inputs) {
+			flushIfFull(kInputPropertiesSize);
+			encode(input, payload);
+			records.appendRecord(state::kInputProperties, payload, kInputPropertiesSize);
+		}
+
+		for (int i = 0; i < topology.mixEffectBlocks; i++) {
+			flushIfFull(kInputSelectionSize * 2 + kTransitionPositionSize + kRecordHeaderSize * 2);
+			encode(InputSelection{ uint8_t(i), programInputs[i] }, payload);
+			records.appendRecord(state::kProgramInput, payload, kInputSelectionSize);
+			encode(InputSelection{ uint8_t(i), previewInputs[i] }, payload);
+			records.appendRecord(state::kPreviewInput, payload, kInputSelectionSize);
+			TransitionPosition pos;
+			pos.me = uint8_t(i);
+			encode(pos, payload);
+			records.appendRecord(state::kTransitionPosition, payload, kTransitionPositionSize);
+
+			for (int k = 0; k < (int)keyersOnAir[i].size(); k++) {
+				flushIfFull(kKeyerOnAirSize);
+				encode(KeyerOnAir{ uint8_t(i), uint8_t(k), keyersOnAir[i][k] }, payload);
+				records.appendRecord(state::kKeyerOnAir, payload, kKeyerOnAirSize);
+			}
+		}
+
+		for (int i = 0; i < (int)auxSources.size(); i++) {
+			flushIfFull(kAuxSourceSize);
+			encode(AuxSource{ uint8_t(i), auxSources[i] }, payload);
+			records.appendRecord(state::kAuxSource, payload, kAuxSourceSize);
+		}
+
+		flushIfFull(kInitCompleteSize);
+		memset(payload, 0, kInitCompleteSize);
+		records.appendRecord(state::kInitComplete, payload, kInitCompleteSize);
+		sendRecords(session, records);
+	}
+
+	void Emulator::broadcast(uint32_t name, const uint8_t* payload, size_t size) {
+		for (auto& it : sessions) {
+			if (it.second.synced) sendRecord(it.second, name, payload, size);
+		}
+	}
+
+	void Emulator::broadcast(const PacketWriter& records) {
+		for (auto& it : sessions) {
+			if (it.second.synced) sendRecords(it.second, records);
+		}
+	}
+
+	void Emulator::sendRecords(Session& session, const PacketWriter& records) {
+		session.outgoing.emplace_back();
+		session.outgoing.back().packet = records;
+		session.outgoing.back().queuedMicros = ofGetElapsedTimeMicros();
+		sendQueued(session);
+	}
+
+	void Emulator::sendRecord(Session& session, uint32_t name, const uint8_t* payload, size_t size) {
+		// Join the last queued packet if there is one with room left
+		if (session.outgoing.size() == session.inFlight || !session.outgoing.back().packet.fits(size)) {
+			session.outgoing.emplace_back();
+			session.outgoing.back().queuedMicros = ofGetElapsedTimeMicros();
+		}
+		session.outgoing.back().packet.appendRecord(name, payload, size);
+		sendQueued(session);
+	}
+
+	void Emulator::sendQueued(Session& session) {
+		uint64_t now = ofGetElapsedTimeMillis();
+		while (session.inFlight < session.outgoing.size() && session.inFlight < kSendWindowSize) {
+			if (packetIntervalMillis && now < session.nextSendMillis) break;
+			session.nextSendMillis = now + packetIntervalMillis;
+
+			OutgoingPacket& next = session.outgoing[session.inFlight++];
+			next.header.flags = kFlagAckRequest;
+			next.header.sessionId = session.sessionId;
+			next.header.packetId = session.localPacketId = nextPacketId(session.localPacketId);
+			next.packet.finish(next.header);
+			next.sentMillis = now;
+			session.lastSentMillis = now;
+			sendDatagram(session.address, next.packet.data(), next.packet.size());
+		}
+	}
+
+	void Emulator::sendPacket(const sockaddr_in& to, const PacketHeader& header, const uint8_t* payload, size_t size) {
+		uint8_t packet[kMaxPacketSize];
+		writeHeader(packet, header);
+		if (size) memcpy(packet + kHeaderSize, payload, size);
+		sendDatagram(to, packet, kHeaderSize + size);
+	}
+
+	void Emulator::sendDatagram(const sockaddr_in& to, const uint8_t* data, size_t size) {
+		if (dropPacket()) return;
+		sendto(sock, data, size, 0, (const sockaddr*)&to, sizeof(to));
+	}
+
+	bool Emulator::dropPacket() {
+		if (lossRate <= 0 || uniform(random) >= lossRate) return false;
+		droppedPackets++;
+		return true;
+	}
+
+	uint64_t Emulator::sessionKey(const sockaddr_in& address) {
+		return (uint64_t(address.sin_addr.s_addr) << 16) | address.sin_port;
+	}
+
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include "ofThread.h"
+
+#include "AtemProtocol.h"
+
+namespace ofxAtem {
+
+	// Shape of the emulated switcher
+	struct EmulatorTopology {
+		std::string productName = "ATEM Emulator";
+		int externalInputs = 4;
+		int mixEffectBlocks = 1;
+		int keyersPerMixEffectBlock = 1;
+		int downstreamKeyers = 1;
+		int auxOutputs = 1;
+		int mediaPlayers = 1;
+		int superSources = 0;
+		int stills = 20;
+		int clips = 2;
+		uint8_t videoMode = protocol::kVideoMode1080p50;	// a protocol::VideoModeId
+	};
+
+	// Traffic the emulator generates on its own, for load tests. Rates are per second, 0 is off.
+	struct EmulatorStorm {
+		float transitionRate = 0;	// transition position of every ME, e.g. 60 for a lever ride at frame rate
+		float levelRate = 0;	// meter of every external input
+		float cutRate = 0;	// program / preview swaps on mix effect block 0
+	};
+
+	// Delivery of the switcher's packets to one client, from queued until acknowledged,
+	// in microseconds. Covers the packets acknowledged since the last reset.
+	struct DeliveryLatency {
+		uint16_t sessionId = 0;
+		uint64_t packets = 0;
+		uint32_t p50 = 0;
+		uint32_t p90 = 0;
+		uint32_t p99 = 0;
+		uint32_t max = 0;
+	};
+
+	// Loopback ATEM switcher speaking the native control protocol.
+	// It answers the handshake with a full state dump, echoes program / preview, keyer and aux changes to
+	// every connected client like the hardware does and sends keep-alives, so Device can be
+	// exercised and measured without a switcher on the network.
+	// Delivery is reliable like on the hardware; setLossRate() drops datagrams at random
+	// to exercise the retransmission paths of both ends.
+	// For load tests it serves hundreds of sessions, generates event storms with setStorm() and
+	// reports per-client delivery latency with getDeliveryLatencies().
+	// Media pool uploads are accepted under a store lock, with chunk credit granted like the
+	// hardware does, and checked against the MD5 of their closing FTFD.
+	class Emulator : public ofThread {
+	public:
+		Emulator() {}
+		~Emulator();
+
+		bool start(const EmulatorTopology& topology = EmulatorTopology(), uint16_t port = protocol::kPort, const std::string& address = "127.0.0.1");
+		void stop();
+
+		const EmulatorTopology& getTopology() const { return topology; }
+		const std::vector<protocol::InputProperties>& getInputs() const { return inputs; }
+		size_t getSessionCount();
+
+		// Panel side changes, broadcast to every client
+		void setProgramInput(int me, uint16_t source);
+		void setPreviewInput(int me, uint16_t source);
+
+		// Sends count program changes back-to-back cycling through the inputs,
+		// for measuring event throughput on the client side
+		void sendProgramBurst(int me, int count);
+
+		// Fraction of datagrams, 0 - 1, dropped in each direction
+		void setLossRate(float rate);
+		// Minimum gap between packets to one client, to mimic how long a hardware state dump takes
+		void setPacketInterval(int millis);
+
+		// Starts, changes or (with a default EmulatorStorm) stops the generated traffic
+		void setStorm(const EmulatorStorm& storm);
+		const EmulatorStorm& getStorm() const { return storm; }
+
+		// Streams the timecode to every client at each frame of the video mode, counting from
+		// 10:00:00:00 on a frame clock that runs driftPpm fast (negative: slow) against the local one
+		void setTimecode(bool enable, double driftPpm = 0);
+
+		// One entry per connected client, ordered by session id
+		std::vector<DeliveryLatency> getDeliveryLatencies();
+		void resetDeliveryLatencies();
+
+		uint64_t getReceivedCommandCount() const { return receivedCommands; }
+		uint64_t getReceivedPacketCount() const { return receivedPackets; }
+		uint64_t getDroppedPacketCount() const { return droppedPackets; }
+		uint64_t getRetransmitCount() const { return retransmits; }
+		uint64_t getStormRecordCount() const { return stormRecords; }
+		uint64_t getTimecodeCount() const { return timecodes; }
+		// Media pool uploads stored, their bytes, and uploads refused or found corrupt
+		uint64_t getCompletedTransferCount() const { return completedTransfers; }
+		uint64_t getUploadedByteCount() const { return uploadedBytes; }
+		uint64_t getFailedTransferCount() const { return failedTransfers; }
+
+	private:
+		struct OutgoingPacket {
+			protocol::PacketHeader header;
+			protocol::PacketWriter packet;
+			uint64_t sentMillis = 0;
+			uint64_t queuedMicros = 0;
+		};
+
+		struct Session {
+			sockaddr_in address;
+			uint16_t sessionId = 0;
+			uint16_t localPacketId = 0;
+			bool synced = false;
+			uint64_t lastReceivedMillis = 0;
+			uint64_t lastSentMillis = 0;
+			uint64_t nextSendMillis = 0;
+
+			std::deque<OutgoingPacket> outgoing;	// the first inFlight are sent and unacknowledged, the rest queued
+			size_t inFlight = 0;
+			uint16_t remotePacketId = 0;	// last client packet handled in order
+			std::map<uint16_t, std::vector<uint8_t>> earlyPackets;	// client packets ahead of a lost one
+
+			std::vector<uint32_t> latencies;	// ring of the last kMaxLatencySamples, in microseconds
+			uint64_t acknowledged = 0;
+		};
+
+		// Media pool upload in progress, keyed by session and transfer id
+		struct Upload {
+			uint16_t storeId = 0;
+			uint16_t slot = 0;
+			uint32_t size = 0;
+			std::vector<uint8_t> data;
+			int chunksSinceCredit = 0;
+		};
+
+		void threadedFunction() override;
+		void housekeeping(uint64_t now);
+		void runStorm(uint64_t nowMicros);
+		void runTimecode(uint64_t nowMicros);
+
+		void buildInputs();
+		void handleDatagram(const sockaddr_in& from, const uint8_t* data, size_t size);
+		void handleCommands(Session& session, const uint8_t* data, size_t size);
+		void handleCommand(Session& session, uint32_t name, const uint8_t* payload, size_t size);
+		void handleTransferCommand(Session& session, uint32_t name, const uint8_t* payload, size_t size);
+		void sendTransferStatus(Session& session, uint16_t transferId, uint8_t error);
+		// Locks and uploads of a session that went away
+		void releaseSession(Session& session);
+		void handleAck(Session& session, uint16_t ackId);
+		void retransmit(Session& session, OutgoingPacket& sent, uint64_t now);
+
+		void sendStateDump(Session& session);
+		void broadcast(uint32_t name, const uint8_t* payload, size_t size);
+		void broadcast(const protocol::PacketWriter& records);
+		void sendRecords(Session& session, const protocol::PacketWriter& records);
+		void sendRecord(Session& session, uint32_t name, const uint8_t* payload, size_t size);
+		void sendQueued(Session& session);
+		void sendPacket(const sockaddr_in& to, const protocol::PacketHeader& header, const uint8_t* payload, size_t size);
+		void sendDatagram(const sockaddr_in& to, const uint8_t* data, size_t size);
+		bool dropPacket();
+
+		static uint64_t sessionKey(const sockaddr_in& address);
+
+		int sock = -1;
+		EmulatorTopology topology;
+		std::vector<protocol::InputProperties> inputs;
+		std::vector<uint16_t> programInputs;
+		std::vector<uint16_t> previewInputs;
+		std::vector<std::vector<bool>> keyersOnAir;	// per ME, per upstream keyer
+		std::vector<uint16_t> auxSources;
+		std::map<uint16_t, uint16_t> storeLocks;	// session id holding each locked store
+		std::map<uint32_t, Upload> uploads;
+
+		std::map<uint64_t, Session> sessions;
+		uint16_t nextSessionId = 0x8001;
+		float lossRate = 0;
+		uint64_t packetIntervalMillis = 0;
+		EmulatorStorm storm;
+		uint64_t nextTransitionMicros = 0;
+		uint64_t nextLevelMicros = 0;
+		uint64_t nextCutMicros = 0;
+		uint32_t transitionStep = 0;
+		uint32_t levelStep = 0;
+		bool timecodeEnabled = false;
+		double timecodeDriftPpm = 0;
+		uint64_t timecodeStartMicros = 0;
+		int64_t lastTimecodeFrame = -1;
+		std::mt19937 random;
+		std::uniform_real_distribution<float> uniform{ 0.f, 1.f };
+
+		std::atomic<uint64_t> receivedCommands{ 0 };
+		std::atomic<uint64_t> receivedPackets{ 0 };
+		std::atomic<uint64_t> droppedPackets{ 0 };
+		std::atomic<uint64_t> retransmits{ 0 };
+		std::atomic<uint64_t> stormRecords{ 0 };
+		std::atomic<uint64_t> timecodes{ 0 };
+		std::atomic<uint64_t> completedTransfers{ 0 };
+		std::atomic<uint64_t> uploadedBytes{ 0 };
+		std::atomic<uint64_t> failedTransfers{ 0 };
+	};
+
+}
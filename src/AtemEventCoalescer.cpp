@@ -0,0 +1,81 @@
+#include "AtemEventCoalescer.h"
+
+namespace ofxAtem {
+
+	EventCoalescer::EventCoalescer() {
+		for (auto& count : merged) count = 0;
+		for (auto& block : slots) block.fill(-1);
+		// A batch of a few frames' worth of records never allocates
+		pending.reserve(64);
+		batch.reserve(64);
+
+		setCoalesced(bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged, true);
+		setCoalesced(bmdSwitcherMixEffectBlockEventTypeTransitionFramesRemainingChanged, true);
+		setCoalesced(bmdSwitcherMixEffectBlockEventTypeFadeToBlackFramesRemainingChanged, true);
+	}
+
+	bool EventCoalescer::setCoalesced(BMDSwitcherMixEffectBlockEventType type, bool enable) {
+		int slot = typeSlot(type);
+		if (enable) {
+			if (slot >= 0) return true;
+			if (typeCount == kMaxTypes) return false;
+			types[typeCount++] = type;
+			return true;
+		}
+		if (slot < 0) return true;
+
+		// The last type takes the place of the removed one, its pending events and counter too
+		clear();
+		typeCount--;
+		types[slot] = types[typeCount];
+		merged[slot] = merged[typeCount].load();
+		merged[typeCount] = 0;
+		return true;
+	}
+
+	void EventCoalescer::add(const MixEffectEvent& e) {
+		// Only this thread writes the counters, no need for a locked increment
+		received.store(received.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		int type = e.me >= 0 && e.me < kMaxMixEffectBlocks ? typeSlot(e.type) : -1;
+		if (type < 0) {
+			pending.push_back(e);
+			return;
+		}
+
+		int& slot = slots[e.me][type];
+		if (slot >= 0) {
+			merged[type].store(merged[type].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return;
+		}
+		slot = (int)pending.size();
+		pending.push_back(e);
+	}
+
+	void EventCoalescer::clear() {
+		pending.clear();
+		resetSlots();
+	}
+
+	uint64_t EventCoalescer::getMergedCount() const {
+		uint64_t count = 0;
+		for (auto& m : merged) count += m;
+		return count;
+	}
+
+	uint64_t EventCoalescer::getMergedCount(BMDSwitcherMixEffectBlockEventType type) const {
+		int slot = typeSlot(type);
+		return slot < 0 ? 0 : merged[slot].load();
+	}
+
+	int EventCoalescer::typeSlot(BMDSwitcherMixEffectBlockEventType type) const {
+		for (int i = 0; i < typeCount; i++) {
+			if (types[i] == type) return i;
+		}
+		return -1;
+	}
+
+	void EventCoalescer::resetSlots() {
+		for (auto& block : slots) block.fill(-1);
+	}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "AtemTypes.h"
+
+namespace ofxAtem {
+
+	// Collects the mix effect block events a backend hands over in one go, merging the high-rate
+	// ones. A coalesced type keeps one event per block until the next drain(), in the place the
+	// first one arrived; the device reads the block's state when it gets it, so the listeners see
+	// the latest value once per drain instead of once per switcher notification.
+	// By default that is the transition position and frames remaining, and the fade to black
+	// frames remaining, which come every frame during a transition.
+	//
+	// Fed and drained on the thread delivering events, the counters can be read from any.
+	class EventCoalescer {
+	public:
+		// Blocks past this are delivered as they come
+		static const int kMaxMixEffectBlocks = 4;
+		static const int kMaxTypes = 8;
+
+		EventCoalescer();
+
+		// Merge events of type, or deliver every one of them. Call before connect().
+		// False if kMaxTypes types are coalesced already.
+		bool setCoalesced(BMDSwitcherMixEffectBlockEventType type, bool enable);
+		bool isCoalesced(BMDSwitcherMixEffectBlockEventType type) const { return typeSlot(type) >= 0; }
+
+		void add(const MixEffectEvent& e);
+		// Hands the events to handler in order and starts a new batch. The handler may add events
+		// and drain again; those are delivered as a batch of their own once this one is done.
+		template<typename Handler>
+		void drain(Handler&& handler) {
+			if (draining) return;
+			draining = true;
+			while (!pending.empty()) {
+				batch.swap(pending);
+				resetSlots();
+				for (auto& e : batch) handler(e);
+				batch.clear();
+			}
+			draining = false;
+		}
+		void clear();
+		bool empty() const { return pending.empty(); }
+
+		// Events added, and merged into one already pending, since construction
+		uint64_t getReceivedCount() const { return received; }
+		uint64_t getMergedCount() const;
+		uint64_t getMergedCount(BMDSwitcherMixEffectBlockEventType type) const;
+
+	private:
+		// Index in types, -1 if type is not coalesced
+		int typeSlot(BMDSwitcherMixEffectBlockEventType type) const;
+		void resetSlots();
+
+		std::array<BMDSwitcherMixEffectBlockEventType, kMaxTypes> types;
+		int typeCount = 0;
+
+		std::vector<MixEffectEvent> pending;
+		std::vector<MixEffectEvent> batch;	// being drained
+		bool draining = false;
+		std::array<std::array<int, kMaxTypes>, kMaxMixEffectBlocks> slots;	// in pending per block and type, -1 if none
+
+		std::atomic<uint64_t> received{ 0 };
+		std::array<std::atomic<uint64_t>, kMaxTypes> merged;
+	};
+
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ofTypes.h"
+
+#include "AtemEventCoalescer.h"
+#include "AtemLinkMonitor.h"
+#include "AtemSwitcherClock.h"
+#include "AtemTypes.h"
+
+namespace ofxAtem {
+
+	// In-memory Device backend for tests and benchmarks.
+	// Commands apply immediately and are reported back to the device synchronously,
+	// like a switcher with zero latency: Device drains the events with deliver() right after
+	// each command and commit, as direct calls into the sink.
+	class FakeBackend {
+	public:
+		FakeBackend() { reset(4, 1); }
+
+		// Black, externalInputs cameras and color bars, every ME on camera 1 / camera 2
+		void reset(int externalInputs, int mixEffectBlocks) {
+			inputs.clear();
+			addInput(0, "Black", "BLK", "Black Video");
+			for (int i = 1; i <= externalInputs; i++) {
+				addInput(i, "Camera " + std::to_string(i), "CAM" + std::to_string(i), "External (HDMI)");
+			}
+			addInput(1000, "Color Bars", "BARS", "Color-Bars");
+
+			programInputs.assign(mixEffectBlocks, externalInputs > 0 ? 1 : 0);
+			previewInputs.assign(mixEffectBlocks, externalInputs > 1 ? 2 : programInputs[0]);
+			keyersOnAir.assign(mixEffectBlocks, std::vector<bool>(kKeyersPerMixEffectBlock, false));
+			auxSources.assign(kAuxOutputs, 0);
+		}
+
+		void setProductName(const std::string& name) { productName = name; }
+
+		template<typename Sink>
+		bool connect(const std::string&, Sink& sink) {
+			connected = true;
+			sink.onBackendConnected(true);
+			return true;
+		}
+
+		template<typename Sink>
+		void disconnect(Sink&) {
+			connected = false;
+			pendingEvents.clear();
+		}
+
+		void printInfo() {
+			printf(" %-40s %s\n", "Product Name:", productName.c_str());
+			printf(" %-40s %d\n", "Number of Mix Effect Blocks:", (int)programInputs.size());
+			for (auto& input : inputs) {
+				printf(" %-6lld %-24s %-8s %s\n", (long long)input.bmdId, input.longName.c_str(), input.shortName.c_str(), input.portType.c_str());
+			}
+		}
+
+		std::string getProductName() { return productName; }
+
+		bool readInputs(std::vector<ofPtr<Input>>& out) {
+			for (auto& input : inputs) {
+				out.push_back(std::make_shared<Input>(input));
+			}
+			return true;
+		}
+
+		bool setProgramInput(int me, BMDSwitcherInputId id) {
+			if (!connected || me < 0 || me >= (int)programInputs.size()) return false;
+			programInputs[me] = id;
+			send(me, bmdSwitcherMixEffectBlockEventTypeProgramInputChanged);
+			return true;
+		}
+
+		bool setPreviewInput(int me, BMDSwitcherInputId id) {
+			if (!connected || me < 0 || me >= (int)previewInputs.size()) return false;
+			previewInputs[me] = id;
+			send(me, bmdSwitcherMixEffectBlockEventTypePreviewInputChanged);
+			return true;
+		}
+
+		bool setKeyerOnAir(int me, int keyer, bool onAir) {
+			if (!connected || me < 0 || me >= (int)keyersOnAir.size() || keyer < 0 || keyer >= (int)keyersOnAir[me].size()) return false;
+			keyersOnAir[me][keyer] = onAir;
+			send(me, kKeyerOnAirChanged);
+			return true;
+		}
+
+		bool setAuxSource(int aux, BMDSwitcherInputId id) {
+			if (!connected || aux < 0 || aux >= (int)auxSources.size()) return false;
+			auxSources[aux] = id;
+			send();
+			return true;
+		}
+
+		// State changes apply at once, their events and the "datagram" go out on commit
+		void beginBatch() { batchDepth++; }
+
+		bool commitBatch() {
+			if (batchDepth == 0 || --batchDepth > 0) return true;
+			flush();
+			return true;
+		}
+
+		// Hands sink the events of the commands sent so far; those of an open batch wait for it
+		template<typename Sink>
+		void deliver(Sink& sink) {
+			if (batchDepth > 0) return;
+			pendingEvents.drain([&sink](MixEffectEvent& e) { sink.onMixEffectBlockUpdated(e); });
+		}
+
+		bool getProgramInput(int me, BMDSwitcherInputId& id) {
+			if (me < 0 || me >= (int)programInputs.size()) return false;
+			id = programInputs[me];
+			return true;
+		}
+
+		bool getPreviewInput(int me, BMDSwitcherInputId& id) {
+			if (me < 0 || me >= (int)previewInputs.size()) return false;
+			id = previewInputs[me];
+			return true;
+		}
+
+		// Cuts only, never in a transition
+		bool getTransition(int me, TransitionState& transition) {
+			if (me < 0 || me >= (int)programInputs.size()) return false;
+			transition = TransitionState();
+			return true;
+		}
+
+		bool getKeyersOnAir(int me, uint32_t& onAir) {
+			if (me < 0 || me >= (int)keyersOnAir.size()) return false;
+			onAir = 0;
+			for (int keyer = 0; keyer < (int)keyersOnAir[me].size(); keyer++) {
+				if (keyersOnAir[me][keyer]) onAir |= 1u << keyer;
+			}
+			return true;
+		}
+
+		int getMixEffectBlockCount() { return (int)programInputs.size(); }
+
+		bool getKeyerOnAir(int me, int keyer) const { return keyersOnAir[me][keyer]; }
+		BMDSwitcherInputId getAuxSource(int aux) const { return auxSources[aux]; }
+
+		// Nothing feeds it, tests add timecodes themselves
+		SwitcherClock& getClock() { return clock; }
+		// Never fed either, the fake link is always healthy
+		LinkMonitor& getLinkMonitor() { return link; }
+		// Merges the events of one batch, until deliver()
+		EventCoalescer& getEventCoalescer() { return pendingEvents; }
+
+		uint64_t getCommandCount() const { return commandCount; }
+		uint64_t getPacketCount() const { return packetCount; }
+
+	private:
+		static const int kKeyersPerMixEffectBlock = 4;
+		static const int kAuxOutputs = 6;
+
+		void addInput(BMDSwitcherInputId id, const std::string& longName, const std::string& shortName, const std::string& portType) {
+			Input input;
+			input.bmdId = id;
+			input.index = (int)inputs.size();
+			input.longName = longName;
+			input.shortName = shortName;
+			input.portType = portType;
+			inputs.push_back(input);
+		}
+
+		void send() {
+			commandCount++;
+			pendingCommands++;
+			if (batchDepth == 0) flush();
+		}
+
+		void send(int me, BMDSwitcherMixEffectBlockEventType type) {
+			pendingEvents.add({ me, type });
+			send();
+		}
+
+		void flush() {
+			if (pendingCommands == 0) return;
+			packetCount++;
+			pendingCommands = 0;
+		}
+
+		std::string productName = "ATEM Fake";
+		std::vector<Input> inputs;
+		std::vector<BMDSwitcherInputId> programInputs;
+		std::vector<BMDSwitcherInputId> previewInputs;
+		std::vector<std::vector<bool>> keyersOnAir;
+		std::vector<BMDSwitcherInputId> auxSources;
+		bool connected = false;
+		SwitcherClock clock;
+		LinkMonitor link;
+
+		int batchDepth = 0;
+		int pendingCommands = 0;
+		EventCoalescer pendingEvents;
+		uint64_t commandCount = 0;
+		uint64_t packetCount = 0;
+	};
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ofxAtem {
+namespace protocol {
+
+	// Perfect hash over a fixed set of four character record names, built at compile time.
+	// The slot of a name is the top Bits of name * seed; the constructor searches for a seed
+	// that gives every name its own slot, so a lookup is one multiply, one load and one compare,
+	// and a name outside the set falls through on that same compare.
+	template<size_t N, unsigned Bits>
+	class FourccDispatch {
+	public:
+		static constexpr size_t kSlots = size_t(1) << Bits;
+		static_assert(N <= kSlots, "More names than slots");
+
+		constexpr FourccDispatch(const uint32_t(&names)[N]) : seed(findSeed(names)), slotNames(), slotIndices() {
+			for (size_t s = 0; s < kSlots; s++) slotIndices[s] = -1;
+			for (size_t i = 0; i < N; i++) {
+				size_t s = slot(names[i], seed);
+				slotNames[s] = names[i];
+				slotIndices[s] = int8_t(i);
+			}
+		}
+
+		// Position of name in the list given to the constructor, -1 for any other name
+		constexpr int find(uint32_t name) const {
+			size_t s = slot(name, seed);
+			return slotNames[s] == name ? slotIndices[s] : -1;
+		}
+
+		// 0 if no seed was found, worth a static_assert next to the table
+		constexpr uint32_t getSeed() const { return seed; }
+
+	private:
+		static constexpr unsigned kMaxSeedAttempts = 4096;
+
+		static constexpr size_t slot(uint32_t name, uint32_t seed) { return size_t(uint32_t(name * seed) >> (32 - Bits)); }
+
+		static constexpr uint32_t findSeed(const uint32_t(&names)[N]) {
+			uint32_t seed = 0x9e3779b1u;	// odd multipliers only, starting from the golden ratio
+			for (unsigned attempt = 0; attempt < kMaxSeedAttempts; attempt++, seed += 2) {
+				bool used[kSlots] = {};
+				bool perfect = true;
+				for (size_t i = 0; i < N && perfect; i++) {
+					size_t s = slot(names[i], seed);
+					perfect = !used[s];
+					used[s] = true;
+				}
+				if (perfect) return seed;
+			}
+			return 0;
+		}
+
+		uint32_t seed;
+		uint32_t slotNames[kSlots];
+		int8_t slotIndices[kSlots];
+	};
+
+}
+}
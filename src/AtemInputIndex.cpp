@@ -0,0 +1,75 @@
+#include "AtemInputIndex.h"
+
+namespace ofxAtem {
+
+	void InputIndex::build(const std::vector<ofPtr<Input>>& inputs) {
+		this->inputs = &inputs;
+
+		// Long and short names share a table, so it holds twice as many keys as the id table
+		size_t size = 16;
+		while (size < inputs.size() * 4) size *= 2;
+		mask = size - 1;
+		ids.assign(size, IdSlot());
+		names.assign(size, NameSlot());
+
+		for (size_t i = 0; i < inputs.size(); i++) {
+			const Input& input = *inputs[i];
+			size_t slot = hashId(input.bmdId) & mask;
+			while (ids[slot].index >= 0 && ids[slot].id != input.bmdId) slot = (slot + 1) & mask;
+			if (ids[slot].index < 0) ids[slot] = IdSlot{ input.bmdId, int(i) };
+
+			insertName(input.longName, int(i));
+			insertName(input.shortName, int(i));
+		}
+	}
+
+	void InputIndex::clear() {
+		inputs = nullptr;
+		ids.clear();
+		names.clear();
+		mask = 0;
+	}
+
+	int InputIndex::findId(BMDSwitcherInputId id) const {
+		if (ids.empty()) return -1;
+		for (size_t slot = hashId(id) & mask; ids[slot].index >= 0; slot = (slot + 1) & mask) {
+			if (ids[slot].id == id) return ids[slot].index;
+		}
+		return -1;
+	}
+
+	int InputIndex::findName(const std::string& name) const {
+		if (names.empty()) return -1;
+		uint64_t hash = hashName(name);
+		for (size_t slot = hash & mask; names[slot].index >= 0; slot = (slot + 1) & mask) {
+			if (names[slot].hash != hash) continue;
+			const Input& input = *(*inputs)[names[slot].index];
+			if (input.longName == name || input.shortName == name) return names[slot].index;
+		}
+		return -1;
+	}
+
+	uint64_t InputIndex::hashId(BMDSwitcherInputId id) {
+		// Fibonacci hashing spreads the runs of neighbouring ids the switcher uses
+		return (uint64_t(id) * 0x9e3779b97f4a7c15ull) >> 32;
+	}
+
+	uint64_t InputIndex::hashName(const std::string& name) {
+		// FNV-1a
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (char c : name) {
+			hash ^= uint8_t(c);
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	void InputIndex::insertName(const std::string& name, int index) {
+		if (name.empty() || findName(name) >= 0) return;
+		uint64_t hash = hashName(name);
+		size_t slot = hash & mask;
+		while (names[slot].index >= 0) slot = (slot + 1) & mask;
+		names[slot] = NameSlot{ hash, index };
+	}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ofTypes.h"
+
+#include "AtemTypes.h"
+
+namespace ofxAtem {
+
+	// Constant time lookups into an input map, by switcher input id and by name.
+	// Both are open addressing tables at most half full, built along with the map; lookups
+	// probe a slot or two and never allocate.
+	class InputIndex {
+	public:
+		// Indexes inputs, which must outlive the index or be rebuilt with it
+		void build(const std::vector<ofPtr<Input>>& inputs);
+		void clear();
+
+		// Position in the input map, -1 if not in it
+		int findId(BMDSwitcherInputId id) const;
+		// Long or short name, exactly; the first input if several share it
+		int findName(const std::string& name) const;
+
+	private:
+		struct IdSlot {
+			BMDSwitcherInputId id = 0;
+			int index = -1;	// -1 if the slot is free
+		};
+
+		struct NameSlot {
+			uint64_t hash = 0;
+			int index = -1;
+		};
+
+		static uint64_t hashId(BMDSwitcherInputId id);
+		static uint64_t hashName(const std::string& name);
+		void insertName(const std::string& name, int index);
+
+		const std::vector<ofPtr<Input>>* inputs = nullptr;
+		std::vector<IdSlot> ids;
+		std::vector<NameSlot> names;
+		size_t mask = 0;	// both tables have mask + 1 slots
+	};
+
+}
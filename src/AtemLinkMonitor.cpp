@@ -0,0 +1,114 @@
+#include "AtemLinkMonitor.h"
+
+#include <algorithm>
+#include <bitset>
+
+namespace ofxAtem {
+
+	void LinkMonitor::setHeartbeat(int intervalMillis, int missThreshold) {
+		std::lock_guard<std::mutex> lock(mutex);
+		intervalMicros = uint64_t(std::max(intervalMillis, 1)) * 1000;
+		this->missThreshold = std::max(missThreshold, 1);
+	}
+
+	int LinkMonitor::getHeartbeatInterval() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return int(intervalMicros / 1000);
+	}
+
+	int LinkMonitor::getMissThreshold() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return missThreshold;
+	}
+
+	void LinkMonitor::reset(uint64_t now) {
+		std::lock_guard<std::mutex> lock(mutex);
+		lastHeardMicros = now;
+		heartbeatMicros = 0;
+		heartbeatPending = false;
+	}
+
+	bool LinkMonitor::heartbeatDue(uint64_t now) {
+		std::lock_guard<std::mutex> lock(mutex);
+		expireHeartbeat(now);
+		if (heartbeatPending || (heartbeatMicros && now - heartbeatMicros < intervalMicros)) return false;
+
+		heartbeatPending = true;
+		heartbeatMicros = now;
+		heartbeats++;
+		return true;
+	}
+
+	void LinkMonitor::onHeartbeatAnswered(uint64_t now) {
+		std::lock_guard<std::mutex> lock(mutex);
+		lastHeardMicros = std::max(lastHeardMicros, now);
+
+		// An answer after the heartbeat expired is already counted as lost
+		if (!heartbeatPending) return;
+		heartbeatPending = false;
+		addRtt(now - heartbeatMicros);
+		addOutcome(false);
+	}
+
+	void LinkMonitor::onDelivered(uint64_t rttMicros, bool retransmitted) {
+		std::lock_guard<std::mutex> lock(mutex);
+		// The round trip of a retransmitted command is ambiguous, it may be the ack of any attempt
+		if (!retransmitted) addRtt(rttMicros);
+		addOutcome(retransmitted);
+	}
+
+	void LinkMonitor::onHeard(uint64_t now) {
+		std::lock_guard<std::mutex> lock(mutex);
+		lastHeardMicros = std::max(lastHeardMicros, now);
+	}
+
+	LinkMonitor::Change LinkMonitor::update(uint64_t now) {
+		std::lock_guard<std::mutex> lock(mutex);
+		expireHeartbeat(now);
+		if (lastHeardMicros == 0) return kUnchanged;
+
+		bool silent = now > lastHeardMicros && now - lastHeardMicros >= intervalMicros * missThreshold;
+		if (silent == degraded) return kUnchanged;
+		degraded = silent;
+		if (!degraded) return kRestored;
+		degradations++;
+		return kDegraded;
+	}
+
+	ConnectionHealth LinkMonitor::getHealth(uint64_t now) {
+		std::lock_guard<std::mutex> lock(mutex);
+		ConnectionHealth health;
+		health.degraded = degraded;
+		if (lastHeardMicros && now > lastHeardMicros) health.silentMicros = now - lastHeardMicros;
+		health.rttMillis = smoothedRttMicros / 1000;
+		health.minRttMillis = minRttMicros / 1000;
+		if (outcomes) health.lossRate = double(std::bitset<kLossWindow>(lossBits).count()) / outcomes;
+		health.heartbeats = heartbeats;
+		health.missedHeartbeats = missedHeartbeats;
+		health.degradations = degradations;
+		return health;
+	}
+
+	void LinkMonitor::expireHeartbeat(uint64_t now) {
+		if (!heartbeatPending || now - heartbeatMicros < intervalMicros) return;
+		heartbeatPending = false;
+		missedHeartbeats++;
+		addOutcome(true);
+	}
+
+	void LinkMonitor::addOutcome(bool lost) {
+		lossBits = (lossBits << 1) | (lost ? 1 : 0);
+		outcomes = std::min(outcomes + 1, kLossWindow);
+	}
+
+	void LinkMonitor::addRtt(uint64_t micros) {
+		double rtt = double(micros);
+		if (smoothedRttMicros == 0) {
+			smoothedRttMicros = minRttMicros = rtt;
+			return;
+		}
+		smoothedRttMicros += kRttGain * (rtt - smoothedRttMicros);
+		minRttMicros = std::min(minRttMicros, rtt);
+	}
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace ofxAtem {
+
+	// How the link to the switcher is doing, as LinkMonitor sees it
+	struct ConnectionHealth {
+		bool degraded = false;	// the switcher missed the threshold of heartbeats
+		uint64_t silentMicros = 0;	// since the switcher was last heard
+		double rttMillis = 0;	// smoothed round trip of heartbeats, and commands where the backend tells
+		double minRttMillis = 0;
+		double lossRate = 0;	// of the last LinkMonitor::kLossWindow heartbeats and commands, 0 - 1
+		uint64_t heartbeats = 0;	// sent
+		uint64_t missedHeartbeats = 0;	// not answered within the heartbeat interval
+		uint64_t degradations = 0;	// times the link went degraded
+	};
+
+	// Active liveness check of the link to a switcher.
+	// The backend sends a heartbeat the switcher has to answer whenever heartbeatDue() says so and
+	// reports the answer, and anything else it hears. update() finds the link degraded once the
+	// switcher has been silent for missThreshold heartbeat intervals, 300 ms by default, long
+	// before the transport or the SDK gives up on it, and restored as soon as it is heard again.
+	// Round trips and losses of heartbeats, and of commands where the backend tells, make up the
+	// rest of ConnectionHealth.
+	//
+	// Times are ofGetElapsedTimeMicros(). Fed from the backend's thread, read from any.
+	class LinkMonitor {
+	public:
+		static constexpr size_t kLossWindow = 64;
+
+		enum Change {
+			kUnchanged,
+			kDegraded,
+			kRestored,
+		};
+
+		// Heartbeat period, and how many of them may go by without a word from the switcher
+		// (default 100 ms, 3)
+		void setHeartbeat(int intervalMillis, int missThreshold);
+		int getHeartbeatInterval();
+		int getMissThreshold();
+
+		// Starts timing the link afresh, on connect and reconnect. A degraded link stays so until
+		// the next update().
+		void reset(uint64_t now);
+
+		// True when a heartbeat should go out now, it is then taken as sent
+		bool heartbeatDue(uint64_t now);
+		// The switcher answered the last heartbeat sent
+		void onHeartbeatAnswered(uint64_t now);
+		// The switcher acknowledged a command rttMicros after it was first sent
+		void onDelivered(uint64_t rttMicros, bool retransmitted);
+		// Anything received from the switcher
+		void onHeard(uint64_t now);
+
+		// Call at least every heartbeat interval, the returned change is for the backend to report
+		Change update(uint64_t now);
+		// Same, reporting the change to sink's onLinkDegraded() or onLinkRestored()
+		template<typename Sink>
+		void update(uint64_t now, Sink& sink) {
+			Change change = update(now);
+			if (change == kUnchanged) return;
+			ConnectionHealth health = getHealth(now);
+			if (change == kDegraded) sink.onLinkDegraded(health);
+			else sink.onLinkRestored(health);
+		}
+		ConnectionHealth getHealth(uint64_t now);
+
+	private:
+		// Round trips are smoothed like TCP's
+		static constexpr double kRttGain = 0.125;
+
+		// The following expect mutex to be held
+		void expireHeartbeat(uint64_t now);
+		void addOutcome(bool lost);
+		void addRtt(uint64_t micros);
+
+		std::mutex mutex;
+		uint64_t intervalMicros = 100000;
+		int missThreshold = 3;
+
+		uint64_t lastHeardMicros = 0;	// 0 until reset()
+		uint64_t heartbeatMicros = 0;	// last heartbeat sent
+		bool heartbeatPending = false;
+		bool degraded = false;
+
+		double smoothedRttMicros = 0;
+		double minRttMicros = 0;
+		uint64_t lossBits = 0;	// one bit per outcome in the window, set if lost
+		size_t outcomes = 0;
+		uint64_t heartbeats = 0;
+		uint64_t missedHeartbeats = 0;
+		uint64_t degradations = 0;
+	};
+
+}
@@ -0,0 +1,283 @@
+#include "AtemMediaTransfer.h"
+
+#include <algorithm>
+
+#include "ofLog.h"
+#include "ofUtils.h"
+
+namespace ofxAtem {
+
+	using namespace protocol;
+
+	// An upload without any reply or ack for this long is given up on
+	static const uint64_t kStallTimeoutMillis = 5000;
+	// The client's retransmit timeout: further retransmits within it belong to the same loss
+	static const uint64_t kLossHoldMicros = 100000;
+	// Round trip allowed above twice the best one before chunks stop growing
+	static const uint64_t kRttSlackMicros = 1000;
+
+	void MediaTransfer::setWindow(int chunks) {
+		window = std::max(1, std::min(chunks, (int)UdpClient::kMaxPacketsInFlight));
+	}
+
+	void MediaTransfer::setChunkSize(size_t bytes) {
+		std::lock_guard<std::mutex> lock(mutex);
+		fixedChunkSize = bytes ? std::max(kMinChunkSize, std::min(bytes, kMaxTransferChunkSize)) : 0;
+	}
+
+	void MediaTransfer::setProgressCallback(ProgressCallback callback) {
+		// Waits for a call of the old one in progress on the client's thread
+		std::lock_guard<std::recursive_mutex> lock(callbackMutex);
+		progressCallback = callback;
+	}
+
+	bool MediaTransfer::uploadStill(int slot, std::vector<uint8_t> data, const std::string& name, const std::string& description) {
+		return start(kStillsStoreId, uint16_t(slot), data, name, description);
+	}
+
+	bool MediaTransfer::uploadClipFrame(int clip, int frame, std::vector<uint8_t> data) {
+		return start(clipStoreId(clip), uint16_t(frame), data, "", "");
+	}
+
+	bool MediaTransfer::start(uint16_t store, uint16_t slot, std::vector<uint8_t>& upload, const std::string& name, const std::string& text) {
+		if (upload.empty() || upload.size() > UINT32_MAX) {
+			ofLogError(__FUNCTION__) << "Invalid upload size " << upload.size();
+			return false;
+		}
+
+		// Hashed before taking the lock, a still takes a few milliseconds
+		TransferDescription closing;
+		strncpy(closing.name, name.c_str(), sizeof(closing.name) - 1);
+		strncpy(closing.description, text.c_str(), sizeof(closing.description) - 1);
+		md5(upload.data(), upload.size(), closing.md5);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stage != kIdle) {
+			ofLogError(__FUNCTION__) << "An upload is already running";
+			return false;
+		}
+		if (!client.isConnected() || client.isOffline()) {
+			ofLogError(__FUNCTION__) << "Not connected to a switcher";
+			return false;
+		}
+
+		transferId++;
+		storeId = store;
+		this->slot = slot;
+		data = std::move(upload);
+		description = closing;
+		description.transferId = transferId;
+
+		lastProgressMillis = ofGetElapsedTimeMillis();
+		startMicros = endMicros = 0;
+		lockObtained = completed = stored = false;
+		errorCode = -1;
+		totalBytes = data.size();
+		sentBytes = acknowledgedBytes = 0;
+		credit = 0;
+		inFlight.clear();
+		smoothedRttMicros = minRttMicros = 0;
+		ackedSinceResize = 0;
+		lastRetransmits = client.getRetransmitCount();
+		lossHoldMicros = 0;
+
+		if (!client.sendStoreLock(storeId, true)) {
+			ofLogError(__FUNCTION__) << "Could not request the media pool lock";
+			data.clear();
+			return false;
+		}
+		stage = kLocking;
+		busy = true;
+		return true;
+	}
+
+	void MediaTransfer::cancel() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stage == kIdle) return;
+		ofLogNotice(__FUNCTION__) << "Upload cancelled";
+		finish(false, "");
+	}
+
+	bool MediaTransfer::waitForCompletion(int timeoutMs) {
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return stage == kIdle; });
+		return stage == kIdle && stored;
+	}
+
+	TransferProgress MediaTransfer::getProgress() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return makeProgress(ofGetElapsedTimeMicros());
+	}
+
+	void MediaTransfer::handleRecord(uint32_t name, const uint8_t* payload, size_t size) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stage == kIdle) return;
+
+		switch (name) {
+		case state::kLockObtained: {
+			StoreLock obtained;
+			if (decode(payload, size, obtained) && obtained.storeId == storeId) lockObtained = true;
+			break;
+		}
+		case state::kTransferCredit: {
+			TransferCredit grant;
+			if (!decode(payload, size, grant) || grant.transferId != transferId) break;
+			credit = grant.chunkCount;
+			chunkLimit = grant.chunkSize ? std::min<size_t>(grant.chunkSize, kMaxTransferChunkSize) : kMaxTransferChunkSize;
+			if (stage == kRequesting) {
+				stage = kSending;
+				startMicros = ofGetElapsedTimeMicros();
+				chunkSize = chunkLimit;
+			}
+			chunkSize = std::min(fixedChunkSize ? fixedChunkSize : chunkSize, chunkLimit);
+			lastProgressMillis = ofGetElapsedTimeMillis();
+			break;
+		}
+		case state::kTransferComplete: {
+			TransferStatus status;
+			if (decode(payload, size, status) && status.transferId == transferId) completed = true;
+			break;
+		}
+		case state::kTransferError: {
+			TransferStatus status;
+			if (decode(payload, size, status) && status.transferId == transferId) errorCode = status.error;
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	void MediaTransfer::update() {
+		if (!busy) return;
+
+		bool notify = false;
+		TransferProgress progress;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stage == kIdle) return;
+			uint64_t now = ofGetElapsedTimeMicros();
+
+			if (client.isOffline()) {
+				finish(false, "the link to the switcher was lost");
+			} else if (errorCode >= 0) {
+				finish(false, "the switcher refused it with error " + ofToString(errorCode));
+			} else if (completed) {
+				acknowledgedBytes = totalBytes;
+				finish(true, "");
+			} else {
+				if (stage == kLocking && lockObtained) {
+					TransferRequest request;
+					request.transferId = transferId;
+					request.storeId = storeId;
+					request.slot = slot;
+					request.size = uint32_t(data.size());
+					if (client.sendTransferRequest(request)) stage = kRequesting;
+				}
+				if (stage == kSending || stage == kFinishing) acknowledgeChunks(now);
+				if (stage == kSending) {
+					adaptChunkSize(now);
+					sendChunks(now);
+					// Commands are delivered in order, the description lands behind the last chunk
+					if (sentBytes == data.size() && client.sendTransferDescription(description)) stage = kFinishing;
+				}
+				if (ofGetElapsedTimeMillis() - lastProgressMillis > kStallTimeoutMillis) finish(false, "it stalled");
+			}
+
+			if (progressPending) {
+				notify = true;
+				progress = makeProgress(now);
+			}
+			progressPending = false;
+		}
+		if (!notify) return;
+		std::lock_guard<std::recursive_mutex> lock(callbackMutex);
+		if (progressCallback) progressCallback(progress);
+	}
+
+	void MediaTransfer::acknowledgeChunks(uint64_t now) {
+		uint64_t acknowledged = client.getAcknowledgedPacketCount();
+		while (!inFlight.empty() && inFlight.front().sequence <= acknowledged) {
+			uint64_t rtt = now - inFlight.front().sentMicros;
+			smoothedRttMicros = smoothedRttMicros ? (7 * smoothedRttMicros + rtt) / 8 : rtt;
+			minRttMicros = minRttMicros ? std::min(minRttMicros, rtt) : rtt;
+
+			acknowledgedBytes += inFlight.front().size;
+			ackedSinceResize++;
+			inFlight.pop_front();
+			progressPending = true;
+			lastProgressMillis = ofGetElapsedTimeMillis();
+		}
+	}
+
+	void MediaTransfer::adaptChunkSize(uint64_t now) {
+		if (fixedChunkSize) return;
+
+		// Multiplicative decrease once per loss: smaller datagrams get through lossy or
+		// fragmenting links more often and cost less to send again
+		uint64_t retransmits = client.getRetransmitCount();
+		if (retransmits != lastRetransmits) {
+			lastRetransmits = retransmits;
+			if (now >= lossHoldMicros) {
+				chunkSize = std::max(kMinChunkSize, chunkSize / 2);
+				lossHoldMicros = now + kLossHoldMicros;
+				ackedSinceResize = 0;
+			}
+			return;
+		}
+
+		// Additive increase per clean window, unless the round trip shows the link queueing
+		if (ackedSinceResize >= window && now >= lossHoldMicros) {
+			ackedSinceResize = 0;
+			if (smoothedRttMicros <= 2 * minRttMicros + kRttSlackMicros) chunkSize = std::min(chunkLimit, chunkSize + kChunkSizeStep);
+		}
+	}
+
+	void MediaTransfer::sendChunks(uint64_t now) {
+		while (credit > 0 && (int)inFlight.size() < window && sentBytes < data.size()) {
+			// Leave room in the client's send window, it would drop a command that finds it full
+			if (client.getQueuedPacketCount() - client.getAcknowledgedPacketCount() >= UdpClient::kMaxPacketsInFlight) break;
+
+			size_t size = std::min(chunkSize, data.size() - sentBytes);
+			if (!client.sendTransferData(transferId, data.data() + sentBytes, size)) break;
+
+			SentChunk chunk;
+			chunk.size = size;
+			chunk.sequence = client.getQueuedPacketCount();
+			chunk.sentMicros = now;
+			inFlight.push_back(chunk);
+			sentBytes += size;
+			credit--;
+		}
+	}
+
+	void MediaTransfer::finish(bool success, const std::string& reason) {
+		if (!success && !reason.empty()) ofLogError(__FUNCTION__) << "Upload failed, " << reason;
+
+		client.sendStoreLock(storeId, false);
+		stage = kIdle;
+		stored = success;
+		endMicros = ofGetElapsedTimeMicros();
+		data.clear();
+		data.shrink_to_fit();
+		inFlight.clear();
+		progressPending = true;
+		busy = false;
+		doneCondition.notify_all();
+	}
+
+	TransferProgress MediaTransfer::makeProgress(uint64_t now) const {
+		TransferProgress progress;
+		progress.totalBytes = totalBytes;
+		progress.sentBytes = sentBytes;
+		progress.acknowledgedBytes = acknowledgedBytes;
+		progress.chunkSize = chunkSize;
+		progress.window = window;
+		if (startMicros) progress.elapsedMicros = (stage == kIdle ? endMicros : now) - startMicros;
+		if (progress.elapsedMicros) progress.megabytesPerSecond = double(acknowledgedBytes) / progress.elapsedMicros;
+		progress.finished = stage == kIdle && stored;
+		progress.failed = stage == kIdle && !stored && endMicros != 0;
+		return progress;
+	}
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "AtemProtocol.h"
+#include "AtemUdpClient.h"
+
+namespace ofxAtem {
+
+	// Where an upload stands, as handed to the progress callback
+	struct TransferProgress {
+		size_t totalBytes = 0;
+		size_t sentBytes = 0;
+		size_t acknowledgedBytes = 0;
+		size_t chunkSize = 0;	// payload of the chunks going out now
+		int window = 0;	// chunks allowed in flight
+		uint64_t elapsedMicros = 0;	// since the switcher accepted the upload
+		double megabytesPerSecond = 0;	// acknowledged bytes over elapsedMicros, 1 MB = 10^6 bytes
+		bool finished = false;	// stored by the switcher
+		bool failed = false;
+	};
+
+	// Uploads stills and clip frames to the media pool over a UdpClient.
+	// Chunks are pipelined: up to the configured window of them are in flight ahead of their
+	// acks, within the chunk credit the switcher grants and the client's send window, so a large
+	// still is bounded by the link rather than by one round trip per chunk. The chunk size starts
+	// at the switcher's limit, is halved when the client has to retransmit and grows back by
+	// kChunkSizeStep for each clean window of acks while the round trip is not building up.
+	//
+	// Uploads are started from any thread. The transfer itself runs on the thread driving the
+	// client: UdpBackend calls handleRecord() with its replies and update() after every service
+	// round, and the progress callback is called from there as acks come in.
+	class MediaTransfer {
+	public:
+		typedef std::function<void(const TransferProgress&)> ProgressCallback;
+
+		static constexpr size_t kMinChunkSize = 256;
+		static constexpr size_t kChunkSizeStep = 128;
+
+		explicit MediaTransfer(UdpClient& client) : client(client) {}
+
+		// Chunks sent ahead of their acks, 1 - UdpClient::kMaxPacketsInFlight (default 24)
+		void setWindow(int chunks);
+		int getWindow() const { return window; }
+		// Fixes the chunk size (bytes) instead of adapting it, 0 (the default) adapts
+		void setChunkSize(size_t bytes);
+		// Called on the thread driving the client, see above. Once this returns the previous
+		// callback is not running and will not be called again.
+		void setProgressCallback(ProgressCallback callback);
+
+		// Starts uploading data, e.g. a still encoded with the switcher's RLE, into a still slot or
+		// a frame of a clip. False if an upload is already running or the client is not connected.
+		bool uploadStill(int slot, std::vector<uint8_t> data, const std::string& name = "", const std::string& description = "");
+		bool uploadClipFrame(int clip, int frame, std::vector<uint8_t> data);
+		// Abandons the running upload and releases its lock
+		void cancel();
+
+		bool isBusy() const { return busy; }
+		// Blocks until the running upload finished or timeoutMs elapsed, true if it was stored
+		bool waitForCompletion(int timeoutMs);
+		TransferProgress getProgress();
+
+		// On the thread driving the client
+		void handleRecord(uint32_t name, const uint8_t* payload, size_t size);
+		void update();
+
+	private:
+		enum Stage {
+			kIdle,
+			kLocking,	// PLCK sent, waiting for LKOB
+			kRequesting,	// FTSD sent, waiting for the first FTCD
+			kSending,
+			kFinishing,	// FTFD sent, waiting for FTDC
+		};
+
+		struct SentChunk {
+			size_t size = 0;
+			uint64_t sequence = 0;	// acknowledged once the client's acknowledged count reaches it
+			uint64_t sentMicros = 0;
+		};
+
+		bool start(uint16_t storeId, uint16_t slot, std::vector<uint8_t>& data, const std::string& name, const std::string& description);
+		// The following expect mutex to be held
+		void acknowledgeChunks(uint64_t now);
+		void adaptChunkSize(uint64_t now);
+		void sendChunks(uint64_t now);
+		void finish(bool stored, const std::string& reason);
+		TransferProgress makeProgress(uint64_t now) const;
+
+		UdpClient& client;
+
+		std::mutex mutex;
+		std::condition_variable doneCondition;
+		std::recursive_mutex callbackMutex;	// held while progressCallback runs, it may set another
+		ProgressCallback progressCallback;
+		std::atomic<bool> busy{ false };
+		std::atomic<int> window{ 24 };
+		size_t fixedChunkSize = 0;
+
+		Stage stage = kIdle;
+		uint16_t transferId = 0;
+		uint16_t storeId = 0;
+		uint16_t slot = 0;
+		std::vector<uint8_t> data;	// released once the upload is over
+		protocol::TransferDescription description;
+		uint64_t lastProgressMillis = 0;	// for the stall timeout
+		uint64_t startMicros = 0;
+		uint64_t endMicros = 0;
+		// Replies seen by handleRecord(), acted upon by update()
+		bool lockObtained = false;
+		bool completed = false;
+		int errorCode = -1;
+		bool stored = false;
+		bool progressPending = false;
+
+		size_t totalBytes = 0;
+		size_t sentBytes = 0;
+		size_t acknowledgedBytes = 0;
+		int credit = 0;	// chunks the switcher still accepts
+		size_t chunkLimit = protocol::kMaxTransferChunkSize;
+		size_t chunkSize = protocol::kMaxTransferChunkSize;
+		std::deque<SentChunk> inFlight;
+
+		// Chunk size adaptation
+		uint64_t smoothedRttMicros = 0;
+		uint64_t minRttMicros = 0;
+		int ackedSinceResize = 0;
+		uint64_t lastRetransmits = 0;
+		uint64_t lossHoldMicros = 0;	// a loss seen before then belongs to the last decrease
+	};
+
+}
@@ -1,3 +1,3 @@
 #include "AtemMonitors.h"
 
-ofEvent<BMDSwitcherMixEffectBlockEventType> MixEffectBlockMonitor::effectBlockChanged;
\ No newline at end of file
+ofEvent<BMDSwitcherMixEffectBlockEventType> MixEffectBlockMonitor::effectBlockChanged;
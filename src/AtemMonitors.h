@@ -1,14 +1,60 @@
 #pragma once
 
+#include <atomic>
+
 #include "BMDSwitcherAPI_h.h"
 #include "ofLog.h"
 #include "ofEvent.h"
 #include "ofEventUtils.h"
+#include "ofUtils.h"
+
+#include "AtemDeviceInfo.h"
+#include "AtemLinkMonitor.h"
+#include "AtemSpscQueue.h"
+#include "AtemSwitcherClock.h"
+#include "AtemTypes.h"
+
+// Notification of one of the monitors below
+struct MonitorEvent {
+	enum Type {
+		kMixEffectBlock,
+		kDisconnected,
+	};
+
+	Type type = kMixEffectBlock;
+	ofxAtem::MixEffectEvent mixEffect;	// for kMixEffectBlock
+};
+
+// Where the monitors of one connection queue their notifications, for ComBackend to deliver on
+// its own thread. The SDK calls back on a single notification thread, the one producer.
+// post() never blocks: with the queue full the event is dropped and counted instead.
+class MonitorQueue {
+public:
+	static constexpr size_t kCapacity = 1024;
+
+	void post(const MonitorEvent& e) {
+		if (!events.push(e)) dropped++;
+	}
+
+	// Consumer side
+	bool pop(MonitorEvent& e) { return events.pop(e); }
+	void clear() {
+		events.clear();
+		dropped = 0;
+	}
+	// Events dropped since the last call
+	uint64_t consumeDropped() { return dropped.exchange(0); }
+
+private:
+	ofxAtem::SpscQueue<MonitorEvent, kCapacity> events;
+	std::atomic<uint64_t> dropped{ 0 };
+};
 
 // Callback class for monitoring property changes on a mix effect block.
+// Events are queued with the index of the block, me.
 class MixEffectBlockMonitor : public IBMDSwitcherMixEffectBlockCallback {
 public:
-	MixEffectBlockMonitor() : mRefCount(1) {}
+	MixEffectBlockMonitor(int me, MonitorQueue& queue) : mMe(me), mQueue(queue), mRefCount(1) {}
 	virtual ~MixEffectBlockMonitor() {}
 
 	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) {
@@ -44,7 +90,9 @@ public:
 
 	HRESULT STDMETHODCALLTYPE Notify(BMDSwitcherMixEffectBlockEventType eventType) override {
 
-		ofNotifyEvent(effectBlockChanged, eventType);
+		MonitorEvent e;
+		e.mixEffect = ofxAtem::MixEffectEvent{ mMe, eventType };
+		mQueue.post(e);
 
 		switch (eventType) {
 		case bmdSwitcherMixEffectBlockEventTypeProgramInputChanged:
@@ -71,9 +119,66 @@ public:
 		return S_OK;
 	}
 
+	// Deprecated, listen to Device::mixEffectBlockChanged instead. Every ComDevice notifies it
+	// for the changes it delivers, on the update() thread like the device's own event.
 	static ofEvent<BMDSwitcherMixEffectBlockEventType> effectBlockChanged;
 
 private:
+	int mMe;
+	MonitorQueue& mQueue;	// outlives the monitor, like the backend owning both
+	LONG mRefCount;
+};
+
+// Callback class for an upstream keyer of mix effect block me.
+// Queues it going on or off air as an ofxAtem::kKeyerOnAirChanged mix effect block event.
+class KeyerMonitor : public IBMDSwitcherKeyCallback {
+public:
+	KeyerMonitor(int me, MonitorQueue& queue) : mMe(me), mQueue(queue), mRefCount(1) {}
+	virtual ~KeyerMonitor() {}
+
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) {
+		if (!ppv)
+			return E_POINTER;
+
+		if (IsEqualGUID(iid, IID_IBMDSwitcherKeyCallback)) {
+			*ppv = static_cast<IBMDSwitcherKeyCallback*>(this);
+			AddRef();
+			return S_OK;
+		}
+
+		if (IsEqualGUID(iid, IID_IUnknown)) {
+			*ppv = static_cast<IUnknown*>(this);
+			AddRef();
+			return S_OK;
+		}
+
+		*ppv = NULL;
+		return E_NOINTERFACE;
+	}
+
+	ULONG STDMETHODCALLTYPE AddRef(void) {
+		return InterlockedIncrement(&mRefCount);
+	}
+
+	ULONG STDMETHODCALLTYPE Release(void) {
+		int newCount = InterlockedDecrement(&mRefCount);
+		if (newCount == 0)
+			delete this;
+		return newCount;
+	}
+
+	HRESULT STDMETHODCALLTYPE Notify(BMDSwitcherKeyEventType eventType) override {
+		if (eventType == bmdSwitcherKeyEventTypeOnAirChanged) {
+			MonitorEvent e;
+			e.mixEffect = ofxAtem::MixEffectEvent{ mMe, ofxAtem::kKeyerOnAirChanged };
+			mQueue.post(e);
+		}
+		return S_OK;
+	}
+
+private:
+	int mMe;
+	MonitorQueue& mQueue;
 	LONG mRefCount;
 };
 
@@ -146,9 +251,20 @@ private:
 // Callback class to monitor switcher disconnection
 class SwitcherMonitor : public IBMDSwitcherCallback {
 public:
-	SwitcherMonitor() : mRefCount(1) {}
+	// Feeds clock with the timecode switcher reports and the frame rate of its video mode,
+	// and link with the answer to the heartbeat's timecode request, and any other timecode as
+	// heard. Both are safe from the SDK's thread, only the disconnection is queued.
+	SwitcherMonitor(IBMDSwitcher* switcher, ofxAtem::SwitcherClock& clock, ofxAtem::LinkMonitor& link, MonitorQueue& queue) :
+		mSwitcher(switcher), mClock(clock), mLink(link), mQueue(queue), mRefCount(1) {}
 	virtual ~SwitcherMonitor() {}
 
+	// Call before each RequestTimeCode(), heartbeat if the request is one. The answers come
+	// back in order, so the heartbeat is answered by its own rather than one still outstanding.
+	void timecodeRequested(bool heartbeat) {
+		uint64_t request = ++mRequested;
+		if (heartbeat) mHeartbeatRequest = request;
+	}
+
 	// IBMDSwitcherCallback interface
 	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID* ppv) {
 		if (!ppv)
@@ -185,12 +301,37 @@ public:
 	HRESULT STDMETHODCALLTYPE Notify(BMDSwitcherEventType eventType, BMDSwitcherVideoMode coreVideoMode) {
 		if (eventType == bmdSwitcherEventTypeDisconnected) {
 			ofLogNotice() << "switcher disconnected.";
-			//PostMessage(mHwnd, WM_SWITCHER_DISCONNECTED, 0, 0);
+			MonitorEvent e;
+			e.type = MonitorEvent::kDisconnected;
+			mQueue.post(e);
+		} else if (eventType == bmdSwitcherEventTypeTimeCodeChanged) {
+			// Stamped before the call, which may take a while
+			uint64_t now = ofGetElapsedTimeMicros();
+			uint64_t answer = ++mAnswered;
+			uint64_t heartbeat = mHeartbeatRequest;
+			// At or past it, in case the SDK dropped an answer on the way
+			if (heartbeat && answer >= heartbeat && mHeartbeatRequest.compare_exchange_strong(heartbeat, 0))
+				mLink.onHeartbeatAnswered(now);
+			else
+				mLink.onHeard(now);
+			unsigned char hours, minutes, seconds, frames;
+			BOOL dropFrame;
+			if (SUCCEEDED(mSwitcher->GetTimeCode(&hours, &minutes, &seconds, &frames, &dropFrame)))
+				mClock.addTimecode(ofxAtem::Timecode{ hours, minutes, seconds, frames, dropFrame != FALSE }, now);
+		} else if (eventType == bmdSwitcherEventTypeVideoModeChanged) {
+			mClock.setFrameRate(get_video_mode_frame_rate(coreVideoMode));
 		}
 
 		return S_OK;
 	}
 
 private:
+	IBMDSwitcher* mSwitcher;	// outlives the monitor, which is removed from it first
+	ofxAtem::SwitcherClock& mClock;
+	ofxAtem::LinkMonitor& mLink;
+	MonitorQueue& mQueue;
+	std::atomic<uint64_t> mRequested{ 0 };
+	std::atomic<uint64_t> mAnswered{ 0 };
+	std::atomic<uint64_t> mHeartbeatRequest{ 0 };	// 0 while none is outstanding
 	LONG mRefCount;
 };
\ No newline at end of file
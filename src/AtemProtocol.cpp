@@ -0,0 +1,509 @@
+#include "AtemProtocol.h"
+
+#include <algorithm>
+
+namespace ofxAtem {
+namespace protocol {
+
+	std::string fourccToString(uint32_t name) {
+		char s[5] = { char(name >> 24), char(name >> 16), char(name >> 8), char(name), 0 };
+		return std::string(s);
+	}
+
+	bool readHeader(const uint8_t* data, size_t size, PacketHeader& header) {
+		if (size < kHeaderSize) return false;
+
+		uint16_t word = readU16(data);
+		header.flags = uint8_t(word >> 11);
+		header.length = word & 0x07ff;
+		header.sessionId = readU16(data + 2);
+		header.ackId = readU16(data + 4);
+		header.resendId = readU16(data + 8);
+		header.packetId = readU16(data + 10);
+
+		return header.length >= kHeaderSize && header.length <= size;
+	}
+
+	void writeHeader(uint8_t* data, const PacketHeader& header) {
+		writeU16(data, uint16_t((header.flags << 11) | (header.length & 0x07ff)));
+		writeU16(data + 2, header.sessionId);
+		writeU16(data + 4, header.ackId);
+		writeU16(data + 6, 0);
+		writeU16(data + 8, header.resendId);
+		writeU16(data + 10, header.packetId);
+	}
+
+	std::string portTypeToString(uint8_t internalPortType, uint16_t externalPortType) {
+		switch (internalPortType) {
+		case kPortExternal: {
+			std::string s = "External";
+			switch (externalPortType) {
+			case kExternalSDI:			return s + " (SDI)";
+			case kExternalHDMI:			return s + " (HDMI)";
+			case kExternalComponent:	return s + " (Component)";
+			case kExternalComposite:	return s + " (Composite)";
+			case kExternalSVideo:		return s + " (S-Video)";
+			case kExternalInternal:		return s + " (Internal)";
+			case kExternalXLR:			return s + " (XLR Audio)";
+			case kExternalAESEBU:		return s + " (AES EBU Audio)";
+			case kExternalRCA:			return s + " (RCA Audio)";
+			default:					return s + " (Unknown)";
+			}
+		}
+		case kPortBlack:				return "Black Video";
+		case kPortColorBars:			return "Color-Bars";
+		case kPortColorGenerator:		return "Color Generator";
+		case kPortMediaPlayerFill:		return "Media-Player Fill";
+		case kPortMediaPlayerCut:		return "Media-Player Cut";
+		case kPortSuperSource:			return "Super-Source";
+		case kPortMixEffectBlockOutput:	return "Mix-Effect Block Output";
+		case kPortAuxOutput:			return "Auxiliary Output";
+		case kPortKeyCutOutput:			return "Key Cut Output";
+		default:						return "Unknown";
+		}
+	}
+
+	FrameRate frameRateOfVideoMode(uint8_t mode) {
+		switch (mode) {
+		case kVideoMode525i5994NTSC:
+		case kVideoMode525i5994Anamorphic:
+		case kVideoMode1080i5994:
+		case kVideoMode1080p2997:
+		case kVideoMode4KHDp2997:
+		case kVideoMode8KHDp2997:		return FrameRate{ 30000, 1001 };
+		case kVideoMode625i50PAL:
+		case kVideoMode625i50Anamorphic:
+		case kVideoMode1080i50:
+		case kVideoMode1080p25:
+		case kVideoMode4KHDp25:
+		case kVideoMode8KHDp25:			return FrameRate{ 25, 1 };
+		case kVideoMode720p50:
+		case kVideoMode1080p50:
+		case kVideoMode4KHDp50:
+		case kVideoMode8KHDp50:			return FrameRate{ 50, 1 };
+		case kVideoMode720p5994:
+		case kVideoMode1080p5994:
+		case kVideoMode4KHDp5994:
+		case kVideoMode8KHDp5994:		return FrameRate{ 60000, 1001 };
+		case kVideoMode1080p2398:
+		case kVideoMode4KHDp2398:
+		case kVideoMode8KHDp2398:		return FrameRate{ 24000, 1001 };
+		case kVideoMode1080p24:
+		case kVideoMode4KHDp24:
+		case kVideoMode8KHDp24:			return FrameRate{ 24, 1 };
+		default:						return FrameRate{ 0, 1 };
+		}
+	}
+
+	bool RecordReader::next(uint32_t& name, const uint8_t*& payload, size_t& payloadSize) {
+		if (size_t(end - cur) < kRecordHeaderSize) return false;
+
+		uint16_t length = readU16(cur);
+		if (length < kRecordHeaderSize || length > size_t(end - cur)) return false;
+
+		name = readU32(cur + 4);
+		payload = cur + kRecordHeaderSize;
+		payloadSize = length - kRecordHeaderSize;
+		cur += length;
+		return true;
+	}
+
+	uint8_t* PacketWriter::beginRecord(uint32_t name, size_t payloadSize) {
+		if (!fits(payloadSize)) return nullptr;
+
+		uint8_t* p = buffer + used;
+		writeU16(p, uint16_t(kRecordHeaderSize + payloadSize));
+		writeU16(p + 2, 0);
+		writeU32(p + 4, name);
+		used += kRecordHeaderSize + payloadSize;
+		return p + kRecordHeaderSize;
+	}
+
+	bool PacketWriter::appendRecord(uint32_t name, const uint8_t* payload, size_t payloadSize) {
+		uint8_t* p = beginRecord(name, payloadSize);
+		if (!p) return false;
+		if (payloadSize) memcpy(p, payload, payloadSize);
+		return true;
+	}
+
+	void PacketWriter::finish(PacketHeader header) {
+		header.length = uint16_t(used);
+		writeHeader(buffer, header);
+	}
+
+	static void copyString(char* dst, size_t dstSize, const uint8_t* src, size_t srcSize) {
+		size_t n = 0;
+		while (n < srcSize && n < dstSize - 1 && src[n]) n++;
+		memcpy(dst, src, n);
+		dst[n] = 0;
+	}
+
+	void encode(const Version& v, uint8_t* out) {
+		writeU16(out, v.major);
+		writeU16(out + 2, v.minor);
+	}
+
+	void encode(const std::string& productName, uint8_t* out) {
+		memset(out, 0, kProductNameSize);
+		memcpy(out, productName.data(), std::min(productName.size(), kProductNameSize - 1));
+	}
+
+	void encode(const Topology& v, uint8_t* out) {
+		memset(out, 0, kTopologySize);
+		out[0] = v.mixEffectBlocks;
+		out[1] = v.sources;
+		out[2] = v.downstreamKeyers;
+		out[3] = v.auxOutputs;
+		out[4] = v.mediaPlayers;
+		out[5] = v.superSources;
+	}
+
+	void encode(const MixEffectConfig& v, uint8_t* out) {
+		memset(out, 0, kMixEffectConfigSize);
+		out[0] = v.me;
+		out[1] = v.keyers;
+	}
+
+	void encode(const MediaPoolConfig& v, uint8_t* out) {
+		memset(out, 0, kMediaPoolConfigSize);
+		out[0] = v.stills;
+		out[1] = v.clips;
+	}
+
+	void encode(const VideoMode& v, uint8_t* out) {
+		memset(out, 0, kVideoModeSize);
+		out[0] = v.mode;
+	}
+
+	void encode(const InputProperties& v, uint8_t* out) {
+		memset(out, 0, kInputPropertiesSize);
+		writeU16(out, v.id);
+		memcpy(out + 2, v.longName, strnlen(v.longName, 20));
+		memcpy(out + 22, v.shortName, strnlen(v.shortName, 4));
+		writeU16(out + 28, v.availableExternalPortTypes);
+		writeU16(out + 30, v.externalPortType);
+		out[32] = v.internalPortType;
+		out[34] = v.sourceAvailability;
+		out[35] = v.meAvailability;
+	}
+
+	void encode(const InputSelection& v, uint8_t* out) {
+		out[0] = v.me;
+		out[1] = 0;
+		writeU16(out + 2, v.source);
+	}
+
+	void encode(const TransitionPosition& v, uint8_t* out) {
+		memset(out, 0, kTransitionPositionSize);
+		out[0] = v.me;
+		out[1] = v.inTransition ? 1 : 0;
+		out[2] = v.framesRemaining;
+		writeU16(out + 4, v.position);
+	}
+
+	void encode(const KeyerOnAir& v, uint8_t* out) {
+		out[0] = v.me;
+		out[1] = v.keyer;
+		out[2] = v.onAir ? 1 : 0;
+		out[3] = 0;
+	}
+
+	void encode(const AuxSource& v, uint8_t* out) {
+		out[0] = v.aux;
+		out[1] = 0;
+		writeU16(out + 2, v.source);
+	}
+
+	void encode(const SourceLevels& v, uint8_t* out) {
+		writeU16(out, v.source);
+		writeU16(out + 2, 0);
+		writeU16(out + 4, uint16_t(v.leftLevel));
+		writeU16(out + 6, uint16_t(v.rightLevel));
+		writeU16(out + 8, uint16_t(v.leftPeak));
+		writeU16(out + 10, uint16_t(v.rightPeak));
+	}
+
+	void encode(const Timecode& v, uint8_t* out) {
+		memset(out, 0, kTimecodeSize);
+		out[0] = v.hours;
+		out[1] = v.minutes;
+		out[2] = v.seconds;
+		out[3] = v.frames;
+		out[4] = v.dropFrame ? 1 : 0;
+	}
+
+	void encode(const StoreLock& v, uint8_t* out) {
+		writeU16(out, v.storeId);
+		out[2] = v.locked ? 1 : 0;
+		out[3] = 0;
+	}
+
+	void encode(const TransferRequest& v, uint8_t* out) {
+		memset(out, 0, kTransferRequestSize);
+		writeU16(out, v.transferId);
+		writeU16(out + 2, v.storeId);
+		writeU16(out + 6, v.slot);
+		writeU32(out + 8, v.size);
+		writeU16(out + 12, v.mode);
+	}
+
+	void encode(const TransferCredit& v, uint8_t* out) {
+		memset(out, 0, kTransferCreditSize);
+		writeU16(out, v.transferId);
+		writeU16(out + 6, v.chunkSize);
+		writeU16(out + 8, v.chunkCount);
+	}
+
+	void encode(const TransferData& v, uint8_t* out) {
+		writeU16(out, v.transferId);
+		writeU16(out + 2, uint16_t(v.size));
+	}
+
+	void encode(const TransferDescription& v, uint8_t* out) {
+		memset(out, 0, kTransferDescriptionSize);
+		writeU16(out, v.transferId);
+		memcpy(out + 2, v.name, strnlen(v.name, sizeof(v.name)));
+		memcpy(out + 66, v.description, strnlen(v.description, sizeof(v.description)));
+		memcpy(out + 194, v.md5, sizeof(v.md5));
+	}
+
+	void encode(const TransferStatus& v, uint8_t* out) {
+		writeU16(out, v.transferId);
+		out[2] = v.error;
+		out[3] = 0;
+	}
+
+	void encodeCommand(const AuxSource& v, uint8_t* out) {
+		out[0] = 0x01;	// set source
+		out[1] = v.aux;
+		writeU16(out + 2, v.source);
+	}
+
+	bool decode(const uint8_t* p, size_t n, Version& v) {
+		if (n < kVersionSize) return false;
+		v.major = readU16(p);
+		v.minor = readU16(p + 2);
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, std::string& productName) {
+		char s[kProductNameSize + 1];
+		copyString(s, sizeof(s), p, std::min(n, kProductNameSize));
+		productName = s;
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, Topology& v) {
+		if (n < 6) return false;
+		v.mixEffectBlocks = p[0];
+		v.sources = p[1];
+		v.downstreamKeyers = p[2];
+		v.auxOutputs = p[3];
+		v.mediaPlayers = p[4];
+		v.superSources = p[5];
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, MixEffectConfig& v) {
+		if (n < 2) return false;
+		v.me = p[0];
+		v.keyers = p[1];
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, MediaPoolConfig& v) {
+		if (n < 2) return false;
+		v.stills = p[0];
+		v.clips = p[1];
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, VideoMode& v) {
+		if (n < 1) return false;
+		v.mode = p[0];
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, InputProperties& v) {
+		if (n < kInputPropertiesSize) return false;
+		v.id = readU16(p);
+		copyString(v.longName, sizeof(v.longName), p + 2, 20);
+		copyString(v.shortName, sizeof(v.shortName), p + 22, 4);
+		v.availableExternalPortTypes = readU16(p + 28);
+		v.externalPortType = readU16(p + 30);
+		v.internalPortType = p[32];
+		v.sourceAvailability = p[34];
+		v.meAvailability = p[35];
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, InputSelection& v) {
+		if (n < kInputSelectionSize) return false;
+		v.me = p[0];
+		v.source = readU16(p + 2);
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, TransitionPosition& v) {
+		if (n < 6) return false;
+		v.me = p[0];
+		v.inTransition = p[1] != 0;
+		v.framesRemaining = p[2];
+		v.position = readU16(p + 4);
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, KeyerOnAir& v) {
+		if (n < 3) return false;
+		v.me = p[0];
+		v.keyer = p[1];
+		v.onAir = p[2] != 0;
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, AuxSource& v) {
+		if (n < kAuxSourceSize) return false;
+		v.aux = p[0];
+		v.source = readU16(p + 2);
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, SourceLevels& v) {
+		if (n < kSourceLevelsSize) return false;
+		v.source = readU16(p);
+		v.leftLevel = int16_t(readU16(p + 4));
+		v.rightLevel = int16_t(readU16(p + 6));
+		v.leftPeak = int16_t(readU16(p + 8));
+		v.rightPeak = int16_t(readU16(p + 10));
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, Timecode& v) {
+		if (n < 5) return false;
+		v.hours = p[0];
+		v.minutes = p[1];
+		v.seconds = p[2];
+		v.frames = p[3];
+		v.dropFrame = p[4] != 0;
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, StoreLock& v) {
+		if (n < 3) return false;
+		v.storeId = readU16(p);
+		v.locked = p[2] != 0;
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, TransferRequest& v) {
+		if (n < 14) return false;
+		v.transferId = readU16(p);
+		v.storeId = readU16(p + 2);
+		v.slot = readU16(p + 6);
+		v.size = readU32(p + 8);
+		v.mode = readU16(p + 12);
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, TransferCredit& v) {
+		if (n < 10) return false;
+		v.transferId = readU16(p);
+		v.chunkSize = readU16(p + 6);
+		v.chunkCount = readU16(p + 8);
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, TransferData& v) {
+		if (n < kTransferDataHeaderSize) return false;
+		v.transferId = readU16(p);
+		v.size = readU16(p + 2);
+		v.data = p + kTransferDataHeaderSize;
+		return v.size <= n - kTransferDataHeaderSize;
+	}
+
+	bool decode(const uint8_t* p, size_t n, TransferDescription& v) {
+		if (n < 210) return false;
+		v.transferId = readU16(p);
+		copyString(v.name, sizeof(v.name), p + 2, 64);
+		copyString(v.description, sizeof(v.description), p + 66, 128);
+		memcpy(v.md5, p + 194, sizeof(v.md5));
+		return true;
+	}
+
+	bool decode(const uint8_t* p, size_t n, TransferStatus& v) {
+		if (n < 2) return false;
+		v.transferId = readU16(p);
+		v.error = n > 2 ? p[2] : 0;
+		return true;
+	}
+
+	bool decodeCommand(const uint8_t* p, size_t n, AuxSource& v) {
+		if (n < kAuxSourceSize || !(p[0] & 0x01)) return false;
+		v.aux = p[1];
+		v.source = readU16(p + 2);
+		return true;
+	}
+
+	// RFC 1321, one pass over a buffer that is all in memory
+	void md5(const uint8_t* data, size_t size, uint8_t digest[16]) {
+		static const uint32_t k[64] = {
+			0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+			0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+			0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+			0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+			0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+			0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+			0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+			0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+		};
+		static const uint8_t r[64] = {
+			7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+			5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+			4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+			6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+		};
+		uint32_t h[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+
+		auto block = [&](const uint8_t* b) {
+			uint32_t w[16];
+			for (int i = 0; i < 16; i++) {
+				w[i] = uint32_t(b[i * 4]) | (uint32_t(b[i * 4 + 1]) << 8) | (uint32_t(b[i * 4 + 2]) << 16) | (uint32_t(b[i * 4 + 3]) << 24);
+			}
+			uint32_t a = h[0], bb = h[1], c = h[2], d = h[3];
+			for (int i = 0; i < 64; i++) {
+				uint32_t f;
+				int g;
+				if (i < 16) { f = (bb & c) | (~bb & d); g = i; }
+				else if (i < 32) { f = (d & bb) | (~d & c); g = (5 * i + 1) & 15; }
+				else if (i < 48) { f = bb ^ c ^ d; g = (3 * i + 5) & 15; }
+				else { f = c ^ (bb | ~d); g = (7 * i) & 15; }
+				uint32_t t = d;
+				d = c;
+				c = bb;
+				uint32_t x = a + f + k[i] + w[g];
+				bb = bb + ((x << r[i]) | (x >> (32 - r[i])));
+				a = t;
+			}
+			h[0] += a; h[1] += bb; h[2] += c; h[3] += d;
+		};
+
+		size_t whole = size & ~size_t(63);
+		for (size_t i = 0; i < whole; i += 64) block(data + i);
+
+		// Tail, the 0x80 terminator and the bit length, in one or two blocks
+		uint8_t tail[128] = {};
+		size_t rest = size - whole;
+		memcpy(tail, data + whole, rest);
+		tail[rest] = 0x80;
+		size_t tailSize = rest < 56 ? 64 : 128;
+		uint64_t bits = uint64_t(size) * 8;
+		for (int i = 0; i < 8; i++) tail[tailSize - 8 + i] = uint8_t(bits >> (8 * i));
+		for (size_t i = 0; i < tailSize; i += 64) block(tail + i);
+
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++) digest[i * 4 + j] = uint8_t(h[i] >> (8 * j));
+		}
+	}
+
+}
+}
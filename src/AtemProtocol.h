@@ -0,0 +1,462 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "AtemTypes.h"
+
+// Wire format of the ATEM control protocol (UDP port 9910).
+//
+// Every datagram starts with a 12 byte header:
+//   [0-1]   flags (upper 5 bits) | datagram length (lower 11 bits)
+//   [2-3]   session id
+//   [4-5]   id of the remote packet being acknowledged
+//   [6-7]   reserved
+//   [8-9]   id of the packet requested for resend
+//   [10-11] local packet id
+// followed by zero or more records:
+//   [0-1]   record length including this 8 byte record header
+//   [2-3]   reserved
+//   [4-7]   four character command name
+//   [8-..]  command payload
+// All integers are big-endian.
+
+namespace ofxAtem {
+namespace protocol {
+
+	const uint16_t kPort = 9910;
+	const size_t kHeaderSize = 12;
+	const size_t kRecordHeaderSize = 8;
+	const size_t kMaxPacketSize = 1416;
+	const size_t kHelloPayloadSize = 8;
+	const uint16_t kPacketIdMask = 0x7fff;
+
+	enum PacketFlags : uint8_t {
+		kFlagAckRequest = 0x01,
+		kFlagHello = 0x02,
+		kFlagResend = 0x04,
+		kFlagRequestResend = 0x08,
+		kFlagAck = 0x10,
+	};
+
+	// Payload byte 0 of the switcher's hello reply
+	enum HelloReply : uint8_t {
+		kHelloAccepted = 0x02,
+		kHelloRejected = 0x03,
+	};
+
+	struct PacketHeader {
+		uint8_t flags = 0;
+		uint16_t length = 0;
+		uint16_t sessionId = 0;
+		uint16_t ackId = 0;
+		uint16_t resendId = 0;
+		uint16_t packetId = 0;
+	};
+
+	constexpr uint32_t fourcc(const char(&s)[5]) {
+		return (uint32_t(uint8_t(s[0])) << 24) | (uint32_t(uint8_t(s[1])) << 16) | (uint32_t(uint8_t(s[2])) << 8) | uint32_t(uint8_t(s[3]));
+	}
+
+	std::string fourccToString(uint32_t name);
+
+	inline uint16_t nextPacketId(uint16_t id) { return uint16_t((id + 1) & kPacketIdMask); }
+	// True if packet id a comes after b, allowing for the 15 bit wrap-around
+	inline bool isNewer(uint16_t a, uint16_t b) {
+		uint16_t d = uint16_t((a - b) & kPacketIdMask);
+		return d != 0 && d < (kPacketIdMask + 1) / 2;
+	}
+	inline uint16_t packetIdDistance(uint16_t from, uint16_t to) { return uint16_t((to - from) & kPacketIdMask); }
+
+	inline uint16_t readU16(const uint8_t* p) { return uint16_t((p[0] << 8) | p[1]); }
+	inline uint32_t readU32(const uint8_t* p) { return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]); }
+	inline void writeU16(uint8_t* p, uint16_t v) { p[0] = uint8_t(v >> 8); p[1] = uint8_t(v); }
+	inline void writeU32(uint8_t* p, uint32_t v) { p[0] = uint8_t(v >> 24); p[1] = uint8_t(v >> 16); p[2] = uint8_t(v >> 8); p[3] = uint8_t(v); }
+
+	bool readHeader(const uint8_t* data, size_t size, PacketHeader& header);
+	void writeHeader(uint8_t* data, const PacketHeader& header);
+
+	// Switcher -> client state records
+	namespace state {
+		const uint32_t kVersion = fourcc("_ver");
+		const uint32_t kProductName = fourcc("_pin");
+		const uint32_t kTopology = fourcc("_top");
+		const uint32_t kMixEffectConfig = fourcc("_MeC");
+		const uint32_t kMediaPoolConfig = fourcc("_mpl");
+		const uint32_t kVideoMode = fourcc("VidM");
+		const uint32_t kInputProperties = fourcc("InPr");
+		const uint32_t kProgramInput = fourcc("PrgI");
+		const uint32_t kPreviewInput = fourcc("PrvI");
+		const uint32_t kTransitionPosition = fourcc("TrPs");
+		const uint32_t kKeyerOnAir = fourcc("KeOn");
+		const uint32_t kAuxSource = fourcc("AuxS");
+		const uint32_t kSourceLevels = fourcc("FMLv");
+		const uint32_t kInitComplete = fourcc("InCm");
+		const uint32_t kTimecode = fourcc("Time");	// a Timecode, streamed at frame rate rather than mirrored
+		// Media pool locks and transfers
+		const uint32_t kLockObtained = fourcc("LKOB");
+		const uint32_t kLockState = fourcc("LKST");
+		const uint32_t kTransferCredit = fourcc("FTCD");
+		const uint32_t kTransferComplete = fourcc("FTDC");
+		const uint32_t kTransferError = fourcc("FTDE");
+	}
+
+	// Client -> switcher command records
+	namespace command {
+		const uint32_t kProgramInput = fourcc("CPgI");
+		const uint32_t kPreviewInput = fourcc("CPvI");
+		const uint32_t kCut = fourcc("DCut");
+		const uint32_t kAuto = fourcc("DAut");
+		const uint32_t kKeyerOnAir = fourcc("CKOn");
+		const uint32_t kAuxSource = fourcc("CAuS");
+		// Media pool locks and transfers
+		const uint32_t kStoreLock = fourcc("PLCK");
+		const uint32_t kTransferRequest = fourcc("FTSD");
+		const uint32_t kTransferData = fourcc("FTDa");
+		const uint32_t kTransferDescription = fourcc("FTFD");
+	}
+
+	// Lock and transfer replies, the LK.. and FT.. records, which are not mirrored
+	inline bool isTransferRecord(uint32_t name) {
+		uint32_t prefix = name >> 16;
+		return prefix == ((uint32_t('L') << 8) | 'K') || prefix == ((uint32_t('F') << 8) | 'T');
+	}
+
+	// Internal port types as reported in InPr
+	enum InternalPortType : uint8_t {
+		kPortExternal = 0,
+		kPortBlack = 1,
+		kPortColorBars = 2,
+		kPortColorGenerator = 3,
+		kPortMediaPlayerFill = 4,
+		kPortMediaPlayerCut = 5,
+		kPortSuperSource = 6,
+		kPortMixEffectBlockOutput = 128,
+		kPortAuxOutput = 129,
+		kPortKeyCutOutput = 130,
+	};
+
+	// External port types as reported in InPr (bit flags)
+	enum ExternalPortType : uint16_t {
+		kExternalSDI = 0x0001,
+		kExternalHDMI = 0x0002,
+		kExternalComponent = 0x0004,
+		kExternalComposite = 0x0008,
+		kExternalSVideo = 0x0010,
+		kExternalInternal = 0x0020,
+		kExternalXLR = 0x0040,
+		kExternalAESEBU = 0x0080,
+		kExternalRCA = 0x0100,
+	};
+
+	// Same wording as the SDK lookup tables so Input::portType reads the same on every backend
+	std::string portTypeToString(uint8_t internalPortType, uint16_t externalPortType);
+
+	struct Version {
+		uint16_t major = 0;
+		uint16_t minor = 0;
+	};
+
+	struct Topology {
+		uint8_t mixEffectBlocks = 0;
+		uint8_t sources = 0;
+		uint8_t downstreamKeyers = 0;
+		uint8_t auxOutputs = 0;
+		uint8_t mediaPlayers = 0;
+		uint8_t superSources = 0;
+	};
+
+	struct MixEffectConfig {
+		uint8_t me = 0;
+		uint8_t keyers = 0;
+	};
+
+	struct MediaPoolConfig {
+		uint8_t stills = 0;
+		uint8_t clips = 0;
+	};
+
+	// Video modes as numbered in VidM, in the order of the SDK's kSwitcherVideoModes
+	enum VideoModeId : uint8_t {
+		kVideoMode525i5994NTSC = 0,
+		kVideoMode625i50PAL = 1,
+		kVideoMode525i5994Anamorphic = 2,
+		kVideoMode625i50Anamorphic = 3,
+		kVideoMode720p50 = 4,
+		kVideoMode720p5994 = 5,
+		kVideoMode1080i50 = 6,
+		kVideoMode1080i5994 = 7,
+		kVideoMode1080p2398 = 8,
+		kVideoMode1080p24 = 9,
+		kVideoMode1080p25 = 10,
+		kVideoMode1080p2997 = 11,
+		kVideoMode1080p50 = 12,
+		kVideoMode1080p5994 = 13,
+		kVideoMode4KHDp2398 = 14,
+		kVideoMode4KHDp24 = 15,
+		kVideoMode4KHDp25 = 16,
+		kVideoMode4KHDp2997 = 17,
+		kVideoMode4KHDp50 = 18,
+		kVideoMode4KHDp5994 = 19,
+		kVideoMode8KHDp2398 = 20,
+		kVideoMode8KHDp24 = 21,
+		kVideoMode8KHDp25 = 22,
+		kVideoMode8KHDp2997 = 23,
+		kVideoMode8KHDp50 = 24,
+		kVideoMode8KHDp5994 = 25,
+	};
+
+	// Invalid for a mode this table does not know
+	FrameRate frameRateOfVideoMode(uint8_t mode);
+
+	struct VideoMode {
+		uint8_t mode = kVideoMode1080i50;
+	};
+
+	struct InputProperties {
+		uint16_t id = 0;
+		char longName[21] = {};
+		char shortName[5] = {};
+		uint16_t availableExternalPortTypes = 0;
+		uint16_t externalPortType = 0;
+		uint8_t internalPortType = 0;
+		uint8_t sourceAvailability = 0;
+		uint8_t meAvailability = 0;
+	};
+
+	struct InputSelection {
+		uint8_t me = 0;
+		uint16_t source = 0;
+	};
+
+	struct TransitionPosition {
+		uint8_t me = 0;
+		bool inTransition = false;
+		uint8_t framesRemaining = 0;
+		uint16_t position = 0;	// 0 - 10000
+	};
+
+	struct KeyerOnAir {
+		uint8_t me = 0;
+		uint8_t keyer = 0;
+		bool onAir = false;
+	};
+
+	struct AuxSource {
+		uint8_t aux = 0;
+		uint16_t source = 0;
+	};
+
+	// Audio meter of one source, streamed by the switcher while a client subscribes to levels.
+	// Levels are in hundredths of a dB. The client does not mirror meters.
+	struct SourceLevels {
+		uint16_t source = 0;
+		int16_t leftLevel = 0;
+		int16_t rightLevel = 0;
+		int16_t leftPeak = 0;
+		int16_t rightPeak = 0;
+	};
+
+	// Media pool store of a transfer: the stills, or one clip
+	const uint16_t kStillsStoreId = 0;
+	inline uint16_t clipStoreId(int clip) { return uint16_t(clip + 1); }
+
+	// PLCK asks for (or releases) the lock of a store, LKOB grants it, LKST tells every client
+	struct StoreLock {
+		uint16_t storeId = 0;
+		bool locked = false;
+	};
+
+	enum TransferMode : uint16_t {
+		kTransferModeWrite = 1,
+	};
+
+	// FTSD, starts an upload of size bytes into a still slot or clip frame of a locked store
+	struct TransferRequest {
+		uint16_t transferId = 0;
+		uint16_t storeId = 0;
+		uint16_t slot = 0;
+		uint32_t size = 0;
+		uint16_t mode = kTransferModeWrite;
+	};
+
+	// FTCD, the switcher's go-ahead for chunkCount more FTDa records of up to chunkSize bytes each
+	struct TransferCredit {
+		uint16_t transferId = 0;
+		uint16_t chunkSize = 0;
+		uint16_t chunkCount = 0;
+	};
+
+	// FTDa, one chunk of an upload. data points into the decoded payload.
+	struct TransferData {
+		uint16_t transferId = 0;
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+	};
+
+	// FTFD, closes an upload with the name and MD5 of what was sent
+	struct TransferDescription {
+		uint16_t transferId = 0;
+		char name[64] = {};
+		char description[128] = {};
+		uint8_t md5[16] = {};
+	};
+
+	enum TransferErrorCode : uint8_t {
+		kTransferErrorNone = 0,
+		kTransferErrorRetry = 1,
+		kTransferErrorNotFound = 2,
+		kTransferErrorNotLocked = 5,
+		kTransferErrorCorrupt = 6,
+	};
+
+	// FTDC once the switcher has stored an upload, FTDE with the reason if it could not
+	struct TransferStatus {
+		uint16_t transferId = 0;
+		uint8_t error = kTransferErrorNone;
+	};
+
+	// Payload sizes, excluding the record header
+	const size_t kVersionSize = 4;
+	const size_t kProductNameSize = 44;
+	const size_t kTopologySize = 12;
+	const size_t kMixEffectConfigSize = 4;
+	const size_t kMediaPoolConfigSize = 4;
+	const size_t kInputPropertiesSize = 36;
+	const size_t kInputSelectionSize = 4;
+	const size_t kTransitionPositionSize = 8;
+	const size_t kKeyerOnAirSize = 4;
+	const size_t kAuxSourceSize = 4;
+	const size_t kSourceLevelsSize = 12;
+	const size_t kInitCompleteSize = 4;
+	const size_t kVideoModeSize = 4;
+	const size_t kTimecodeSize = 8;
+	const size_t kStoreLockSize = 4;
+	const size_t kTransferRequestSize = 16;
+	const size_t kTransferCreditSize = 12;
+	const size_t kTransferDataHeaderSize = 4;
+	const size_t kTransferDescriptionSize = 212;
+	const size_t kTransferStatusSize = 4;
+	// Largest chunk that fits a datagram on its own
+	const size_t kMaxTransferChunkSize = kMaxPacketSize - kHeaderSize - kRecordHeaderSize - kTransferDataHeaderSize;
+
+	// Iterates the records of one datagram payload
+	class RecordReader {
+	public:
+		RecordReader(const uint8_t* data, size_t size) : cur(data), end(data + size) {}
+
+		// Returns false at the end of the payload or on a malformed record
+		bool next(uint32_t& name, const uint8_t*& payload, size_t& payloadSize);
+
+	private:
+		const uint8_t* cur;
+		const uint8_t* end;
+	};
+
+	// Fixed-capacity datagram under construction.
+	// Room for the packet header is reserved up front and records are encoded in place
+	// behind it, so a finished packet goes to the socket as is, without allocation or copy.
+	class PacketWriter {
+	public:
+		PacketWriter() { reset(); }
+
+		void reset() { used = kHeaderSize; }
+		bool empty() const { return used == kHeaderSize; }
+		bool fits(size_t payloadSize) const { return used + kRecordHeaderSize + payloadSize <= kMaxPacketSize; }
+
+		// Writes the record header and returns where its payload goes, nullptr if the packet is full
+		uint8_t* beginRecord(uint32_t name, size_t payloadSize);
+		// Copies a ready-made payload into a new record
+		bool appendRecord(uint32_t name, const uint8_t* payload, size_t payloadSize);
+
+		// Writes header, with its length set to the records written so far, in front of them
+		void finish(PacketHeader header);
+
+		const uint8_t* data() const { return buffer; }
+		size_t size() const { return used; }
+
+	private:
+		uint8_t buffer[kMaxPacketSize];
+		size_t used;
+	};
+
+	// Fixed set of datagram sized buffers, handed out and taken back by index.
+	// Datagrams are received straight into the buffer they are parsed from, and one that has
+	// to wait for a lost predecessor is held by its index instead of being copied aside.
+	template<size_t N>
+	class DatagramPool {
+	public:
+		DatagramPool() { reset(); }
+
+		// Takes every buffer back
+		void reset() {
+			for (size_t i = 0; i < N; i++) freeList[i] = int(N - 1 - i);
+			freeCount = N;
+		}
+
+		// -1 once all buffers are out
+		int acquire() { return freeCount > 0 ? freeList[--freeCount] : -1; }
+		void release(int index) { freeList[freeCount++] = index; }
+
+		uint8_t* data(int index) { return buffers[index]; }
+		static constexpr size_t capacity() { return kMaxPacketSize; }
+
+	private:
+		uint8_t buffers[N][kMaxPacketSize];
+		int freeList[N];
+		size_t freeCount = 0;
+	};
+
+	// Payload encoders
+	void encode(const Version& v, uint8_t* out);
+	void encode(const std::string& productName, uint8_t* out);
+	void encode(const Topology& v, uint8_t* out);
+	void encode(const MixEffectConfig& v, uint8_t* out);
+	void encode(const MediaPoolConfig& v, uint8_t* out);
+	void encode(const VideoMode& v, uint8_t* out);
+	void encode(const InputProperties& v, uint8_t* out);
+	void encode(const InputSelection& v, uint8_t* out);
+	void encode(const TransitionPosition& v, uint8_t* out);
+	void encode(const KeyerOnAir& v, uint8_t* out);
+	void encode(const AuxSource& v, uint8_t* out);
+	void encode(const SourceLevels& v, uint8_t* out);
+	void encode(const Timecode& v, uint8_t* out);
+	void encode(const StoreLock& v, uint8_t* out);
+	void encode(const TransferRequest& v, uint8_t* out);
+	void encode(const TransferCredit& v, uint8_t* out);
+	// Only the kTransferDataHeaderSize bytes in front of the chunk, which the caller copies behind them
+	void encode(const TransferData& v, uint8_t* out);
+	void encode(const TransferDescription& v, uint8_t* out);
+	void encode(const TransferStatus& v, uint8_t* out);
+
+	// CAuS carries a field mask in front of the aux index, unlike the AuxS state record
+	void encodeCommand(const AuxSource& v, uint8_t* out);
+
+	// Payload decoders, false if the payload is too short
+	bool decode(const uint8_t* p, size_t n, Version& v);
+	bool decode(const uint8_t* p, size_t n, std::string& productName);
+	bool decode(const uint8_t* p, size_t n, Topology& v);
+	bool decode(const uint8_t* p, size_t n, MixEffectConfig& v);
+	bool decode(const uint8_t* p, size_t n, MediaPoolConfig& v);
+	bool decode(const uint8_t* p, size_t n, VideoMode& v);
+	bool decode(const uint8_t* p, size_t n, InputProperties& v);
+	bool decode(const uint8_t* p, size_t n, InputSelection& v);
+	bool decode(const uint8_t* p, size_t n, TransitionPosition& v);
+	bool decode(const uint8_t* p, size_t n, KeyerOnAir& v);
+	bool decode(const uint8_t* p, size_t n, AuxSource& v);
+	bool decode(const uint8_t* p, size_t n, SourceLevels& v);
+	bool decode(const uint8_t* p, size_t n, Timecode& v);
+	bool decode(const uint8_t* p, size_t n, StoreLock& v);
+	bool decode(const uint8_t* p, size_t n, TransferRequest& v);
+	bool decode(const uint8_t* p, size_t n, TransferCredit& v);
+	bool decode(const uint8_t* p, size_t n, TransferData& v);
+	bool decode(const uint8_t* p, size_t n, TransferDescription& v);
+	bool decode(const uint8_t* p, size_t n, TransferStatus& v);
+	bool decodeCommand(const uint8_t* p, size_t n, AuxSource& v);
+
+	// MD5 digest of data, as FTFD carries it
+	void md5(const uint8_t* data, size_t size, uint8_t digest[16]);
+
+}
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ofLog.h"
+#include "ofTypes.h"
+#include "ofUtils.h"
+
+#include "AtemTypes.h"
+#include "AtemSessionRecorder.h"
+#include "AtemUdpBackend.h"
+#include "AtemUdpClient.h"
+
+namespace ofxAtem {
+
+	// Device backend playing a SessionRecorder file back instead of talking to a switcher.
+	// The recorded switcher datagrams go through the same client and parser as live ones, in
+	// their original order, so Device sees the show exactly as it happened: connect() takes the
+	// path of the recording and ready, mixEffectBlockChanged etc. follow on the replay thread.
+	// Commands are refused, a recording cannot be steered. Listeners may connect or disconnect
+	// again from the replay thread, which acts on it once they have returned.
+	class ReplayBackend {
+	public:
+		ReplayBackend() {}
+		~ReplayBackend() { close(); }
+
+		template<typename Sink>
+		bool connect(const std::string& path, Sink& sink) {
+			// From a listener, the replay it belongs to is further up this stack
+			if (std::this_thread::get_id() == replayThread.get_id()) {
+				std::lock_guard<std::mutex> lock(wakeMutex);
+				running = false;
+				restartPath = path;
+				restart = true;
+				return true;
+			}
+			close();
+			if (!open(path)) return false;
+
+			running = true;
+			replayThread = std::thread([this, &sink] {
+				for (;;) {
+					replay(sink);
+
+					// A listener asked for another replay, started now that the last one returned
+					std::string next;
+					{
+						std::lock_guard<std::mutex> lock(wakeMutex);
+						if (!restart) return;
+						next = restartPath;
+						restart = false;
+						running = true;
+					}
+					if (!open(next)) {
+						ofLogError(__FUNCTION__) << "Failed to open recording " << next;
+						running = false;
+						sink.onBackendConnected(false);
+						return;
+					}
+				}
+			});
+			return true;
+		}
+
+		template<typename Sink>
+		void disconnect(Sink&) { close(); }
+		// Events come from the replay thread
+		template<typename Sink>
+		void deliver(Sink&) {}
+
+		void printInfo() { UdpBackend::printInfo(client.getState()); }
+		std::string getProductName() { return client.getState().productName; }
+		bool readInputs(std::vector<ofPtr<Input>>& inputs) { return UdpBackend::readInputs(client.getState(), inputs); }
+
+		bool setProgramInput(int, BMDSwitcherInputId) { return false; }
+		bool setPreviewInput(int, BMDSwitcherInputId) { return false; }
+		bool setKeyerOnAir(int, int, bool) { return false; }
+		bool setAuxSource(int, BMDSwitcherInputId) { return false; }
+
+		void beginBatch() {}
+		bool commitBatch() { return true; }
+
+		bool getProgramInput(int me, BMDSwitcherInputId& id) {
+			uint16_t source;
+			if (!client.getProgramInput(me, source)) return false;
+			id = source;
+			return true;
+		}
+
+		bool getPreviewInput(int me, BMDSwitcherInputId& id) {
+			uint16_t source;
+			if (!client.getPreviewInput(me, source)) return false;
+			id = source;
+			return true;
+		}
+
+		bool getTransition(int me, TransitionState& transition) { return UdpBackend::getTransition(client, me, transition); }
+		bool getKeyersOnAir(int me, uint32_t& onAir) { return UdpBackend::getKeyersOnAir(client, me, onAir); }
+		int getMixEffectBlockCount() { return client.getMixEffectBlockCount(); }
+
+		// Fed with the recorded timecodes at their recorded arrival times, at either replay speed;
+		// reset on every connect
+		SwitcherClock& getClock() { return client.getClock(); }
+		// A recording sends no heartbeats, the link is never degraded
+		LinkMonitor& getLinkMonitor() { return client.getLinkMonitor(); }
+		// Merges the events of each recorded datagram; its settings are kept across connects
+		EventCoalescer& getEventCoalescer() { return client.getEventCoalescer(); }
+
+		// True (the default) keeps the recorded timing, false replays as fast as possible.
+		// Takes effect on the next connect.
+		void setRealTime(bool enable) { realTime = enable; }
+		bool isFinished() const { return finished; }
+		uint64_t getReplayedCount() const { return replayed; }
+		uint64_t getDurationMicros() const { return reader.getDurationMicros(); }
+
+	private:
+		bool open(const std::string& path) {
+			if (!reader.open(path)) return false;
+
+			client.reset();
+			replayed = 0;
+			finished = false;
+			return true;
+		}
+
+		template<typename Sink>
+		void replay(Sink& sink) {
+			auto handler = [&sink](MixEffectEvent& e) { sink.onMixEffectBlockUpdated(e); };
+			auto start = std::chrono::steady_clock::now();
+			// Datagrams arrive at their recorded offsets from here on, whatever the replay speed
+			uint64_t startMicros = ofGetElapsedTimeMicros();
+			bool synced = false;
+
+			SessionReader::Entry entry;
+			while (running && reader.next(entry)) {
+				if (entry.direction != kFromSwitcher) continue;
+				if (realTime) {
+					// close() does not wait out a gap in the recording
+					std::unique_lock<std::mutex> lock(wakeMutex);
+					wake.wait_until(lock, start + std::chrono::microseconds(entry.micros), [this] { return !running; });
+					if (!running) break;
+				}
+
+				client.inject(entry.data, entry.size, startMicros + entry.micros, handler);
+				replayed++;
+
+				if (!synced && client.isConnected()) {
+					synced = true;
+					sink.onBackendConnected(true);
+				}
+				if (client.consumeInputsChanged()) sink.onInputsChanged();
+			}
+			// Stopped by close() or connect(), which have dealt with a connect still pending
+			if (!synced && running) sink.onBackendConnected(false);
+			finished = true;
+		}
+
+		void close() {
+			{
+				std::lock_guard<std::mutex> lock(wakeMutex);
+				running = false;
+				restart = false;
+			}
+			wake.notify_all();
+			// From a listener on the replay thread, which stops once that returns
+			if (std::this_thread::get_id() == replayThread.get_id()) return;
+
+			if (replayThread.joinable()) {
+				replayThread.join();
+			}
+		}
+
+		SessionReader reader;
+		UdpClient client;	// reset per replay, never opened
+		bool realTime = true;
+		std::atomic<bool> running{ false };
+		std::atomic<bool> finished{ false };
+		std::atomic<uint64_t> replayed{ 0 };
+		std::thread replayThread;
+		std::mutex wakeMutex;
+		std::condition_variable wake;	// cuts the wait for the next recorded datagram short
+		// Where a listener on the replay thread asked to replay next
+		std::string restartPath;
+		bool restart = false;
+	};
+
+}
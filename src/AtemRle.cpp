@@ -0,0 +1,361 @@
+#include "AtemRle.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OFX_ATEM_RLE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// AVX2 code is compiled per function, so the addon needs no -mavx2 and still runs on older CPUs
+#if defined(OFX_ATEM_RLE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define OFX_ATEM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define OFX_ATEM_TARGET_AVX2
+#endif
+
+namespace ofxAtem {
+namespace rle {
+
+	static inline uint64_t load64(const uint8_t* p) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		return v;
+	}
+
+	static inline void store64(uint8_t* p, uint64_t v) { memcpy(p, &v, 8); }
+
+	static inline uint64_t readCount(const uint8_t* p) {
+		uint64_t v = 0;
+		for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+		return v;
+	}
+
+	static inline void writeCount(uint8_t* p, uint64_t v) {
+		for (int i = 7; i >= 0; i--, v >>= 8) p[i] = uint8_t(v);
+	}
+
+	static inline int countTrailingZeros(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (int)index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	// Every flavour provides the scans the generic coder below is built from, on word indices
+	// into d: where the next run or marker word starts, the same while copying the literal words
+	// in front of it to out (which may also receive a few words past it), where a run of w ends,
+	// where the next marker is, and a fill of count copies of w.
+	struct ScalarScan {
+		static size_t runStart(const uint8_t* d, size_t i, size_t n) {
+			for (; i < n; i++) {
+				uint64_t w = load64(d + i * 8);
+				if (w == kRunMarker) return i;
+				if (i + 2 < n && load64(d + (i + 1) * 8) == w && load64(d + (i + 2) * 8) == w) return i;
+			}
+			return n;
+		}
+
+		static size_t copyToRunStart(const uint8_t* d, size_t i, size_t n, uint8_t* out) {
+			size_t start = runStart(d, i, n);
+			memcpy(out, d + i * 8, (start - i) * 8);
+			return start;
+		}
+
+		static size_t runEnd(const uint8_t* d, size_t i, size_t n, uint64_t w) {
+			while (i < n && load64(d + i * 8) == w) i++;
+			return i;
+		}
+
+		static size_t marker(const uint8_t* d, size_t i, size_t n) {
+			while (i < n && load64(d + i * 8) != kRunMarker) i++;
+			return i;
+		}
+
+		static void fill(uint8_t* out, uint64_t w, size_t count) {
+			for (size_t i = 0; i < count; i++) store64(out + i * 8, w);
+		}
+	};
+
+#ifdef OFX_ATEM_RLE_X86
+	// SSE2 compares 32 bit lanes only, a word is equal where both of its halves are
+	static inline __m128i cmpeq64(__m128i a, __m128i b) {
+		__m128i e = _mm_cmpeq_epi32(a, b);
+		return _mm_and_si128(e, _mm_shuffle_epi32(e, _MM_SHUFFLE(2, 3, 0, 1)));
+	}
+
+	static inline __m128i load128(const uint8_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+	static inline int mask2(__m128i v) { return _mm_movemask_pd(_mm_castsi128_pd(v)); }
+
+	struct Sse2Scan {
+		static size_t runStart(const uint8_t* d, size_t i, size_t n) {
+			const __m128i marker = _mm_set1_epi32(int(0xfefefefe));
+			// Words i..i+3 against their two successors, reading up to word i+5
+			for (; i + 6 <= n; i += 4) {
+				const uint8_t* p = d + i * 8;
+				__m128i a0 = load128(p), a1 = load128(p + 16);
+				__m128i b0 = load128(p + 8), b1 = load128(p + 24);
+				__m128i c0 = load128(p + 16), c1 = load128(p + 32);
+				__m128i h0 = _mm_or_si128(_mm_and_si128(cmpeq64(a0, b0), cmpeq64(b0, c0)), cmpeq64(a0, marker));
+				__m128i h1 = _mm_or_si128(_mm_and_si128(cmpeq64(a1, b1), cmpeq64(b1, c1)), cmpeq64(a1, marker));
+				int mask = mask2(h0) | (mask2(h1) << 2);
+				if (mask) return i + countTrailingZeros(mask);
+			}
+			return ScalarScan::runStart(d, i, n);
+		}
+
+		// Photos are nearly all literal, copying while scanning reads them once
+		static size_t copyToRunStart(const uint8_t* d, size_t i, size_t n, uint8_t* out) {
+			const __m128i marker = _mm_set1_epi32(int(0xfefefefe));
+			size_t j = i;
+			for (; j + 6 <= n; j += 4) {
+				const uint8_t* p = d + j * 8;
+				__m128i a0 = load128(p), a1 = load128(p + 16);
+				__m128i b0 = load128(p + 8), b1 = load128(p + 24);
+				__m128i c0 = load128(p + 16), c1 = load128(p + 32);
+				_mm_storeu_si128((__m128i*)(out + (j - i) * 8), a0);
+				_mm_storeu_si128((__m128i*)(out + (j - i) * 8 + 16), a1);
+				__m128i h0 = _mm_or_si128(_mm_and_si128(cmpeq64(a0, b0), cmpeq64(b0, c0)), cmpeq64(a0, marker));
+				__m128i h1 = _mm_or_si128(_mm_and_si128(cmpeq64(a1, b1), cmpeq64(b1, c1)), cmpeq64(a1, marker));
+				int mask = mask2(h0) | (mask2(h1) << 2);
+				if (mask) return j + countTrailingZeros(mask);
+			}
+			return ScalarScan::copyToRunStart(d, j, n, out + (j - i) * 8);
+		}
+
+		static size_t runEnd(const uint8_t* d, size_t i, size_t n, uint64_t w) {
+			const __m128i v = _mm_set1_epi64x((long long)w);
+			for (; i + 4 <= n; i += 4) {
+				const uint8_t* p = d + i * 8;
+				int mask = mask2(cmpeq64(load128(p), v)) | (mask2(cmpeq64(load128(p + 16), v)) << 2);
+				if (mask != 0xf) return i + countTrailingZeros(~mask & 0xf);
+			}
+			return ScalarScan::runEnd(d, i, n, w);
+		}
+
+		static size_t marker(const uint8_t* d, size_t i, size_t n) {
+			const __m128i m = _mm_set1_epi32(int(0xfefefefe));
+			for (; i + 4 <= n; i += 4) {
+				const uint8_t* p = d + i * 8;
+				int mask = mask2(cmpeq64(load128(p), m)) | (mask2(cmpeq64(load128(p + 16), m)) << 2);
+				if (mask) return i + countTrailingZeros(mask);
+			}
+			return ScalarScan::marker(d, i, n);
+		}
+
+		static void fill(uint8_t* out, uint64_t w, size_t count) {
+			const __m128i v = _mm_set1_epi64x((long long)w);
+			size_t i = 0;
+			for (; i + 2 <= count; i += 2) _mm_storeu_si128((__m128i*)(out + i * 8), v);
+			if (i < count) store64(out + i * 8, w);
+		}
+	};
+
+	struct Avx2Scan {
+		OFX_ATEM_TARGET_AVX2 static inline __m256i load256(const uint8_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+		OFX_ATEM_TARGET_AVX2 static inline int mask4(__m256i v) { return _mm256_movemask_pd(_mm256_castsi256_pd(v)); }
+
+		OFX_ATEM_TARGET_AVX2 static size_t runStart(const uint8_t* d, size_t i, size_t n) {
+			const __m256i marker = _mm256_set1_epi64x((long long)kRunMarker);
+			// Words i..i+3 against their two successors, reading up to word i+5
+			for (; i + 6 <= n; i += 4) {
+				const uint8_t* p = d + i * 8;
+				__m256i a = load256(p), b = load256(p + 8), c = load256(p + 16);
+				__m256i hit = _mm256_or_si256(_mm256_and_si256(_mm256_cmpeq_epi64(a, b), _mm256_cmpeq_epi64(b, c)), _mm256_cmpeq_epi64(a, marker));
+				int mask = mask4(hit);
+				if (mask) return i + countTrailingZeros(mask);
+			}
+			return ScalarScan::runStart(d, i, n);
+		}
+
+		OFX_ATEM_TARGET_AVX2 static size_t copyToRunStart(const uint8_t* d, size_t i, size_t n, uint8_t* out) {
+			const __m256i marker = _mm256_set1_epi64x((long long)kRunMarker);
+			size_t j = i;
+			for (; j + 6 <= n; j += 4) {
+				const uint8_t* p = d + j * 8;
+				__m256i a = load256(p), b = load256(p + 8), c = load256(p + 16);
+				_mm256_storeu_si256((__m256i*)(out + (j - i) * 8), a);
+				__m256i hit = _mm256_or_si256(_mm256_and_si256(_mm256_cmpeq_epi64(a, b), _mm256_cmpeq_epi64(b, c)), _mm256_cmpeq_epi64(a, marker));
+				int mask = mask4(hit);
+				if (mask) return j + countTrailingZeros(mask);
+			}
+			return ScalarScan::copyToRunStart(d, j, n, out + (j - i) * 8);
+		}
+
+		OFX_ATEM_TARGET_AVX2 static size_t runEnd(const uint8_t* d, size_t i, size_t n, uint64_t w) {
+			const __m256i v = _mm256_set1_epi64x((long long)w);
+			// Long runs are the common case of flat graphics, eight words per round
+			for (; i + 8 <= n; i += 8) {
+				const uint8_t* p = d + i * 8;
+				int mask = mask4(_mm256_cmpeq_epi64(load256(p), v)) | (mask4(_mm256_cmpeq_epi64(load256(p + 32), v)) << 4);
+				if (mask != 0xff) return i + countTrailingZeros(~mask & 0xff);
+			}
+			return ScalarScan::runEnd(d, i, n, w);
+		}
+
+		OFX_ATEM_TARGET_AVX2 static size_t marker(const uint8_t* d, size_t i, size_t n) {
+			const __m256i m = _mm256_set1_epi64x((long long)kRunMarker);
+			for (; i + 8 <= n; i += 8) {
+				const uint8_t* p = d + i * 8;
+				int mask = mask4(_mm256_cmpeq_epi64(load256(p), m)) | (mask4(_mm256_cmpeq_epi64(load256(p + 32), m)) << 4);
+				if (mask) return i + countTrailingZeros(mask);
+			}
+			return ScalarScan::marker(d, i, n);
+		}
+
+		OFX_ATEM_TARGET_AVX2 static void fill(uint8_t* out, uint64_t w, size_t count) {
+			const __m256i v = _mm256_set1_epi64x((long long)w);
+			size_t i = 0;
+			for (; i + 4 <= count; i += 4) _mm256_storeu_si256((__m256i*)(out + i * 8), v);
+			for (; i < count; i++) store64(out + i * 8, w);
+		}
+	};
+#endif
+
+	template<typename Scan>
+	static inline size_t encodeWith(const uint8_t* data, size_t size, uint8_t* out, size_t capacity) {
+		size_t n = size / 8;
+		size_t o = 0;
+		for (size_t i = 0; i < n;) {
+			size_t start;
+			if (o + (n - i) * 8 <= capacity) {
+				// Room for the rest as literals, so also for the words copied past the run start
+				start = Scan::copyToRunStart(data, i, n, out + o);
+			} else {
+				start = Scan::runStart(data, i, n);
+				if (o + (start - i) * 8 > capacity) return 0;
+				memcpy(out + o, data + i * 8, (start - i) * 8);
+			}
+			o += (start - i) * 8;
+			if (start == n) break;
+
+			uint64_t w = load64(data + start * 8);
+			size_t end = Scan::runEnd(data, start + 1, n, w);
+			if (o + 24 > capacity) return 0;
+			store64(out + o, kRunMarker);
+			writeCount(out + o + 8, end - start);
+			store64(out + o + 16, w);
+			o += 24;
+			i = end;
+		}
+
+		size_t tail = size % 8;
+		if (o + tail > capacity) return 0;
+		if (tail) memcpy(out + o, data + n * 8, tail);
+		return o + tail;
+	}
+
+	template<typename Scan>
+	static inline bool decodeWith(const uint8_t* data, size_t size, uint8_t* out, size_t capacity, size_t& written) {
+		size_t n = size / 8;
+		size_t o = 0;
+		written = 0;
+		for (size_t i = 0; i < n;) {
+			size_t m = Scan::marker(data, i, n);
+			size_t literal = (m - i) * 8;
+			if (o + literal > capacity) return false;
+			memcpy(out + o, data + i * 8, literal);
+			o += literal;
+			if (m == n) break;
+
+			if (m + 3 > n) return false;
+			uint64_t count = readCount(data + (m + 1) * 8);
+			if (count > (capacity - o) / 8) return false;
+			Scan::fill(out + o, load64(data + (m + 2) * 8), (size_t)count);
+			o += (size_t)count * 8;
+			i = m + 3;
+		}
+
+		size_t tail = size % 8;
+		if (o + tail > capacity) return false;
+		if (tail) memcpy(out + o, data + n * 8, tail);
+		written = o + tail;
+		return true;
+	}
+
+	static size_t encodeScalar(const uint8_t* data, size_t size, uint8_t* out, size_t capacity) { return encodeWith<ScalarScan>(data, size, out, capacity); }
+	static bool decodeScalar(const uint8_t* data, size_t size, uint8_t* out, size_t capacity, size_t& written) { return decodeWith<ScalarScan>(data, size, out, capacity, written); }
+#ifdef OFX_ATEM_RLE_X86
+	static size_t encodeSse2(const uint8_t* data, size_t size, uint8_t* out, size_t capacity) { return encodeWith<Sse2Scan>(data, size, out, capacity); }
+	static bool decodeSse2(const uint8_t* data, size_t size, uint8_t* out, size_t capacity, size_t& written) { return decodeWith<Sse2Scan>(data, size, out, capacity, written); }
+	OFX_ATEM_TARGET_AVX2 static size_t encodeAvx2(const uint8_t* data, size_t size, uint8_t* out, size_t capacity) { return encodeWith<Avx2Scan>(data, size, out, capacity); }
+	OFX_ATEM_TARGET_AVX2 static bool decodeAvx2(const uint8_t* data, size_t size, uint8_t* out, size_t capacity, size_t& written) { return decodeWith<Avx2Scan>(data, size, out, capacity, written); }
+#endif
+
+	static Isa detectIsa() {
+#ifdef OFX_ATEM_RLE_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+		// AVX2 needs both the CPU feature and the OS saving the YMM registers
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] >= 7) {
+			__cpuid(info, 1);
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			__cpuidex(info, 7, 0);
+			if (osxsave && (info[1] & (1 << 5)) && (_xgetbv(0) & 0x6) == 0x6) return kAvx2;
+		}
+		return kSse2;
+#else
+		if (__builtin_cpu_supports("avx2")) return kAvx2;
+		return __builtin_cpu_supports("sse2") ? kSse2 : kScalar;
+#endif
+#else
+		return kScalar;
+#endif
+	}
+
+	Isa getIsa() {
+		static const Isa isa = detectIsa();
+		return isa;
+	}
+
+	const char* isaToString(Isa isa) {
+		switch (isa) {
+		case kSse2: return "SSE2";
+		case kAvx2: return "AVX2";
+		default: return "scalar";
+		}
+	}
+
+	size_t encode(const uint8_t* data, size_t size, uint8_t* out, size_t capacity, Isa isa) {
+		if (isa > getIsa()) isa = getIsa();
+		switch (isa) {
+#ifdef OFX_ATEM_RLE_X86
+		case kAvx2: return encodeAvx2(data, size, out, capacity);
+		case kSse2: return encodeSse2(data, size, out, capacity);
+#endif
+		default: return encodeScalar(data, size, out, capacity);
+		}
+	}
+
+	std::vector<uint8_t> encode(const std::vector<uint8_t>& frame) {
+		std::vector<uint8_t> out(frame.size());
+		size_t size = encode(frame.data(), frame.size(), out.data(), out.size());
+		if (size == 0 && !frame.empty()) {
+			// Marker words in the frame, rare enough to pay for a second pass
+			out.resize(maxEncodedSize(frame.size()));
+			size = encode(frame.data(), frame.size(), out.data(), out.size());
+		}
+		out.resize(size);
+		return out;
+	}
+
+	bool decode(const uint8_t* data, size_t size, uint8_t* out, size_t capacity, size_t& written, Isa isa) {
+		if (isa > getIsa()) isa = getIsa();
+		switch (isa) {
+#ifdef OFX_ATEM_RLE_X86
+		case kAvx2: return decodeAvx2(data, size, out, capacity, written);
+		case kSse2: return decodeSse2(data, size, out, capacity, written);
+#endif
+		default: return decodeScalar(data, size, out, capacity, written);
+		}
+	}
+
+}
+}
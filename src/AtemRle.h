@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Run-length coding of media pool frames.
+//
+// A frame is a sequence of 64 bit words, each a pair of pixels. A run of identical words is
+// replaced by three words:
+//   [0-7]   kRunMarker
+//   [8-15]  number of words in the run, big-endian
+//   [16-23] the repeated word
+// and every other word is copied as is. Runs shorter than kMinRun stay literal, except for
+// words equal to the marker, which are always coded as a run so the decoder cannot mistake
+// them. Trailing bytes that do not fill a word are copied as is.
+//
+// Encoder and decoder come in a scalar, an SSE2 and an AVX2 flavour that produce the same
+// output; the default picks the widest one the CPU runs.
+
+namespace ofxAtem {
+namespace rle {
+
+	const uint64_t kRunMarker = 0xfefefefefefefefeull;
+	const size_t kMinRun = 3;
+
+	enum Isa {
+		kScalar,
+		kSse2,
+		kAvx2,
+	};
+
+	// Widest instruction set of this CPU the codec was built for
+	Isa getIsa();
+	const char* isaToString(Isa isa);
+
+	// Room the encoding of size bytes may need, three times its size if every word is a marker
+	inline size_t maxEncodedSize(size_t size) { return size / 8 * 24 + size % 8; }
+
+	// Encodes size bytes into out and returns the encoded size, 0 if it needs more than capacity.
+	// A frame without marker words never grows, so capacity = size is enough in practice.
+	size_t encode(const uint8_t* data, size_t size, uint8_t* out, size_t capacity, Isa isa = getIsa());
+	std::vector<uint8_t> encode(const std::vector<uint8_t>& frame);
+
+	// Decodes size bytes into out, false if they are malformed or decode to more than capacity
+	bool decode(const uint8_t* data, size_t size, uint8_t* out, size_t capacity, size_t& written, Isa isa = getIsa());
+
+}
+}
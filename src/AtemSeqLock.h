@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace ofxAtem {
+
+	// Versioned snapshot of a small trivially copyable T, stored by one writer at a time and
+	// loaded by any number of threads without locks or allocations.
+	// It keeps two copies, latch style: the writer updates one while readers are sent to the
+	// other, so a load never waits for a store in progress and is only repeated when two stores
+	// complete while it copies. The copies are held in relaxed atomic words, so the overlapping
+	// reads a seqlock relies on are not data races.
+	template<typename T>
+	class SeqLock {
+		static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+	public:
+		SeqLock() {
+			T value = T();
+			write(0, value);
+			write(1, value);
+		}
+
+		// Callers serialise stores among themselves
+		void store(const T& value) {
+			uint64_t s = sequence.load(std::memory_order_relaxed);
+
+			// Readers take copy 1 while copy 0 is written, then copy 0 while copy 1 is. Each
+			// sequence store releases the copy written before it, and the fences make a reader that
+			// saw any word of a copy being written also see the sequence moved.
+			sequence.store(s + 1, std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_release);
+			write(0, value);
+			sequence.store(s + 2, std::memory_order_release);
+			std::atomic_thread_fence(std::memory_order_release);
+			write(1, value);
+		}
+
+		// Returns the version of the snapshot copied into value, the number of stores before it
+		uint64_t load(T& value) const {
+			for (;;) {
+				uint64_t s = sequence.load(std::memory_order_acquire);
+				read(s & 1, value);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (sequence.load(std::memory_order_relaxed) == s) return s / 2;
+			}
+		}
+
+		T load() const {
+			T value;
+			load(value);
+			return value;
+		}
+
+		// Stores completed so far, the version the next load() returns at least
+		uint64_t getVersion() const { return sequence.load(std::memory_order_acquire) / 2; }
+
+	private:
+		static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+		void write(int copy, const T& value) {
+			uint64_t words[kWords] = {};
+			memcpy(words, &value, sizeof(T));
+			for (size_t i = 0; i < kWords; i++) copies[copy][i].store(words[i], std::memory_order_relaxed);
+		}
+
+		void read(int copy, T& value) const {
+			uint64_t words[kWords];
+			for (size_t i = 0; i < kWords; i++) words[i] = copies[copy][i].load(std::memory_order_relaxed);
+			memcpy(&value, words, sizeof(T));
+		}
+
+		std::atomic<uint64_t> sequence{ 0 };
+		std::atomic<uint64_t> copies[2][kWords];
+	};
+
+}
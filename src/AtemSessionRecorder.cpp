@@ -0,0 +1,137 @@
+#include "AtemSessionRecorder.h"
+
+#include <chrono>
+#include <iterator>
+
+#include "ofLog.h"
+
+#include "AtemProtocol.h"
+
+namespace ofxAtem {
+
+	using namespace protocol;
+
+	static const uint32_t kRecordingMagic = fourcc("AtRc");
+	static const uint16_t kRecordingFormat = 1;
+	static const size_t kRecordingHeaderSize = 6;
+
+	static uint64_t monotonicMicros() {
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// LEB128, the deltas between datagrams mostly fit in one or two bytes
+	static size_t writeVarint(uint8_t* p, uint64_t v) {
+		size_t n = 0;
+		while (v >= 0x80) {
+			p[n++] = uint8_t(v | 0x80);
+			v >>= 7;
+		}
+		p[n++] = uint8_t(v);
+		return n;
+	}
+
+	static bool readVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+		v = 0;
+		for (int shift = 0; p < end && shift < 64; shift += 7) {
+			uint8_t b = *p++;
+			v |= uint64_t(b & 0x7f) << shift;
+			if (!(b & 0x80)) return true;
+		}
+		return false;
+	}
+
+	bool SessionRecorder::open(const std::string& path) {
+		close();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		file.open(path, std::ios::binary | std::ios::trunc);
+		uint8_t header[kRecordingHeaderSize];
+		writeU32(header, kRecordingMagic);
+		writeU16(header + 4, kRecordingFormat);
+		if (!file || !file.write((const char*)header, sizeof(header))) {
+			ofLogError(__FUNCTION__) << "Could not open " << path << " for recording";
+			file.close();
+			return false;
+		}
+
+		lastMicros = monotonicMicros();
+		recorded = 0;
+		recording = true;
+		return true;
+	}
+
+	void SessionRecorder::close() {
+		std::lock_guard<std::mutex> lock(mutex);
+		recording = false;
+		if (file.is_open()) file.close();
+	}
+
+	void SessionRecorder::record(RecordedDirection direction, const uint8_t* data, size_t size) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!recording) return;
+
+		uint64_t now = monotonicMicros();
+		uint8_t header[1 + 10 + 10];
+		size_t headerSize = 0;
+		header[headerSize++] = direction;
+		headerSize += writeVarint(header + headerSize, now - lastMicros);
+		headerSize += writeVarint(header + headerSize, size);
+		lastMicros = now;
+
+		if (!file.write((const char*)header, headerSize) || !file.write((const char*)data, size)) {
+			ofLogError(__FUNCTION__) << "Recording stopped, the file could not be written";
+			recording = false;
+			return;
+		}
+		recorded++;
+	}
+
+	bool SessionReader::open(const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			ofLogError(__FUNCTION__) << "Could not open recording " << path;
+			return false;
+		}
+
+		data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		if (data.size() < kRecordingHeaderSize || readU32(data.data()) != kRecordingMagic || readU16(data.data() + 4) != kRecordingFormat) {
+			ofLogError(__FUNCTION__) << path << " is not a session recording";
+			data.clear();
+			return false;
+		}
+
+		// One pass up front for the duration
+		rewind();
+		Entry entry;
+		while (next(entry)) {}
+		durationMicros = micros;
+		rewind();
+		return true;
+	}
+
+	void SessionReader::rewind() {
+		offset = kRecordingHeaderSize;
+		micros = 0;
+	}
+
+	bool SessionReader::next(Entry& entry) {
+		if (offset >= data.size()) return false;
+
+		const uint8_t* p = data.data() + offset;
+		const uint8_t* end = data.data() + data.size();
+		uint64_t delta, size;
+		entry.direction = RecordedDirection(*p++);
+		if (!readVarint(p, end, delta) || !readVarint(p, end, size) || size > uint64_t(end - p)) {
+			offset = data.size();
+			return false;
+		}
+
+		micros += delta;
+		entry.micros = micros;
+		entry.data = p;
+		entry.size = (size_t)size;
+		offset = (p - data.data()) + entry.size;
+		return true;
+	}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ofxAtem {
+
+	// Direction of a recorded datagram
+	enum RecordedDirection : uint8_t {
+		kFromSwitcher = 0,
+		kToSwitcher = 1,
+	};
+
+	// Append-only capture of the datagrams of a native session, for reproducing a show offline.
+	// After a short file header each datagram is stored as
+	//   direction (1 byte), microseconds since the previous one (varint), size (varint), datagram
+	// with timestamps from the monotonic clock. record() is safe to call from any thread.
+	class SessionRecorder {
+	public:
+		SessionRecorder() {}
+		~SessionRecorder() { close(); }
+
+		bool open(const std::string& path);
+		void close();
+		bool isOpen() const { return recording; }
+
+		void record(RecordedDirection direction, const uint8_t* data, size_t size);
+
+		uint64_t getRecordedCount() const { return recorded; }
+
+	private:
+		std::mutex mutex;
+		std::ofstream file;
+		std::atomic<bool> recording{ false };
+		std::atomic<uint64_t> recorded{ 0 };
+		uint64_t lastMicros = 0;
+	};
+
+	// Reads a SessionRecorder file back, entry by entry, straight out of memory
+	class SessionReader {
+	public:
+		struct Entry {
+			RecordedDirection direction = kFromSwitcher;
+			uint64_t micros = 0;	// since the recording started
+			const uint8_t* data = nullptr;
+			size_t size = 0;
+		};
+
+		bool open(const std::string& path);
+		// Back to the first entry
+		void rewind();
+		// False at the end of the recording or on a truncated entry
+		bool next(Entry& entry);
+
+		uint64_t getDurationMicros() const { return durationMicros; }
+
+	private:
+		std::vector<uint8_t> data;
+		size_t offset = 0;
+		uint64_t micros = 0;
+		uint64_t durationMicros = 0;
+	};
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace ofxAtem {
+
+	// Bounded queue from one producer thread to one consumer thread, lock-free and allocation
+	// free. push() never waits: it fails when the queue is full and leaves it to the producer
+	// what to do about it. Capacity is a power of two.
+	// Each side keeps its index on a cache line of its own, with a cached copy of the other
+	// side's, so neither touches the other's line unless the queue looks full or empty.
+	template<typename T, size_t Capacity>
+	class SpscQueue {
+		static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+	public:
+		// Producer side
+		bool push(const T& value) {
+			size_t t = tail.load(std::memory_order_relaxed);
+			if (t - cachedHead == Capacity) {
+				cachedHead = head.load(std::memory_order_acquire);
+				if (t - cachedHead == Capacity) return false;
+			}
+			slots[t & (Capacity - 1)] = value;
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer side
+		bool pop(T& value) {
+			size_t h = head.load(std::memory_order_relaxed);
+			if (h == cachedTail) {
+				cachedTail = tail.load(std::memory_order_acquire);
+				if (h == cachedTail) return false;
+			}
+			value = slots[h & (Capacity - 1)];
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer side, drops whatever is queued
+		void clear() {
+			T value;
+			while (pop(value)) {}
+		}
+
+		// From either side, a snapshot that may be stale by the time it returns
+		size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+		static constexpr size_t capacity() { return Capacity; }
+
+	private:
+		alignas(64) std::atomic<size_t> head{ 0 };	// next slot to pop
+		size_t cachedTail = 0;	// consumer's copy of tail
+		alignas(64) std::atomic<size_t> tail{ 0 };	// next slot to push
+		size_t cachedHead = 0;	// producer's copy of head
+		alignas(64) std::array<T, Capacity> slots;
+	};
+
+}
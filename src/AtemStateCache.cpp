@@ -0,0 +1,63 @@
+#include "AtemStateCache.h"
+
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+#include "ofFileUtils.h"
+#include "ofLog.h"
+
+namespace ofxAtem {
+
+	using namespace protocol;
+
+	static const uint32_t kCacheMagic = fourcc("AtSC");
+	static const uint16_t kCacheFormat = 1;
+	static const size_t kCacheHeaderSize = 6;
+
+	bool StateCache::load(const std::string& productName, const Version& version, std::vector<uint8_t>& records) {
+		if (!isEnabled()) return false;
+
+		std::ifstream file(getPath(productName, version), std::ios::binary);
+		if (!file) return false;
+
+		std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if (data.size() < kCacheHeaderSize || readU32(data.data()) != kCacheMagic || readU16(data.data() + 4) != kCacheFormat) {
+			ofLogWarning(__FUNCTION__) << "Ignoring unreadable state cache for " << productName;
+			return false;
+		}
+
+		records.assign(data.begin() + kCacheHeaderSize, data.end());
+		return true;
+	}
+
+	bool StateCache::save(const SwitcherState& state) {
+		if (!isEnabled() || state.productName.empty()) return false;
+
+		std::vector<uint8_t> data(kCacheHeaderSize);
+		writeU32(data.data(), kCacheMagic);
+		writeU16(data.data() + 4, kCacheFormat);
+
+		encodeState(state, data);
+
+		if (!ofDirectory::doesDirectoryExist(directory, false)) {
+			ofDirectory::createDirectory(directory, false, true);
+		}
+
+		std::ofstream file(getPath(state.productName, state.version), std::ios::binary | std::ios::trunc);
+		if (!file.write((const char*)data.data(), data.size())) {
+			ofLogError(__FUNCTION__) << "Could not write state cache to " << directory;
+			return false;
+		}
+		return true;
+	}
+
+	std::string StateCache::getPath(const std::string& productName, const Version& version) const {
+		std::string name;
+		for (char c : productName) {
+			name += std::isalnum((unsigned char)c) ? c : '-';
+		}
+		return ofFilePath::join(directory, name + "-" + std::to_string(version.major) + "." + std::to_string(version.minor) + ".cache");
+	}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AtemProtocol.h"
+#include "AtemSwitcherState.h"
+
+namespace ofxAtem {
+
+	// Last synced SwitcherState of each switcher model, kept on disk so a reconnect can
+	// show inputs and tally before the live state dump is in.
+	// Files are keyed by product name and protocol version and hold the same records the
+	// switcher sends, so loading one is a replay through the usual record parser.
+	class StateCache {
+	public:
+		// Empty disables the cache
+		void setDirectory(const std::string& directory) { this->directory = directory; }
+		bool isEnabled() const { return !directory.empty(); }
+
+		// Records of the snapshot for this switcher, false if there is none
+		bool load(const std::string& productName, const protocol::Version& version, std::vector<uint8_t>& records);
+		bool save(const SwitcherState& state);
+
+	private:
+		std::string getPath(const std::string& productName, const protocol::Version& version) const;
+
+		std::string directory;
+	};
+
+}
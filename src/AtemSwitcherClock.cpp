@@ -0,0 +1,220 @@
+#include "AtemSwitcherClock.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ofUtils.h"
+
+namespace ofxAtem {
+
+	// Frame numbers dropped per minute in drop-frame timecode, 0 if the rate has none
+	static int droppedFrames(const FrameRate& rate, bool dropFrame) {
+		int base = rate.timecodeBase();
+		return dropFrame && base % 30 == 0 ? base / 15 : 0;
+	}
+
+	int64_t timecodeToFrame(const Timecode& timecode, const FrameRate& rate) {
+		int64_t base = rate.timecodeBase();
+		int64_t minutes = 60 * timecode.hours + timecode.minutes;
+		int64_t frame = (60 * minutes + timecode.seconds) * base + timecode.frames;
+		return frame - droppedFrames(rate, timecode.dropFrame) * (minutes - minutes / 10);
+	}
+
+	Timecode frameToTimecode(int64_t frame, const FrameRate& rate, bool dropFrame) {
+		Timecode timecode;
+		timecode.dropFrame = dropFrame;
+		int64_t base = rate.timecodeBase();
+		if (base == 0) return timecode;
+
+		int64_t day = framesPerDay(rate, dropFrame);
+		frame %= day;
+		if (frame < 0) frame += day;
+
+		// Put the skipped frame numbers back, then it splits like non-drop timecode
+		int64_t drop = droppedFrames(rate, dropFrame);
+		if (drop) {
+			int64_t perMinute = base * 60 - drop;
+			int64_t perTenMinutes = base * 600 - drop * 9;
+			int64_t tens = frame / perTenMinutes;
+			int64_t rest = frame % perTenMinutes;
+			frame += drop * 9 * tens + (rest > drop ? drop * ((rest - drop) / perMinute) : 0);
+		}
+
+		timecode.frames = uint8_t(frame % base);
+		timecode.seconds = uint8_t(frame / base % 60);
+		timecode.minutes = uint8_t(frame / (base * 60) % 60);
+		timecode.hours = uint8_t(frame / (base * 3600) % 24);
+		return timecode;
+	}
+
+	int64_t framesPerDay(const FrameRate& rate, bool dropFrame) {
+		int64_t base = rate.timecodeBase();
+		int64_t drop = droppedFrames(rate, dropFrame);
+		return (base * 600 - drop * 9) * 144;
+	}
+
+	void SwitcherClock::setFrameRate(const FrameRate& newRate) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (newRate.numerator == rate.numerator && newRate.denominator == rate.denominator) return;
+		rate = newRate;
+		if (count) resets++;
+		clear();
+		dayOffset = 0;
+		lastFrame = -1;
+	}
+
+	FrameRate SwitcherClock::getFrameRate() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return rate;
+	}
+
+	void SwitcherClock::addTimecode(const Timecode& timecode, uint64_t localMicros) {
+		int64_t frame;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!rate.isValid()) return;
+			dropFrame = timecode.dropFrame;
+
+			// A timecode far behind the last one is taken for the next day
+			int64_t day = framesPerDay(rate, dropFrame);
+			frame = timecodeToFrame(timecode, rate) + dayOffset;
+			if (lastFrame >= 0 && frame < lastFrame - day / 2) {
+				dayOffset += day;
+				frame += day;
+			}
+		}
+		addFrame(frame, localMicros);
+	}
+
+	void SwitcherClock::addFrame(int64_t frame, uint64_t localMicros) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!rate.isValid() || frame == lastFrame) return;
+		lastFrame = frame;
+
+		if (count) {
+			double residual = (double(int64_t(localMicros - originMicros)) - offsetMicros) - (frame - originFrame) * periodMicros;
+			if (residual < -kMaxEarlyFrames * periodMicros) {
+				// Ahead of anything the line allows, the timecode jumped forward
+				resets++;
+				clear();
+			} else if (residual > kMaxLateFrames * periodMicros) {
+				if (++lateRun < kMaxLateRun) {
+					lateSamples++;
+					return;
+				}
+				// Late every time, the timecode jumped back
+				resets++;
+				clear();
+			} else {
+				lateRun = 0;
+			}
+		}
+
+		Sample& sample = samples[(first + count) % kMaxSamples];
+		if (count == kMaxSamples) first = (first + 1) % kMaxSamples;
+		else count++;
+		sample.frame = frame;
+		sample.micros = localMicros;
+		fit();
+	}
+
+	void SwitcherClock::reset() {
+		std::lock_guard<std::mutex> lock(mutex);
+		clear();
+		dayOffset = 0;
+		lastFrame = -1;
+	}
+
+	bool SwitcherClock::isLocked() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return count >= kMinSamples;
+	}
+
+	ClockEstimate SwitcherClock::getEstimate() {
+		std::lock_guard<std::mutex> lock(mutex);
+		ClockEstimate estimate;
+		estimate.locked = count >= kMinSamples;
+		estimate.frameRate = rate;
+		if (periodMicros > 0) estimate.framesPerSecond = 1e6 / periodMicros;
+		if (estimate.locked) estimate.driftPpm = (nominalPeriod() / periodMicros - 1) * 1e6;
+		estimate.jitterMicros = jitterMicros;
+		estimate.samples = count;
+		estimate.resets = resets;
+		estimate.lateSamples = lateSamples;
+		return estimate;
+	}
+
+	double SwitcherClock::frameAt(uint64_t localMicros) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return frameAtLocked(localMicros);
+	}
+
+	int64_t SwitcherClock::getCurrentFrame() {
+		return (int64_t)std::floor(frameAt(ofGetElapsedTimeMicros()));
+	}
+
+	uint64_t SwitcherClock::timeOfFrame(int64_t frame) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (count == 0) return 0;
+		double micros = double(originMicros) + offsetMicros + (frame - originFrame) * periodMicros;
+		return micros > 0 ? uint64_t(std::llround(micros)) : 0;
+	}
+
+	Timecode SwitcherClock::timecodeOf(int64_t frame) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return frameToTimecode(frame, rate, dropFrame);
+	}
+
+	void SwitcherClock::clear() {
+		first = count = 0;
+		lateRun = 0;
+		originFrame = 0;
+		originMicros = 0;
+		offsetMicros = periodMicros = jitterMicros = 0;
+	}
+
+	void SwitcherClock::fit() {
+		const Sample& origin = samples[first];
+		originFrame = origin.frame;
+		originMicros = origin.micros;
+
+		// Until locked there are too few timecodes to tell drift from jitter
+		double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+		for (size_t i = 0; i < count; i++) {
+			const Sample& s = samples[(first + i) % kMaxSamples];
+			double x = double(s.frame - originFrame);
+			double y = double(int64_t(s.micros - originMicros));
+			sumX += x;
+			sumY += y;
+			sumXX += x * x;
+			sumXY += x * y;
+		}
+		double n = double(count);
+		double denominator = n * sumXX - sumX * sumX;
+		periodMicros = nominalPeriod();
+		if (count >= kMinSamples && denominator > 0) {
+			double period = (n * sumXY - sumX * sumY) / denominator;
+			if (period > 0) periodMicros = period;
+		}
+
+		// Jitter about the least squares line, offset from the earliest arrivals
+		double intercept = (sumY - periodMicros * sumX) / n;
+		double sumSquares = 0;
+		offsetMicros = 0;
+		for (size_t i = 0; i < count; i++) {
+			const Sample& s = samples[(first + i) % kMaxSamples];
+			double x = double(s.frame - originFrame);
+			double y = double(int64_t(s.micros - originMicros));
+			double residual = y - intercept - periodMicros * x;
+			sumSquares += residual * residual;
+			offsetMicros = i == 0 ? y - periodMicros * x : std::min(offsetMicros, y - periodMicros * x);
+		}
+		jitterMicros = std::sqrt(sumSquares / n);
+	}
+
+	double SwitcherClock::frameAtLocked(uint64_t localMicros) const {
+		if (count == 0) return 0;
+		return originFrame + (double(int64_t(localMicros - originMicros)) - offsetMicros) / periodMicros;
+	}
+
+}
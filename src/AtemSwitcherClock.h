@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+#include "AtemTypes.h"
+
+namespace ofxAtem {
+
+	// Frames since 00:00:00:00, and back. Drop-frame timecode skips the first two frame numbers
+	// (four at 59.94) of every minute not divisible by ten.
+	int64_t timecodeToFrame(const Timecode& timecode, const FrameRate& rate);
+	Timecode frameToTimecode(int64_t frame, const FrameRate& rate, bool dropFrame);
+	// Frames in 24 hours of timecode
+	int64_t framesPerDay(const FrameRate& rate, bool dropFrame);
+
+	// What SwitcherClock knows about the switcher's frame clock
+	struct ClockEstimate {
+		bool locked = false;	// enough timecodes since the last reset to trust the estimate
+		FrameRate frameRate;	// of the video mode
+		double framesPerSecond = 0;	// as measured against the local clock
+		// Of the switcher against the local clock, positive if it runs fast. Fitted over the samples,
+		// so only good to about jitterMicros * sqrt(12 / samples) / (samples frame periods).
+		double driftPpm = 0;
+		double jitterMicros = 0;	// RMS of the timecode arrivals about the fitted line
+		size_t samples = 0;	// timecodes the fit is over
+		uint64_t resets = 0;	// timecode jumps and video mode changes that started it over
+		uint64_t lateSamples = 0;	// timecodes left out of the fit for arriving too late
+	};
+
+	// Local clock disciplined to the switcher's timecode.
+	// Backends feed it every timecode along with the local time it arrived at. A least squares
+	// line through the last kMaxSamples of them gives the switcher's frame period in local
+	// microseconds, so its drift against the local clock, and the line is then lowered onto
+	// the earliest arrivals: network and polling delays only ever make a timecode late, so
+	// those are closest to when the switcher started the frame. Frames are numbered from
+	// 00:00:00:00 and keep counting past midnight.
+	//
+	// Local times are ofGetElapsedTimeMicros(). Fed from the backend's thread, read from any.
+	class SwitcherClock {
+	public:
+		static constexpr size_t kMaxSamples = 512;
+		// Timecodes needed after a reset before the estimate is locked
+		static constexpr size_t kMinSamples = 16;
+
+		// Resets the clock if the rate changed
+		void setFrameRate(const FrameRate& rate);
+		FrameRate getFrameRate();
+
+		// A timecode received at localMicros. Repeats of the last one are ignored, the first
+		// arrival is the better one.
+		void addTimecode(const Timecode& timecode, uint64_t localMicros);
+		void addFrame(int64_t frame, uint64_t localMicros);
+		void reset();
+
+		bool isLocked();
+		ClockEstimate getEstimate();
+
+		// Frame on air at localMicros, with the fraction of it elapsed; 0 before the first timecode
+		double frameAt(uint64_t localMicros);
+		int64_t getCurrentFrame();
+		// Local time frame starts at, 0 before the first timecode
+		uint64_t timeOfFrame(int64_t frame);
+		// Timecode of a frame, with the drop-frame flag of the last one received
+		Timecode timecodeOf(int64_t frame);
+
+	private:
+		// Timecodes arriving more than this many frames behind the line are left out of the fit,
+		// this many in a row mean the timecode jumped back
+		static constexpr double kMaxLateFrames = 3;
+		static constexpr int kMaxLateRun = 8;
+		// A timecode this far ahead of the line means it jumped forward
+		static constexpr double kMaxEarlyFrames = 2;
+
+		struct Sample {
+			int64_t frame = 0;
+			uint64_t micros = 0;
+		};
+
+		// The following expect mutex to be held
+		void clear();
+		void fit();
+		double frameAtLocked(uint64_t localMicros) const;
+		double nominalPeriod() const { return rate.isValid() ? 1e6 * rate.denominator / rate.numerator : 0; }
+
+		std::mutex mutex;
+		FrameRate rate;
+		bool dropFrame = false;
+		int64_t dayOffset = 0;	// frames added for each midnight passed
+		int64_t lastFrame = -1;
+
+		std::array<Sample, kMaxSamples> samples;
+		size_t first = 0;	// oldest sample
+		size_t count = 0;
+		int lateRun = 0;
+		uint64_t resets = 0;
+		uint64_t lateSamples = 0;
+
+		// Fitted line: frame f starts at originMicros + offsetMicros + (f - originFrame) * periodMicros
+		int64_t originFrame = 0;
+		uint64_t originMicros = 0;
+		double offsetMicros = 0;
+		double periodMicros = 0;
+		double jitterMicros = 0;
+	};
+
+}
@@ -0,0 +1,62 @@
+#include "AtemSwitcherState.h"
+
+namespace ofxAtem {
+
+	using namespace protocol;
+
+	static void appendRecord(std::vector<uint8_t>& records, uint32_t name, const uint8_t* payload, size_t payloadSize) {
+		size_t offset = records.size();
+		records.resize(offset + kRecordHeaderSize + payloadSize);
+
+		uint8_t* p = records.data() + offset;
+		writeU16(p, uint16_t(kRecordHeaderSize + payloadSize));
+		writeU16(p + 2, 0);
+		writeU32(p + 4, name);
+		memcpy(p + kRecordHeaderSize, payload, payloadSize);
+	}
+
+	void encodeState(const SwitcherState& state, std::vector<uint8_t>& records) {
+		uint8_t payload[kProductNameSize];
+
+		encode(state.version, payload);
+		appendRecord(records, state::kVersion, payload, kVersionSize);
+		encode(state.productName, payload);
+		appendRecord(records, state::kProductName, payload, kProductNameSize);
+		encode(state.topology, payload);
+		appendRecord(records, state::kTopology, payload, kTopologySize);
+		for (auto& config : state.mixEffectBlocks) {
+			encode(config, payload);
+			appendRecord(records, state::kMixEffectConfig, payload, kMixEffectConfigSize);
+		}
+		encode(state.mediaPool, payload);
+		appendRecord(records, state::kMediaPoolConfig, payload, kMediaPoolConfigSize);
+		encode(state.videoMode, payload);
+		appendRecord(records, state::kVideoMode, payload, kVideoModeSize);
+
+		for (auto& input : state.inputs) {
+			encode(input, payload);
+			appendRecord(records, state::kInputProperties, payload, kInputPropertiesSize);
+		}
+
+		for (size_t me = 0; me < state.programInputs.size(); me++) {
+			encode(InputSelection{ uint8_t(me), state.programInputs[me] }, payload);
+			appendRecord(records, state::kProgramInput, payload, kInputSelectionSize);
+			encode(InputSelection{ uint8_t(me), state.previewInputs[me] }, payload);
+			appendRecord(records, state::kPreviewInput, payload, kInputSelectionSize);
+			encode(state.transitions[me], payload);
+			appendRecord(records, state::kTransitionPosition, payload, kTransitionPositionSize);
+
+			int keyers = me < state.mixEffectBlocks.size() ? state.mixEffectBlocks[me].keyers : 0;
+			for (int keyer = 0; keyer < keyers && keyer < 16; keyer++) {
+				encode(KeyerOnAir{ uint8_t(me), uint8_t(keyer), (state.keyersOnAir[me] & (1 << keyer)) != 0 }, payload);
+				appendRecord(records, state::kKeyerOnAir, payload, kKeyerOnAirSize);
+			}
+		}
+
+		for (size_t aux = 0; aux < state.auxSources.size(); aux++) {
+			encode(AuxSource{ uint8_t(aux), state.auxSources[aux] }, payload);
+			appendRecord(records, state::kAuxSource, payload, kAuxSourceSize);
+		}
+	}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AtemProtocol.h"
+
+namespace ofxAtem {
+
+	// Mirror of the switcher state received over the native protocol
+	struct SwitcherState {
+		std::string productName;
+		protocol::Version version;
+		protocol::Topology topology;
+		protocol::MediaPoolConfig mediaPool;
+		protocol::VideoMode videoMode;
+		std::vector<protocol::MixEffectConfig> mixEffectBlocks;
+		std::vector<protocol::InputProperties> inputs;
+		std::vector<uint16_t> programInputs;	// per ME
+		std::vector<uint16_t> previewInputs;	// per ME
+		std::vector<protocol::TransitionPosition> transitions;	// per ME
+		std::vector<uint16_t> keyersOnAir;	// per ME, one bit per upstream keyer
+		std::vector<uint16_t> auxSources;	// per aux output
+	};
+
+	// Appends the records a switcher would send to describe state, in dump order and without
+	// InCm. Read back through the usual record parser they give the same SwitcherState.
+	void encodeState(const SwitcherState& state, std::vector<uint8_t>& records);
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Backend availability.
+// The COM backend needs the Windows ATEM Switchers SDK, the native UDP backend needs POSIX sockets.
+// Elsewhere OFX_ATEM_COM_COMPAT builds the COM backend too, against the COM shim and the
+// in-memory switcher of libs/compat, so it can be run and measured without Windows.
+#ifdef _WIN32
+#define OFX_ATEM_HAS_COM
+#else
+#define OFX_ATEM_HAS_NATIVE
+#ifdef OFX_ATEM_COM_COMPAT
+#define OFX_ATEM_HAS_COM
+#endif
+#endif
+
+// Backend used by ofxAtem::Device unless another one is picked with BasicDevice<...>
+#if !defined(OFX_ATEM_USE_COM) && !defined(OFX_ATEM_USE_NATIVE)
+#ifdef _WIN32
+#define OFX_ATEM_USE_COM
+#else
+#define OFX_ATEM_USE_NATIVE
+#endif
+#endif
+
+#ifdef OFX_ATEM_HAS_COM
+
+#include "BMDSwitcherAPI_h.h"
+
+#else
+
+// Without the SDK header, mirror the few SDK types that are part of the public Device API
+// so application code is identical on every platform.
+typedef long long BMDSwitcherInputId;
+
+typedef enum _BMDSwitcherMixEffectBlockEventType {
+	bmdSwitcherMixEffectBlockEventTypeProgramInputChanged = 0x70676943,
+	bmdSwitcherMixEffectBlockEventTypePreviewInputChanged = 0x70766943,
+	bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged = 0x74737043,
+	bmdSwitcherMixEffectBlockEventTypeTransitionFramesRemainingChanged = 0x74667243,
+	bmdSwitcherMixEffectBlockEventTypeInTransitionChanged = 0x69697443,
+	bmdSwitcherMixEffectBlockEventTypeFadeToBlackFramesRemainingChanged = 0x66667243,
+	bmdSwitcherMixEffectBlockEventTypeInFadeToBlackChanged = 0x69666243,
+	bmdSwitcherMixEffectBlockEventTypePreviewLiveChanged = 0x70766c43,
+	bmdSwitcherMixEffectBlockEventTypePreviewTransitionChanged = 0x70767443,
+	bmdSwitcherMixEffectBlockEventTypeInputAvailabilityMaskChanged = 0x61766d43,
+	bmdSwitcherMixEffectBlockEventTypeFadeToBlackRateChanged = 0x66627243,
+	bmdSwitcherMixEffectBlockEventTypeFadeToBlackFullyBlackChanged = 0x66626243,
+	bmdSwitcherMixEffectBlockEventTypeFadeToBlackInTransitionChanged = 0x66627443
+} BMDSwitcherMixEffectBlockEventType;
+
+#endif
+
+namespace ofxAtem {
+
+	struct Input {
+		std::string shortName;
+		std::string longName;
+		BMDSwitcherInputId bmdId;
+		int index;
+		std::string portType;
+	};
+
+	// An upstream keyer of a mix effect block went on or off air. The SDK reports that through
+	// the keyer's own callback; Device passes it on with the mix effect block events, as this type.
+	const BMDSwitcherMixEffectBlockEventType kKeyerOnAirChanged = BMDSwitcherMixEffectBlockEventType(0x6b6f6143);	// 'koaC'
+
+	// A mix effect block event, with the block it happened on
+	struct MixEffectEvent {
+		int me = 0;
+		BMDSwitcherMixEffectBlockEventType type = bmdSwitcherMixEffectBlockEventTypeProgramInputChanged;
+	};
+
+	// Transition of a mix effect block
+	struct TransitionState {
+		bool inTransition = false;
+		double position = 0;	// 0 - 1
+		int framesRemaining = 0;
+
+		bool operator==(const TransitionState& o) const { return inTransition == o.inTransition && position == o.position && framesRemaining == o.framesRemaining; }
+		bool operator!=(const TransitionState& o) const { return !(*this == o); }
+	};
+
+	// Program, preview, transition and keyers of a mix effect block, as Device last read them
+	struct MixEffectState {
+		BMDSwitcherInputId program = -1;
+		BMDSwitcherInputId preview = -1;
+		int programIndex = -1;	// in the input map, -1 until known
+		int previewIndex = -1;
+		TransitionState transition;
+		uint32_t keyersOnAir = 0;	// one bit per upstream keyer
+
+		bool operator==(const MixEffectState& o) const {
+			return program == o.program && preview == o.preview && programIndex == o.programIndex && previewIndex == o.previewIndex &&
+				transition == o.transition && keyersOnAir == o.keyersOnAir;
+		}
+		bool operator!=(const MixEffectState& o) const { return !(*this == o); }
+	};
+
+	// Switcher timecode, as the SDK's GetTimeCode reports it
+	struct Timecode {
+		uint8_t hours = 0;
+		uint8_t minutes = 0;
+		uint8_t seconds = 0;
+		uint8_t frames = 0;
+		bool dropFrame = false;
+	};
+
+	// Frame rate of a video mode, e.g. 30000 / 1001 for 1080p29.97. Interlaced modes count
+	// frames, not fields, like their timecode does.
+	struct FrameRate {
+		uint32_t numerator = 0;
+		uint32_t denominator = 1;
+
+		bool isValid() const { return numerator > 0 && denominator > 0; }
+		double framesPerSecond() const { return isValid() ? double(numerator) / denominator : 0; }
+		// Frames per timecode second, 30 for 29.97
+		int timecodeBase() const { return isValid() ? int((numerator + denominator - 1) / denominator) : 0; }
+	};
+
+}
@@ -0,0 +1,117 @@
+#include "AtemUdpBackend.h"
+
+#include <cstdio>
+
+namespace ofxAtem {
+
+	bool UdpBackend::open(const std::string& address) {
+		if (!client.open(address)) return false;
+
+		this->address = address;
+		synced = online = finished = false;
+		syncDeadline = ofGetElapsedTimeMillis() + kSyncTimeoutMs;
+		reconnectMillis = 0;
+		backoffMs = kReconnectMinBackoffMs;
+		return true;
+	}
+
+	void UdpBackend::close() {
+		{
+			std::lock_guard<std::mutex> lock(restartMutex);
+			running = false;
+			restart = false;
+		}
+		// From a listener on the receive thread, which closes the client once its poll() returns
+		if (std::this_thread::get_id() == receiveThread.get_id()) return;
+
+		if (receiveThread.joinable()) {
+			receiveThread.join();
+		}
+		transfer.cancel();
+		client.close();
+	}
+
+	void UdpBackend::printInfo() {
+		printInfo(client.getState());
+	}
+
+	void UdpBackend::printInfo(const SwitcherState& state) {
+
+		printf(" %-40s %s\n", "Product Name:", state.productName.c_str());
+		printf(" %-40s %d.%d\n", "Protocol Version:", state.version.major, state.version.minor);
+
+		// Print Mix Effect block count
+		printf(" %-40s %d\n", "Number of Mix Effect Blocks:", (int)state.mixEffectBlocks.size());
+		for (unsigned int i = 0; i < state.mixEffectBlocks.size(); i++) {
+			printf(" - Number of Upstream Keyers for ME%d:     %d\n", i, state.mixEffectBlocks[i].keyers);
+		}
+		printf(" %-40s %d\n", "Number of Downstream Keyers", state.topology.downstreamKeyers);
+
+		// Print swicther input type counts
+		auto countPortType = [&](uint8_t portType) {
+			int count = 0;
+			for (auto& input : state.inputs) {
+				if (input.internalPortType == portType) count++;
+			}
+			return count;
+		};
+		printf(" %-40s %d\n", "Number of External Inputs:", countPortType(protocol::kPortExternal));
+		printf(" %-40s %d\n", "Number of SuperSources:", countPortType(protocol::kPortSuperSource));
+		printf(" %-40s %d\n", "Number of Media Players:", countPortType(protocol::kPortMediaPlayerFill));
+		printf(" %-40s %d\n", "Number of AUX Outputs:", countPortType(protocol::kPortAuxOutput));
+
+		printf(" %-40s %u\n", "Number of Stills in Media Pool:", state.mediaPool.stills);
+		printf(" %-40s %u\n", "Number of Clips in Media Pool:", state.mediaPool.clips);
+
+		printf("\nSwitcher Inputs:\n");
+		for (auto& input : state.inputs) {
+			printf(" %-6d %-24s %-8s %s\n", input.id, input.longName, input.shortName,
+				protocol::portTypeToString(input.internalPortType, input.externalPortType).c_str());
+		}
+
+	}
+
+	std::string UdpBackend::getProductName() {
+		return client.getState().productName;
+	}
+
+	bool UdpBackend::readInputs(std::vector<ofPtr<Input>>& inputs) {
+		return readInputs(client.getState(), inputs);
+	}
+
+	bool UdpBackend::readInputs(const SwitcherState& state, std::vector<ofPtr<Input>>& inputs) {
+
+		int index = 0;
+		for (auto& input : state.inputs) {
+			ofPtr<Input> inputPtr = std::make_shared<Input>();
+			inputPtr->bmdId = input.id;
+			inputPtr->index = index;
+			inputPtr->longName = input.longName;
+			inputPtr->shortName = input.shortName;
+			inputPtr->portType = protocol::portTypeToString(input.internalPortType, input.externalPortType);
+
+			inputs.push_back(std::move(inputPtr));
+
+			index++;
+		}
+
+		return true;
+	}
+
+	bool UdpBackend::getTransition(UdpClient& client, int me, TransitionState& transition) {
+		protocol::TransitionPosition position;
+		if (!client.getTransition(me, position)) return false;
+		transition.inTransition = position.inTransition;
+		transition.position = position.position / 10000.0;
+		transition.framesRemaining = position.framesRemaining;
+		return true;
+	}
+
+	bool UdpBackend::getKeyersOnAir(UdpClient& client, int me, uint32_t& onAir) {
+		uint16_t keyers;
+		if (!client.getKeyersOnAir(me, keyers)) return false;
+		onAir = keyers;
+		return true;
+	}
+
+}
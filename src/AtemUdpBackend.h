@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ofLog.h"
+#include "ofTypes.h"
+#include "ofUtils.h"
+
+#include "AtemMediaTransfer.h"
+#include "AtemTypes.h"
+#include "AtemUdpClient.h"
+
+namespace ofxAtem {
+
+	// Device backend over the native UDP control protocol.
+	// The receive thread is instantiated for the concrete sink, so MixEffectBlock events
+	// go from the packet parser to Device::onMixEffectBlockUpdated without any indirection.
+	// connect() only opens the socket; the state dump is parsed as its packets arrive and
+	// the sink hears onBackendConnected() from the receive thread once it is complete.
+	// A switcher that stops answering heartbeats is reported by onLinkDegraded() within
+	// a few hundred milliseconds, long before the link is given up on.
+	// Listeners may connect or disconnect again from the receive thread; the thread carries
+	// that out once the poll() that called them has returned.
+	class UdpBackend {
+	public:
+		UdpBackend() {
+			client.setRecorder(&recorder);
+			client.setTransferListener([this](uint32_t name, const uint8_t* payload, size_t size) { transfer.handleRecord(name, payload, size); });
+		}
+		~UdpBackend() { close(); }
+
+		template<typename Sink>
+		bool connect(const std::string& address, Sink& sink) {
+			// From a listener, its poll() is further up this stack
+			if (std::this_thread::get_id() == receiveThread.get_id()) {
+				std::lock_guard<std::mutex> lock(restartMutex);
+				running = false;
+				restartAddress = address;
+				restart = true;
+				return true;
+			}
+			close();
+			if (!open(address)) return false;
+			if (!threaded) return true;
+
+			running = true;
+			receiveThread = std::thread([this, &sink] { receive(sink); });
+			return true;
+		}
+
+		// One round of the link supervisor: services the client for up to timeoutMs and reports
+		// sync, loss and recovery to the sink. Returns false once it has given up on the link.
+		template<typename Sink>
+		bool poll(Sink& sink, int timeoutMs) {
+			if (finished) return false;
+
+			if (reconnectMillis > 0) {
+				// Late packets of the lost session would keep the socket readable meanwhile
+				client.discardPending();
+				uint64_t now = ofGetElapsedTimeMillis();
+				if (now < reconnectMillis) {
+					if (timeoutMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(std::min<uint64_t>(timeoutMs, reconnectMillis - now)));
+					return true;
+				}
+				reconnectMillis = 0;
+				ofLogNotice(__FUNCTION__) << "Reconnecting to " << address;
+				client.reconnect();
+				syncDeadline = ofGetElapsedTimeMillis() + kSyncTimeoutMs;
+				return true;
+			}
+
+			auto handler = [&sink](MixEffectEvent& e) { sink.onMixEffectBlockUpdated(e); };
+			bool alive = client.service(timeoutMs, handler);
+			// A listener closed or reconnected the backend meanwhile, receive() takes it from here
+			if (threaded && !running) return false;
+			transfer.update();
+			if (alive && !online && client.isConnected()) {
+				if (synced) sink.onBackendReconnected();
+				else sink.onBackendConnected(true);
+				synced = online = true;
+				backoffMs = kReconnectMinBackoffMs;
+			}
+			if (alive && online) {
+				if (client.consumeInputsChanged()) sink.onInputsChanged();
+				client.getLinkMonitor().update(ofGetElapsedTimeMicros(), sink);
+				return true;
+			}
+			if (alive) {
+				if (ofGetElapsedTimeMillis() <= syncDeadline) return true;
+				ofLogError(__FUNCTION__) << "State synchronisation with " << address << " timed-out";
+			}
+
+			// Link lost, or the new session never synced: start over after a growing pause
+			if (online) {
+				online = false;
+				sink.onBackendDisconnected();
+			}
+			if (!synced || !autoReconnect) {
+				finished = true;
+				if (!synced) sink.onBackendConnected(false);
+				return false;
+			}
+			reconnectMillis = ofGetElapsedTimeMillis() + backoffMs;
+			backoffMs = std::min(backoffMs * 2, kReconnectMaxBackoffMs);
+			return true;
+		}
+
+		template<typename Sink>
+		void disconnect(Sink&) { close(); }
+		// Events come from the receive thread, commands report nothing back directly
+		template<typename Sink>
+		void deliver(Sink&) {}
+
+		void printInfo();
+		std::string getProductName();
+		bool readInputs(std::vector<ofPtr<Input>>& inputs);
+		// Shared with ReplayBackend, which mirrors the same state
+		static void printInfo(const SwitcherState& state);
+		static bool readInputs(const SwitcherState& state, std::vector<ofPtr<Input>>& inputs);
+		static bool getTransition(UdpClient& client, int me, TransitionState& transition);
+		static bool getKeyersOnAir(UdpClient& client, int me, uint32_t& onAir);
+
+		bool setProgramInput(int me, BMDSwitcherInputId id) { return client.sendProgramInput(me, (uint16_t)id); }
+		bool setPreviewInput(int me, BMDSwitcherInputId id) { return client.sendPreviewInput(me, (uint16_t)id); }
+		bool setKeyerOnAir(int me, int keyer, bool onAir) { return client.sendKeyerOnAir(me, keyer, onAir); }
+		bool setAuxSource(int aux, BMDSwitcherInputId id) { return client.sendAuxSource(aux, (uint16_t)id); }
+
+		void beginBatch() { client.beginBatch(); }
+		bool commitBatch() { return client.commitBatch(); }
+
+		bool getProgramInput(int me, BMDSwitcherInputId& id) {
+			uint16_t source;
+			if (!client.getProgramInput(me, source)) return false;
+			id = source;
+			return true;
+		}
+
+		bool getPreviewInput(int me, BMDSwitcherInputId& id) {
+			uint16_t source;
+			if (!client.getPreviewInput(me, source)) return false;
+			id = source;
+			return true;
+		}
+
+		bool getTransition(int me, TransitionState& transition) { return getTransition(client, me, transition); }
+		bool getKeyersOnAir(int me, uint32_t& onAir) { return getKeyersOnAir(client, me, onAir); }
+		int getMixEffectBlockCount() { return client.getMixEffectBlockCount(); }
+
+		// See UdpClient::setStateCacheDirectory, takes effect on the next connect
+		void setStateCacheDirectory(const std::string& directory) { client.setStateCacheDirectory(directory); }
+		// By default connect() starts a receive thread that calls poll() in a loop. With threaded off
+		// it only opens the socket and the owner polls, e.g. DeviceManager for many devices at once.
+		void setThreaded(bool enable) { threaded = enable; }
+		int getSocket() const { return client.getSocket(); }
+
+		// Once synced, a lost link is re-established with exponential backoff (on by default).
+		// Commands issued meanwhile are held and replayed after the new state dump.
+		void setAutoReconnect(bool enable) { autoReconnect = enable; }
+
+		UdpClient& getClient() { return client; }
+		SwitcherClock& getClock() { return client.getClock(); }
+		LinkMonitor& getLinkMonitor() { return client.getLinkMonitor(); }
+		EventCoalescer& getEventCoalescer() { return client.getEventCoalescer(); }
+		// Media pool uploads, e.g. getMediaTransfer().uploadStill(0, frame) once connected
+		MediaTransfer& getMediaTransfer() { return transfer; }
+		// Open it to capture the session for ReplayBackend, e.g. getRecorder().open(ofToDataPath("show.atemrec"))
+		SessionRecorder& getRecorder() { return recorder; }
+
+	private:
+		static constexpr int kServiceIntervalMs = 50;
+		static constexpr int kSyncTimeoutMs = 5000;
+		static constexpr int kReconnectMinBackoffMs = 250;
+		static constexpr int kReconnectMaxBackoffMs = 5000;
+
+		bool open(const std::string& address);
+		void close();
+
+		template<typename Sink>
+		void receive(Sink& sink) {
+			for (;;) {
+				while (running && poll(sink, kServiceIntervalMs)) {}
+
+				// A listener closed or reconnected the backend, done now that poll() returned
+				std::string next;
+				{
+					std::lock_guard<std::mutex> lock(restartMutex);
+					if (running) return;
+					if (restart) {
+						next = restartAddress;
+						restart = false;
+						running = true;
+					}
+				}
+				transfer.cancel();
+				client.close();
+				if (next.empty()) return;
+				if (!open(next)) {
+					ofLogError(__FUNCTION__) << "Failed to connect to switcher at address " << next;
+					running = false;
+					sink.onBackendConnected(false);
+					return;
+				}
+			}
+		}
+
+		SessionRecorder recorder;
+		UdpClient client;
+		MediaTransfer transfer{ client };
+		std::atomic<bool> running{ false };
+		std::atomic<bool> autoReconnect{ true };
+		bool threaded = true;
+
+		// Link supervisor, only touched by whoever calls poll()
+		std::string address;
+		bool synced = false;
+		bool online = false;
+		bool finished = false;
+		uint64_t syncDeadline = 0;
+		uint64_t reconnectMillis = 0;	// waiting out the backoff until then
+		int backoffMs = kReconnectMinBackoffMs;
+		std::thread receiveThread;
+		// Where a listener on the receive thread asked to connect to next
+		std::mutex restartMutex;
+		std::string restartAddress;
+		bool restart = false;
+	};
+
+}
@@ -0,0 +1,837 @@
+#include "AtemUdpClient.h"
+
+#include <mutex>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ofLog.h"
+#include "ofUtils.h"
+
+#include "AtemFourccDispatch.h"
+
+namespace ofxAtem {
+
+	using namespace protocol;
+
+	// No packet from the switcher for this long means the link is gone
+	static const uint64_t kReceiveTimeoutMillis = 5000;
+	static const uint64_t kHelloIntervalMillis = 500;
+	static const uint16_t kClientHelloSessionId = 0x53ab;
+
+	// Unacknowledged commands are sent again after this long, and given up on after kMaxSendAttempts
+	static const uint64_t kRetransmitMillis = 100;
+	static const int kMaxSendAttempts = 10;
+	// Datagrams drained from the socket per service() call, all covered by a single ack
+	static const int kMaxDatagramsPerService = 64;
+
+	// State records mirrored into SwitcherState, in MirroredRecord order.
+	// A dump carries a few hundred records, so they are routed through a perfect hash
+	// rather than a chain of compares.
+	enum MirroredRecord {
+		kMirrorVersion,
+		kMirrorProductName,
+		kMirrorTopology,
+		kMirrorMixEffectConfig,
+		kMirrorMediaPoolConfig,
+		kMirrorVideoMode,
+		kMirrorInputProperties,
+		kMirrorProgramInput,
+		kMirrorPreviewInput,
+		kMirrorTransitionPosition,
+		kMirrorKeyerOnAir,
+		kMirrorAuxSource,
+	};
+	static constexpr uint32_t kMirroredRecords[] = {
+		state::kVersion,
+		state::kProductName,
+		state::kTopology,
+		state::kMixEffectConfig,
+		state::kMediaPoolConfig,
+		state::kVideoMode,
+		state::kInputProperties,
+		state::kProgramInput,
+		state::kPreviewInput,
+		state::kTransitionPosition,
+		state::kKeyerOnAir,
+		state::kAuxSource,
+	};
+	static constexpr FourccDispatch<12, 5> kMirroredRecordDispatch(kMirroredRecords);
+	static_assert(kMirroredRecordDispatch.getSeed() != 0, "No perfect hash for the mirrored records");
+
+	UdpClient::~UdpClient() {
+		close();
+	}
+
+	bool UdpClient::open(const std::string& address) {
+		close();
+
+		std::string newPath;
+		int newSock = openSocket(address, newPath);
+		if (newSock < 0) return false;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		{
+			std::lock_guard<std::mutex> sendLock(sendMutex);
+			sock = newSock;
+			boundPath = newPath;
+			windowBegin = windowEnd = 0;
+			openPacket().reset();
+			batchDepth = 0;
+		}
+		this->address = address;
+		state = SwitcherState();
+		warmStarted = false;
+		resetSession();
+
+		return true;
+	}
+
+	bool UdpClient::reconnect() {
+		std::string newPath;
+		int newSock = openSocket(address, newPath);
+		if (newSock < 0) return false;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		{
+			std::lock_guard<std::mutex> sendLock(sendMutex);
+			closeSocket();
+			sock = newSock;
+			boundPath = newPath;
+		}
+
+		// Whatever was known last is the snapshot the new dump gets reconciled against
+		if (synced) warmStarted = true;
+		resetSession();
+
+		return true;
+	}
+
+	void UdpClient::discardPending() {
+		uint8_t buffer[kMaxPacketSize];
+		while (sock >= 0 && recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {}
+	}
+
+	void UdpClient::close() {
+		{
+			// Keep the latest tally for the next start
+			std::lock_guard<std::mutex> lock(mutex);
+			if (synced && sock >= 0) cache.save(state);
+		}
+		{
+			std::lock_guard<std::mutex> sendLock(sendMutex);
+			closeSocket();
+		}
+		connected = false;
+		offline = false;
+	}
+
+	void UdpClient::reset() {
+		close();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		{
+			std::lock_guard<std::mutex> sendLock(sendMutex);
+			windowBegin = windowEnd = 0;
+			openPacket().reset();
+			batchDepth = 0;
+		}
+		state = SwitcherState();
+		warmStarted = false;
+		clock.reset();
+		resetSession();
+	}
+
+	int UdpClient::openSocket(const std::string& address, std::string& boundPath) {
+		static const std::string kUnixPrefix = "unix:";
+		if (address.compare(0, kUnixPrefix.size(), kUnixPrefix) == 0) {
+			// A broker only answers datagrams from a named socket, so bind one next to its own
+			static std::atomic<int> socketCount{ 0 };
+			sockaddr_un local = {}, remote = {};
+			std::string remotePath = address.substr(kUnixPrefix.size());
+			boundPath = remotePath + "." + std::to_string(getpid()) + "." + std::to_string(socketCount++);
+			if (remotePath.empty() || boundPath.size() >= sizeof(local.sun_path)) {
+				ofLogError(__FUNCTION__) << "Invalid broker address " << address;
+				return -1;
+			}
+			local.sun_family = remote.sun_family = AF_UNIX;
+			strncpy(local.sun_path, boundPath.c_str(), sizeof(local.sun_path) - 1);
+			strncpy(remote.sun_path, remotePath.c_str(), sizeof(remote.sun_path) - 1);
+
+			unlink(boundPath.c_str());
+			int newSock = socket(AF_UNIX, SOCK_DGRAM, 0);
+			if (newSock < 0 || bind(newSock, (sockaddr*)&local, sizeof(local)) != 0 || ::connect(newSock, (sockaddr*)&remote, sizeof(remote)) != 0) {
+				ofLogError(__FUNCTION__) << "Could not open a socket to " << address;
+				if (newSock >= 0) ::close(newSock);
+				unlink(boundPath.c_str());
+				boundPath.clear();
+				return -1;
+			}
+			return newSock;
+		}
+
+		// "host" or "host:port", the port defaults to the switcher's control port
+		std::string host = address;
+		std::string port = std::to_string(kPort);
+		size_t colon = address.rfind(':');
+		if (colon != std::string::npos) {
+			host = address.substr(0, colon);
+			port = address.substr(colon + 1);
+		}
+
+		addrinfo hints = {};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_DGRAM;
+		addrinfo* info = nullptr;
+		if (getaddrinfo(host.c_str(), port.c_str(), &hints, &info) != 0 || !info) {
+			ofLogError(__FUNCTION__) << "Could not resolve switcher address " << address;
+			return -1;
+		}
+
+		int newSock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+		if (newSock < 0 || ::connect(newSock, info->ai_addr, info->ai_addrlen) != 0) {
+			ofLogError(__FUNCTION__) << "Could not open a socket to " << address;
+			if (newSock >= 0) ::close(newSock);
+			newSock = -1;
+		}
+		freeaddrinfo(info);
+		return newSock;
+	}
+
+	void UdpClient::closeSocket() {
+		if (sock >= 0) {
+			::close(sock);
+			sock = -1;
+		}
+		if (!boundPath.empty()) {
+			unlink(boundPath.c_str());
+			boundPath.clear();
+		}
+	}
+
+	void UdpClient::resetSession() {
+		syncState = SwitcherState();
+		inputsChanged = false;
+		events.clear();
+		{
+			std::lock_guard<std::mutex> sendLock(sendMutex);
+			localPacketId = 0;
+		}
+		remotePacketId = 0;
+		ackPending = false;
+		requestedResendMillis = 0;
+		for (auto& early : earlyPackets) early.buffer = -1;
+		receiveBuffers.reset();
+		sessionId = kClientHelloSessionId;
+		helloAccepted = false;
+		synced = false;
+		lastReceivedMillis = ofGetElapsedTimeMillis();
+		nextHelloMillis = 0;
+		link.reset(ofGetElapsedTimeMicros());
+	}
+
+	bool UdpClient::waitForSync(int timeoutMs) {
+		std::unique_lock<std::mutex> lock(mutex);
+		return syncCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return synced; });
+	}
+
+	bool UdpClient::sendProgramInput(int me, uint16_t source) {
+		return sendCommand(command::kProgramInput, kInputSelectionSize, [&](uint8_t* p) { encode(InputSelection{ uint8_t(me), source }, p); });
+	}
+
+	bool UdpClient::sendPreviewInput(int me, uint16_t source) {
+		return sendCommand(command::kPreviewInput, kInputSelectionSize, [&](uint8_t* p) { encode(InputSelection{ uint8_t(me), source }, p); });
+	}
+
+	bool UdpClient::sendKeyerOnAir(int me, int keyer, bool onAir) {
+		return sendCommand(command::kKeyerOnAir, kKeyerOnAirSize, [&](uint8_t* p) { encode(KeyerOnAir{ uint8_t(me), uint8_t(keyer), onAir }, p); });
+	}
+
+	bool UdpClient::sendAuxSource(int aux, uint16_t source) {
+		return sendCommand(command::kAuxSource, kAuxSourceSize, [&](uint8_t* p) { encodeCommand(AuxSource{ uint8_t(aux), source }, p); });
+	}
+
+	bool UdpClient::sendRecord(uint32_t name, const uint8_t* payload, size_t size) {
+		return sendCommand(name, size, [&](uint8_t* p) { memcpy(p, payload, size); });
+	}
+
+	bool UdpClient::sendStoreLock(uint16_t storeId, bool locked) {
+		return sendCommand(command::kStoreLock, kStoreLockSize, [&](uint8_t* p) { encode(StoreLock{ storeId, locked }, p); });
+	}
+
+	bool UdpClient::sendTransferRequest(const TransferRequest& request) {
+		return sendCommand(command::kTransferRequest, kTransferRequestSize, [&](uint8_t* p) { encode(request, p); });
+	}
+
+	bool UdpClient::sendTransferData(uint16_t transferId, const uint8_t* data, size_t size) {
+		// The chunk is copied once, from the caller's buffer into the datagram
+		return sendCommand(command::kTransferData, kTransferDataHeaderSize + size, [&](uint8_t* p) {
+			encode(TransferData{ transferId, data, size }, p);
+			memcpy(p + kTransferDataHeaderSize, data, size);
+		});
+	}
+
+	bool UdpClient::sendTransferDescription(const TransferDescription& description) {
+		return sendCommand(command::kTransferDescription, kTransferDescriptionSize, [&](uint8_t* p) { encode(description, p); });
+	}
+
+	void UdpClient::beginBatch() {
+		std::lock_guard<std::mutex> lock(sendMutex);
+		batchDepth++;
+	}
+
+	bool UdpClient::commitBatch() {
+		std::lock_guard<std::mutex> lock(sendMutex);
+		if (batchDepth == 0) return true;
+		if (--batchDepth > 0) return true;
+		return flushCommands();
+	}
+
+	uint64_t UdpClient::getQueuedPacketCount() {
+		std::lock_guard<std::mutex> lock(sendMutex);
+		return windowEnd + (openPacket().empty() ? 0 : 1);
+	}
+
+	uint64_t UdpClient::getAcknowledgedPacketCount() {
+		std::lock_guard<std::mutex> lock(sendMutex);
+		return windowBegin;
+	}
+
+	SwitcherState UdpClient::getState() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return state;
+	}
+
+	bool UdpClient::getProgramInput(int me, uint16_t& source) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (me < 0 || me >= (int)state.programInputs.size()) return false;
+		source = state.programInputs[me];
+		return true;
+	}
+
+	bool UdpClient::getPreviewInput(int me, uint16_t& source) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (me < 0 || me >= (int)state.previewInputs.size()) return false;
+		source = state.previewInputs[me];
+		return true;
+	}
+
+	bool UdpClient::getTransition(int me, TransitionPosition& transition) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (me < 0 || me >= (int)state.transitions.size()) return false;
+		transition = state.transitions[me];
+		return true;
+	}
+
+	bool UdpClient::getKeyersOnAir(int me, uint16_t& onAir) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (me < 0 || me >= (int)state.keyersOnAir.size()) return false;
+		onAir = state.keyersOnAir[me];
+		return true;
+	}
+
+	int UdpClient::getMixEffectBlockCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return (int)state.programInputs.size();
+	}
+
+	bool UdpClient::receive(int timeoutMs) {
+		serviceThread = std::this_thread::get_id();
+		uint64_t now = ofGetElapsedTimeMillis();
+
+		if (!helloAccepted && now >= nextHelloMillis) {
+			sendHello();
+			nextHelloMillis = now + kHelloIntervalMillis;
+		}
+
+		if (connected && now - lastReceivedMillis > kReceiveTimeoutMillis) {
+			ofLogNotice() << "switcher disconnected.";
+			connected = false;
+			offline = true;
+			return false;
+		}
+
+		if (!retransmit(now)) {
+			ofLogNotice() << "switcher stopped acknowledging commands.";
+			connected = false;
+			offline = true;
+			return false;
+		}
+		if (connected) sendHeartbeat(ofGetElapsedTimeMicros());
+
+		pollfd pfd = { sock, POLLIN, 0 };
+		if (poll(&pfd, 1, timeoutMs) <= 0) return true;
+
+		// Each datagram lands in a pooled buffer and is parsed in place; the rare one that
+		// has to wait for a lost predecessor keeps its buffer and the next recv takes another
+		int buffer = receiveBuffers.acquire();
+		ssize_t size = recv(sock, receiveBuffers.data(buffer), receiveBuffers.capacity(), 0);
+		for (int n = 1; size > 0; n++) {
+			const uint8_t* data = receiveBuffers.data(buffer);
+			lastReceivedMillis = ofGetElapsedTimeMillis();
+			arrivalMicros = ofGetElapsedTimeMicros();
+			link.onHeard(arrivalMicros);
+			if (recorder && recorder->isOpen()) recorder->record(kFromSwitcher, data, (size_t)size);
+			if (handleDatagram(data, (size_t)size, buffer)) buffer = receiveBuffers.acquire();
+			if (n == kMaxDatagramsPerService) break;
+			size = recv(sock, receiveBuffers.data(buffer), receiveBuffers.capacity(), MSG_DONTWAIT);
+		}
+		receiveBuffers.release(buffer);
+
+		// One ack covers every packet handled above
+		if (ackPending) {
+			sendAck(remotePacketId);
+			ackPending = false;
+		}
+		return true;
+	}
+
+	bool UdpClient::handleDatagram(const uint8_t* data, size_t size, int buffer) {
+		PacketHeader header;
+		if (!readHeader(data, size, header)) return false;
+
+		if (header.flags & kFlagHello) {
+			if (size >= kHeaderSize + 1 && data[kHeaderSize] == kHelloAccepted) {
+				helloAccepted = true;
+				sendAck(0);
+			} else {
+				ofLogError(__FUNCTION__) << "Switcher rejected the connection";
+			}
+			return false;
+		}
+
+		if (!helloAccepted) return false;
+
+		// The switcher assigns the session id on its first packet after the handshake
+		sessionId = header.sessionId;
+
+		if (header.flags & kFlagAck) handleAck(header.ackId);
+		if (header.flags & kFlagRequestResend) handleResendRequest(header.resendId);
+		if (!(header.flags & kFlagAckRequest)) return false;
+
+		// Anything at or before remotePacketId is a resend of a packet already handled,
+		// it only needs acknowledging again
+		ackPending = true;
+
+		if (header.packetId == nextPacketId(remotePacketId)) {
+			handleRecords(data, header);
+			remotePacketId = header.packetId;
+
+			// Packets held back behind this one are in order now
+			for (;;) {
+				EarlyPacket& early = earlyPackets[nextPacketId(remotePacketId) % kReceiveWindowSize];
+				if (early.buffer < 0 || early.packetId != nextPacketId(remotePacketId)) break;
+				const uint8_t* earlyData = receiveBuffers.data(early.buffer);
+				arrivalMicros = early.arrivalMicros;
+				PacketHeader earlyHeader;
+				readHeader(earlyData, kMaxPacketSize, earlyHeader);
+				handleRecords(earlyData, earlyHeader);
+				remotePacketId = early.packetId;
+				receiveBuffers.release(early.buffer);
+				early.buffer = -1;
+			}
+		} else if (isNewer(header.packetId, remotePacketId) && packetIdDistance(remotePacketId, header.packetId) <= kReceiveWindowSize) {
+			holdEarlyPacket(data, header, buffer);
+
+			// Ask for the missing packet instead of waiting for the switcher to time out
+			uint16_t missing = nextPacketId(remotePacketId);
+			uint64_t now = ofGetElapsedTimeMillis();
+			if (missing != requestedResendId || now - requestedResendMillis > kRetransmitMillis) {
+				sendResendRequest(missing);
+				requestedResendId = missing;
+				requestedResendMillis = now;
+			}
+			return buffer >= 0;
+		}
+		return false;
+	}
+
+	void UdpClient::holdEarlyPacket(const uint8_t* data, const PacketHeader& header, int buffer) {
+		EarlyPacket& early = earlyPackets[header.packetId % kReceiveWindowSize];
+		if (early.buffer >= 0) receiveBuffers.release(early.buffer);
+
+		// Only datagrams that did not come from the pool, e.g. injected ones, are copied
+		if (buffer < 0) {
+			buffer = receiveBuffers.acquire();
+			memcpy(receiveBuffers.data(buffer), data, header.length);
+		}
+		early.buffer = buffer;
+		early.packetId = header.packetId;
+		early.arrivalMicros = arrivalMicros;
+		heldPackets++;
+	}
+
+	void UdpClient::handleRecords(const uint8_t* data, const PacketHeader& header) {
+		bool justWarmStarted = false;
+		bool justSynced = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			RecordReader reader(data + kHeaderSize, header.length - kHeaderSize);
+			uint32_t name;
+			const uint8_t* payload;
+			size_t payloadSize;
+			while (reader.next(name, payload, payloadSize)) {
+				handleRecord(warmStarted && !synced ? syncState : state, name, payload, payloadSize);
+				if (synced && recordListener) recordListener(name, payload, payloadSize);
+				if (synced && transferListener && isTransferRecord(name)) transferListener(name, payload, payloadSize);
+				if (name == state::kTimecode || name == state::kVideoMode) handleClockRecord(name, payload, payloadSize);
+
+				if (name == state::kProductName && !synced && !warmStarted && cache.isEnabled()) {
+					justWarmStarted = warmStart();
+				}
+				if (name == state::kInitComplete && !synced) {
+					if (warmStarted) reconcile();
+					synced = true;
+					justSynced = true;
+				}
+			}
+
+			// Nothing to report until the initial dump is complete
+			if (!synced) events.clear();
+
+			if (justSynced) cache.save(state);
+		}
+
+		if (justWarmStarted || justSynced) {
+			connected = true;
+			offline = false;
+			syncCondition.notify_all();
+		}
+		if (justSynced) replayCommands();
+	}
+
+	bool UdpClient::warmStart() {
+		std::vector<uint8_t> records;
+		if (!cache.load(state.productName, state.version, records)) return false;
+
+		SwitcherState cached;
+		RecordReader reader(records.data(), records.size());
+		uint32_t name;
+		const uint8_t* payload;
+		size_t payloadSize;
+		while (reader.next(name, payload, payloadSize)) {
+			handleRecord(cached, name, payload, payloadSize);
+		}
+		if (cached.productName != state.productName || cached.version.major != state.version.major || cached.version.minor != state.version.minor) {
+			return false;
+		}
+
+		// The rest of the dump goes to syncState, readers get the snapshot meanwhile
+		syncState = std::move(state);
+		state = std::move(cached);
+		warmStarted = true;
+		return true;
+	}
+
+	static bool sameInputs(const std::vector<InputProperties>& a, const std::vector<InputProperties>& b) {
+		if (a.size() != b.size()) return false;
+		for (size_t i = 0; i < a.size(); i++) {
+			if (a[i].id != b[i].id || strcmp(a[i].longName, b[i].longName) != 0 || strcmp(a[i].shortName, b[i].shortName) != 0 ||
+				a[i].internalPortType != b[i].internalPortType || a[i].externalPortType != b[i].externalPortType) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static void diffTransition(int me, const TransitionPosition& prev, const TransitionPosition& next, EventCoalescer& events) {
+		if (prev.inTransition != next.inTransition) events.add({ me, bmdSwitcherMixEffectBlockEventTypeInTransitionChanged });
+		if (prev.position != next.position) events.add({ me, bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged });
+		if (prev.framesRemaining != next.framesRemaining) events.add({ me, bmdSwitcherMixEffectBlockEventTypeTransitionFramesRemainingChanged });
+	}
+
+	void UdpClient::reconcile() {
+		SwitcherState& live = syncState;
+		events.clear();
+
+		for (size_t me = 0; me < live.programInputs.size(); me++) {
+			bool known = me < state.programInputs.size();
+			if (!known || state.programInputs[me] != live.programInputs[me]) events.add({ int(me), bmdSwitcherMixEffectBlockEventTypeProgramInputChanged });
+			if (!known || state.previewInputs[me] != live.previewInputs[me]) events.add({ int(me), bmdSwitcherMixEffectBlockEventTypePreviewInputChanged });
+			diffTransition(int(me), known ? state.transitions[me] : TransitionPosition(), live.transitions[me], events);
+			uint16_t keyersOnAir = me < state.keyersOnAir.size() ? state.keyersOnAir[me] : 0;
+			if (me < live.keyersOnAir.size() && keyersOnAir != live.keyersOnAir[me]) events.add({ int(me), kKeyerOnAirChanged });
+		}
+		if (live.programInputs.size() != state.programInputs.size() || !sameInputs(live.inputs, state.inputs)) {
+			inputsChanged = true;
+		}
+
+		state = std::move(live);
+		syncState = SwitcherState();
+	}
+
+	void UdpClient::handleAck(uint16_t ackId) {
+		std::lock_guard<std::mutex> lock(sendMutex);
+
+		// Acks are cumulative, the switcher handles commands in order
+		while (windowBegin != windowEnd && !isNewer(sendWindow[windowBegin % kSendWindowSize].header.packetId, ackId)) {
+			const SentPacket& sent = sendWindow[windowBegin % kSendWindowSize];
+			if (sent.heartbeat) link.onHeartbeatAnswered(arrivalMicros);
+			else link.onDelivered(arrivalMicros - sent.firstSentMicros, sent.attempts > 1);
+			windowBegin++;
+		}
+
+		// Commands that queued up while the window was full
+		if (batchDepth == 0) flushCommands();
+		windowCondition.notify_all();
+	}
+
+	void UdpClient::handleResendRequest(uint16_t packetId) {
+		std::lock_guard<std::mutex> lock(sendMutex);
+		for (size_t i = windowBegin; i != windowEnd; i++) {
+			SentPacket& sent = sendWindow[i % kSendWindowSize];
+			if (sent.header.packetId == packetId) {
+				transmit(sent, ofGetElapsedTimeMillis());
+				return;
+			}
+		}
+	}
+
+	bool UdpClient::retransmit(uint64_t now) {
+		if (!connected) return true;
+
+		std::lock_guard<std::mutex> lock(sendMutex);
+		for (size_t i = windowBegin; i != windowEnd; i++) {
+			SentPacket& sent = sendWindow[i % kSendWindowSize];
+			if (now - sent.sentMillis < kRetransmitMillis) continue;
+			if (sent.attempts >= kMaxSendAttempts) return false;
+			transmit(sent, now);
+		}
+		return true;
+	}
+
+	void UdpClient::handleClockRecord(uint32_t name, const uint8_t* payload, size_t size) {
+		// Live records only, a cached video mode may be stale
+		if (name == state::kVideoMode) {
+			VideoMode mode;
+			if (decode(payload, size, mode)) clock.setFrameRate(frameRateOfVideoMode(mode.mode));
+		} else {
+			Timecode timecode;
+			if (decode(payload, size, timecode)) clock.addTimecode(timecode, arrivalMicros);
+		}
+	}
+
+	void UdpClient::handleRecord(SwitcherState& target, uint32_t name, const uint8_t* payload, size_t size) {
+
+		switch (kMirroredRecordDispatch.find(name)) {
+		case kMirrorVersion:
+			decode(payload, size, target.version);
+			break;
+		case kMirrorProductName:
+			decode(payload, size, target.productName);
+			break;
+		case kMirrorTopology:
+			if (decode(payload, size, target.topology)) {
+				target.programInputs.assign(target.topology.mixEffectBlocks, 0);
+				target.previewInputs.assign(target.topology.mixEffectBlocks, 0);
+				target.transitions.assign(target.topology.mixEffectBlocks, TransitionPosition());
+				target.mixEffectBlocks.assign(target.topology.mixEffectBlocks, MixEffectConfig());
+				target.keyersOnAir.assign(target.topology.mixEffectBlocks, 0);
+				target.auxSources.assign(target.topology.auxOutputs, 0);
+			}
+			break;
+		case kMirrorMixEffectConfig: {
+			MixEffectConfig config;
+			if (decode(payload, size, config) && config.me < target.mixEffectBlocks.size()) {
+				target.mixEffectBlocks[config.me] = config;
+			}
+			break;
+		}
+		case kMirrorMediaPoolConfig:
+			decode(payload, size, target.mediaPool);
+			break;
+		case kMirrorVideoMode:
+			decode(payload, size, target.videoMode);
+			break;
+		case kMirrorInputProperties: {
+			InputProperties input;
+			if (!decode(payload, size, input)) return;
+			for (auto& existing : target.inputs) {
+				if (existing.id == input.id) {
+					existing = input;
+					return;
+				}
+			}
+			target.inputs.push_back(input);
+			break;
+		}
+		case kMirrorProgramInput: {
+			InputSelection sel;
+			if (decode(payload, size, sel) && sel.me < target.programInputs.size()) {
+				target.programInputs[sel.me] = sel.source;
+				events.add({ sel.me, bmdSwitcherMixEffectBlockEventTypeProgramInputChanged });
+			}
+			break;
+		}
+		case kMirrorPreviewInput: {
+			InputSelection sel;
+			if (decode(payload, size, sel) && sel.me < target.previewInputs.size()) {
+				target.previewInputs[sel.me] = sel.source;
+				events.add({ sel.me, bmdSwitcherMixEffectBlockEventTypePreviewInputChanged });
+			}
+			break;
+		}
+		case kMirrorTransitionPosition: {
+			TransitionPosition pos;
+			if (decode(payload, size, pos) && pos.me < target.transitions.size()) {
+				diffTransition(pos.me, target.transitions[pos.me], pos, events);
+				target.transitions[pos.me] = pos;
+			}
+			break;
+		}
+		case kMirrorKeyerOnAir: {
+			KeyerOnAir key;
+			if (decode(payload, size, key) && key.me < target.keyersOnAir.size() && key.keyer < 16) {
+				uint16_t bit = uint16_t(1 << key.keyer);
+				uint16_t onAir = key.onAir ? (target.keyersOnAir[key.me] | bit) : (target.keyersOnAir[key.me] & ~bit);
+				if (onAir != target.keyersOnAir[key.me]) events.add({ key.me, kKeyerOnAirChanged });
+				target.keyersOnAir[key.me] = onAir;
+			}
+			break;
+		}
+		case kMirrorAuxSource: {
+			AuxSource aux;
+			if (decode(payload, size, aux) && aux.aux < target.auxSources.size()) {
+				target.auxSources[aux.aux] = aux.source;
+			}
+			break;
+		}
+		default:
+			// Everything else is not mirrored yet
+			break;
+		}
+	}
+
+	bool UdpClient::sendHello() {
+		PacketHeader header;
+		header.flags = kFlagHello;
+		header.length = uint16_t(kHeaderSize + kHelloPayloadSize);
+		header.sessionId = kClientHelloSessionId;
+
+		uint8_t payload[kHelloPayloadSize] = { 0x01, 0, 0, 0, 0, 0, 0, 0 };
+		return sendPacket(header, payload, sizeof(payload));
+	}
+
+	bool UdpClient::sendAck(uint16_t ackId) {
+		PacketHeader header;
+		header.flags = kFlagAck;
+		header.length = uint16_t(kHeaderSize);
+		header.sessionId = sessionId;
+		header.ackId = ackId;
+		return sendPacket(header, nullptr, 0);
+	}
+
+	uint8_t* UdpClient::beginCommand(std::unique_lock<std::mutex>& lock, uint32_t name, size_t size) {
+		// A batch larger than one datagram spills into the next one
+		if (!openPacket().fits(size)) flushCommands();
+
+		// Window and next packet full: wait for acks, unless called from the thread that handles them
+		if (!openPacket().fits(size) && std::this_thread::get_id() != serviceThread) {
+			windowCondition.wait_for(lock, std::chrono::milliseconds(kRetransmitMillis * kMaxSendAttempts), [&] {
+				flushCommands();
+				return openPacket().fits(size) || !connected;
+			});
+		}
+
+		uint8_t* payload = openPacket().beginRecord(name, size);
+		if (!payload) {
+			ofLogError(__FUNCTION__) << "Send window full, dropping " << fourccToString(name);
+		}
+		return payload;
+	}
+
+	bool UdpClient::flushCommands() {
+		if (openPacket().empty()) return true;
+
+		// With the window full the packet stays open, collecting further commands,
+		// and goes out as soon as an ack frees a slot
+		if (windowEnd - windowBegin >= kSendWindowSize - 1) return true;
+
+		SentPacket& sent = sendWindow[windowEnd % kSendWindowSize];
+		sent.heartbeat = false;
+		windowEnd++;
+		openPacket().reset();
+
+		// Held back while offline, replayCommands() sends it after the next sync
+		if (!connected) return true;
+		return transmitNew(sent, ofGetElapsedTimeMillis());
+	}
+
+	void UdpClient::replayCommands() {
+		std::lock_guard<std::mutex> lock(sendMutex);
+
+		// Unacknowledged and offline commands, renumbered for the new session.
+		// They all set absolute values, so one the old session did deliver is harmless.
+		uint64_t now = ofGetElapsedTimeMillis();
+		for (size_t i = windowBegin; i != windowEnd; i++) {
+			transmitNew(sendWindow[i % kSendWindowSize], now);
+		}
+		if (batchDepth == 0) flushCommands();
+	}
+
+	bool UdpClient::transmitNew(SentPacket& sent, uint64_t now) {
+		sent.header = PacketHeader();
+		sent.header.flags = kFlagAckRequest;
+		sent.header.sessionId = sessionId;
+		sent.header.packetId = localPacketId = nextPacketId(localPacketId);
+		sent.firstSentMicros = ofGetElapsedTimeMicros();
+		sent.attempts = 0;
+		return transmit(sent, now);
+	}
+
+	void UdpClient::sendHeartbeat(uint64_t nowMicros) {
+		std::lock_guard<std::mutex> lock(sendMutex);
+
+		// Commands in flight or about to go get acknowledged anyway
+		if (windowBegin != windowEnd || !openPacket().empty() || batchDepth > 0) return;
+		if (!link.heartbeatDue(nowMicros)) return;
+
+		// An empty packet, acknowledged like any other
+		SentPacket& sent = sendWindow[windowEnd % kSendWindowSize];
+		windowEnd++;
+		openPacket().reset();
+		sent.heartbeat = true;
+		transmitNew(sent, nowMicros / 1000);
+	}
+
+	bool UdpClient::transmit(SentPacket& sent, uint64_t now) {
+		if (sent.attempts > 0) {
+			sent.header.flags |= kFlagResend;
+			retransmits++;
+		}
+		sent.packet.finish(sent.header);
+		sent.sentMillis = now;
+		sent.attempts++;
+
+		return sendDatagram(sent.packet.data(), sent.packet.size());
+	}
+
+	bool UdpClient::sendResendRequest(uint16_t packetId) {
+		PacketHeader header;
+		header.flags = kFlagRequestResend;
+		header.length = uint16_t(kHeaderSize);
+		header.sessionId = sessionId;
+		header.resendId = packetId;
+		return sendPacket(header, nullptr, 0);
+	}
+
+	bool UdpClient::sendPacket(const PacketHeader& header, const uint8_t* payload, size_t size) {
+		uint8_t packet[kHeaderSize + kHelloPayloadSize];
+		if (size > kHelloPayloadSize) return false;
+		writeHeader(packet, header);
+		if (size) memcpy(packet + kHeaderSize, payload, size);
+
+		return sendDatagram(packet, kHeaderSize + size);
+	}
+
+	bool UdpClient::sendDatagram(const uint8_t* data, size_t size) {
+		if (recorder && recorder->isOpen()) recorder->record(kToSwitcher, data, size);
+		return send(sock, data, size, 0) == (ssize_t)size;
+	}
+
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ofUtils.h"
+
+#include "AtemTypes.h"
+#include "AtemEventCoalescer.h"
+#include "AtemLinkMonitor.h"
+#include "AtemProtocol.h"
+#include "AtemSessionRecorder.h"
+#include "AtemStateCache.h"
+#include "AtemSwitcherClock.h"
+#include "AtemSwitcherState.h"
+
+namespace ofxAtem {
+
+	// Native client of the ATEM UDP control protocol.
+	// It owns no thread: whoever drives it calls service() in a loop, which acknowledges
+	// switcher packets, keeps SwitcherState up to date and hands the resulting
+	// MixEffectBlock events to the caller's handler.
+	//
+	// Delivery is reliable both ways. Commands go out through a sliding window of up to
+	// kSendWindowSize - 1 unacknowledged packets which are retransmitted one by one on timeout
+	// or on request. While the window is full, commands pile up in the next packet and
+	// callers only wait once that is full too. Switcher packets are put back in order and
+	// acknowledged with one ack per batch of datagrams drained from the socket.
+	class UdpClient {
+	public:
+		static constexpr size_t kMaxPacketsInFlight = 31;
+
+		UdpClient() {}
+		~UdpClient();
+
+		// address is "host" or "host:port", or "unix:/path" for a local Broker
+		bool open(const std::string& address);
+		void close();
+
+		// Starts a new session with the same switcher after the link was lost. The new dump is
+		// reconciled against the last known state, so only what changed meanwhile is reported,
+		// and commands that were not acknowledged or were issued while offline are sent again
+		// once it is complete. Call from the thread driving service().
+		bool reconnect();
+		// Link lost since the last sync; commands are held for reconnect()
+		bool isOffline() const { return offline; }
+		// Drops whatever the lost session still has queued on the socket
+		void discardPending();
+
+		// For waiting on several clients at once, changes on open() and reconnect()
+		int getSocket() const { return sock; }
+
+		// Blocks until the initial state dump has been received or timeoutMs elapsed
+		bool waitForSync(int timeoutMs);
+		// True once the state is usable: synced, or warm started from the state cache
+		bool isConnected() const { return connected; }
+
+		// Where the last synced state of each switcher model is kept, empty (the default) disables it.
+		// With a snapshot for the model and protocol version at hand the client reports connected as soon as
+		// the product name is in, serves the cached state during the dump and, once the dump is
+		// complete, emits events only for what differs from it.
+		void setStateCacheDirectory(const std::string& directory) { cache.setDirectory(directory); }
+		bool isWarmStarted() const { return warmStarted; }
+		// True once after the live input list turned out different from the cached one
+		bool consumeInputsChanged() { return inputsChanged.exchange(false); }
+
+		// Waits up to timeoutMs for one datagram and dispatches its events.
+		// Returns false once the link is lost.
+		template<typename Handler>
+		bool service(int timeoutMs, Handler&& handler) {
+			if (!receive(timeoutMs)) return false;
+			events.drain(handler);
+			return true;
+		}
+
+		// Closes the client and forgets the switcher's state, keeping the configuration: cache
+		// directory, listeners, coalesced event types. Readies a client for inject() again.
+		void reset();
+
+		// Handles a recorded switcher datagram as if it had been received at arrivalMicros, on a
+		// client that was never opened: its replies go nowhere. For replaying a SessionRecorder
+		// file, the clock sees the recorded timing however fast it is replayed.
+		template<typename Handler>
+		void inject(const uint8_t* data, size_t size, uint64_t arrivalMicros, Handler&& handler) {
+			this->arrivalMicros = arrivalMicros;
+			handleDatagram(data, size, -1);
+			ackPending = false;
+			events.drain(handler);
+		}
+
+		// Every datagram sent and received goes to recorder while it is open
+		void setRecorder(SessionRecorder* recorder) { this->recorder = recorder; }
+
+		// Sees every state record received after the sync, on the thread driving service() with the
+		// state locked; it must not call back into the client. For forwarding changes as they come.
+		typedef std::function<void(uint32_t name, const uint8_t* payload, size_t size)> RecordListener;
+		void setRecordListener(RecordListener listener) { recordListener = listener; }
+		// Sees the lock and transfer replies (see protocol::isTransferRecord) under the same rules,
+		// for MediaTransfer
+		void setTransferListener(RecordListener listener) { transferListener = listener; }
+
+		bool sendProgramInput(int me, uint16_t source);
+		bool sendPreviewInput(int me, uint16_t source);
+		bool sendKeyerOnAir(int me, int keyer, bool onAir);
+		bool sendAuxSource(int aux, uint16_t source);
+		// A command encoded elsewhere, e.g. received from a Broker client
+		bool sendRecord(uint32_t name, const uint8_t* payload, size_t size);
+
+		// Media pool transfers, driven by MediaTransfer
+		bool sendStoreLock(uint16_t storeId, bool locked);
+		bool sendTransferRequest(const protocol::TransferRequest& request);
+		bool sendTransferData(uint16_t transferId, const uint8_t* data, size_t size);
+		bool sendTransferDescription(const protocol::TransferDescription& description);
+
+		// Commands sent between beginBatch() and commitBatch() are packed into as few
+		// datagrams as possible and reach the switcher together. Batches nest.
+		void beginBatch();
+		bool commitBatch();
+
+		// Disciplined to the Time records, at the frame rate of the switcher's video mode
+		SwitcherClock& getClock() { return clock; }
+		// Fed by service(): an empty packet the switcher has to acknowledge goes out as the
+		// heartbeat while no command is in flight, command acks stand in for it otherwise.
+		// The owner calls its update().
+		LinkMonitor& getLinkMonitor() { return link; }
+		// Merges the high-rate events of the datagrams drained by one service() call
+		EventCoalescer& getEventCoalescer() { return events; }
+
+		SwitcherState getState();
+		bool getProgramInput(int me, uint16_t& source);
+		bool getPreviewInput(int me, uint16_t& source);
+		bool getTransition(int me, protocol::TransitionPosition& transition);
+		// One bit per upstream keyer
+		bool getKeyersOnAir(int me, uint16_t& onAir);
+		int getMixEffectBlockCount();
+
+		// Command packets handed to the transport since open(), counting the one being filled, and
+		// how many of them the switcher acknowledged. Acks are cumulative, so a command is delivered
+		// once the acknowledged count reaches the queued count read right after sending it.
+		uint64_t getQueuedPacketCount();
+		uint64_t getAcknowledgedPacketCount();
+
+		uint64_t getRetransmitCount() const { return retransmits; }
+		// Switcher packets that arrived out of order and waited for a lost one
+		uint64_t getHeldPacketCount() const { return heldPackets; }
+
+	private:
+		static const size_t kSendWindowSize = kMaxPacketsInFlight + 1;	// packets in flight plus the one being filled
+		static const size_t kReceiveWindowSize = 32;	// switcher packets held while waiting for a missing one
+
+		// Command packet kept until the switcher acknowledges it
+		struct SentPacket {
+			protocol::PacketWriter packet;
+			protocol::PacketHeader header;
+			uint64_t sentMillis = 0;
+			uint64_t firstSentMicros = 0;	// of the current session, for the round trip
+			int attempts = 0;
+			bool heartbeat = false;	// no commands, only sent for LinkMonitor
+		};
+
+		// Switcher packet that arrived ahead of a lost one, held in its receive buffer
+		struct EarlyPacket {
+			int buffer = -1;	// in receiveBuffers, -1 if the slot is empty
+			uint16_t packetId = 0;
+			uint64_t arrivalMicros = 0;
+		};
+
+		// boundPath is the local end of a unix: socket, to unlink once it is closed
+		int openSocket(const std::string& address, std::string& boundPath);
+		void closeSocket();
+		void resetSession();
+
+		bool receive(int timeoutMs);
+		// buffer is the receiveBuffers entry holding data, or -1 if the caller keeps it.
+		// Returns true if the datagram was held back, its buffer is then no longer the caller's.
+		bool handleDatagram(const uint8_t* data, size_t size, int buffer);
+		void holdEarlyPacket(const uint8_t* data, const protocol::PacketHeader& header, int buffer);
+		void handleRecords(const uint8_t* data, const protocol::PacketHeader& header);
+		void handleRecord(SwitcherState& target, uint32_t name, const uint8_t* payload, size_t size);
+		void handleClockRecord(uint32_t name, const uint8_t* payload, size_t size);
+
+		// Both expect mutex to be held
+		bool warmStart();
+		void reconcile();
+
+		void handleAck(uint16_t ackId);
+		void handleResendRequest(uint16_t packetId);
+		bool retransmit(uint64_t now);
+		void sendHeartbeat(uint64_t nowMicros);
+
+		bool sendHello();
+		bool sendAck(uint16_t ackId);
+		// write encodes the payload straight into the outgoing packet
+		template<typename Writer>
+		bool sendCommand(uint32_t name, size_t size, Writer&& write) {
+			if (!connected && !offline) return false;
+
+			std::unique_lock<std::mutex> lock(sendMutex);
+			uint8_t* payload = beginCommand(lock, name, size);
+			if (!payload) return false;
+			write(payload);
+
+			return batchDepth > 0 ? true : flushCommands();
+		}
+
+		// The following expect sendMutex to be held
+		protocol::PacketWriter& openPacket() { return sendWindow[windowEnd % kSendWindowSize].packet; }
+		uint8_t* beginCommand(std::unique_lock<std::mutex>& lock, uint32_t name, size_t size);
+		bool flushCommands();
+		void replayCommands();
+		bool transmitNew(SentPacket& sent, uint64_t now);
+		bool transmit(SentPacket& sent, uint64_t now);
+		bool sendResendRequest(uint16_t packetId);
+		// Control packets only (hello, ack, resend request), their payload fits on the stack
+		bool sendPacket(const protocol::PacketHeader& header, const uint8_t* payload, size_t size);
+		bool sendDatagram(const uint8_t* data, size_t size);
+
+		int sock = -1;
+		std::string address;
+		std::string boundPath;
+		std::atomic<uint16_t> sessionId{ 0 };
+		uint16_t localPacketId = 0;
+		uint64_t lastReceivedMillis = 0;
+		uint64_t nextHelloMillis = 0;
+
+		bool helloAccepted = false;
+		bool synced = false;
+		std::atomic<bool> connected{ false };
+		std::atomic<bool> offline{ false };
+
+		std::mutex mutex;
+		std::condition_variable syncCondition;
+
+		std::mutex sendMutex;
+		std::condition_variable windowCondition;
+		std::atomic<std::thread::id> serviceThread;
+		std::array<SentPacket, kSendWindowSize> sendWindow;
+		size_t windowBegin = 0;	// oldest unacknowledged packet
+		size_t windowEnd = 0;	// packet being filled, the next to go out
+		int batchDepth = 0;
+		std::atomic<uint64_t> retransmits{ 0 };
+
+		uint16_t remotePacketId = 0;	// last switcher packet handled in order
+		bool ackPending = false;
+		uint16_t requestedResendId = 0;
+		uint64_t requestedResendMillis = 0;
+		std::array<EarlyPacket, kReceiveWindowSize> earlyPackets;
+		protocol::DatagramPool<kReceiveWindowSize + 1> receiveBuffers;	// one per early packet plus the one being received
+		std::atomic<uint64_t> heldPackets{ 0 };
+
+		SwitcherState state;
+		EventCoalescer events;	// of the datagrams handled by one receive()
+		SwitcherClock clock;
+		uint64_t arrivalMicros = 0;	// of the datagram being handled, for the clock and the link monitor
+		LinkMonitor link;
+
+		StateCache cache;
+		std::atomic<bool> warmStarted{ false };
+		SwitcherState syncState;	// live dump in progress while state holds the cached snapshot
+		std::atomic<bool> inputsChanged{ false };
+
+		SessionRecorder* recorder = nullptr;
+		RecordListener recordListener;
+		RecordListener transferListener;
+	};
+
+}
@@ -1,59 +1,306 @@
 #pragma once
 
+#include <array>
+#include <future>
+#include <memory>
+
 #include "ofMain.h"
-#include "AtemDeviceInfo.h"
-#include "AtemMonitors.h"
+#include "AtemTypes.h"
+#include "AtemFakeBackend.h"
+#include "AtemInputIndex.h"
+#include "AtemSeqLock.h"
 
-namespace ofxAtem {
+#ifdef OFX_ATEM_HAS_COM
+#include "AtemComBackend.h"
+#endif
 
-	struct Input {
-		std::string shortName;
-		std::string longName;
-		BMDSwitcherInputId bmdId;
-		int index;
-		std::string portType;
-	};
+#ifdef OFX_ATEM_HAS_NATIVE
+#include "AtemUdpBackend.h"
+#include "AtemReplayBackend.h"
+#endif
 
-	class Device {
+namespace ofxAtem {
+
+	// Switcher connection, with the transport picked at compile time.
+	// Backend is ComBackend, UdpBackend or FakeBackend; it is called directly,
+	// so the set / read paths below inline into the caller.
+	template<typename Backend>
+	class BasicDevice {
 	public:
-		Device() {}
-		~Device() {}
+		// Mix effect blocks mirrored, as many as the largest switchers have
+		static const int kMaxMixEffectBlocks = 4;
+
+		BasicDevice() {}
+		~BasicDevice() {
+			setAutoFlush(false);
+			if (synced || connectPending) disconnect();
+		}
 
-		bool connect(const std::string& ipAddress);
-		void printInfo();
+		// Blocks until the switcher state is synchronised
+		bool connect(const std::string& ipAddress) { return connectAsync(ipAddress).get(); }
+		// Returns at once; the future and the ready event follow when the state dump is in.
+		// On the native backend both come from the receive thread.
+		std::future<bool> connectAsync(const std::string& ipAddress);
+		void printInfo() { backend.printInfo(); }
 		void disconnect();
 
-		bool setProgramByIndex(int index);
-		bool setPreviewByIndex(int index);
-		int getProgramIndex() const;
-		int getPreviewIndex() const;
+		bool isReady() const { return synced; }
+		// False between the disconnected and reconnected events; set calls made meanwhile are
+		// held by the backend and replayed once the link is back
+		bool isOnline() const { return synced && online; }
+
+		// On mix effect block me, to the input at index in the input map. False if either is out of range.
+		bool setProgram(int me, int index) {
+			const Input* input = getInput(index);
+			if (!isMixEffectBlock(me) || !input) return false;
+			return delivered(backend.setProgramInput(me, input->bmdId));
+		}
+		bool setPreview(int me, int index) {
+			const Input* input = getInput(index);
+			if (!isMixEffectBlock(me) || !input) return false;
+			return delivered(backend.setPreviewInput(me, input->bmdId));
+		}
+		bool setKeyerOnAir(int me, int keyer, bool onAir) { return isMixEffectBlock(me) && delivered(backend.setKeyerOnAir(me, keyer, onAir)); }
+
+		// The same on ME 0
+		bool setProgramByIndex(int index) { return setProgram(0, index); }
+		bool setPreviewByIndex(int index) { return setPreview(0, index); }
+		bool setKeyerOnAir(int keyer, bool onAir) { return setKeyerOnAir(0, keyer, onAir); }
+		bool setAuxSourceByIndex(int aux, int index) {
+			const Input* input = getInput(index);
+			if (!input) return false;
+			return delivered(backend.setAuxSource(aux, input->bmdId));
+		}
+
+		// Commands issued between beginBatch() and commitBatch() are sent in one datagram,
+		// so multi-parameter changes land on the same switcher frame. Batches nest.
+		void beginBatch() { backend.beginBatch(); }
+		bool commitBatch() { return delivered(backend.commitBatch()); }
+
+		// Batches every command issued during ofApp::update() and sends them right after it
+		void setAutoFlush(bool enable) {
+			if (enable == autoFlush) return;
+			autoFlush = enable;
+			if (enable) {
+				ofAddListener(ofEvents().update, this, &BasicDevice::onUpdateBegin, OF_EVENT_ORDER_BEFORE_APP);
+				ofAddListener(ofEvents().update, this, &BasicDevice::onUpdateEnd, OF_EVENT_ORDER_AFTER_APP);
+			} else {
+				ofRemoveListener(ofEvents().update, this, &BasicDevice::onUpdateBegin, OF_EVENT_ORDER_BEFORE_APP);
+				ofRemoveListener(ofEvents().update, this, &BasicDevice::onUpdateEnd, OF_EVENT_ORDER_AFTER_APP);
+			}
+		}
+		// Mix effect blocks of the switcher, up to kMaxMixEffectBlocks; 0 until ready
+		int getMixEffectBlockCount() const { return mixEffectBlocks; }
+
+		// -1 until known. Safe from any thread, like getMixEffectState().
+		int getProgramIndex(int me = 0) const { return getMixEffectState(me).programIndex; }
+		int getPreviewIndex(int me = 0) const { return getMixEffectState(me).previewIndex; }
+
+		// Program, preview, transition and keyers of mix effect block me as one consistent snapshot,
+		// lock-free for the caller on any thread: it never blocks on the backend thread updating it.
+		// The version counts the changes Device has seen on that block, so a render thread can tell
+		// when to look again. Blocks the switcher does not have read as the default state.
+		MixEffectState getMixEffectState(int me = 0) const {
+			MixEffectState state;
+			getMixEffectState(me, state);
+			return state;
+		}
+		uint64_t getMixEffectState(int me, MixEffectState& state) const {
+			if (me < 0 || me >= kMaxMixEffectBlocks) {
+				state = MixEffectState();
+				return 0;
+			}
+			return mixEffects[me].state.load(state);
+		}
+		uint64_t getMixEffectVersion(int me = 0) const {
+			return me < 0 || me >= kMaxMixEffectBlocks ? 0 : mixEffects[me].state.getVersion();
+		}
 
 		const std::string& getProductName() const { return productName; }
 
-		const std::vector<ofPtr<Input>>& getInputMap() const { return inputMap; }
+		// The input map is replaced as a whole when the switcher's inputs change, never modified in
+		// place, and may be read from any thread. The vector returned keeps the inputs it had, and
+		// stays valid until the next connect() or the device is destroyed, even after inputsChanged
+		// announced a newer one; call again then to get that.
+		const std::vector<ofPtr<Input>>& getInputMap() const { return getInputTable().inputs; }
+		// Constant time and allocation free, through tables built with the input map.
+		// nullptr / -1 for an id or name that is not in it.
+		const Input* getInputById(BMDSwitcherInputId id) const {
+			const InputTable& table = getInputTable();
+			int index = table.index.findId(id);
+			return index < 0 ? nullptr : table.inputs[index].get();
+		}
+		int getIndexById(BMDSwitcherInputId id) const { return getInputTable().index.findId(id); }
+		// Long or short name, e.g. "Camera 1" or "CAM1"
+		int getIndexByName(const std::string& name) const { return getInputTable().index.findName(name); }
+
+		// Local clock disciplined to the switcher's timecode, for scheduling on switcher frames,
+		// e.g. getClock().timeOfFrame(getClock().getCurrentFrame() + 10)
+		SwitcherClock& getClock() { return backend.getClock(); }
+
+		// The switcher has to answer a heartbeat every intervalMillis; linkDegraded is notified once
+		// missThreshold intervals went by without a word from it (default 100 ms, 3)
+		void setHeartbeat(int intervalMillis, int missThreshold) { backend.getLinkMonitor().setHeartbeat(intervalMillis, missThreshold); }
+		ConnectionHealth getConnectionHealth() { return backend.getLinkMonitor().getHealth(ofGetElapsedTimeMicros()); }
 
-		void onMixEffectBlockUpdated(BMDSwitcherMixEffectBlockEventType& e);
+		// Transition position and frames remaining come every frame during a transition; the
+		// backend merges them per block between deliveries, so listeners get the latest once per
+		// batch rather than every switcher notification. Pick other types and read the merge
+		// counts here, e.g. getEventCoalescer().setCoalesced(type, false) before connect().
+		EventCoalescer& getEventCoalescer() { return backend.getEventCoalescer(); }
+
+		// Backend callbacks: once per connect, and whenever the switcher's input list changed
+		void onBackendConnected(bool success);
+		// The link was lost after the initial sync, and is back with the state resynchronised
+		void onBackendDisconnected() {
+			online = false;
+			ofNotifyEvent(disconnected);
+		}
+		void onBackendReconnected();
+		// The switcher stopped answering heartbeats, and was heard again
+		void onLinkDegraded(ConnectionHealth& health) { ofNotifyEvent(linkDegraded, health); }
+		void onLinkRestored(ConnectionHealth& health) { ofNotifyEvent(linkRestored, health); }
+		void onInputsChanged() {
+			readInputMap();
+			readMixEffectStates();
+			ofNotifyEvent(inputsChanged);
+		}
+
+		void onMixEffectBlockUpdated(MixEffectEvent& e) {
+			if (!synced || !isMixEffectBlock(e.me)) return;
+
+			// kKeyerOnAirChanged is not one of the SDK's values, so it cannot be a case below
+			bool refresh = e.type == kKeyerOnAirChanged;
+			switch (e.type) {
+			case bmdSwitcherMixEffectBlockEventTypeProgramInputChanged:
+			case bmdSwitcherMixEffectBlockEventTypePreviewInputChanged:
+			case bmdSwitcherMixEffectBlockEventTypeInTransitionChanged:
+			case bmdSwitcherMixEffectBlockEventTypeTransitionPositionChanged:
+			case bmdSwitcherMixEffectBlockEventTypeTransitionFramesRemainingChanged:
+				refresh = true;
+				break;
+			default:
+				break;
+			}
+			if (refresh) readMixEffectState(e.me);
+			notifyMixEffectChanged(e);
+		}
+
+		// Notified once Device has refreshed its own state for the change, on any mix effect block.
+		// Keyers going on or off air come as kKeyerOnAirChanged.
+		ofEvent<BMDSwitcherMixEffectBlockEventType> mixEffectBlockChanged;
+		// The same, with the block it happened on
+		ofEvent<MixEffectEvent> mixEffectChanged;
+		// Notified once the input map can be read: the state dump is complete, or on the native
+		// backend a cached snapshot of it has been loaded
+		ofEvent<void> ready;
+		// Notified after the input map was rebuilt, e.g. when a warm start from the state cache
+		// turned out to have stale input names
+		ofEvent<void> inputsChanged;
+		// Notified when the connection to the switcher drops, and once it has been re-established.
+		// Changes made on the switcher in between arrive as mixEffectBlockChanged before reconnected.
+		ofEvent<void> disconnected;
+		ofEvent<void> reconnected;
+		// Notified when the switcher stops answering heartbeats, well before the link is given up on,
+		// and when it is heard again. The link stays up meanwhile, and unless it recovers
+		// disconnected follows once the backend gives up on it.
+		ofEvent<ConnectionHealth> linkDegraded;
+		ofEvent<ConnectionHealth> linkRestored;
+
+		Backend& getBackend() { return backend; }
 
 	private:
-		bool readActiveIds();
+		void onUpdateBegin(ofEventArgs&) { beginBatch(); }
+		void onUpdateEnd(ofEventArgs&) { commitBatch(); }
+
+		// Lets a backend that reports commands synchronously hand over their events, as direct calls
+		bool delivered(bool result) {
+			backend.deliver(*this);
+			return result;
+		}
+
+		bool isMixEffectBlock(int me) const { return me >= 0 && me < mixEffectBlocks; }
+		// nullptr if index is not in the input map
+		const Input* getInput(int index) const {
+			const std::vector<ofPtr<Input>>& inputs = getInputTable().inputs;
+			return index >= 0 && index < (int)inputs.size() ? inputs[index].get() : nullptr;
+		}
+
+		// Refreshes the snapshot of block me; what the backend cannot tell keeps its last value
+		bool readMixEffectState(int me) {
+			// Snapshots take one writer at a time, readers never take this
+			std::lock_guard<std::mutex> lock(mixEffectMutex);
+			SeqLock<MixEffectState>& snapshot = mixEffects[me].state;
+			MixEffectState state = snapshot.load();
+			bool resultProgram = backend.getProgramInput(me, state.program);
+			bool resultPreview = backend.getPreviewInput(me, state.preview);
+			backend.getTransition(me, state.transition);
+			backend.getKeyersOnAir(me, state.keyersOnAir);
+
+			const InputIndex& inputIndex = getInputTable().index;
+			if (resultProgram) state.programIndex = inputIndex.findId(state.program);
+			if (resultPreview) state.previewIndex = inputIndex.findId(state.preview);
+			if (state != snapshot.load()) snapshot.store(state);
+
+			return resultProgram && resultPreview;
+		}
+		// Every block, after the switcher may have changed
+		void readMixEffectStates();
+		void notifyMixEffectChanged(MixEffectEvent& e) {
+			ofNotifyEvent(mixEffectBlockChanged, e.type);
+			ofNotifyEvent(mixEffectChanged, e);
+		}
+
 		bool readInputMap();
+		// Frees the input maps replaced since the last connect, once no backend thread runs
+		void releaseInputTables();
 
-		CComPtr<IBMDSwitcherDiscovery> switcherDiscovery;
-		CComPtr<IBMDSwitcher> switcher;
-		std::vector<CComPtr<IBMDSwitcherInput>>	switcherInputs;
-		std::vector<CComPtr<IBMDSwitcherMixEffectBlock>> switcherMixEffectBlocks;
-		CComQIPtr<IBMDSwitcherMediaPool> switcherMediaPool;
-		CComPtr<IBMDSwitcherStills>	switcherStills;
-		CComQIPtr<IBMDSwitcherFairlightAudioMixer> fairlightAudioMixer;
+		Backend backend;
 		std::string	productName;
+		std::atomic<bool> synced{ false };
+		std::atomic<bool> connectPending{ false };
+		std::atomic<bool> online{ false };
+		std::promise<bool> connectResult;
+		bool autoFlush = false;
 
-		SwitcherMonitor* switcherMonitor;
-		std::vector<InputMonitor*> inputMonitors;
-		std::vector<MixEffectBlockMonitor*> mixEffectBlockMonitors;
+		// An input map with its lookup tables, never modified once published
+		struct InputTable {
+			std::vector<ofPtr<Input>> inputs;
+			InputIndex index;
+		};
+		const InputTable& getInputTable() const { return *inputTable.load(std::memory_order_acquire); }
 
-		std::vector<ofPtr<Input>> inputMap;
-		ofPtr<Input> currentProgram, currentPreview;
+		// Rebuilt off to the side on the backend's thread and swapped in, so readers on other
+		// threads never see one half built. The ones replaced are kept until the next connect,
+		// when no backend thread is left to publish another.
+		InputTable noInputs;
+		std::atomic<const InputTable*> inputTable{ &noInputs };
+		std::vector<std::unique_ptr<InputTable>> inputTables;
+
+		// Each block's snapshot on cache lines of its own, so readers of one block never
+		// contend with stores to another
+		struct alignas(64) MixEffectSlot {
+			SeqLock<MixEffectState> state;
+		};
+		std::array<MixEffectSlot, kMaxMixEffectBlocks> mixEffects;
+		std::atomic<int> mixEffectBlocks{ 0 };
+		std::mutex mixEffectMutex;
 	};
 
+#ifdef OFX_ATEM_USE_COM
+	typedef BasicDevice<ComBackend> Device;
+#else
+	typedef BasicDevice<UdpBackend> Device;
+#endif
+
+#ifdef OFX_ATEM_HAS_COM
+	typedef BasicDevice<ComBackend> ComDevice;
+#endif
+
+#ifdef OFX_ATEM_HAS_NATIVE
+	typedef BasicDevice<UdpBackend> NativeDevice;
+	// connect() takes the path of a recording made with UdpBackend::getRecorder()
+	typedef BasicDevice<ReplayBackend> ReplayDevice;
+#endif
 
 }